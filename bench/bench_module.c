@@ -0,0 +1,87 @@
+#include "postgres.h"
+#include "optimizer_bench.h"
+#include "../src/optimizer/optimizer.h"
+
+#include "access/htup_details.h"
+#include "fmgr.h"
+#include "funcapi.h"
+#include "utils/builtins.h"
+
+// The benchmarks' own module: it links the optimizer but not the extension,
+// so it loads without pg_carbon's hooks and settings. pg_carbon_bench
+// creates the function in pg_temp.
+PG_MODULE_MAGIC;
+
+static const struct {
+  const char *name;
+  CarbonBenchShape shape;
+} bench_shapes[] = {
+    {"chain", CARBON_BENCH_CHAIN},
+    {"star", CARBON_BENCH_STAR},
+    {"cycle", CARBON_BENCH_CYCLE},
+    {"clique", CARBON_BENCH_CLIQUE},
+    {"scan", CARBON_BENCH_SCAN},
+    {"scan-search", CARBON_BENCH_SCAN_SEARCH},
+};
+
+// pg_carbon_bench(shape, relations, iterations, time_budget): optimizes a
+// synthetic join graph or scan; see pg_carbon_bench_run(). time_budget is
+// pg_carbon.search_time_budget in microseconds, 0 for none.
+PG_FUNCTION_INFO_V1(pg_carbon_bench);
+
+Datum pg_carbon_bench(PG_FUNCTION_ARGS) {
+  char *shape_name = text_to_cstring(PG_GETARG_TEXT_PP(0));
+  int relations = PG_GETARG_INT32(1);
+  int iterations = PG_GETARG_INT32(2);
+  int time_budget = PG_GETARG_INT32(3);
+  int shape = -1;
+  TupleDesc tupdesc;
+  CarbonBenchResult result;
+  Datum values[11];
+  bool nulls[11] = {false};
+  int n = 0;
+
+  for (int i = 0; i < lengthof(bench_shapes); i++) {
+    if (strcmp(shape_name, bench_shapes[i].name) == 0)
+      shape = bench_shapes[i].shape;
+  }
+  if (shape < 0)
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("unknown join graph \"%s\"", shape_name),
+                    errhint("Use chain, star, cycle, clique, scan or "
+                            "scan-search.")));
+  if (relations < 2 || relations > 100)
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("relations must be between 2 and 100")));
+  if (iterations < 1 || time_budget < 0)
+    ereport(ERROR,
+            (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+             errmsg("iterations must be at least 1 and time_budget must not "
+                    "be negative")));
+  if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+    elog(ERROR, "return type must be a row type");
+
+  pg_carbon_search_time_budget = time_budget;
+  pg_carbon_single_table_fast_path = shape != CARBON_BENCH_SCAN_SEARCH;
+  pg_carbon_bench_run((CarbonBenchShape)shape, relations, iterations,
+                      &result);
+
+  values[n++] = Float8GetDatum(result.min_time_ms);
+  values[n++] = Float8GetDatum(result.mean_time_ms);
+  values[n++] = Float8GetDatum(result.max_time_ms);
+  values[n++] = Int64GetDatum((int64)result.peak_memory);
+  values[n++] = Int64GetDatum((int64)result.stats.memory);
+  values[n++] = Int64GetDatum(result.stats.groups);
+  values[n++] = Int64GetDatum(result.stats.expressions);
+  values[n++] = Int32GetDatum(result.stats.stage);
+  values[n++] = BoolGetDatum(result.stats.exhausted);
+  if (result.total_cost >= 0)
+    values[n++] = Float8GetDatum(result.total_cost);
+  else
+    nulls[n++] = true;
+  values[n++] = Int64GetDatum(result.stats.tasks[CARBON_TASK_APPLY_RULE]);
+  Assert(n == lengthof(values));
+
+  PG_RETURN_DATUM(
+      HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
@@ -0,0 +1,250 @@
+#include "optimizer_bench.h"
+#include "../src/metadata/metadata.h"
+#include "../src/operators/operators.h"
+#include "../src/optimizer/optimizer.h"
+#include "../src/optimizer/translator.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+extern "C" {
+#include "catalog/pg_operator_d.h"
+#include "catalog/pg_opfamily_d.h"
+#include "catalog/pg_type_d.h"
+#include "nodes/makefuncs.h"
+#include "portability/instr_time.h"
+#include "utils/fmgroids.h"
+#include "utils/memutils.h"
+}
+
+namespace pg_carbon {
+
+// Oids of the synthetic tables, well above what a test database assigns.
+// The search never looks them up in the catalogs.
+static const Oid kFirstTableOid = 3000000000u;
+
+// Tables t_0 .. t_{n-1}: int4 columns 1 .. n + 1, of which column 1 is a
+// unique key with a btree index and column k + 2 references t_k. t_0 is the
+// large one, the fact table of a star.
+class MockCatalog : public CatalogProvider {
+public:
+  explicit MockCatalog(int relations) : relations_(relations) {}
+
+  static Oid TableOid(int table) { return kFirstTableOid + table; }
+  static double TableRows(int table) {
+    return table == 0 ? 1000000.0 : 1000.0 * (1 + table * 37 % 97);
+  }
+
+  TableMetadata *LoadTable(Oid table_oid) override {
+    int table = Table(table_oid);
+    auto *metadata = new TableMetadata();
+    metadata->rows = TableRows(table);
+    metadata->pages = std::ceil(metadata->rows / 100);
+    for (AttrNumber attnum = 1; attnum <= relations_ + 1; attnum++) {
+      ColumnMetadata column;
+      column.attnum = attnum;
+      column.type = INT4OID;
+      metadata->columns.push_back(column);
+    }
+
+    UniqueKey key;
+    key.columns.push_back(1);
+    key.opfamilies.push_back(INTEGER_BTREE_FAM_OID);
+    metadata->unique_keys.push_back(std::move(key));
+
+    IndexMetadata index;
+    index.oid = TableOid(relations_ + table);
+    index.unique = true;
+    index.columns.push_back(1);
+    index.opfamilies.push_back(INTEGER_BTREE_FAM_OID);
+    index.collations.push_back(InvalidOid);
+    index.descending.push_back(false);
+    index.nulls_first.push_back(false);
+    index.pages = std::ceil(metadata->rows / 300);
+    index.tuples = metadata->rows;
+    index.tree_height = metadata->rows > 100000 ? 2 : 1;
+    metadata->indexes.push_back(std::move(index));
+    return metadata;
+  }
+
+  int32 LoadColumnWidth(Oid, AttrNumber) override { return 4; }
+
+  ColumnStats LoadColumnStats(Oid table_oid, AttrNumber attr_num) override {
+    double rows = TableRows(Table(table_oid));
+    ColumnStats stats;
+    stats.ndistinct = attr_num == 1
+                          ? rows
+                          : std::min(rows, TableRows(attr_num - 2));
+    return stats;
+  }
+
+  bool LoadPartitionBoundsMatch(Oid, Oid) override { return false; }
+
+private:
+  int Table(Oid table_oid) const {
+    int table = (int)(table_oid - kFirstTableOid);
+    if (table_oid < kFirstTableOid || table >= relations_)
+      elog(ERROR, "pg_carbon: table %u is not in the mock catalog",
+           table_oid);
+    return table;
+  }
+
+  int relations_;
+};
+
+// t_from.c_{to + 2} = t_to.c_1, a foreign key join as the translator would
+// describe it. Table t_i is range table entry i + 1.
+static Predicate *MakeJoinPredicate(int from, int to) {
+  ColumnRef foreign_key;
+  foreign_key.rt_index = from + 1;
+  foreign_key.table_oid = MockCatalog::TableOid(from);
+  foreign_key.attr_num = to + 2;
+  ColumnRef key;
+  key.rt_index = to + 1;
+  key.table_oid = MockCatalog::TableOid(to);
+  key.attr_num = 1;
+
+  Var *left = makeVar(foreign_key.rt_index, foreign_key.attr_num, INT4OID,
+                      -1, InvalidOid, 0);
+  Var *right = makeVar(key.rt_index, key.attr_num, INT4OID, -1, InvalidOid, 0);
+  auto *clause =
+      (OpExpr *)make_opclause(Int4EqualOperator, BOOLOID, false, (Expr *)left,
+                              (Expr *)right, InvalidOid, InvalidOid);
+  clause->opfuncid = F_INT4EQ;
+
+  Predicate *pred = Translator::DescribePredicate(
+      (Node *)clause, 1.0 / MockCatalog::TableRows(to));
+  pred->SetColumnOperands(Int4EqualOperator, foreign_key, key);
+  return pred;
+}
+
+// What the translator makes of SELECT FROM t_0, ..., t_{n-1} WHERE <the
+// joins of `shape`>: a cross join of the tables under a filter.
+static Operator *MakeJoinGraph(CarbonBenchShape shape, int relations) {
+  PredicateList predicates;
+  switch (shape) {
+  case CARBON_BENCH_CHAIN:
+  case CARBON_BENCH_CYCLE:
+    for (int i = 0; i + 1 < relations; i++)
+      predicates.push_back(MakeJoinPredicate(i + 1, i));
+    // Two tables are a chain already.
+    if (shape == CARBON_BENCH_CYCLE && relations > 2)
+      predicates.push_back(MakeJoinPredicate(0, relations - 1));
+    break;
+  case CARBON_BENCH_STAR:
+    for (int i = 1; i < relations; i++)
+      predicates.push_back(MakeJoinPredicate(0, i));
+    break;
+  case CARBON_BENCH_CLIQUE:
+    for (int i = 0; i < relations; i++)
+      for (int j = i + 1; j < relations; j++)
+        predicates.push_back(MakeJoinPredicate(i, j));
+    break;
+  default:
+    break;
+  }
+
+  Operator *from = nullptr;
+  for (int i = 0; i < relations; i++) {
+    auto *get = new LogicalGet(MockCatalog::TableOid(i), i + 1);
+    if (!from) {
+      from = get;
+      continue;
+    }
+    auto *join = new LogicalInnerJoin();
+    join->AddInput(from);
+    join->AddInput(get);
+    from = join;
+  }
+  auto *filter = new LogicalFilter(std::move(predicates));
+  filter->AddInput(from);
+  Translator::DeriveRequiredColumns(filter, new AttrSet());
+  return filter;
+}
+
+// What the translator makes of SELECT FROM t_0 WHERE c_1 = 1 AND ... AND
+// c_n = 1: a filter of the table alone.
+static Operator *MakeScan(int columns) {
+  PredicateList predicates;
+  for (AttrNumber attnum = 1; attnum <= columns; attnum++) {
+    Var *column = makeVar(1, attnum, INT4OID, -1, InvalidOid, 0);
+    Const *value = makeConst(INT4OID, -1, InvalidOid, sizeof(int32),
+                             Int32GetDatum(1), false, true);
+    auto *clause = (OpExpr *)make_opclause(Int4EqualOperator, BOOLOID, false,
+                                           (Expr *)column, (Expr *)value,
+                                           InvalidOid, InvalidOid);
+    clause->opfuncid = F_INT4EQ;
+    // Column k + 2 references t_k, so it has as many values as t_k rows.
+    double ndistinct = MockCatalog::TableRows(attnum == 1 ? 0 : attnum - 2);
+    predicates.push_back(
+        Translator::DescribePredicate((Node *)clause, 1.0 / ndistinct));
+  }
+
+  auto *filter = new LogicalFilter(std::move(predicates));
+  filter->AddInput(new LogicalGet(MockCatalog::TableOid(0), 1));
+  Translator::DeriveRequiredColumns(filter, new AttrSet());
+  return filter;
+}
+
+// Static, so that an error in the search does not leave Memory counting
+// into a stack frame that is gone
+static MemoryUsage memory_usage;
+
+// One optimization of the join graph; returns its time in milliseconds
+static double RunOnce(MockCatalog *catalog, CarbonBenchShape shape,
+                      int relations, CarbonBenchResult *result) {
+  instr_time start, duration;
+
+  MetadataAccessor::SetProvider(catalog);
+  Operator *root_op =
+      shape == CARBON_BENCH_SCAN || shape == CARBON_BENCH_SCAN_SEARCH
+          ? MakeScan(relations)
+          : MakeJoinGraph(shape, relations);
+
+  memset(&result->stats, 0, sizeof(CarbonStats));
+  memory_usage = MemoryUsage();
+  Memory::Track(&memory_usage);
+  INSTR_TIME_SET_CURRENT(start);
+  Optimizer optimizer(&result->stats);
+  GroupExpression *best = optimizer.Optimize(root_op);
+  INSTR_TIME_SET_CURRENT(duration);
+  Memory::Track(nullptr);
+  INSTR_TIME_SUBTRACT(duration, start);
+
+  result->stats.time_ms = INSTR_TIME_GET_MILLISEC(duration);
+  result->peak_memory = std::max(result->peak_memory, memory_usage.peak);
+  result->total_cost = best ? best->GetCost().total : -1;
+  return result->stats.time_ms;
+}
+
+} // namespace pg_carbon
+
+extern "C" {
+void pg_carbon_bench_run(CarbonBenchShape shape, int relations,
+                         int iterations, CarbonBenchResult *result) {
+  MemoryContext caller = CurrentMemoryContext;
+  auto *catalog = new pg_carbon::MockCatalog(relations);
+  double total_time = 0.0;
+
+  memset(result, 0, sizeof(CarbonBenchResult));
+  result->min_time_ms = DBL_MAX;
+  for (int i = 0; i < iterations; i++) {
+    // As in a planning run, everything lives in a memory context of its own
+    MemoryContext context = AllocSetContextCreate(
+        caller, "pg_carbon benchmark", ALLOCSET_DEFAULT_SIZES);
+    MemoryContextSwitchTo(context);
+    pg_carbon::MetadataAccessor::ResetCache();
+
+    double time_ms = pg_carbon::RunOnce(catalog, shape, relations, result);
+    total_time += time_ms;
+    result->min_time_ms = std::min(result->min_time_ms, time_ms);
+    result->max_time_ms = std::max(result->max_time_ms, time_ms);
+
+    MemoryContextSwitchTo(caller);
+    pg_carbon::MetadataAccessor::ResetCache();
+    MemoryContextDelete(context);
+  }
+  result->mean_time_ms = total_time / iterations;
+  delete catalog;
+}
+}
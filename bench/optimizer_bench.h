@@ -0,0 +1,42 @@
+#ifndef PG_CARBON_OPTIMIZER_BENCH_H
+#define PG_CARBON_OPTIMIZER_BENCH_H
+
+#include "../src/optimizer/instrumentation.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Join graphs of the benchmarks, over tables t_0 .. t_{n-1}. The scans are
+// of t_0 alone, filtered on its first n columns, to compare the
+// single-table fast path with the search.
+typedef enum CarbonBenchShape {
+  CARBON_BENCH_CHAIN,       // t_i joins t_{i+1}
+  CARBON_BENCH_STAR,        // t_0 joins every other table
+  CARBON_BENCH_CYCLE,       // a chain whose ends join too
+  CARBON_BENCH_CLIQUE,      // every table joins every other
+  CARBON_BENCH_SCAN,        // planned by the fast path
+  CARBON_BENCH_SCAN_SEARCH, // searched, with the fast path off
+} CarbonBenchShape;
+
+typedef struct CarbonBenchResult {
+  double min_time_ms;
+  double mean_time_ms;
+  double max_time_ms;
+  Size peak_memory;  // most optimizer memory in use at once
+  double total_cost; // of the chosen plan, or -1 if there is none
+  CarbonStats stats; // of the last run
+} CarbonBenchResult;
+
+// Optimizes the inner join of `relations` synthetic tables joined as
+// `shape` says, or the scan, `iterations` times, under the search budgets
+// of optimizer.h.
+// The tables only exist in a mock catalog, so any database will do.
+void pg_carbon_bench_run(CarbonBenchShape shape, int relations,
+                         int iterations, CarbonBenchResult *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PG_CARBON_OPTIMIZER_BENCH_H
@@ -0,0 +1,305 @@
+// pg_carbon_bench: optimizer microbenchmarks. It measures how long the
+// search takes and how much memory it needs on synthetic join graphs
+// (chain, star, cycle and clique) of a range of sizes, and on a filtered
+// table with and without the single-table fast path (scan and
+// scan-search). It reports the results the way Google Benchmark does, as a
+// table or as JSON that its tools/compare.py reads. Like pg_carbon_replay,
+// it runs the optimizer in a single-user backend on a data directory no
+// server is using; the tables only exist in the benchmarks' mock catalog,
+// and pg_carbon does not have to be installed in the database.
+
+#include "../tools/single_user.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifndef PG_PKGLIBDIR
+#error PG_PKGLIBDIR must be set to the directory of pg_carbon_bench.so
+#endif
+
+// A row of the benchmarks' output; the column list of pg_carbon_bench()
+typedef struct BenchRow {
+  char name[64];
+  double min_time;
+  double mean_time;
+  double max_time;
+  long long peak_memory;
+  long long memory;
+  long long memo_groups;
+  long long memo_expressions;
+  int stage;
+  bool exhausted;
+  bool has_cost;
+  double total_cost;
+  long long rule_applications;
+} BenchRow;
+
+static void usage(const char *progname) {
+  printf("%s benchmarks the pg_carbon optimizer in a single-user "
+         "backend.\n\n"
+         "Usage:\n"
+         "  %s -D DATADIR [OPTION]...\n\n"
+         "Options:\n"
+         "  -D, --pgdata=DATADIR      data directory no server is running on\n"
+         "  -d, --dbname=DBNAME       database to run in (default "
+         "\"postgres\")\n"
+         "  -g, --graphs=LIST         join graphs, from chain, star, cycle, "
+         "clique,\n"
+         "                            scan and scan-search (default all)\n"
+         "  -r, --relations=MIN-MAX   numbers of relations (default 2-30)\n"
+         "  -n, --iterations=N        runs per benchmark (default 10)\n"
+         "  -t, --time-budget=US      pg_carbon.search_time_budget (default "
+         "1000000,\n"
+         "                            0 for none)\n"
+         "  -j, --json                report in Google Benchmark's JSON "
+         "format\n"
+         "  -?, --help                show this help, then exit\n",
+         progname, progname);
+}
+
+// "1.5 MiB" for a byte count
+static const char *format_bytes(long long bytes, char *buf, size_t size) {
+  static const char *const units[] = {"B", "KiB", "MiB", "GiB"};
+  double value = (double)bytes;
+  int unit = 0;
+
+  while (value >= 1024 && unit < 3) {
+    value /= 1024;
+    unit++;
+  }
+  snprintf(buf, size, unit == 0 ? "%.0f %s" : "%.1f %s", value,
+           units[unit]);
+  return buf;
+}
+
+// Parses a line of the CSV the backend wrote; false if it is malformed
+static bool parse_row(char *line, BenchRow *row) {
+  char *fields[13];
+  int n = 0;
+  char *field;
+
+  line[strcspn(line, "\r\n")] = '\0';
+  while (n < 13 && (field = strsep(&line, ",")) != NULL)
+    fields[n++] = field;
+  if (n != 13 || line != NULL)
+    return false;
+
+  snprintf(row->name, sizeof(row->name), "BM_Optimize/%s/%s", fields[0],
+           fields[1]);
+  row->min_time = strtod(fields[2], NULL);
+  row->mean_time = strtod(fields[3], NULL);
+  row->max_time = strtod(fields[4], NULL);
+  row->peak_memory = strtoll(fields[5], NULL, 10);
+  row->memory = strtoll(fields[6], NULL, 10);
+  row->memo_groups = strtoll(fields[7], NULL, 10);
+  row->memo_expressions = strtoll(fields[8], NULL, 10);
+  row->stage = atoi(fields[9]);
+  row->exhausted = strcmp(fields[10], "t") == 0;
+  row->has_cost = fields[11][0] != '\0';
+  row->total_cost = row->has_cost ? strtod(fields[11], NULL) : 0.0;
+  row->rule_applications = strtoll(fields[12], NULL, 10);
+  return true;
+}
+
+static void print_console(const BenchRow *rows, int nrows, int iterations) {
+  char peak[32];
+
+  printf("%-28s %12s %12s %12s %10s\n", "Benchmark", "Time", "Min", "Max",
+         "Iterations");
+  for (int i = 0; i < 78; i++)
+    putchar('-');
+  putchar('\n');
+  for (int i = 0; i < nrows; i++) {
+    const BenchRow *row = &rows[i];
+    printf("%-28s %9.3f ms %9.3f ms %9.3f ms %10d groups=%lld "
+           "expressions=%lld rules=%lld peak_memory=%s stage=%d%s\n",
+           row->name, row->mean_time, row->min_time, row->max_time,
+           iterations, row->memo_groups, row->memo_expressions,
+           row->rule_applications,
+           format_bytes(row->peak_memory, peak, sizeof(peak)), row->stage,
+           row->exhausted ? " budget_exhausted" : "");
+  }
+}
+
+static void print_json(const BenchRow *rows, int nrows, int iterations,
+                       int time_budget) {
+  printf("{\n"
+         "  \"context\": {\n"
+         "    \"executable\": \"pg_carbon_bench\",\n"
+         "    \"library_build_type\": \"release\",\n"
+         "    \"time_budget_us\": %d\n"
+         "  },\n"
+         "  \"benchmarks\": [",
+         time_budget);
+  for (int i = 0; i < nrows; i++) {
+    const BenchRow *row = &rows[i];
+    // The search runs in one thread, so its CPU time is its wall time.
+    printf("%s\n    {\n"
+           "      \"name\": \"%s\",\n"
+           "      \"run_name\": \"%s\",\n"
+           "      \"run_type\": \"iteration\",\n"
+           "      \"iterations\": %d,\n"
+           "      \"real_time\": %.6f,\n"
+           "      \"cpu_time\": %.6f,\n"
+           "      \"time_unit\": \"ms\",\n"
+           "      \"min_time\": %.6f,\n"
+           "      \"max_time\": %.6f,\n"
+           "      \"peak_memory\": %lld,\n"
+           "      \"memory\": %lld,\n"
+           "      \"memo_groups\": %lld,\n"
+           "      \"memo_expressions\": %lld,\n"
+           "      \"rule_applications\": %lld,\n"
+           "      \"stage\": %d,\n"
+           "      \"budget_exhausted\": %d,\n",
+           i > 0 ? "," : "", row->name, row->name, iterations,
+           row->mean_time, row->mean_time, row->min_time, row->max_time,
+           row->peak_memory, row->memory, row->memo_groups,
+           row->memo_expressions, row->rule_applications, row->stage,
+           row->exhausted);
+    if (row->has_cost)
+      printf("      \"total_cost\": %.2f\n    }", row->total_cost);
+    else
+      printf("      \"total_cost\": null\n    }");
+  }
+  printf("\n  ]\n}\n");
+}
+
+int main(int argc, char **argv) {
+  static const struct option long_options[] = {
+      {"pgdata", required_argument, NULL, 'D'},
+      {"dbname", required_argument, NULL, 'd'},
+      {"graphs", required_argument, NULL, 'g'},
+      {"relations", required_argument, NULL, 'r'},
+      {"iterations", required_argument, NULL, 'n'},
+      {"time-budget", required_argument, NULL, 't'},
+      {"json", no_argument, NULL, 'j'},
+      {NULL, 0, NULL, 0}};
+  const char *progname = argv[0];
+  const char *datadir = NULL;
+  const char *dbname = "postgres";
+  char *graphs = strdup("chain,star,cycle,clique,scan,scan-search");
+  int min_relations = 2;
+  int max_relations = 30;
+  int iterations = 10;
+  int time_budget = 1000000;
+  bool json = false;
+  int c;
+
+  if (argc > 1 &&
+      (strcmp(argv[1], "--help") == 0 || strcmp(argv[1], "-?") == 0)) {
+    usage(progname);
+    exit(0);
+  }
+  while ((c = getopt_long(argc, argv, "D:d:g:r:n:t:j", long_options,
+                          NULL)) != -1) {
+    switch (c) {
+    case 'D':
+      datadir = optarg;
+      break;
+    case 'd':
+      dbname = optarg;
+      break;
+    case 'g':
+      free(graphs);
+      graphs = strdup(optarg);
+      break;
+    case 'r':
+      if (sscanf(optarg, "%d-%d", &min_relations, &max_relations) == 1)
+        max_relations = min_relations;
+      break;
+    case 'n':
+      iterations = atoi(optarg);
+      break;
+    case 't':
+      time_budget = atoi(optarg);
+      break;
+    case 'j':
+      json = true;
+      break;
+    default:
+      fprintf(stderr, "Try \"%s --help\" for more information.\n",
+              progname);
+      exit(1);
+    }
+  }
+  if (!datadir || optind < argc || iterations < 1 || time_budget < 0 ||
+      min_relations < 2 || max_relations < min_relations) {
+    fprintf(stderr, "%s: a data directory is required, relations must be a "
+                    "range from at least 2, and iterations must be at least "
+                    "1\n",
+            progname);
+    fprintf(stderr, "Try \"%s --help\" for more information.\n", progname);
+    exit(1);
+  }
+
+  // The backend writes the results here, as CSV.
+  char results[] = "/tmp/pg_carbon_bench_XXXXXX";
+  int fd = mkstemp(results);
+  if (fd < 0) {
+    fprintf(stderr, "%s: could not create a temporary file: %s\n", progname,
+            strerror(errno));
+    exit(1);
+  }
+  close(fd);
+
+  pid_t pid;
+  FILE *backend = single_user_start(progname, datadir, dbname, true, &pid);
+  fprintf(backend,
+          "CREATE FUNCTION pg_temp.pg_carbon_bench(shape text, relations "
+          "int, iterations int, time_budget int, OUT min_time float8, OUT "
+          "mean_time float8, OUT max_time float8, OUT peak_memory int8, OUT "
+          "memory int8, OUT memo_groups int8, OUT memo_expressions int8, OUT "
+          "stage int4, OUT budget_exhausted bool, OUT total_cost float8, OUT "
+          "rule_applications int8) RETURNS record AS ");
+  single_user_literal(backend, PG_PKGLIBDIR "/pg_carbon_bench");
+  fprintf(backend, ", 'pg_carbon_bench' LANGUAGE C STRICT;\n\n");
+  fprintf(backend, "COPY (SELECT g.shape, n, b.* FROM unnest(string_to_array(");
+  single_user_literal(backend, graphs);
+  fprintf(backend,
+          ", ',')) WITH ORDINALITY g(shape, i), generate_series(%d, %d) n, "
+          "pg_temp.pg_carbon_bench(g.shape, n, %d, %d) b ORDER BY g.i, n) "
+          "TO ",
+          min_relations, max_relations, iterations, time_budget);
+  single_user_literal(backend, results);
+  fprintf(backend, " (FORMAT csv);\n\n");
+  int status = single_user_finish(progname, backend, pid);
+
+  FILE *file = fopen(results, "r");
+  int nrows = 0;
+  int capacity = 16;
+  BenchRow *rows = malloc(capacity * sizeof(BenchRow));
+  char line[1024];
+  while (file && fgets(line, sizeof(line), file)) {
+    if (nrows == capacity) {
+      capacity *= 2;
+      rows = realloc(rows, capacity * sizeof(BenchRow));
+    }
+    if (!parse_row(line, &rows[nrows])) {
+      fprintf(stderr, "%s: malformed result line: %s\n", progname, line);
+      status = 1;
+      break;
+    }
+    nrows++;
+  }
+  if (file)
+    fclose(file);
+  unlink(results);
+
+  // Errors in the backend leave no results, but not an exit status.
+  if (nrows == 0) {
+    fprintf(stderr, "%s: the benchmarks did not run; see the backend's "
+                    "messages above\n",
+            progname);
+    exit(1);
+  }
+  if (json)
+    print_json(rows, nrows, iterations, time_budget);
+  else
+    print_console(rows, nrows, iterations);
+  free(rows);
+  free(graphs);
+  return status;
+}
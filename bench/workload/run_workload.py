@@ -0,0 +1,378 @@
+#!/usr/bin/env python3
+"""End-to-end workload benchmarks for pg_carbon: TPC-H and the Join Order
+Benchmark (JOB).
+
+`load` creates a suite's tables in a database and fills them: TPC-H from
+the .tbl files of the TPC-H dbgen tool, JOB from the IMDB CSV files and the
+schema of the JOB repository
+(https://github.com/gregrahn/join-order-benchmark).
+
+`run` runs every query of a suite with pg_carbon.enable off and on, under
+EXPLAIN (ANALYZE, CARBON), and writes a JSON report: planning and execution
+times, estimated and actual rows, and which planner planned each query, from
+which follows pg_carbon's fallback rate. Each query also runs once more in
+each mode to check that both return the same rows; queries that do not are
+reported as wrong results, and make `run` exit with status 1.
+
+`compare` sets two reports side by side, such as those of two releases.
+
+The database is reached with psql, so the usual PG* environment variables
+apply. pg_carbon has to be installed on the server; the sessions LOAD it.
+"""
+
+import argparse
+import datetime
+import hashlib
+import json
+import math
+import os
+import re
+import statistics
+import subprocess
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+TPCH_TABLES = ["region", "nation", "part", "supplier", "partsupp", "customer",
+               "orders", "lineitem"]
+MODES = ["off", "on"]
+
+
+def psql_command(args, *extra):
+    command = [args.psql, "-X", "-q", "-v", "ON_ERROR_STOP=1"]
+    if args.dbname:
+        command += ["-d", args.dbname]
+    return command + list(extra)
+
+
+def run_psql(args, sql=None, files=()):
+    """Runs `sql` and then `files` in one session; exits if they fail."""
+    command = psql_command(args)
+    if sql:
+        command += ["-c", sql]
+    for path in files:
+        command += ["-f", path]
+    if subprocess.run(command).returncode != 0:
+        sys.exit("psql failed")
+
+
+def copy_file(args, table, path, options, transform=None):
+    """COPYs the file at `path` into `table`, one line at a time."""
+    print(f"loading {table} from {path}", file=sys.stderr)
+    command = psql_command(args, "-c", f"COPY {table} FROM STDIN ({options})")
+    with subprocess.Popen(command, stdin=subprocess.PIPE) as proc, \
+            open(path, "rb") as data:
+        for line in data:
+            proc.stdin.write(transform(line) if transform else line)
+        proc.stdin.close()
+        if proc.wait() != 0:
+            sys.exit(f"loading {table} failed")
+
+
+def load_tpch(args):
+    run_psql(args, files=[os.path.join(HERE, "tpch", "schema.sql")])
+    for table in TPCH_TABLES:
+        # dbgen ends every line with the delimiter too.
+        copy_file(args, table, os.path.join(args.data, table + ".tbl"),
+                  "DELIMITER '|'",
+                  lambda line: line.rstrip(b"\r\n").rstrip(b"|") + b"\n")
+    run_psql(args, files=[os.path.join(HERE, "tpch", "keys.sql")])
+    run_psql(args, "VACUUM ANALYZE")
+
+
+def load_job(args):
+    if not args.job:
+        sys.exit("--job (a checkout of the JOB repository) is required")
+    schema = open(os.path.join(args.job, "schema.sql")).read()
+    run_psql(args, files=[os.path.join(args.job, "schema.sql")])
+    for table in re.findall(r"CREATE TABLE (\w+)", schema, re.IGNORECASE):
+        copy_file(args, table, os.path.join(args.data, table + ".csv"),
+                  "FORMAT csv, ESCAPE '\\'")
+    run_psql(args, files=[os.path.join(args.job, "fkindexes.sql")])
+    run_psql(args, "VACUUM ANALYZE")
+
+
+def natural_key(name):
+    return [int(part) if part.isdigit() else part
+            for part in re.split(r"(\d+)", name)]
+
+
+def suite_queries(args):
+    """(name, text) of the suite's queries, in their natural order."""
+    if args.suite == "tpch":
+        directory = os.path.join(HERE, "tpch", "queries")
+    elif args.job:
+        directory = args.job
+    else:
+        sys.exit("--job (a checkout of the JOB repository) is required")
+    names = [name for name in os.listdir(directory)
+             if re.fullmatch(r"(q\d+|\d+[a-z])\.sql", name)]
+    queries = []
+    for name in sorted(names, key=natural_key):
+        query = name[:-len(".sql")]
+        if args.queries and query not in args.queries:
+            continue
+        with open(os.path.join(directory, name)) as f:
+            queries.append((query, f.read().strip().rstrip(";")))
+    return queries
+
+
+def plan_nodes(node):
+    yield node
+    for child in node.get("Plans", []):
+        yield from plan_nodes(child)
+
+
+def q_error(estimated, actual):
+    """How far off an estimate was, as a factor of at least 1."""
+    estimated = max(estimated, 1.0)
+    actual = max(actual, 1.0)
+    return max(estimated, actual) / min(estimated, actual)
+
+
+def explain_once(args, mode, query):
+    """One EXPLAIN ANALYZE of `query` with pg_carbon.enable = `mode`."""
+    script = (f"LOAD 'pg_carbon';\n"
+              f"SET pg_carbon.enable = {mode};\n"
+              f"SET statement_timeout = '{args.timeout}s';\n"
+              f"EXPLAIN (ANALYZE, TIMING OFF, FORMAT JSON, CARBON)\n"
+              f"{query};\n")
+    proc = subprocess.run(psql_command(args, "-A", "-t"), input=script,
+                          capture_output=True, text=True)
+    if proc.returncode != 0:
+        status = "timeout" if "statement timeout" in proc.stderr else "error"
+        return {"status": status, "message": proc.stderr.strip()}
+
+    explain = json.loads(proc.stdout)[0]
+    carbon = explain.get("Carbon", {})
+    root = explain["Plan"]
+    # Per loop, as both are reported; nodes that never ran say nothing.
+    errors = [q_error(node["Plan Rows"], node["Actual Rows"])
+              for node in plan_nodes(root) if node.get("Actual Loops")]
+    return {
+        "status": "ok",
+        "planning_ms": explain["Planning Time"],
+        "execution_ms": explain["Execution Time"],
+        "planner": carbon.get("Planner", "PostgreSQL"),
+        "fallback_reason": carbon.get("Fallback Reason"),
+        "total_cost": root["Total Cost"],
+        "estimated_rows": root["Plan Rows"],
+        "actual_rows": root["Actual Rows"],
+        "max_q_error": max(errors, default=1.0),
+        "mean_q_error": geometric_mean(errors) or 1.0,
+    }
+
+
+def result_digest(args, mode, query):
+    """Row count and SHA-256 of the sorted rows of `query` in `mode`, or
+    None if it failed."""
+    script = (f"LOAD 'pg_carbon';\n"
+              f"SET pg_carbon.enable = {mode};\n"
+              f"SET statement_timeout = '{args.timeout}s';\n"
+              f"{query};\n")
+    # Unit separator between fields, so that no value can shift a column
+    proc = subprocess.run(psql_command(args, "-A", "-t", "-F", "\x1f"),
+                          input=script, capture_output=True, text=True)
+    if proc.returncode != 0:
+        return None
+    rows = sorted(proc.stdout.splitlines())
+    digest = hashlib.sha256("\n".join(rows).encode()).hexdigest()
+    return {"rows": len(rows), "sha256": digest}
+
+
+def run_query(args, mode, query):
+    """The runs of `query` in `mode`, summarized by their median times."""
+    for _ in range(args.warmup):
+        explain_once(args, mode, query)
+    runs = [explain_once(args, mode, query) for _ in range(args.runs)]
+    failed = [run for run in runs if run["status"] != "ok"]
+    if failed:
+        return failed[0]
+    result = dict(runs[-1])
+    result["planning_ms"] = statistics.median(r["planning_ms"] for r in runs)
+    result["execution_ms"] = statistics.median(
+        r["execution_ms"] for r in runs)
+    result["planning_ms_runs"] = [r["planning_ms"] for r in runs]
+    result["execution_ms_runs"] = [r["execution_ms"] for r in runs]
+    return result
+
+
+def total_ms(result):
+    return result["planning_ms"] + result["execution_ms"]
+
+
+def geometric_mean(values):
+    values = list(values)
+    if not values:
+        return None
+    return math.exp(statistics.fmean(math.log(value) for value in values))
+
+
+def summarize(results):
+    summary = {}
+    for mode in MODES:
+        ok = [r["modes"][mode] for r in results
+              if r["modes"][mode]["status"] == "ok"]
+        mode_summary = {
+            "queries": len(results),
+            "failed": len(results) - len(ok),
+            "planning_ms": sum(r["planning_ms"] for r in ok),
+            "execution_ms": sum(r["execution_ms"] for r in ok),
+            "mean_q_error": geometric_mean(r["mean_q_error"] for r in ok),
+        }
+        if mode == "on":
+            mode_summary["wrong_results"] = [
+                r["query"] for r in results if r["results_match"] is False]
+        if mode == "on":
+            fallbacks = {}
+            for r in ok:
+                if r["planner"] != "pg_carbon":
+                    reason = r["fallback_reason"] or "unknown"
+                    fallbacks[reason] = fallbacks.get(reason, 0) + 1
+            mode_summary["fallbacks"] = fallbacks
+            mode_summary["fallback_rate"] = (
+                sum(fallbacks.values()) / len(ok) if ok else None)
+        summary[mode] = mode_summary
+    # > 1 when pg_carbon's plans make the queries faster overall
+    summary["speedup"] = geometric_mean(
+        total_ms(r["modes"]["off"]) / total_ms(r["modes"]["on"])
+        for r in results
+        if all(r["modes"][m]["status"] == "ok" for m in MODES))
+    return summary
+
+
+def server_version(args):
+    proc = subprocess.run(psql_command(args, "-A", "-t", "-c",
+                                       "SHOW server_version"),
+                          capture_output=True, text=True)
+    return proc.stdout.strip() or None
+
+
+def run_suite(args):
+    started = datetime.datetime.now(datetime.timezone.utc)
+    results = []
+    for query, text in suite_queries(args):
+        # Both modes run query by query, so that drift in the machine's
+        # performance does not favor one of them.
+        modes = {mode: run_query(args, mode, text) for mode in MODES}
+        for mode in MODES:
+            modes[mode]["result"] = result_digest(args, mode, text)
+        # None when a mode failed and there is nothing to compare
+        digests = [modes[mode]["result"] for mode in MODES]
+        matches = None if None in digests else digests[0] == digests[1]
+        results.append({"query": query, "modes": modes,
+                        "results_match": matches})
+        print(f"{query}: " + ", ".join(
+            f"{mode} {total_ms(r):.1f} ms" if r["status"] == "ok"
+            else f"{mode} {r['status']}" for mode, r in modes.items()) +
+            (", WRONG RESULTS" if matches is False else ""),
+            file=sys.stderr)
+
+    report = {
+        "suite": args.suite,
+        "started": started.isoformat(),
+        "server_version": server_version(args),
+        "runs": args.runs,
+        "warmup": args.warmup,
+        "timeout_s": args.timeout,
+        "summary": summarize(results),
+        "queries": results,
+    }
+    with open(args.output, "w") as f:
+        json.dump(report, f, indent=2)
+    print_summary(report["summary"])
+    if report["summary"]["on"]["wrong_results"]:
+        sys.exit(1)
+
+
+def print_summary(summary):
+    for mode in MODES:
+        s = summary[mode]
+        line = (f"pg_carbon.enable={mode}: {s['queries'] - s['failed']}/"
+                f"{s['queries']} queries, planning {s['planning_ms']:.1f} ms,"
+                f" execution {s['execution_ms']:.1f} ms")
+        if s["mean_q_error"] is not None:
+            line += f", mean q-error {s['mean_q_error']:.2f}"
+        if mode == "on" and s["fallback_rate"] is not None:
+            line += f", fallback rate {s['fallback_rate']:.1%}"
+        print(line)
+        if mode == "on" and s["wrong_results"]:
+            print("FAILED: different rows with pg_carbon for "
+                  + ", ".join(s["wrong_results"]))
+    if summary["speedup"] is not None:
+        print(f"speedup with pg_carbon (geometric mean): "
+              f"{summary['speedup']:.3f}")
+
+
+def compare_reports(args):
+    """Per-query planning and total time of `new` relative to `old`."""
+    old, new = (json.load(open(path)) for path in (args.old, args.new))
+    old_queries = {r["query"]: r for r in old["queries"]}
+    ratios = []
+    print(f"{'query':<8} {'mode':<4} {'old ms':>12} {'new ms':>12} "
+          f"{'new/old':>8}  planner")
+    for result in new["queries"]:
+        previous = old_queries.get(result["query"])
+        if not previous:
+            continue
+        for mode in MODES:
+            a, b = previous["modes"][mode], result["modes"][mode]
+            if a["status"] != "ok" or b["status"] != "ok":
+                print(f"{result['query']:<8} {mode:<4} {a['status']:>12} "
+                      f"{b['status']:>12}")
+                continue
+            ratio = total_ms(b) / total_ms(a)
+            if mode == "on":
+                ratios.append(ratio)
+            print(f"{result['query']:<8} {mode:<4} {total_ms(a):>12.1f} "
+                  f"{total_ms(b):>12.1f} {ratio:>8.3f}  {a['planner']} -> "
+                  f"{b['planner']}")
+    if ratios:
+        print(f"pg_carbon.enable=on, new/old (geometric mean): "
+              f"{geometric_mean(ratios):.3f}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("-d", "--dbname", help="database (default: psql's)")
+    parser.add_argument("--psql", default="psql", help="psql to use")
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    load = commands.add_parser("load", help="create and fill a suite's tables")
+    load.add_argument("suite", choices=["tpch", "job"])
+    load.add_argument("--data", required=True,
+                      help="directory of the .tbl (TPC-H) or .csv (JOB) files")
+    load.add_argument("--job", help="checkout of the JOB repository")
+
+    run = commands.add_parser("run", help="run a suite and write a report")
+    run.add_argument("suite", choices=["tpch", "job"])
+    run.add_argument("--job", help="checkout of the JOB repository")
+    run.add_argument("--queries", type=lambda s: s.split(","),
+                     help="comma-separated queries to run (default all)")
+    run.add_argument("--runs", type=int, default=3,
+                     help="measured runs per query and mode (default 3)")
+    run.add_argument("--warmup", type=int, default=1,
+                     help="unmeasured runs first (default 1)")
+    run.add_argument("--timeout", type=int, default=300,
+                     help="statement_timeout in seconds (default 300)")
+    run.add_argument("-o", "--output", default="report.json",
+                     help="report file (default report.json)")
+
+    compare = commands.add_parser("compare", help="compare two reports")
+    compare.add_argument("old")
+    compare.add_argument("new")
+
+    args = parser.parse_args()
+    if args.command == "load" and args.suite == "tpch":
+        load_tpch(args)
+    elif args.command == "load":
+        load_job(args)
+    elif args.command == "run":
+        if args.runs < 1:
+            parser.error("--runs must be at least 1")
+        run_suite(args)
+    else:
+        compare_reports(args)
+
+
+if __name__ == "__main__":
+    main()
@@ -2,3 +2,110 @@
 \echo Use "CREATE EXTENSION pg_carbon" to load this file. \quit
 
 LOAD 'pg_carbon';
+
+-- Shadow mode statistics (pg_carbon.mode = shadow), per query fingerprint,
+-- over the queries pg_carbon planned too (pg_carbon.shadow_plan_rate).
+-- Costs are means over the plans pg_carbon found, times in milliseconds.
+-- Only PostgreSQL's plans run in shadow mode, so sampled_runs and
+-- mean_exec_time are of those: pg_carbon's plans are compared by estimated
+-- cost, not by measured run time.
+CREATE FUNCTION pg_carbon_shadow_stats(
+    OUT queryid bigint,
+    OUT plans bigint,
+    OUT carbon_failures bigint,
+    OUT regressions bigint,
+    OUT mean_standard_cost float8,
+    OUT mean_carbon_cost float8,
+    OUT sampled_runs bigint,
+    OUT mean_exec_time float8)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pg_carbon_shadow_stats'
+LANGUAGE C STRICT VOLATILE PARALLEL SAFE;
+
+CREATE VIEW pg_carbon_shadow_stats AS
+  SELECT * FROM pg_carbon_shadow_stats();
+
+CREATE FUNCTION pg_carbon_shadow_reset()
+RETURNS void
+AS 'MODULE_PATHNAME', 'pg_carbon_shadow_reset'
+LANGUAGE C STRICT VOLATILE PARALLEL SAFE;
+
+REVOKE ALL ON FUNCTION pg_carbon_shadow_reset() FROM PUBLIC;
+
+-- Optimizer statistics, per query fingerprint; queries without one
+-- (compute_query_id off) are not counted. Times in milliseconds, memory in
+-- bytes; the peak is sampled every 64 search tasks and at the end.
+CREATE FUNCTION pg_carbon_stats(
+    OUT queryid bigint,
+    OUT calls bigint,
+    OUT carbon_plans bigint,
+    OUT fallback_unsupported bigint,
+    OUT fallback_no_plan bigint,
+    OUT fallback_not_cheaper bigint,
+    OUT fallback_plan_conversion bigint,
+    OUT fallback_error bigint,
+    OUT o_group_tasks bigint,
+    OUT e_group_tasks bigint,
+    OUT o_expr_tasks bigint,
+    OUT apply_rule_tasks bigint,
+    OUT o_inputs_tasks bigint,
+    OUT mean_memo_groups float8,
+    OUT mean_memo_expressions float8,
+    OUT peak_memo_memory bigint,
+    OUT budget_exhausted bigint,
+    OUT max_stage int,
+    OUT total_time float8,
+    OUT mean_time float8,
+    OUT max_time float8)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pg_carbon_stats'
+LANGUAGE C STRICT VOLATILE PARALLEL SAFE;
+
+CREATE VIEW pg_carbon_stats AS
+  SELECT * FROM pg_carbon_stats();
+
+-- How often each rule was applied, and added an expression to the Memo
+CREATE FUNCTION pg_carbon_rule_stats(
+    OUT queryid bigint,
+    OUT rule text,
+    OUT fires bigint,
+    OUT successes bigint)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pg_carbon_rule_stats'
+LANGUAGE C STRICT VOLATILE PARALLEL SAFE;
+
+CREATE VIEW pg_carbon_rule_stats AS
+  SELECT * FROM pg_carbon_rule_stats();
+
+CREATE FUNCTION pg_carbon_stats_reset()
+RETURNS void
+AS 'MODULE_PATHNAME', 'pg_carbon_stats_reset'
+LANGUAGE C STRICT VOLATILE PARALLEL SAFE;
+
+REVOKE ALL ON FUNCTION pg_carbon_stats_reset() FROM PUBLIC;
+
+-- Plans the query of a dump (pg_carbon.dump_directory) again from the
+-- metadata saved with it, `iterations` times, with the settings it was
+-- planned with unless told otherwise. fallback is why the dumped run would
+-- have fallen back to the standard planner ('none' if it would not), times
+-- are of translation and search in milliseconds, memory in bytes.
+CREATE FUNCTION pg_carbon_replay(
+    path text,
+    iterations int DEFAULT 1,
+    dump_settings boolean DEFAULT true,
+    OUT plan text,
+    OUT total_cost float8,
+    OUT fallback text,
+    OUT memo_groups bigint,
+    OUT memo_expressions bigint,
+    OUT memory bigint,
+    OUT stage int,
+    OUT budget_exhausted boolean,
+    OUT min_time float8,
+    OUT mean_time float8,
+    OUT max_time float8)
+RETURNS record
+AS 'MODULE_PATHNAME', 'pg_carbon_replay'
+LANGUAGE C STRICT VOLATILE;
+
+REVOKE ALL ON FUNCTION pg_carbon_replay(text, int, boolean) FROM PUBLIC;
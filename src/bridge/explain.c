@@ -0,0 +1,242 @@
+#include "postgres.h"
+#include "explain.h"
+
+#include "commands/defrem.h"
+#include "commands/explain.h"
+#include "commands/explain_format.h"
+#include "commands/explain_state.h"
+#include "lib/stringinfo.h"
+
+typedef struct CarbonExplainOptions {
+  bool carbon; // CARBON
+  bool memo;   // CARBON_MEMO
+} CarbonExplainOptions;
+
+// The planning run recorded for the statement EXPLAIN is working on
+typedef struct CarbonExplainRun {
+  PlannedStmt *result;
+  bool produced;
+  CarbonStats stats;
+  CarbonExplain details;
+  Cost standard_cost;
+} CarbonExplainRun;
+
+static int explain_extension_id;
+
+static ExplainOneQuery_hook_type prev_ExplainOneQuery = NULL;
+static explain_per_plan_hook_type prev_explain_per_plan = NULL;
+static explain_per_node_hook_type prev_explain_per_node = NULL;
+
+// Options of the EXPLAIN being planned, if it asked for CARBON, until the
+// planner hook claims them for the statement
+static const CarbonExplainOptions *explain_options = NULL;
+static CarbonExplainRun *explain_run = NULL;
+
+static CarbonExplainOptions *explain_get_options(ExplainState *es,
+                                                 bool create) {
+  CarbonExplainOptions *options =
+      GetExplainExtensionState(es, explain_extension_id);
+
+  if (!options && create) {
+    options = palloc0(sizeof(CarbonExplainOptions));
+    SetExplainExtensionState(es, explain_extension_id, options);
+  }
+  return options;
+}
+
+static void explain_carbon_handler(ExplainState *es, DefElem *opt,
+                                   ParseState *pstate) {
+  explain_get_options(es, true)->carbon = defGetBoolean(opt);
+}
+
+static void explain_carbon_memo_handler(ExplainState *es, DefElem *opt,
+                                        ParseState *pstate) {
+  explain_get_options(es, true)->memo = defGetBoolean(opt);
+}
+
+bool pg_carbon_explain_requested(bool *want_memo) {
+  const CarbonExplainOptions *options = explain_options;
+
+  // Only the statement explained is recorded, not the queries planned while
+  // it is, such as those of functions run by constant folding or ANALYZE.
+  explain_options = NULL;
+  *want_memo = options && options->memo;
+  return options != NULL;
+}
+
+void pg_carbon_explain_record(PlannedStmt *result, bool produced,
+                              const CarbonStats *stats,
+                              const CarbonExplain *details,
+                              Cost standard_cost) {
+  explain_run = palloc(sizeof(CarbonExplainRun));
+  explain_run->result = result;
+  explain_run->produced = produced;
+  explain_run->stats = *stats;
+  explain_run->details = *details;
+  explain_run->standard_cost = standard_cost;
+}
+
+static void carbon_ExplainOneQuery(Query *query, int cursorOptions,
+                                   IntoClause *into, ExplainState *es,
+                                   const char *queryString,
+                                   ParamListInfo params,
+                                   QueryEnvironment *queryEnv) {
+  const CarbonExplainOptions *save_options = explain_options;
+  CarbonExplainRun *save_run = explain_run;
+  CarbonExplainOptions *options = explain_get_options(es, false);
+
+  explain_options = options && options->carbon ? options : NULL;
+  explain_run = NULL;
+  PG_TRY();
+  {
+    if (prev_ExplainOneQuery)
+      prev_ExplainOneQuery(query, cursorOptions, into, es, queryString,
+                           params, queryEnv);
+    else
+      standard_ExplainOneQuery(query, cursorOptions, into, es, queryString,
+                               params, queryEnv);
+  }
+  PG_CATCH();
+  {
+    explain_options = save_options;
+    explain_run = save_run;
+    PG_RE_THROW();
+  }
+  PG_END_TRY();
+  explain_options = save_options;
+  explain_run = save_run;
+}
+
+// Multi-line text as its own indented block in text format
+static void explain_text_block(const char *label, const char *text,
+                               ExplainState *es) {
+  const char *line = text;
+
+  if (es->format != EXPLAIN_FORMAT_TEXT) {
+    ExplainPropertyText(label, text, es);
+    return;
+  }
+  ExplainIndentText(es);
+  appendStringInfo(es->str, "%s:\n", label);
+  es->indent++;
+  while (*line) {
+    const char *end = strchr(line, '\n');
+    int len = end ? end - line : (int)strlen(line);
+
+    ExplainIndentText(es);
+    appendBinaryStringInfo(es->str, line, len);
+    appendStringInfoChar(es->str, '\n');
+    line += end ? len + 1 : len;
+  }
+  es->indent--;
+}
+
+static void explain_print_run(const CarbonExplainRun *run, ExplainState *es) {
+  const CarbonStats *stats = &run->stats;
+  List *rules = NIL;
+
+  ExplainPropertyText("Planner", run->produced ? "pg_carbon" : "PostgreSQL",
+                      es);
+  if (!run->produced)
+    ExplainPropertyText("Fallback Reason",
+                        pg_carbon_fallback_name(stats->fallback), es);
+  ExplainPropertyFloat("Optimization Time", "ms", stats->time_ms, 3, es);
+  ExplainPropertyInteger("Memo Groups", NULL, stats->groups, es);
+  ExplainPropertyInteger("Memo Expressions", NULL, stats->expressions, es);
+  ExplainPropertyInteger("Search Stage", NULL, stats->stage, es);
+  ExplainPropertyBool("Budget Exhausted", stats->exhausted, es);
+
+  for (int i = 0; i < CARBON_MAX_RULES; i++) {
+    if (stats->rule_fires[i] == 0)
+      continue;
+    rules = lappend(rules,
+                    psprintf("%s: " INT64_FORMAT " applied, " INT64_FORMAT
+                             " added",
+                             pg_carbon_rule_name(i), stats->rule_fires[i],
+                             stats->rule_successes[i]));
+  }
+  ExplainPropertyList("Rules Fired", rules, es);
+
+  ExplainPropertyFloat("PostgreSQL Total Cost", NULL, run->standard_cost, 2,
+                       es);
+  if (run->details.plan)
+    explain_text_block("Carbon Plan", run->details.plan, es);
+  if (run->details.memo)
+    explain_text_block("Memo", run->details.memo, es);
+}
+
+static void carbon_explain_per_plan(PlannedStmt *plannedstmt,
+                                    IntoClause *into, ExplainState *es,
+                                    const char *queryString,
+                                    ParamListInfo params,
+                                    QueryEnvironment *queryEnv) {
+  CarbonExplainOptions *options = explain_get_options(es, false);
+
+  if (prev_explain_per_plan)
+    prev_explain_per_plan(plannedstmt, into, es, queryString, params,
+                          queryEnv);
+  if (!options || !options->carbon)
+    return;
+
+  ExplainOpenGroup("Carbon", "Carbon", true, es);
+  // pg_carbon did not take part if it is disabled or in shadow mode.
+  if (explain_run && explain_run->result == plannedstmt)
+    explain_print_run(explain_run, es);
+  else
+    ExplainPropertyText("Planner", "PostgreSQL", es);
+  ExplainCloseGroup("Carbon", "Carbon", true, es);
+}
+
+// Where each node of pg_carbon's plan comes from in the Memo
+static void carbon_explain_per_node(PlanState *planstate, List *ancestors,
+                                    const char *relationship,
+                                    const char *plan_name,
+                                    ExplainState *es) {
+  CarbonExplainOptions *options = explain_get_options(es, false);
+  const CarbonExplainNode *node = NULL;
+
+  if (prev_explain_per_node)
+    prev_explain_per_node(planstate, ancestors, relationship, plan_name, es);
+  if (!options || !options->carbon || !explain_run || !explain_run->produced)
+    return;
+
+  for (int i = 0; i < explain_run->details.num_nodes; i++) {
+    if (explain_run->details.nodes[i].plan == planstate->plan) {
+      node = &explain_run->details.nodes[i];
+      break;
+    }
+  }
+  // The translator adds some nodes of its own, which no group plans.
+  if (!node)
+    return;
+
+  if (es->format == EXPLAIN_FORMAT_TEXT) {
+    ExplainIndentText(es);
+    appendStringInfo(es->str, "Carbon Group: %d", node->group);
+    if (es->costs)
+      appendStringInfo(es->str, "  (cost=%.2f..%.2f rows=%.0f)",
+                       node->startup_cost, node->total_cost, node->rows);
+    appendStringInfoChar(es->str, '\n');
+    return;
+  }
+  ExplainPropertyInteger("Carbon Group", NULL, node->group, es);
+  if (es->costs) {
+    ExplainPropertyFloat("Carbon Startup Cost", NULL, node->startup_cost, 2,
+                         es);
+    ExplainPropertyFloat("Carbon Total Cost", NULL, node->total_cost, 2, es);
+    ExplainPropertyFloat("Carbon Plan Rows", NULL, node->rows, 0, es);
+  }
+}
+
+void pg_carbon_explain_init(void) {
+  explain_extension_id = GetExplainExtensionId("pg_carbon");
+  RegisterExtensionExplainOption("carbon", explain_carbon_handler);
+  RegisterExtensionExplainOption("carbon_memo", explain_carbon_memo_handler);
+
+  prev_ExplainOneQuery = ExplainOneQuery_hook;
+  ExplainOneQuery_hook = carbon_ExplainOneQuery;
+  prev_explain_per_plan = explain_per_plan_hook;
+  explain_per_plan_hook = carbon_explain_per_plan;
+  prev_explain_per_node = explain_per_node_hook;
+  explain_per_node_hook = carbon_explain_per_node;
+}
@@ -0,0 +1,31 @@
+#ifndef PG_CARBON_EXPLAIN_H
+#define PG_CARBON_EXPLAIN_H
+
+#include "postgres.h"
+#include "nodes/plannodes.h"
+#include "../optimizer/instrumentation.h"
+
+// EXPLAIN (CARBON [, CARBON_MEMO]): how pg_carbon planned the query, added
+// to the output of EXPLAIN. The planner hook records the run while EXPLAIN
+// plans the query, and the details are printed with the plan, and the Memo
+// group and estimates of each node with the node.
+
+// Registers the EXPLAIN options and installs the hooks; called from
+// _PG_init
+void pg_carbon_explain_init(void);
+
+// Whether the query being planned is explained with EXPLAIN (CARBON); sets
+// *want_memo to whether CARBON_MEMO asks for the Memo too. The first call
+// claims the statement, and later ones, for queries planned while it is,
+// return false.
+bool pg_carbon_explain_requested(bool *want_memo);
+
+// Keeps the run that planned `result` for the EXPLAIN output: `produced`
+// tells whether the plan is pg_carbon's, `standard_cost` is the total cost
+// of the standard planner's plan
+void pg_carbon_explain_record(PlannedStmt *result, bool produced,
+                              const CarbonStats *stats,
+                              const CarbonExplain *details,
+                              Cost standard_cost);
+
+#endif // PG_CARBON_EXPLAIN_H
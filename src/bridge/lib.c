@@ -3,6 +3,14 @@ struct _dummy;
 #include "../optimizer/optimizer.h"
 #include "fmgr.h"
 #include "optimizer/planner.h"
+#include "access/xact.h"
+#include "common/pg_prng.h"
+#include "explain.h"
+#include "shadow.h"
+#include "stats.h"
+#include "utils/guc.h"
+#include "utils/resowner.h"
+#include <float.h>
 
 // We need to declare the C++ entry point as extern "C" in the C++ file,
 // or use a wrapper. Since we can't include C++ headers here directly if they
@@ -25,71 +33,270 @@ void _PG_init(void);
 static planner_hook_type prev_planner_hook = NULL;
 static bool pg_carbon_enable = true;
 
+// pg_carbon.mode: whether queries run pg_carbon's plans or only compare
+// them with PostgreSQL's
+typedef enum {
+  PG_CARBON_MODE_CARBON,
+  PG_CARBON_MODE_SHADOW
+} PgCarbonMode;
+
+static const struct config_enum_entry pg_carbon_mode_options[] = {
+    {"carbon", PG_CARBON_MODE_CARBON, false},
+    {"shadow", PG_CARBON_MODE_SHADOW, false},
+    {NULL, 0, false}};
+
+static int pg_carbon_mode = PG_CARBON_MODE_CARBON;
+
+// pg_carbon.shadow_plan_rate: fraction of the queries that shadow mode
+// plans with pg_carbon too
+static double pg_carbon_shadow_plan_rate = 0.1;
+
+// pg_carbon.seed_upper_bound: plan with the standard planner first, and only
+// use pg_carbon's plan if it is cheaper
+static bool pg_carbon_seed_upper_bound = false;
+
 // Forward declaration of the C++ wrapper function
 Plan *pg_carbon_optimize_query(Query *parse, int cursorOptions,
-                               ParamListInfo boundParams);
+                               ParamListInfo boundParams, Cost upper_bound,
+                               Query **planned_query,
+                               List **param_exec_types, List **subplans,
+                               CarbonStats *stats, CarbonExplain *explain);
 
-static PlannedStmt *pg_carbon_planner(Query *parse, const char *query_string,
-                                      int cursorOptions,
-                                      ParamListInfo boundParams) {
-  if (pg_carbon_enable) {
-    // Call our C++ optimizer
-    Plan *plan = pg_carbon_optimize_query(parse, cursorOptions, boundParams);
-    if (plan) {
-      elog(WARNING, "pg carbon generate plan success✅");
-
-      // ... (rest of the logic)
-      PlannedStmt *result = makeNode(PlannedStmt);
-      result->commandType = parse->commandType;
-      result->queryId = parse->queryId;
-      result->hasReturning = parse->returningList != NIL;
-      result->hasModifyingCTE = parse->hasModifyingCTE;
-      result->canSetTag = true;
-      result->transientPlan = false;
-      result->dependsOnRole = false;
-      result->parallelModeNeeded = false;
-      result->planTree = plan;
-      result->rtable = parse->rtable;
-      result->resultRelations = NIL;
-      result->subplans = NIL;
-
-      // Populate relationOids and unprunableRelids
-      ListCell *lc;
-      List *relationOids = NIL;
-      Bitmapset *unprunableRelids = NULL;
-      int rti = 1;
-      foreach (lc, parse->rtable) {
-        RangeTblEntry *rte = (RangeTblEntry *)lfirst(lc);
-        if (rte->rtekind == RTE_RELATION) {
-          relationOids = lappend_oid(relationOids, rte->relid);
-          unprunableRelids = bms_add_member(unprunableRelids, rti);
-        }
-        rti++;
-      }
-      result->relationOids = relationOids;
-      result->unprunableRelids = unprunableRelids;
-
-      return result;
+// Plans `parse` with pg_carbon, or returns NULL if the standard planner has
+// to, which includes finding no plan cheaper than `upper_bound`. The run is
+// counted in the optimizer statistics either way, and its counters are left
+// in `stats`. `explain`, if not NULL, asks for the renderings of the run.
+static PlannedStmt *carbon_planner(Query *parse, int cursorOptions,
+                                   ParamListInfo boundParams,
+                                   Cost upper_bound, CarbonStats *stats,
+                                   CarbonExplain *explain) {
+  // Call our C++ optimizer. Sublink pull-up adds range table entries, so
+  // the plan goes with the query it was built from.
+  Query *planned = NULL;
+  List *param_exec_types = NIL;
+  List *subplans = NIL;
+  Plan *plan = pg_carbon_optimize_query(parse, cursorOptions, boundParams,
+                                        upper_bound, &planned,
+                                        &param_exec_types, &subplans, stats,
+                                        explain);
+  pg_carbon_stats_record(parse->queryId, stats);
+  if (!plan) {
+    elog(DEBUG1, "pg_carbon: falling back to the standard planner: %s",
+         pg_carbon_fallback_name(stats->fallback));
+    return NULL;
+  }
+
+  PlannedStmt *result = makeNode(PlannedStmt);
+  result->commandType = parse->commandType;
+  result->queryId = parse->queryId;
+  result->hasReturning = parse->returningList != NIL;
+  result->hasModifyingCTE = parse->hasModifyingCTE;
+  result->canSetTag = true;
+  result->transientPlan = false;
+  result->dependsOnRole = false;
+  result->parallelModeNeeded = false;
+  result->planTree = plan;
+  result->rtable = planned->rtable;
+  result->permInfos = planned->rteperminfos;
+  result->resultRelations = NIL;
+  result->subplans = subplans;
+  result->paramExecTypes = param_exec_types;
+
+  // Populate relationOids and unprunableRelids
+  ListCell *lc;
+  List *relationOids = NIL;
+  Bitmapset *unprunableRelids = NULL;
+  int rti = 1;
+  foreach (lc, planned->rtable) {
+    RangeTblEntry *rte = (RangeTblEntry *)lfirst(lc);
+    if (rte->rtekind == RTE_RELATION) {
+      relationOids = lappend_oid(relationOids, rte->relid);
+      unprunableRelids = bms_add_member(unprunableRelids, rti);
     }
-    elog(WARNING,
-         "pg carbon generate plan failed❌, fallback to standard planner!");
+    rti++;
   }
+  result->relationOids = relationOids;
+  result->unprunableRelids = unprunableRelids;
 
-  // Fallback to standard planner if Carbon fails or returns null
+  return result;
+}
+
+static PlannedStmt *standard_plan(Query *parse, const char *query_string,
+                                  int cursorOptions,
+                                  ParamListInfo boundParams) {
   if (prev_planner_hook)
     return prev_planner_hook(parse, query_string, cursorOptions, boundParams);
   else
     return standard_planner(parse, query_string, cursorOptions, boundParams);
 }
 
-#include "utils/guc.h"
+// Shadow mode: plans with both planners and returns PostgreSQL's plan.
+// pg_carbon plans in a subtransaction, so that its errors only count as
+// failures. That and the second planning run are paid by a sample of the
+// queries only.
+static PlannedStmt *shadow_planner(Query *parse, const char *query_string,
+                                   int cursorOptions,
+                                   ParamListInfo boundParams) {
+  MemoryContext oldcontext = CurrentMemoryContext;
+  ResourceOwner oldowner = CurrentResourceOwner;
+  PlannedStmt *volatile carbon = NULL;
+  CarbonStats stats;
 
-void _PG_init(void) {
-  elog(WARNING, "pg_carbon loaded!");
+  if (pg_carbon_shadow_plan_rate < 1.0 &&
+      pg_prng_double(&pg_global_prng_state) >= pg_carbon_shadow_plan_rate)
+    return standard_plan(parse, query_string, cursorOptions, boundParams);
+
+  BeginInternalSubTransaction(NULL);
+  MemoryContextSwitchTo(oldcontext);
+  PG_TRY();
+  {
+    carbon = carbon_planner(parse, cursorOptions, boundParams, DBL_MAX,
+                            &stats, NULL);
+    ReleaseCurrentSubTransaction();
+    MemoryContextSwitchTo(oldcontext);
+    CurrentResourceOwner = oldowner;
+  }
+  PG_CATCH();
+  {
+    MemoryContextSwitchTo(oldcontext);
+    ErrorData *edata = CopyErrorData();
+    FlushErrorState();
+    RollbackAndReleaseCurrentSubTransaction();
+    MemoryContextSwitchTo(oldcontext);
+    CurrentResourceOwner = oldowner;
+    elog(DEBUG1, "pg_carbon: shadow planning failed: %s", edata->message);
+    FreeErrorData(edata);
+    carbon = NULL;
 
+    memset(&stats, 0, sizeof(stats));
+    stats.fallback = CARBON_FALLBACK_ERROR;
+    pg_carbon_stats_record(parse->queryId, &stats);
+  }
+  PG_END_TRY();
+
+  // The carbon plan is built from a copy, so `parse` is still intact.
+  PlannedStmt *result =
+      standard_plan(parse, query_string, cursorOptions, boundParams);
+  pg_carbon_shadow_record(result, carbon);
+  return result;
+}
+
+static PlannedStmt *pg_carbon_planner(Query *parse, const char *query_string,
+                                      int cursorOptions,
+                                      ParamListInfo boundParams) {
+  CarbonStats stats;
+  CarbonExplain details = {0};
+  bool explain;
+  PlannedStmt *standard = NULL;
+  PlannedStmt *result;
+
+  // Claimed first, so that no query planned under this one takes it
+  explain = pg_carbon_explain_requested(&details.want_memo);
+  if (!pg_carbon_enable)
+    return standard_plan(parse, query_string, cursorOptions, boundParams);
+  if (pg_carbon_mode == PG_CARBON_MODE_SHADOW)
+    return shadow_planner(parse, query_string, cursorOptions, boundParams);
+
+  if (pg_carbon_seed_upper_bound || explain) {
+    // The standard planner scribbles on its query. With a seeded bound,
+    // pg_carbon's search prunes every plan that costs more than the
+    // standard plan, and if none is left the standard plan is the better
+    // one. EXPLAIN (CARBON) shows its cost next to pg_carbon's.
+    standard = standard_plan((Query *)copyObject(parse), query_string,
+                             cursorOptions, boundParams);
+  }
+
+  result = carbon_planner(parse, cursorOptions, boundParams,
+                          pg_carbon_seed_upper_bound
+                              ? standard->planTree->total_cost
+                              : DBL_MAX,
+                          &stats, explain ? &details : NULL);
+  if (explain)
+    pg_carbon_explain_record(
+        result ? result : standard, result != NULL, &stats, &details,
+        standard->planTree->total_cost);
+  if (result)
+    return result;
+  if (standard)
+    return standard;
+
+  // Fallback to standard planner if Carbon fails or returns null
+  return standard_plan(parse, query_string, cursorOptions, boundParams);
+}
+
+void _PG_init(void) {
   DefineCustomBoolVariable("pg_carbon.enable", "Enable pg_carbon optimizer",
                            NULL, &pg_carbon_enable, true, PGC_USERSET, 0, NULL,
                            NULL, NULL);
+  DefineCustomEnumVariable(
+      "pg_carbon.mode",
+      "Whether queries run pg_carbon's plans (carbon) or PostgreSQL's, with "
+      "pg_carbon's planned alongside for comparison (shadow)",
+      NULL, &pg_carbon_mode, PG_CARBON_MODE_CARBON, pg_carbon_mode_options,
+      PGC_USERSET, 0, NULL, NULL, NULL);
+  DefineCustomRealVariable(
+      "pg_carbon.shadow_plan_rate",
+      "Fraction of the queries that shadow mode also plans with pg_carbon",
+      "Each of them is planned twice, pg_carbon's run in a subtransaction of "
+      "its own, which even the simplest statements pay for.",
+      &pg_carbon_shadow_plan_rate, 0.1, 0.0, 1.0, PGC_SUSET, 0, NULL, NULL,
+      NULL);
+  DefineCustomBoolVariable(
+      "pg_carbon.seed_upper_bound",
+      "Plans with the standard planner first and uses pg_carbon's plan only "
+      "if it is estimated to be cheaper",
+      NULL, &pg_carbon_seed_upper_bound, false, PGC_USERSET, 0, NULL, NULL,
+      NULL);
+
+  DefineCustomIntVariable(
+      "pg_carbon.search_time_budget",
+      "Microseconds the plan search may take before it settles for the best "
+      "plan found so far (0 = no limit)",
+      NULL, &pg_carbon_search_time_budget, 1000000, 0, INT_MAX, PGC_USERSET,
+      0, NULL, NULL, NULL);
+  DefineCustomIntVariable(
+      "pg_carbon.search_task_budget",
+      "Search tasks the plan search may perform before it settles for the "
+      "best plan found so far (0 = no limit)",
+      NULL, &pg_carbon_search_task_budget, 0, 0, INT_MAX, PGC_USERSET, 0,
+      NULL, NULL, NULL);
+  DefineCustomIntVariable(
+      "pg_carbon.memo_memory_budget",
+      "Memory the plan search may allocate before it settles for the best "
+      "plan found so far (0 = no limit)",
+      NULL, &pg_carbon_memo_memory_budget, 0, 0, INT_MAX / 1024, PGC_USERSET,
+      GUC_UNIT_KB, NULL, NULL, NULL);
+  DefineCustomRealVariable(
+      "pg_carbon.stage0_cost_limit",
+      "Plan cost above which the search goes on from implementing the query "
+      "as written to cheap rewrites",
+      NULL, &pg_carbon_stage0_cost_limit, 100.0, 0.0, DBL_MAX, PGC_USERSET, 0,
+      NULL, NULL, NULL);
+  DefineCustomRealVariable(
+      "pg_carbon.stage1_cost_limit",
+      "Plan cost above which the search goes on from cheap rewrites to "
+      "exploring join orders and aggregate placement",
+      NULL, &pg_carbon_stage1_cost_limit, 10000.0, 0.0, DBL_MAX, PGC_USERSET,
+      0, NULL, NULL, NULL);
+  DefineCustomBoolVariable(
+      "pg_carbon.single_table_fast_path",
+      "Plans queries on a single table without searching for rewrites",
+      NULL, &pg_carbon_single_table_fast_path, true, PGC_USERSET, 0, NULL,
+      NULL, NULL);
+  DefineCustomStringVariable(
+      "pg_carbon.dump_directory",
+      "Directory pg_carbon dumps the queries it plans to, with the metadata "
+      "they used, for replaying them offline (empty = no dumps)",
+      NULL, &pg_carbon_dump_directory, "", PGC_SUSET, 0, NULL, NULL, NULL);
+  DefineCustomIntVariable(
+      "pg_carbon.dump_min_duration",
+      "Minimum planning time of the queries pg_carbon dumps", NULL,
+      &pg_carbon_dump_min_duration, 0, 0, INT_MAX, PGC_SUSET, GUC_UNIT_MS,
+      NULL, NULL, NULL);
+
+  pg_carbon_shadow_init();
+  pg_carbon_stats_init();
+  pg_carbon_explain_init();
 
   prev_planner_hook = planner_hook;
   planner_hook = pg_carbon_planner;
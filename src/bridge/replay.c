@@ -0,0 +1,54 @@
+#include "postgres.h"
+#include "../optimizer/optimizer.h"
+
+#include "access/htup_details.h"
+#include "fmgr.h"
+#include "funcapi.h"
+#include "utils/builtins.h"
+
+// pg_carbon_replay(path, iterations, dump_settings): plans the query of a
+// dump (pg_carbon.dump_directory) again from the metadata saved with it.
+// Reading server files is for superusers unless granted otherwise, as for
+// pg_read_file().
+PG_FUNCTION_INFO_V1(pg_carbon_replay);
+
+Datum pg_carbon_replay(PG_FUNCTION_ARGS) {
+  char *path = text_to_cstring(PG_GETARG_TEXT_PP(0));
+  int iterations = PG_GETARG_INT32(1);
+  bool dump_settings = PG_GETARG_BOOL(2);
+  TupleDesc tupdesc;
+  CarbonReplay replay;
+  Datum values[11];
+  bool nulls[11] = {false};
+  int n = 0;
+
+  if (iterations < 1)
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("iterations must be at least 1")));
+  if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+    elog(ERROR, "return type must be a row type");
+
+  pg_carbon_replay_dump(path, iterations, dump_settings, &replay);
+
+  if (replay.plan) {
+    values[n++] = CStringGetTextDatum(replay.plan);
+    values[n++] = Float8GetDatum(replay.total_cost);
+  } else {
+    nulls[n++] = true;
+    nulls[n++] = true;
+  }
+  values[n++] =
+      CStringGetTextDatum(pg_carbon_fallback_name(replay.stats.fallback));
+  values[n++] = Int64GetDatum(replay.stats.groups);
+  values[n++] = Int64GetDatum(replay.stats.expressions);
+  values[n++] = Int64GetDatum((int64)replay.stats.memory);
+  values[n++] = Int32GetDatum(replay.stats.stage);
+  values[n++] = BoolGetDatum(replay.stats.exhausted);
+  values[n++] = Float8GetDatum(replay.min_time_ms);
+  values[n++] = Float8GetDatum(replay.mean_time_ms);
+  values[n++] = Float8GetDatum(replay.max_time_ms);
+  Assert(n == lengthof(values));
+
+  PG_RETURN_DATUM(
+      HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
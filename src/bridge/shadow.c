@@ -0,0 +1,290 @@
+#include "postgres.h"
+#include "shadow.h"
+
+#include "common/pg_prng.h"
+#include "executor/executor.h"
+#include "executor/instrument.h"
+#include "fmgr.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "storage/spin.h"
+#include "utils/guc.h"
+#include "utils/hsearch.h"
+
+// pg_carbon's estimate counts as a regression when it is more than 1% above
+// PostgreSQL's
+#define SHADOW_REGRESSION_MARGIN 1.01
+
+// Statistics of one query fingerprint. Costs are summed over the plans
+// pg_carbon found, so that their means compare the same queries.
+typedef struct ShadowEntry {
+  uint64 query_id; // hash key
+  slock_t mutex;   // protects the counters
+  int64 plans;
+  int64 carbon_failures;
+  int64 regressions;
+  double standard_cost;
+  double carbon_cost;
+  int64 sampled_runs;
+  double sampled_time; // milliseconds
+} ShadowEntry;
+
+typedef struct ShadowState {
+  // Shared to update entries, exclusive to add or remove them
+  LWLock *lock;
+} ShadowState;
+
+static int pg_carbon_shadow_max = 1000;
+static double pg_carbon_shadow_sample_rate = 0.0;
+
+static ShadowState *shadow_state = NULL;
+static HTAB *shadow_hash = NULL;
+
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+static ExecutorStart_hook_type prev_ExecutorStart = NULL;
+static ExecutorEnd_hook_type prev_ExecutorEnd = NULL;
+
+// The execution being timed, if any. One at a time: a query started while
+// another is timed, such as one run by a function, ends the sample.
+static QueryDesc *sampled_query = NULL;
+
+static Size shadow_memsize(void) {
+  return add_size(MAXALIGN(sizeof(ShadowState)),
+                  hash_estimate_size(pg_carbon_shadow_max,
+                                     sizeof(ShadowEntry)));
+}
+
+static void shadow_shmem_request(void) {
+  if (prev_shmem_request_hook)
+    prev_shmem_request_hook();
+  RequestAddinShmemSpace(shadow_memsize());
+  RequestNamedLWLockTranche("pg_carbon", 1);
+}
+
+static void shadow_shmem_startup(void) {
+  bool found;
+  HASHCTL info;
+
+  if (prev_shmem_startup_hook)
+    prev_shmem_startup_hook();
+
+  LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+  shadow_state = ShmemInitStruct("pg_carbon shadow", sizeof(ShadowState),
+                                 &found);
+  if (!found)
+    shadow_state->lock = &(GetNamedLWLockTranche("pg_carbon"))->lock;
+  info.keysize = sizeof(uint64);
+  info.entrysize = sizeof(ShadowEntry);
+  shadow_hash = ShmemInitHash("pg_carbon shadow stats", pg_carbon_shadow_max,
+                              pg_carbon_shadow_max, &info,
+                              HASH_ELEM | HASH_BLOBS);
+  LWLockRelease(AddinShmemInitLock);
+}
+
+// Returns the entry of `query_id` with shadow_state->lock held, which the
+// caller releases. Adds the entry if `create`; NULL if it does not exist or
+// the table is full.
+static ShadowEntry *shadow_entry(uint64 query_id, bool create) {
+  bool found;
+  ShadowEntry *entry;
+
+  LWLockAcquire(shadow_state->lock, LW_SHARED);
+  entry = hash_search(shadow_hash, &query_id, HASH_FIND, NULL);
+  if (entry || !create)
+    return entry;
+
+  LWLockRelease(shadow_state->lock);
+  LWLockAcquire(shadow_state->lock, LW_EXCLUSIVE);
+  entry = hash_search(shadow_hash, &query_id, HASH_ENTER_NULL, &found);
+  if (entry && !found) {
+    memset((char *)entry + sizeof(uint64), 0,
+           sizeof(ShadowEntry) - sizeof(uint64));
+    SpinLockInit(&entry->mutex);
+  }
+  return entry;
+}
+
+void pg_carbon_shadow_record(PlannedStmt *standard, PlannedStmt *carbon) {
+  uint64 query_id = standard->queryId;
+  double standard_cost = standard->planTree->total_cost;
+  double carbon_cost = carbon ? carbon->planTree->total_cost : 0.0;
+  bool regression =
+      carbon && carbon_cost > standard_cost * SHADOW_REGRESSION_MARGIN;
+  bool first_regression = false;
+  ShadowEntry *entry;
+
+  // Without a fingerprint (compute_query_id off) there is nothing to
+  // group the query under.
+  if (!shadow_state || query_id == 0)
+    return;
+
+  entry = shadow_entry(query_id, true);
+  if (entry) {
+    SpinLockAcquire(&entry->mutex);
+    entry->plans++;
+    if (carbon) {
+      entry->standard_cost += standard_cost;
+      entry->carbon_cost += carbon_cost;
+    } else {
+      entry->carbon_failures++;
+    }
+    if (regression) {
+      first_regression = entry->regressions == 0;
+      entry->regressions++;
+    }
+    SpinLockRelease(&entry->mutex);
+  }
+  LWLockRelease(shadow_state->lock);
+
+  // Each fingerprint is logged once, until the statistics are reset.
+  if (first_regression)
+    ereport(LOG, (errmsg("pg_carbon: plan of query " INT64_FORMAT
+                         " costs %.2f, PostgreSQL's %.2f",
+                         (int64)query_id, carbon_cost, standard_cost)));
+}
+
+static bool shadow_ExecutorStart(QueryDesc *queryDesc, int eflags) {
+  bool sample = shadow_state && queryDesc->plannedstmt->queryId != 0 &&
+                (eflags & EXEC_FLAG_EXPLAIN_ONLY) == 0 &&
+                pg_carbon_shadow_sample_rate > 0.0 &&
+                pg_prng_double(&pg_global_prng_state) <
+                    pg_carbon_shadow_sample_rate;
+  bool plan_valid;
+
+  if (prev_ExecutorStart)
+    plan_valid = prev_ExecutorStart(queryDesc, eflags);
+  else
+    plan_valid = standard_ExecutorStart(queryDesc, eflags);
+  if (!plan_valid)
+    return false;
+
+  if (sample && queryDesc->totaltime == NULL) {
+    MemoryContext oldcontext =
+        MemoryContextSwitchTo(queryDesc->estate->es_query_cxt);
+    queryDesc->totaltime = InstrAlloc(1, INSTRUMENT_TIMER, false);
+    MemoryContextSwitchTo(oldcontext);
+  }
+  sampled_query = sample ? queryDesc : NULL;
+  return true;
+}
+
+static void shadow_ExecutorEnd(QueryDesc *queryDesc) {
+  if (queryDesc == sampled_query && queryDesc->totaltime) {
+    ShadowEntry *entry;
+
+    // Only fingerprints planned in shadow mode are timed.
+    InstrEndLoop(queryDesc->totaltime);
+    entry = shadow_entry(queryDesc->plannedstmt->queryId, false);
+    if (entry) {
+      SpinLockAcquire(&entry->mutex);
+      entry->sampled_runs++;
+      entry->sampled_time += queryDesc->totaltime->total * 1000.0;
+      SpinLockRelease(&entry->mutex);
+    }
+    LWLockRelease(shadow_state->lock);
+  }
+  if (queryDesc == sampled_query)
+    sampled_query = NULL;
+
+  if (prev_ExecutorEnd)
+    prev_ExecutorEnd(queryDesc);
+  else
+    standard_ExecutorEnd(queryDesc);
+}
+
+void pg_carbon_shadow_init(void) {
+  DefineCustomRealVariable(
+      "pg_carbon.shadow_sample_rate",
+      "Fraction of the executions in shadow mode whose run time is measured",
+      NULL, &pg_carbon_shadow_sample_rate, 0.0, 0.0, 1.0, PGC_SUSET, 0, NULL,
+      NULL, NULL);
+
+  // The statistics need shared memory, which is only set up for libraries
+  // loaded at server start.
+  if (!process_shared_preload_libraries_in_progress)
+    return;
+
+  DefineCustomIntVariable(
+      "pg_carbon.shadow_max",
+      "Number of query fingerprints shadow mode keeps statistics for", NULL,
+      &pg_carbon_shadow_max, 1000, 100, INT_MAX / 2, PGC_POSTMASTER, 0, NULL,
+      NULL, NULL);
+
+  prev_shmem_request_hook = shmem_request_hook;
+  shmem_request_hook = shadow_shmem_request;
+  prev_shmem_startup_hook = shmem_startup_hook;
+  shmem_startup_hook = shadow_shmem_startup;
+  prev_ExecutorStart = ExecutorStart_hook;
+  ExecutorStart_hook = shadow_ExecutorStart;
+  prev_ExecutorEnd = ExecutorEnd_hook;
+  ExecutorEnd_hook = shadow_ExecutorEnd;
+}
+
+static void shadow_check_loaded(void) {
+  if (!shadow_state || !shadow_hash)
+    ereport(ERROR,
+            (errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+             errmsg("pg_carbon must be loaded via shared_preload_libraries")));
+}
+
+PG_FUNCTION_INFO_V1(pg_carbon_shadow_stats);
+
+Datum pg_carbon_shadow_stats(PG_FUNCTION_ARGS) {
+  ReturnSetInfo *rsinfo = (ReturnSetInfo *)fcinfo->resultinfo;
+  HASH_SEQ_STATUS status;
+  ShadowEntry *entry;
+
+  shadow_check_loaded();
+  InitMaterializedSRF(fcinfo, 0);
+
+  LWLockAcquire(shadow_state->lock, LW_SHARED);
+  hash_seq_init(&status, shadow_hash);
+  while ((entry = hash_seq_search(&status)) != NULL) {
+    Datum values[8];
+    bool nulls[8] = {false};
+    ShadowEntry copy;
+    int64 compared;
+
+    SpinLockAcquire(&entry->mutex);
+    copy = *entry;
+    SpinLockRelease(&entry->mutex);
+    compared = copy.plans - copy.carbon_failures;
+
+    values[0] = Int64GetDatum((int64)copy.query_id);
+    values[1] = Int64GetDatum(copy.plans);
+    values[2] = Int64GetDatum(copy.carbon_failures);
+    values[3] = Int64GetDatum(copy.regressions);
+    values[4] = Float8GetDatum(compared ? copy.standard_cost / compared : 0);
+    values[5] = Float8GetDatum(compared ? copy.carbon_cost / compared : 0);
+    values[6] = Int64GetDatum(copy.sampled_runs);
+    values[7] = Float8GetDatum(
+        copy.sampled_runs ? copy.sampled_time / copy.sampled_runs : 0);
+    nulls[4] = nulls[5] = compared == 0;
+    nulls[7] = copy.sampled_runs == 0;
+    tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+  }
+  LWLockRelease(shadow_state->lock);
+
+  return (Datum)0;
+}
+
+PG_FUNCTION_INFO_V1(pg_carbon_shadow_reset);
+
+Datum pg_carbon_shadow_reset(PG_FUNCTION_ARGS) {
+  HASH_SEQ_STATUS status;
+  ShadowEntry *entry;
+
+  shadow_check_loaded();
+
+  LWLockAcquire(shadow_state->lock, LW_EXCLUSIVE);
+  hash_seq_init(&status, shadow_hash);
+  while ((entry = hash_seq_search(&status)) != NULL)
+    hash_search(shadow_hash, &entry->query_id, HASH_REMOVE, NULL);
+  LWLockRelease(shadow_state->lock);
+
+  PG_RETURN_VOID();
+}
@@ -0,0 +1,21 @@
+#ifndef PG_CARBON_SHADOW_H
+#define PG_CARBON_SHADOW_H
+
+#include "postgres.h"
+#include "nodes/plannodes.h"
+
+// Shadow mode statistics: for each query fingerprint (queryId), how
+// pg_carbon's estimated plan costs compare with PostgreSQL's, and the
+// actual run time of a sample of the executions of PostgreSQL's plan, the
+// only one that runs; pg_carbon's plans are never timed. They
+// live in shared memory, so pg_carbon has to be in shared_preload_libraries
+// to keep them, and are shown by the pg_carbon_shadow_stats view.
+
+// Defines the GUCs and installs the hooks; called from _PG_init
+void pg_carbon_shadow_init(void);
+
+// Records the plans of one query: `standard` is PostgreSQL's, `carbon`
+// pg_carbon's or NULL if it failed
+void pg_carbon_shadow_record(PlannedStmt *standard, PlannedStmt *carbon);
+
+#endif // PG_CARBON_SHADOW_H
@@ -0,0 +1,248 @@
+#include "postgres.h"
+#include "stats.h"
+
+#include "fmgr.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "storage/spin.h"
+#include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/hsearch.h"
+
+// Statistics of one query fingerprint; sums unless noted
+typedef struct StatsEntry {
+  uint64 query_id; // hash key
+  slock_t mutex;   // protects the counters
+  int64 calls;
+  int64 fallbacks[CARBON_NUM_FALLBACKS]; // [NONE]: plans pg_carbon made
+  int64 tasks[CARBON_NUM_TASK_TYPES];
+  int64 rule_fires[CARBON_MAX_RULES];
+  int64 rule_successes[CARBON_MAX_RULES];
+  int64 groups;
+  int64 expressions;
+  Size peak_memory; // maximum
+  int64 budget_exhausted;
+  int max_stage; // maximum
+  double total_time;
+  double max_time; // maximum
+} StatsEntry;
+
+typedef struct StatsState {
+  // Shared to update entries, exclusive to add or remove them
+  LWLock *lock;
+} StatsState;
+
+static int pg_carbon_stats_max = 1000;
+
+static StatsState *stats_state = NULL;
+static HTAB *stats_hash = NULL;
+
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+
+static void stats_shmem_request(void) {
+  if (prev_shmem_request_hook)
+    prev_shmem_request_hook();
+  RequestAddinShmemSpace(
+      add_size(MAXALIGN(sizeof(StatsState)),
+               hash_estimate_size(pg_carbon_stats_max, sizeof(StatsEntry))));
+  RequestNamedLWLockTranche("pg_carbon_stats", 1);
+}
+
+static void stats_shmem_startup(void) {
+  bool found;
+  HASHCTL info;
+
+  if (prev_shmem_startup_hook)
+    prev_shmem_startup_hook();
+
+  LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+  stats_state =
+      ShmemInitStruct("pg_carbon stats", sizeof(StatsState), &found);
+  if (!found)
+    stats_state->lock = &(GetNamedLWLockTranche("pg_carbon_stats"))->lock;
+  info.keysize = sizeof(uint64);
+  info.entrysize = sizeof(StatsEntry);
+  stats_hash = ShmemInitHash("pg_carbon stats", pg_carbon_stats_max,
+                             pg_carbon_stats_max, &info,
+                             HASH_ELEM | HASH_BLOBS);
+  LWLockRelease(AddinShmemInitLock);
+}
+
+void pg_carbon_stats_record(uint64 query_id, const CarbonStats *stats) {
+  bool found;
+  StatsEntry *entry;
+
+  // As in shadow mode, queries without a fingerprint (compute_query_id
+  // off) are not counted rather than all counted as one.
+  if (!stats_state || query_id == 0)
+    return;
+
+  LWLockAcquire(stats_state->lock, LW_SHARED);
+  entry = hash_search(stats_hash, &query_id, HASH_FIND, NULL);
+  if (!entry) {
+    LWLockRelease(stats_state->lock);
+    LWLockAcquire(stats_state->lock, LW_EXCLUSIVE);
+    entry = hash_search(stats_hash, &query_id, HASH_ENTER_NULL, &found);
+    if (entry && !found) {
+      memset((char *)entry + sizeof(uint64), 0,
+             sizeof(StatsEntry) - sizeof(uint64));
+      SpinLockInit(&entry->mutex);
+    }
+  }
+
+  // Fingerprints beyond pg_carbon.stats_max are not counted.
+  if (entry) {
+    SpinLockAcquire(&entry->mutex);
+    entry->calls++;
+    entry->fallbacks[stats->fallback]++;
+    for (int i = 0; i < CARBON_NUM_TASK_TYPES; i++)
+      entry->tasks[i] += stats->tasks[i];
+    for (int i = 0; i < CARBON_MAX_RULES; i++) {
+      entry->rule_fires[i] += stats->rule_fires[i];
+      entry->rule_successes[i] += stats->rule_successes[i];
+    }
+    entry->groups += stats->groups;
+    entry->expressions += stats->expressions;
+    entry->peak_memory = Max(entry->peak_memory, stats->memory);
+    entry->budget_exhausted += stats->exhausted;
+    entry->max_stage = Max(entry->max_stage, stats->stage);
+    entry->total_time += stats->time_ms;
+    entry->max_time = Max(entry->max_time, stats->time_ms);
+    SpinLockRelease(&entry->mutex);
+  }
+  LWLockRelease(stats_state->lock);
+}
+
+void pg_carbon_stats_init(void) {
+  // The statistics need shared memory, which is only set up for libraries
+  // loaded at server start.
+  if (!process_shared_preload_libraries_in_progress)
+    return;
+
+  DefineCustomIntVariable(
+      "pg_carbon.stats_max",
+      "Number of query fingerprints pg_carbon keeps optimizer statistics for",
+      NULL, &pg_carbon_stats_max, 1000, 100, INT_MAX / 2, PGC_POSTMASTER, 0,
+      NULL, NULL, NULL);
+
+  prev_shmem_request_hook = shmem_request_hook;
+  shmem_request_hook = stats_shmem_request;
+  prev_shmem_startup_hook = shmem_startup_hook;
+  shmem_startup_hook = stats_shmem_startup;
+}
+
+static void stats_check_loaded(void) {
+  if (!stats_state || !stats_hash)
+    ereport(ERROR,
+            (errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+             errmsg("pg_carbon must be loaded via shared_preload_libraries")));
+}
+
+// A consistent copy of `entry`, read under the shared lock
+static StatsEntry stats_copy(StatsEntry *entry) {
+  StatsEntry copy;
+
+  SpinLockAcquire(&entry->mutex);
+  copy = *entry;
+  SpinLockRelease(&entry->mutex);
+  return copy;
+}
+
+PG_FUNCTION_INFO_V1(pg_carbon_stats);
+
+Datum pg_carbon_stats(PG_FUNCTION_ARGS) {
+  ReturnSetInfo *rsinfo = (ReturnSetInfo *)fcinfo->resultinfo;
+  HASH_SEQ_STATUS status;
+  StatsEntry *entry;
+
+  stats_check_loaded();
+  InitMaterializedSRF(fcinfo, 0);
+
+  LWLockAcquire(stats_state->lock, LW_SHARED);
+  hash_seq_init(&status, stats_hash);
+  while ((entry = hash_seq_search(&status)) != NULL) {
+    Datum values[21];
+    bool nulls[21] = {false};
+    StatsEntry copy = stats_copy(entry);
+    int n = 0;
+
+    values[n++] = Int64GetDatum((int64)copy.query_id);
+    values[n++] = Int64GetDatum(copy.calls);
+    for (int i = 0; i < CARBON_NUM_FALLBACKS; i++)
+      values[n++] = Int64GetDatum(copy.fallbacks[i]);
+    for (int i = 0; i < CARBON_NUM_TASK_TYPES; i++)
+      values[n++] = Int64GetDatum(copy.tasks[i]);
+    values[n++] = Float8GetDatum((double)copy.groups / copy.calls);
+    values[n++] = Float8GetDatum((double)copy.expressions / copy.calls);
+    values[n++] = Int64GetDatum((int64)copy.peak_memory);
+    values[n++] = Int64GetDatum(copy.budget_exhausted);
+    values[n++] = Int32GetDatum(copy.max_stage);
+    values[n++] = Float8GetDatum(copy.total_time);
+    values[n++] = Float8GetDatum(copy.total_time / copy.calls);
+    values[n++] = Float8GetDatum(copy.max_time);
+    Assert(n == lengthof(values));
+    tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+  }
+  LWLockRelease(stats_state->lock);
+
+  return (Datum)0;
+}
+
+PG_FUNCTION_INFO_V1(pg_carbon_rule_stats);
+
+Datum pg_carbon_rule_stats(PG_FUNCTION_ARGS) {
+  ReturnSetInfo *rsinfo = (ReturnSetInfo *)fcinfo->resultinfo;
+  HASH_SEQ_STATUS status;
+  StatsEntry *entry;
+  const char *names[CARBON_MAX_RULES];
+
+  stats_check_loaded();
+  InitMaterializedSRF(fcinfo, 0);
+
+  // Looked up before taking the lock: the first lookup builds the rules.
+  for (int i = 0; i < CARBON_MAX_RULES; i++)
+    names[i] = pg_carbon_rule_name(i);
+
+  LWLockAcquire(stats_state->lock, LW_SHARED);
+  hash_seq_init(&status, stats_hash);
+  while ((entry = hash_seq_search(&status)) != NULL) {
+    StatsEntry copy = stats_copy(entry);
+
+    for (int i = 0; i < CARBON_MAX_RULES; i++) {
+      Datum values[4];
+      bool nulls[4] = {false};
+
+      if (!names[i] || copy.rule_fires[i] == 0)
+        continue;
+      values[0] = Int64GetDatum((int64)copy.query_id);
+      values[1] = CStringGetTextDatum(names[i]);
+      values[2] = Int64GetDatum(copy.rule_fires[i]);
+      values[3] = Int64GetDatum(copy.rule_successes[i]);
+      tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+    }
+  }
+  LWLockRelease(stats_state->lock);
+
+  return (Datum)0;
+}
+
+PG_FUNCTION_INFO_V1(pg_carbon_stats_reset);
+
+Datum pg_carbon_stats_reset(PG_FUNCTION_ARGS) {
+  HASH_SEQ_STATUS status;
+  StatsEntry *entry;
+
+  stats_check_loaded();
+
+  LWLockAcquire(stats_state->lock, LW_EXCLUSIVE);
+  hash_seq_init(&status, stats_hash);
+  while ((entry = hash_seq_search(&status)) != NULL)
+    hash_search(stats_hash, &entry->query_id, HASH_REMOVE, NULL);
+  LWLockRelease(stats_state->lock);
+
+  PG_RETURN_VOID();
+}
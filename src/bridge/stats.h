@@ -0,0 +1,19 @@
+#ifndef PG_CARBON_STATS_H
+#define PG_CARBON_STATS_H
+
+#include "postgres.h"
+#include "../optimizer/instrumentation.h"
+
+// Optimizer statistics: the counters of every pg_carbon planning run
+// (CarbonStats), summed per query fingerprint (queryId); queries without
+// one are not counted. They live in shared memory, so pg_carbon has to be
+// in shared_preload_libraries to keep them, and are shown by the
+// pg_carbon_stats and pg_carbon_rule_stats views.
+
+// Defines the GUCs and installs the hooks; called from _PG_init
+void pg_carbon_stats_init(void);
+
+// Adds the counters of one run to the statistics of `query_id`
+void pg_carbon_stats_record(uint64 query_id, const CarbonStats *stats);
+
+#endif // PG_CARBON_STATS_H
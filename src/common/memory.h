@@ -1,11 +1,16 @@
 #ifndef PG_CARBON_MEMORY_H
 #define PG_CARBON_MEMORY_H
 
+#include <algorithm>
+#include <cstring>
 #include <deque>
+#include <initializer_list>
 #include <list>
 #include <memory>
 #include <new>
 #include <stack>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>
 
 extern "C" {
@@ -15,6 +20,39 @@ extern "C" {
 
 namespace pg_carbon {
 
+// Bytes handed out by Memory while it tracks them, and the most at once
+struct MemoryUsage {
+  Size current = 0;
+  Size peak = 0;
+};
+
+// Where the memory of the optimizer's objects and containers comes from:
+// the given memory context, or the current one. Benchmarks have it count
+// the chunks too, for the peak a search needs.
+class Memory {
+public:
+  static void *Allocate(std::size_t size, MemoryContext ctx = nullptr) {
+    void *p = ctx ? MemoryContextAlloc(ctx, size) : palloc(size);
+    if (unlikely(usage_)) {
+      usage_->current += GetMemoryChunkSpace(p);
+      usage_->peak = std::max(usage_->peak, usage_->current);
+    }
+    return p;
+  }
+
+  static void Free(void *p) {
+    if (unlikely(usage_))
+      usage_->current -= std::min(usage_->current, GetMemoryChunkSpace(p));
+    pfree(p);
+  }
+
+  // Counts allocations in `usage` from now on; nullptr stops counting
+  static void Track(MemoryUsage *usage) { usage_ = usage; }
+
+private:
+  static inline MemoryUsage *usage_ = nullptr;
+};
+
 // C++ Allocator using palloc/pfree
 template <typename T> class PgAllocator {
 public:
@@ -28,19 +66,13 @@ public:
     if (n > std::size_t(-1) / sizeof(T))
       throw std::bad_alloc();
 
-    void *p;
-    if (ctx_) {
-      p = MemoryContextAlloc(ctx_, n * sizeof(T));
-    } else {
-      p = palloc(n * sizeof(T));
-    }
-
+    void *p = Memory::Allocate(n * sizeof(T), ctx_);
     if (p)
       return static_cast<T *>(p);
     throw std::bad_alloc();
   }
 
-  void deallocate(T *p, std::size_t) { pfree(p); }
+  void deallocate(T *p, std::size_t) { Memory::Free(p); }
 
   MemoryContext GetContext() const { return ctx_; }
 
@@ -62,13 +94,17 @@ bool operator!=(const PgAllocator<T> &a, const PgAllocator<U> &b) {
 // Base class for objects to be allocated in PG memory context
 class PgObject {
 public:
-  static void *operator new(std::size_t size) { return palloc(size); }
+  static void *operator new(std::size_t size) {
+    return Memory::Allocate(size);
+  }
   static void *operator new(std::size_t size, MemoryContext ctx) {
-    return MemoryContextAlloc(ctx, size);
+    return Memory::Allocate(size, ctx);
   }
 
-  static void operator delete(void *ptr) { pfree(ptr); }
-  static void operator delete(void *ptr, MemoryContext ctx) { pfree(ptr); }
+  static void operator delete(void *ptr) { Memory::Free(ptr); }
+  static void operator delete(void *ptr, MemoryContext ctx) {
+    Memory::Free(ptr);
+  }
 
   // Placement new/delete
   static void *operator new(std::size_t size, void *ptr) { return ptr; }
@@ -86,6 +122,163 @@ template <typename T> using PgDeque = std::deque<T, PgAllocator<T>>;
 
 template <typename T> using PgStack = std::stack<T, PgDeque<T>>;
 
+template <typename K, typename V, typename Hash = std::hash<K>>
+using PgUnorderedMap =
+    std::unordered_map<K, V, Hash, std::equal_to<K>,
+                       PgAllocator<std::pair<const K, V>>>;
+
+template <typename K, typename V, typename Hash = std::hash<K>>
+using PgUnorderedMultimap =
+    std::unordered_multimap<K, V, Hash, std::equal_to<K>,
+                            PgAllocator<std::pair<const K, V>>>;
+
+// Array of a size fixed at construction, holding up to N elements in place
+// and more in a separate allocation
+template <typename T, std::size_t N> class PgSmallArray {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "PgSmallArray copies its elements with memcpy");
+
+public:
+  PgSmallArray() = default;
+  PgSmallArray(std::initializer_list<T> elems) {
+    Assign(elems.begin(), elems.size());
+  }
+  PgSmallArray(const PgVector<T> &elems) {
+    Assign(elems.data(), elems.size());
+  }
+  PgSmallArray(const PgSmallArray &other) { Assign(other.data(), other.size_); }
+  PgSmallArray &operator=(const PgSmallArray &other) {
+    if (this != &other) {
+      Release();
+      Assign(other.data(), other.size_);
+    }
+    return *this;
+  }
+  ~PgSmallArray() { Release(); }
+
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  const T *data() const { return size_ <= N ? inline_ : heap_; }
+  const T *begin() const { return data(); }
+  const T *end() const { return data() + size_; }
+  const T &operator[](std::size_t i) const { return data()[i]; }
+
+  bool operator==(const PgSmallArray &other) const {
+    return size_ == other.size_ &&
+           std::equal(begin(), end(), other.begin());
+  }
+  bool operator!=(const PgSmallArray &other) const {
+    return !(*this == other);
+  }
+
+private:
+  void Assign(const T *elems, std::size_t size) {
+    size_ = static_cast<uint32>(size);
+    T *dest = inline_;
+    if (size > N)
+      dest = heap_ = static_cast<T *>(Memory::Allocate(size * sizeof(T)));
+    if (size > 0)
+      memcpy(dest, elems, size * sizeof(T));
+  }
+  void Release() {
+    if (size_ > N)
+      Memory::Free(heap_);
+    size_ = 0;
+  }
+
+  uint32 size_ = 0;
+  union {
+    T inline_[N];
+    T *heap_;
+  };
+};
+
+// Hash map keeping its entries in one array, probed linearly, rather than
+// in a node each. Entries cannot be removed.
+template <typename K, typename V, typename Hash = std::hash<K>>
+class PgFlatMap {
+  static_assert(std::is_trivially_copyable<K>::value &&
+                    std::is_trivially_copyable<V>::value,
+                "PgFlatMap moves its entries as plain bytes");
+
+public:
+  PgFlatMap() = default;
+  PgFlatMap(const PgFlatMap &) = delete;
+  PgFlatMap &operator=(const PgFlatMap &) = delete;
+  ~PgFlatMap() {
+    if (slots_)
+      Memory::Free(slots_);
+  }
+
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  // The value of `key`, or nullptr
+  const V *Find(const K &key) const {
+    if (size_ == 0)
+      return nullptr;
+    for (std::size_t i = Bucket(key);; i = (i + 1) & (capacity_ - 1)) {
+      if (!slots_[i].used)
+        return nullptr;
+      if (slots_[i].key == key)
+        return &slots_[i].value;
+    }
+  }
+
+  // Adds `key`, which is not in the map yet
+  void Insert(const K &key, const V &value) {
+    // At most three quarters full, so that probes stay short
+    if ((size_ + 1) * 4 > capacity_ * 3)
+      Grow();
+    Place(key, value);
+    size_++;
+  }
+
+private:
+  struct Slot {
+    K key;
+    V value;
+    bool used;
+  };
+  static constexpr int kInitialBits = 4;
+
+  // Fibonacci hashing: the top bits of the hash times 2^64 / phi, so that
+  // hashes differing only in their high bits still spread out
+  std::size_t Bucket(const K &key) const {
+    uint64 hash = static_cast<uint64>(Hash()(key));
+    return static_cast<std::size_t>((hash * UINT64CONST(0x9E3779B97F4A7C15)) >>
+                                    (64 - bits_));
+  }
+  void Place(const K &key, const V &value) {
+    std::size_t i = Bucket(key);
+    while (slots_[i].used)
+      i = (i + 1) & (capacity_ - 1);
+    slots_[i].key = key;
+    slots_[i].value = value;
+    slots_[i].used = true;
+  }
+  void Grow() {
+    Slot *old = slots_;
+    std::size_t old_capacity = capacity_;
+    bits_ = bits_ ? bits_ + 1 : kInitialBits;
+    capacity_ = std::size_t(1) << bits_;
+    slots_ = static_cast<Slot *>(Memory::Allocate(capacity_ * sizeof(Slot)));
+    for (std::size_t i = 0; i < capacity_; i++)
+      slots_[i].used = false;
+    for (std::size_t i = 0; i < old_capacity; i++) {
+      if (old[i].used)
+        Place(old[i].key, old[i].value);
+    }
+    if (old)
+      Memory::Free(old);
+  }
+
+  Slot *slots_ = nullptr;
+  std::size_t capacity_ = 0;
+  std::size_t size_ = 0;
+  int bits_ = 0;
+};
+
 } // namespace pg_carbon
 
 #endif // PG_CARBON_MEMORY_H
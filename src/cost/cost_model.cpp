@@ -0,0 +1,453 @@
+#include "cost_model.h"
+#include "../metadata/metadata.h"
+#include "../operators/operators.h"
+#include "../optimizer/ordering.h"
+
+extern "C" {
+#include "executor/nodeHash.h"
+#include "miscadmin.h"
+#include "optimizer/cost.h"
+#include "optimizer/optimizer.h"
+#include "postgres.h"
+}
+
+#include <cmath>
+
+namespace pg_carbon {
+
+static double GroupRows(const Group *group) {
+  return group->GetLogicalProperties()
+             ? group->GetLogicalProperties()->GetCardinality()
+             : 1.0;
+}
+
+// Fraction of the inner input a semi or anti join reads per outer row: it
+// stops at the first match, which on average is halfway through for outer
+// rows that have one.
+static double InnerScanFraction(const GroupExpression *expr,
+                                JoinType join_type) {
+  if (join_type != JOIN_SEMI && join_type != JOIN_ANTI)
+    return 1.0;
+  double outer_rows = GroupRows(expr->GetChildren()[0]);
+  double matched = GroupRows(expr->GetGroup()) / outer_rows;
+  if (join_type == JOIN_ANTI)
+    matched = 1.0 - matched;
+  matched = std::max(0.0, std::min(1.0, matched));
+  return 1.0 - matched / 2.0;
+}
+
+static double InputWidth(const Group *group) {
+  return group->GetLogicalProperties()
+             ? group->GetLogicalProperties()->GetWidth()
+             : 0.0;
+}
+
+static const PlanCost &InputCost(const GroupExpression *expr, size_t index) {
+  return expr->GetChildren()[index]->GetBestExpression()->GetCost();
+}
+
+double CostModel::SortCost(double rows, double width) {
+  if (rows < 2.0)
+    rows = 2.0;
+  // Same default comparison cost as cost_sort()
+  double cost = 2.0 * cpu_operator_cost * rows * std::log2(rows);
+
+  // External sort: write and read every page once per merge pass, roughly.
+  double bytes = rows * (width + 24.0);
+  double sort_mem = static_cast<double>(work_mem) * 1024.0;
+  if (bytes > sort_mem) {
+    double pages = std::ceil(bytes / BLCKSZ);
+    cost += 2.0 * pages * seq_page_cost;
+  }
+  return cost;
+}
+
+PlanCost CostModel::SortedInputCost(Memo *memo, const Group *input,
+                                    const SortKeyList &keys,
+                                    int *presorted) {
+  PlanCost input_cost = input->GetBestExpression()->GetCost();
+  int prefix = Ordering::PresortedKeys(input, keys);
+  if (presorted)
+    *presorted = prefix;
+  if (prefix == (int)keys.size())
+    return input_cost;
+
+  double rows = GroupRows(input);
+  double width = InputWidth(input);
+  PlanCost full;
+  full.startup = input_cost.total + SortCost(rows, width);
+  full.total = full.startup + rows * cpu_operator_cost;
+  if (prefix == 0)
+    return full;
+
+  // Incremental sort, as in cost_incremental_sort(): the input is read in
+  // groups of rows that agree on the presorted keys, each sorted on the
+  // rest before it is returned. Groups are assumed to come out half again
+  // as large as the average, and finding their boundaries costs a
+  // comparison per row.
+  double groups = 1.0;
+  for (int i = 0; i < prefix; i++)
+    groups *= KeyDistinct(memo, keys[i].expr);
+  groups = std::max(1.0, std::min(groups, rows));
+  double group_rows = 1.5 * rows / groups;
+  double group_sort =
+      SortCost(group_rows, width) + group_rows * cpu_operator_cost;
+  double input_run = input_cost.total - input_cost.startup;
+  PlanCost incremental;
+  incremental.startup = input_cost.startup + input_run / groups + group_sort;
+  incremental.total = input_cost.total + groups * group_sort +
+                      rows * (cpu_tuple_cost + prefix * cpu_operator_cost) +
+                      2.0 * cpu_tuple_cost * groups;
+  if (incremental.total < full.total)
+    return incremental;
+  if (presorted)
+    *presorted = 0;
+  return full;
+}
+
+bool CostModel::CoversInputs(const GroupExpression *expr) {
+  switch (expr->GetOperatorType()) {
+  case OperatorType::PHYSICAL_LIMIT:
+  case OperatorType::PHYSICAL_MEMOIZE:
+    return false;
+  default:
+    return true;
+  }
+}
+
+double CostModel::MemoizeEntries(double rows, double width) {
+  // Every entry holds its key and tuples plus some bookkeeping.
+  double entry_bytes = rows * (width + 24.0) + 64.0;
+  return std::max(1.0, std::floor(get_hash_memory_limit() / entry_bytes));
+}
+
+// Mackert-Lohman approximation of the pages read when `tuples` rows are
+// fetched at random from a relation of `pages` pages, as in
+// index_pages_fetched(): pages still in the cache (effective_cache_size) are
+// not read again.
+static double PagesFetched(double tuples, double pages) {
+  double cache = std::max(1.0, static_cast<double>(effective_cache_size));
+  pages = std::max(1.0, pages);
+  double fetched;
+  if (pages <= cache) {
+    fetched = std::min(2.0 * pages * tuples / (2.0 * pages + tuples), pages);
+  } else {
+    double limit = 2.0 * pages * cache / (2.0 * pages - cache);
+    if (tuples <= limit)
+      fetched = 2.0 * pages * tuples / (2.0 * pages + tuples);
+    else
+      fetched = cache + (tuples - limit) * (pages - cache) / pages;
+  }
+  return std::ceil(fetched);
+}
+
+PlanCost CostModel::Compute(Memo *memo, const GroupExpression *expr) {
+  Operator *op = expr->GetOperator();
+  PlanCost cost;
+
+  switch (op->GetType()) {
+  case OperatorType::PHYSICAL_TABLE_SCAN: {
+    auto *scan = static_cast<PhysicalTableScan *>(op);
+    double pages = MetadataAccessor::GetTablePages(scan->GetScannedOid());
+    double rows = MetadataAccessor::GetTableRows(scan->GetScannedOid());
+    cost.total = pages * seq_page_cost + rows * cpu_tuple_cost;
+    break;
+  }
+  case OperatorType::PHYSICAL_INDEX_SCAN: {
+    // Descend the btree, read the matching index tuples and fetch a heap
+    // page for each, as cost_index() does for uncorrelated indexes. The
+    // cost is per scan; repeated scans find part of the pages cached.
+    auto *scan = static_cast<PhysicalIndexScan *>(op);
+    const IndexMetadata *index = MetadataAccessor::GetIndexMetadata(
+        scan->GetTableOid(), scan->GetIndexOid());
+    if (!index)
+      break;
+    double loops = std::max(1.0, scan->GetLoops());
+    double tuples = std::max(1.0, std::rint(scan->GetSelectivity() *
+                                            index->tuples));
+    double index_pages =
+        std::ceil(tuples * index->pages / std::max(1.0, index->tuples));
+    double heap_pages = MetadataAccessor::GetTablePages(scan->GetTableOid());
+
+    cost.startup = (std::ceil(std::log2(std::max(2.0, index->tuples))) +
+                    (index->tree_height + 1) * 50.0) *
+                   cpu_operator_cost;
+    cost.total = cost.startup;
+    cost.total += PagesFetched(index_pages * loops, index->pages) / loops *
+                  random_page_cost;
+    cost.total += tuples * (cpu_index_tuple_cost +
+                            scan->GetIndexPredicates().size() *
+                                cpu_operator_cost);
+    cost.total +=
+        PagesFetched(tuples * loops, heap_pages) / loops * random_page_cost;
+    cost.total += tuples * (cpu_tuple_cost + scan->GetPredicates().size() *
+                                                 cpu_operator_cost);
+    break;
+  }
+  case OperatorType::PHYSICAL_MEMOIZE: {
+    // Average cost of one rescan, as in cost_memoize_rescan(): a cache
+    // lookup per call, and the input only runs for keys that are not
+    // cached, the first time they are seen or after an eviction.
+    auto *memoize = static_cast<PhysicalMemoize *>(op);
+    const PlanCost &input = InputCost(expr, 0);
+    Group *child = expr->GetChildren()[0];
+    double rows = GroupRows(child);
+    double calls = std::max(1.0, memoize->GetCalls());
+    double distinct =
+        std::max(1.0, std::min(memoize->GetDistinct(), calls));
+    double entries =
+        std::min(MemoizeEntries(rows, InputWidth(child)), distinct);
+    double evict_ratio = 1.0 - entries / distinct;
+    double hit_ratio = (calls - distinct) / calls * (entries / distinct);
+    hit_ratio = std::max(0.0, std::min(1.0, hit_ratio));
+
+    cost.startup = input.startup * (1.0 - hit_ratio) + cpu_tuple_cost;
+    cost.total = input.total * (1.0 - hit_ratio) + cpu_tuple_cost;
+    cost.total += list_length(memoize->GetCacheKeys()) * cpu_operator_cost;
+    cost.total += (1.0 - hit_ratio + evict_ratio) * rows * cpu_tuple_cost;
+    break;
+  }
+  case OperatorType::PHYSICAL_FILTER: {
+    // The filter is evaluated by the node below, once per input row.
+    auto *filter = static_cast<PhysicalFilter *>(op);
+    cost = InputCost(expr, 0);
+    cost.total += GroupRows(expr->GetChildren()[0]) *
+                  filter->GetPredicates().size() * cpu_operator_cost;
+    break;
+  }
+  case OperatorType::PHYSICAL_NESTED_LOOP_JOIN: {
+    // The inner side is materialized, so rescans only pay for reading the
+    // stored tuples back. A parameterized inner side is rescanned for real,
+    // and its cost and rows are per outer row already.
+    auto *join = static_cast<PhysicalNestedLoopJoin *>(op);
+    const PlanCost &outer = InputCost(expr, 0);
+    const PlanCost &inner = InputCost(expr, 1);
+    double outer_rows = GroupRows(expr->GetChildren()[0]);
+    double inner_rows = GroupRows(expr->GetChildren()[1]);
+    double pairs = outer_rows * inner_rows *
+                   InnerScanFraction(expr, join->GetJoinType());
+
+    cost.startup = outer.startup + inner.startup;
+    if (join->IsParameterized()) {
+      cost.total = outer.total + outer_rows * inner.total;
+    } else {
+      cost.total = outer.total + inner.total;
+      cost.total += 2.0 * cpu_operator_cost * inner_rows;
+    }
+    cost.total += pairs * cpu_operator_cost;
+    cost.total += pairs * join->GetPredicates().size() * cpu_operator_cost;
+    cost.total += GroupRows(expr->GetGroup()) * cpu_tuple_cost;
+    break;
+  }
+  case OperatorType::PHYSICAL_HASH_JOIN: {
+    // Build: hash every inner row before the first output row. Probe: hash
+    // every outer row and check the candidates in its bucket. Inputs that do
+    // not fit into hash_mem are split into batches written out and read back
+    // once.
+    auto *join = static_cast<PhysicalHashJoin *>(op);
+    const PlanCost &outer = InputCost(expr, 0);
+    const PlanCost &inner = InputCost(expr, 1);
+    Group *outer_group = expr->GetChildren()[0];
+    Group *inner_group = expr->GetChildren()[1];
+    double outer_rows = GroupRows(outer_group);
+    double inner_rows = GroupRows(inner_group);
+    double nkeys = join->GetHashPredicates().size();
+
+    cost.startup = inner.total + outer.startup;
+    cost.startup += inner_rows * (nkeys * cpu_operator_cost + cpu_tuple_cost);
+    cost.total = cost.startup + (outer.total - outer.startup);
+    cost.total += outer_rows * nkeys * cpu_operator_cost;
+
+    double inner_bytes = inner_rows * (InputWidth(inner_group) + 24.0);
+    if (inner_bytes > get_hash_memory_limit()) {
+      double pages =
+          std::ceil((inner_bytes + outer_rows * (InputWidth(outer_group) +
+                                                 24.0)) /
+                    BLCKSZ);
+      cost.total += 2.0 * pages * seq_page_cost;
+    }
+
+    // Roughly one candidate per output row (per outer row for semi and
+    // anti joins) has the remaining predicates checked.
+    bool semi = join->GetJoinType() == JOIN_SEMI ||
+                join->GetJoinType() == JOIN_ANTI;
+    double candidates = semi ? outer_rows : GroupRows(expr->GetGroup());
+    cost.total += candidates * (nkeys + join->GetPredicates().size()) *
+                  cpu_operator_cost;
+    cost.total += GroupRows(expr->GetGroup()) * cpu_tuple_cost;
+    break;
+  }
+  case OperatorType::PHYSICAL_MERGE_JOIN: {
+    // Both inputs are sorted on the keys first (the translator adds the Sort
+    // nodes), then read once in step.
+    auto *join = static_cast<PhysicalMergeJoin *>(op);
+    const PlanCost &outer = InputCost(expr, 0);
+    const PlanCost &inner = InputCost(expr, 1);
+    Group *outer_group = expr->GetChildren()[0];
+    Group *inner_group = expr->GetChildren()[1];
+    double outer_rows = GroupRows(outer_group);
+    double inner_rows = GroupRows(inner_group);
+    double nkeys = join->GetMergePredicates().size();
+
+    cost.startup = outer.total + SortCost(outer_rows, InputWidth(outer_group));
+    cost.startup += inner.total + SortCost(inner_rows, InputWidth(inner_group));
+    cost.total = cost.startup;
+    cost.total += (outer_rows + inner_rows) * nkeys * cpu_operator_cost;
+    cost.total += GroupRows(expr->GetGroup()) *
+                  (join->GetPredicates().size() * cpu_operator_cost +
+                   cpu_tuple_cost);
+    break;
+  }
+  case OperatorType::PHYSICAL_APPEND: {
+    // The children run one after the other; passing a row on is cheaper
+    // than a projection.
+    cost = InputCost(expr, 0);
+    for (size_t i = 1; i < expr->GetChildren().size(); i++)
+      cost.total += InputCost(expr, i).total;
+    cost.total += 0.5 * cpu_tuple_cost * GroupRows(expr->GetGroup());
+    break;
+  }
+  case OperatorType::PHYSICAL_MERGE_APPEND: {
+    // Every input is sorted before the first row comes out; each row then
+    // passes through a heap of the inputs' current rows, as in
+    // cost_merge_append().
+    double inputs = std::max(2.0, (double)expr->GetChildren().size());
+    double comparison = 2.0 * cpu_operator_cost * std::log2(inputs);
+    for (size_t i = 0; i < expr->GetChildren().size(); i++) {
+      Group *child = expr->GetChildren()[i];
+      cost.startup += InputCost(expr, i).total +
+                      SortCost(GroupRows(child), InputWidth(child));
+    }
+    cost.startup += inputs * comparison;
+    double rows = GroupRows(expr->GetGroup());
+    cost.total = cost.startup + rows * (comparison + 0.5 * cpu_tuple_cost);
+    break;
+  }
+  case OperatorType::PHYSICAL_SET_OP: {
+    // Every input row has its columns compared or hashed. The hashed
+    // version builds its table on the left input before reading the right
+    // one; the sorted one sorts both.
+    auto *setop = static_cast<PhysicalSetOp *>(op);
+    Group *left = expr->GetChildren()[0];
+    Group *right = expr->GetChildren()[1];
+    double rows = GroupRows(left) + GroupRows(right);
+    double ncols = list_length(setop->GetGroupClauses());
+    double compare = rows * ncols * cpu_operator_cost;
+    cost.startup = InputCost(expr, 0).total + InputCost(expr, 1).total;
+    if (setop->GetStrategy() == SETOP_SORTED) {
+      cost.startup += SortCost(GroupRows(left), InputWidth(left)) +
+                      SortCost(GroupRows(right), InputWidth(right));
+      cost.total = cost.startup + compare;
+    } else {
+      cost.startup += compare;
+      cost.total = cost.startup;
+    }
+    cost.total += GroupRows(expr->GetGroup()) * cpu_tuple_cost;
+    break;
+  }
+  case OperatorType::PHYSICAL_CTE_SCAN: {
+    // The shared plan runs once and writes its rows to a tuplestore that
+    // every reference reads, as in cost_ctescan(). Each reference carries
+    // its share of the plan, so inlining one competes against that.
+    auto *scan = static_cast<PhysicalCteScan *>(op);
+    const Group *producer = memo->GetCteProducer(scan->GetCteIndex());
+    const PlanCost &plan = producer->GetBestExpression()->GetCost();
+    double shares = std::max(1, scan->GetShares());
+    double rows = GroupRows(producer);
+    cost.startup = plan.startup / shares;
+    cost.total = (plan.total + rows * cpu_operator_cost) / shares +
+                 rows * cpu_tuple_cost;
+    break;
+  }
+  case OperatorType::PHYSICAL_SORT: {
+    const PlanCost &input = InputCost(expr, 0);
+    Group *child = expr->GetChildren()[0];
+    double rows = GroupRows(child);
+    cost.startup = input.total + SortCost(rows, InputWidth(child));
+    cost.total = cost.startup + rows * cpu_operator_cost;
+    break;
+  }
+  case OperatorType::PHYSICAL_INCREMENTAL_SORT: {
+    auto *sort = static_cast<PhysicalIncrementalSort *>(op);
+    cost = SortedInputCost(memo, expr->GetChildren()[0], sort->GetKeys());
+    break;
+  }
+  case OperatorType::PHYSICAL_WINDOW_AGG: {
+    // The input sorted on the keys; every row then goes through each window
+    // function and has its keys compared with the previous row's, as in
+    // cost_windowagg().
+    auto *window = static_cast<PhysicalWindowAgg *>(op);
+    Group *child = expr->GetChildren()[0];
+    cost = SortedInputCost(memo, child, window->GetKeys());
+    double per_row =
+        list_length(window->GetWindowFuncs()) + window->GetKeys().size();
+    cost.total +=
+        GroupRows(child) * (per_row * cpu_operator_cost + cpu_tuple_cost);
+    break;
+  }
+  case OperatorType::PHYSICAL_AGGREGATE: {
+    // Every input row goes through each transition function and has its
+    // keys compared or hashed; every group is emitted once. Sorted grouping
+    // sorts its input first. Hashed grouping consumes the whole input before
+    // the first group comes out, and writes the input out and reads it back
+    // once if the groups do not fit into hash_mem.
+    auto *agg = static_cast<PhysicalAggregate *>(op);
+    const PlanCost &input = InputCost(expr, 0);
+    Group *child = expr->GetChildren()[0];
+    double input_rows = GroupRows(child);
+    double groups = GroupRows(expr->GetGroup());
+    double per_row = list_length(agg->GetAggregates()) + agg->GetKeys().size();
+    double transition = input_rows * per_row * cpu_operator_cost;
+
+    switch (agg->GetStrategy()) {
+    case AGG_HASHED: {
+      cost.startup = input.total + transition;
+      double group_bytes = groups * (InputWidth(expr->GetGroup()) + 24.0);
+      if (group_bytes > get_hash_memory_limit()) {
+        double pages =
+            std::ceil(input_rows * (InputWidth(child) + 24.0) / BLCKSZ);
+        cost.startup += 2.0 * pages * seq_page_cost;
+      }
+      cost.total = cost.startup + groups * cpu_tuple_cost;
+      break;
+    }
+    case AGG_SORTED:
+      cost.startup = input.total + SortCost(input_rows, InputWidth(child));
+      cost.total = cost.startup + transition + groups * cpu_tuple_cost;
+      break;
+    default:
+      cost.startup = input.total + transition;
+      cost.total = cost.startup + cpu_tuple_cost;
+      break;
+    }
+    break;
+  }
+  case OperatorType::PHYSICAL_LIMIT: {
+    // Only the fraction of the input that is actually fetched is paid for.
+    const PlanCost &input = InputCost(expr, 0);
+    double input_rows = GroupRows(expr->GetChildren()[0]);
+    double output_rows = GroupRows(expr->GetGroup());
+    double run_cost = input.total - input.startup;
+    double fraction = std::min(1.0, output_rows / input_rows);
+    cost.startup = input.startup;
+    cost.total = input.startup + run_cost * fraction;
+    break;
+  }
+  case OperatorType::PHYSICAL_EMPTY_RESULT:
+    // Decided by a one-time filter before anything is read
+    break;
+  default: {
+    // Projection and friends are evaluated by their input node.
+    for (size_t i = 0; i < expr->GetChildren().size(); i++) {
+      const PlanCost &input = InputCost(expr, i);
+      cost.startup += input.startup;
+      cost.total += input.total;
+    }
+    break;
+  }
+  }
+
+  return cost;
+}
+
+} // namespace pg_carbon
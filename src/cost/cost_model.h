@@ -0,0 +1,43 @@
+#ifndef PG_CARBON_COST_MODEL_H
+#define PG_CARBON_COST_MODEL_H
+
+#include "../common/memory.h"
+#include "../operators/operators.h"
+#include "../optimizer/memo.h"
+
+namespace pg_carbon {
+
+// Cost formulas for physical operators. They follow the shape of PG's
+// costsize.c closely enough that the numbers are comparable with the ones
+// the standard planner produces, and use the same cost GUCs.
+class CostModel {
+public:
+  // Cumulative cost of a physical expression whose input groups all have a
+  // winner already.
+  static PlanCost Compute(Memo *memo, const GroupExpression *expr);
+
+  // Cost of sorting `rows` tuples of `width` bytes, excluding the input
+  static double SortCost(double rows, double width);
+
+  // Cost of the rows of `input`, whose winner is known, sorted on `keys`:
+  // nothing more if the winner is sorted on all of them already, else an
+  // incremental sort if it is sorted on a prefix and that is cheaper, or a
+  // full sort. `presorted` is set to the number of leading keys the chosen
+  // way relies on (0 for a full sort).
+  static PlanCost SortedInputCost(Memo *memo, const Group *input,
+                                  const SortKeyList &keys,
+                                  int *presorted = nullptr);
+
+  // Whether the cost of `expr` includes the whole cost of each input, so
+  // that its inputs bound it from below. Not so for Limit, which only
+  // fetches part of its input, and Memoize, which only runs it on misses.
+  static bool CoversInputs(const GroupExpression *expr);
+
+  // Number of cache entries of `rows` tuples of `width` bytes each that a
+  // Memoize node can keep in hash_mem
+  static double MemoizeEntries(double rows, double width);
+};
+
+} // namespace pg_carbon
+
+#endif // PG_CARBON_COST_MODEL_H
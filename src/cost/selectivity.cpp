@@ -0,0 +1,272 @@
+#include "selectivity.h"
+
+extern "C" {
+#include "nodes/nodeFuncs.h"
+#include "parser/parsetree.h"
+#include "utils/array.h"
+#include "utils/fmgroids.h"
+#include "utils/lsyscache.h"
+#include "utils/selfuncs.h"
+}
+
+#include <algorithm>
+
+namespace pg_carbon {
+
+static Node *StripRelabel(Node *node) {
+  while (node && IsA(node, RelabelType))
+    node = (Node *)((RelabelType *)node)->arg;
+  return node;
+}
+
+static double ClampSelectivity(double selectivity) {
+  return std::max(0.0, std::min(1.0, selectivity));
+}
+
+bool SelectivityEstimator::GetColumnStats(Node *expr, ColumnStats *stats) {
+  expr = StripRelabel(expr);
+  if (!expr || !IsA(expr, Var))
+    return false;
+
+  Var *var = (Var *)expr;
+  if (var->varlevelsup != 0 || var->varattno == InvalidAttrNumber)
+    return false;
+
+  RangeTblEntry *rte = rt_fetch(var->varno, query_->rtable);
+  if (rte->rtekind != RTE_RELATION)
+    return false;
+
+  *stats = MetadataAccessor::GetColumnStats(rte->relid, var->varattno);
+  return true;
+}
+
+double SelectivityEstimator::ValueSelectivity(const ColumnStats &stats,
+                                              FmgrInfo *eqproc, Oid collation,
+                                              Datum value,
+                                              bool column_on_left) {
+  double mcv_total = 0.0;
+  double mcv_min = 1.0;
+  for (size_t i = 0; i < stats.mcv_values.size(); i++) {
+    Datum mcv = stats.mcv_values[i];
+    Datum result = column_on_left
+                       ? FunctionCall2Coll(eqproc, collation, mcv, value)
+                       : FunctionCall2Coll(eqproc, collation, value, mcv);
+    if (DatumGetBool(result))
+      return stats.mcv_freqs[i];
+    mcv_total += stats.mcv_freqs[i];
+    mcv_min = std::min(mcv_min, stats.mcv_freqs[i]);
+  }
+
+  // Not a common value: spread what the MCVs leave over the remaining
+  // distinct values, but never rate it above the least common MCV
+  // (var_eq_const()).
+  double selectivity = ClampSelectivity(1.0 - mcv_total - stats.null_frac);
+  double other_distinct = stats.ndistinct - stats.mcv_values.size();
+  if (other_distinct > 1.0)
+    selectivity /= other_distinct;
+  if (!stats.mcv_values.empty())
+    selectivity = std::min(selectivity, mcv_min);
+  return selectivity;
+}
+
+double SelectivityEstimator::EqualitySelectivity(Oid opno, Oid collation,
+                                                 Node *left, Node *right) {
+  left = StripRelabel(left);
+  right = StripRelabel(right);
+
+  ColumnStats left_stats;
+  ColumnStats right_stats;
+  bool left_is_column = GetColumnStats(left, &left_stats);
+  bool right_is_column = GetColumnStats(right, &right_stats);
+
+  // column = column, usually a join clause: eqjoinsel() without MCVs
+  if (left_is_column && right_is_column) {
+    double nd1 = left_stats.ndistinct > 0 ? left_stats.ndistinct
+                                          : DEFAULT_NUM_DISTINCT;
+    double nd2 = right_stats.ndistinct > 0 ? right_stats.ndistinct
+                                           : DEFAULT_NUM_DISTINCT;
+    return (1.0 - left_stats.null_frac) * (1.0 - right_stats.null_frac) /
+           std::max(nd1, nd2);
+  }
+
+  bool column_on_left = left_is_column;
+  if (!left_is_column) {
+    std::swap(left, right);
+    std::swap(left_stats, right_stats);
+    std::swap(left_is_column, right_is_column);
+  }
+  if (right && IsA(right, Const) && ((Const *)right)->constisnull)
+    return 0.0;
+  if (left_is_column && left_stats.ndistinct > 0) {
+    if (right && IsA(right, Const) && OidIsValid(opno)) {
+      FmgrInfo eqproc;
+      fmgr_info(get_opcode(opno), &eqproc);
+      return ValueSelectivity(left_stats, &eqproc, collation,
+                              ((Const *)right)->constvalue, column_on_left);
+    }
+    // column = unknown value: every distinct value equally likely
+    return (1.0 - left_stats.null_frac) / left_stats.ndistinct;
+  }
+
+  return DEFAULT_EQ_SEL;
+}
+
+double SelectivityEstimator::OperatorSelectivity(Oid opno, Oid collation,
+                                                 Node *left, Node *right) {
+  switch (get_oprrest(opno)) {
+  case F_EQSEL:
+    return EqualitySelectivity(opno, collation, left, right);
+  case F_NEQSEL: {
+    double null_frac = 0.0;
+    ColumnStats stats;
+    if (GetColumnStats(left, &stats) || GetColumnStats(right, &stats))
+      null_frac = stats.null_frac;
+    return 1.0 -
+           EqualitySelectivity(get_negator(opno), collation, left, right) -
+           null_frac;
+  }
+  case F_SCALARLTSEL:
+  case F_SCALARLESEL:
+  case F_SCALARGTSEL:
+  case F_SCALARGESEL:
+    return DEFAULT_INEQ_SEL;
+  case F_LIKESEL:
+  case F_ICLIKESEL:
+  case F_REGEXEQSEL:
+  case F_ICREGEXEQSEL:
+    return DEFAULT_MATCH_SEL;
+  default:
+    return 0.5;
+  }
+}
+
+double SelectivityEstimator::ScalarArraySelectivity(ScalarArrayOpExpr *saop) {
+  Node *left = (Node *)linitial(saop->args);
+  Node *right = StripRelabel((Node *)lsecond(saop->args));
+  if (!saop->useOr || get_oprrest(saop->opno) != F_EQSEL)
+    return 0.5;
+
+  // x IN (list): one equality per element, assumed disjoint. Each element
+  // is estimated on its own so common and rare values are told apart.
+  double selectivity = 0.0;
+  if (IsA(right, Const)) {
+    Const *con = (Const *)right;
+    if (con->constisnull)
+      return 0.0;
+    ArrayType *array = DatumGetArrayTypeP(con->constvalue);
+    int16 elmlen;
+    bool elmbyval;
+    char elmalign;
+    get_typlenbyvalalign(ARR_ELEMTYPE(array), &elmlen, &elmbyval, &elmalign);
+    Datum *values;
+    bool *nulls;
+    int nelems;
+    deconstruct_array(array, ARR_ELEMTYPE(array), elmlen, elmbyval, elmalign,
+                      &values, &nulls, &nelems);
+
+    ColumnStats stats;
+    if (!GetColumnStats(left, &stats) || stats.ndistinct <= 0)
+      return ClampSelectivity(nelems * DEFAULT_EQ_SEL);
+    FmgrInfo eqproc;
+    fmgr_info(get_opcode(saop->opno), &eqproc);
+    for (int i = 0; i < nelems; i++) {
+      if (!nulls[i])
+        selectivity += ValueSelectivity(stats, &eqproc, saop->inputcollid,
+                                        values[i], true);
+    }
+  } else if (IsA(right, ArrayExpr)) {
+    ListCell *lc;
+    foreach (lc, ((ArrayExpr *)right)->elements) {
+      selectivity += EqualitySelectivity(saop->opno, saop->inputcollid, left,
+                                         (Node *)lfirst(lc));
+    }
+  } else {
+    return 0.5;
+  }
+
+  return ClampSelectivity(selectivity);
+}
+
+double SelectivityEstimator::EstimateSemiJoin(Node *clause,
+                                              const ColSet &inner_relids) {
+  if (!IsA(clause, OpExpr) || list_length(((OpExpr *)clause)->args) != 2 ||
+      get_oprrest(((OpExpr *)clause)->opno) != F_EQSEL)
+    return Estimate(clause);
+
+  // outer.x = inner.y: eqjoinsel_semi() without MCVs. If the inner side
+  // has fewer distinct values, only that many outer values can match.
+  Node *outer = StripRelabel((Node *)linitial(((OpExpr *)clause)->args));
+  Node *inner = StripRelabel((Node *)lsecond(((OpExpr *)clause)->args));
+  if (IsA(outer, Var) && inner_relids.IsMember(((Var *)outer)->varno))
+    std::swap(outer, inner);
+  if (!IsA(inner, Var) || !inner_relids.IsMember(((Var *)inner)->varno))
+    return Estimate(clause);
+
+  ColumnStats outer_stats;
+  ColumnStats inner_stats;
+  bool have_outer = GetColumnStats(outer, &outer_stats);
+  bool have_inner = GetColumnStats(inner, &inner_stats);
+  if (!have_outer || !have_inner || outer_stats.ndistinct <= 0 ||
+      inner_stats.ndistinct <= 0)
+    return 0.5 * (1.0 - outer_stats.null_frac);
+
+  double fraction =
+      std::min(1.0, inner_stats.ndistinct / outer_stats.ndistinct);
+  return fraction * (1.0 - outer_stats.null_frac);
+}
+
+double SelectivityEstimator::Estimate(Node *clause) {
+  if (!clause)
+    return 1.0;
+
+  switch (nodeTag(clause)) {
+  case T_Const: {
+    Const *con = (Const *)clause;
+    return (!con->constisnull && DatumGetBool(con->constvalue)) ? 1.0 : 0.0;
+  }
+  case T_BoolExpr: {
+    BoolExpr *bexpr = (BoolExpr *)clause;
+    ListCell *lc;
+    if (bexpr->boolop == AND_EXPR) {
+      double selectivity = 1.0;
+      foreach (lc, bexpr->args)
+        selectivity *= Estimate((Node *)lfirst(lc));
+      return selectivity;
+    }
+    if (bexpr->boolop == OR_EXPR) {
+      double selectivity = 0.0;
+      foreach (lc, bexpr->args) {
+        double arg = Estimate((Node *)lfirst(lc));
+        selectivity = selectivity + arg - selectivity * arg;
+      }
+      return selectivity;
+    }
+    return 1.0 - Estimate((Node *)linitial(bexpr->args));
+  }
+  case T_OpExpr: {
+    OpExpr *opexpr = (OpExpr *)clause;
+    if (list_length(opexpr->args) != 2)
+      return 0.5;
+    return ClampSelectivity(OperatorSelectivity(
+        opexpr->opno, opexpr->inputcollid, (Node *)linitial(opexpr->args),
+        (Node *)lsecond(opexpr->args)));
+  }
+  case T_ScalarArrayOpExpr:
+    return ScalarArraySelectivity((ScalarArrayOpExpr *)clause);
+  case T_NullTest: {
+    NullTest *test = (NullTest *)clause;
+    ColumnStats stats;
+    double null_frac = GetColumnStats((Node *)test->arg, &stats)
+                           ? stats.null_frac
+                           : DEFAULT_UNK_SEL;
+    return test->nulltesttype == IS_NULL ? null_frac : 1.0 - null_frac;
+  }
+  case T_RelabelType:
+    return Estimate((Node *)((RelabelType *)clause)->arg);
+  default:
+    // Same default as clause_selectivity()
+    return 0.5;
+  }
+}
+
+} // namespace pg_carbon
@@ -0,0 +1,51 @@
+#ifndef PG_CARBON_SELECTIVITY_H
+#define PG_CARBON_SELECTIVITY_H
+
+#include "../common/memory.h"
+#include "../metadata/metadata.h"
+#include "../optimizer/column.h"
+
+// clang-format off
+extern "C" {
+#include "postgres.h"
+#include "fmgr.h"
+#include "nodes/parsenodes.h"
+}
+// clang-format on
+
+namespace pg_carbon {
+
+// Estimates the fraction of rows a qual lets through, from pg_statistic
+// where it can and from PG's default selectivities otherwise. Runs once per
+// predicate at translation time; the search only ever sees the result.
+class SelectivityEstimator {
+public:
+  explicit SelectivityEstimator(Query *query) : query_(query) {}
+
+  double Estimate(Node *clause);
+
+  // Fraction of outer rows that find at least one match for `clause` among
+  // the rows of `inner_relids`, for semi and anti join predicates.
+  double EstimateSemiJoin(Node *clause, const ColSet &inner_relids);
+
+private:
+  double OperatorSelectivity(Oid opno, Oid collation, Node *left,
+                             Node *right);
+  double EqualitySelectivity(Oid opno, Oid collation, Node *left,
+                             Node *right);
+  double ScalarArraySelectivity(ScalarArrayOpExpr *saop);
+
+  // column = value, looked up in the column's MCV list
+  static double ValueSelectivity(const ColumnStats &stats, FmgrInfo *eqproc,
+                                 Oid collation, Datum value,
+                                 bool column_on_left);
+
+  // Statistics of a base-relation column, if `expr` is one
+  bool GetColumnStats(Node *expr, ColumnStats *stats);
+
+  Query *query_;
+};
+
+} // namespace pg_carbon
+
+#endif // PG_CARBON_SELECTIVITY_H
@@ -1,17 +1,373 @@
 #include "metadata.h"
 
 extern "C" {
+#include "access/genam.h"
+#include "access/htup_details.h"
+#include "access/nbtree.h"
+#include "access/table.h"
+#include "catalog/partition.h"
+#include "catalog/pg_am_d.h"
+#include "catalog/pg_class.h"
+#include "catalog/pg_constraint.h"
+#include "catalog/pg_index.h"
+#include "catalog/pg_statistic.h"
+#include "optimizer/plancat.h"
+#include "partitioning/partbounds.h"
+#include "partitioning/partdesc.h"
+#include "utils/builtins.h"
+#include "utils/datum.h"
 #include "utils/lsyscache.h"
+#include "utils/partcache.h"
 #include "utils/rel.h"
+#include "utils/relcache.h"
+#include "utils/syscache.h"
 }
 
 namespace pg_carbon {
 
+static PgCatalogProvider catalog_provider;
+
+MetadataAccessor::TableCache *MetadataAccessor::table_cache_ = nullptr;
+CatalogProvider *MetadataAccessor::provider_ = &catalog_provider;
+
+void MetadataAccessor::ResetCache() {
+  table_cache_ = nullptr;
+  provider_ = &catalog_provider;
+}
+
+MetadataAccessor::TableCache *MetadataAccessor::GetCache() {
+  if (!table_cache_)
+    table_cache_ = new TableCache();
+  return table_cache_;
+}
+
+const TableMetadata *MetadataAccessor::GetTableMetadata(Oid table_oid) {
+  TableCache *cache = GetCache();
+  auto it = cache->tables.find(table_oid);
+  if (it != cache->tables.end())
+    return it->second;
+
+  TableMetadata *metadata = provider_->LoadTable(table_oid);
+  cache->tables.emplace(table_oid, metadata);
+  return metadata;
+}
+
+TableMetadata *PgCatalogProvider::LoadTable(Oid table_oid) {
+  auto *metadata = new TableMetadata();
+  BlockNumber relpages;
+  double reltuples;
+  double allvisfrac;
+
+  Relation rel = table_open(table_oid, AccessShareLock);
+  estimate_rel_size(rel, nullptr, &relpages, &reltuples, &allvisfrac);
+  metadata->rows = reltuples;
+  metadata->pages = relpages;
+  LoadColumns(rel, metadata);
+  LoadUniqueKeys(rel, metadata);
+  LoadForeignKeys(rel, metadata);
+  LoadIndexes(rel, metadata);
+  if (rel->rd_rel->relkind == RELKIND_PARTITIONED_TABLE) {
+    PartitionKey key = RelationGetPartitionKey(rel);
+    metadata->partitioned = true;
+    metadata->partition_strategy = key->strategy;
+    for (int i = 0; i < key->partnatts; i++) {
+      metadata->partition_key.push_back(key->partattrs[i]);
+      metadata->partition_opfamilies.push_back(key->partopfamily[i]);
+    }
+    LoadPartitions(rel, rel, NIL, metadata);
+  }
+  table_close(rel, AccessShareLock);
+
+  return metadata;
+}
+
+// Partition constraint that `partition`'s bound imposes, in terms of its
+// parent's columns. Only the catalog is read, so leaf partitions do not
+// have to be opened (and locked) before they survive pruning.
+static List *PartitionBoundQual(Relation parent, Oid partition) {
+  HeapTuple tuple = SearchSysCache1(RELOID, ObjectIdGetDatum(partition));
+  if (!HeapTupleIsValid(tuple))
+    return NIL;
+  bool isnull;
+  Datum datum =
+      SysCacheGetAttr(RELOID, tuple, Anum_pg_class_relpartbound, &isnull);
+  List *qual = NIL;
+  if (!isnull) {
+    auto *bound =
+        (PartitionBoundSpec *)stringToNode(TextDatumGetCString(datum));
+    qual = get_qual_from_partbound(parent, bound);
+  }
+  ReleaseSysCache(tuple);
+  return qual;
+}
+
+void PgCatalogProvider::LoadPartitions(Relation root, Relation parent,
+                                      List *parent_constraint,
+                                      TableMetadata *metadata) {
+  PartitionDesc desc = RelationGetPartitionDesc(parent, true);
+  for (int i = 0; i < desc->nparts; i++) {
+    List *constraint = PartitionBoundQual(parent, desc->oids[i]);
+    if (parent != root)
+      constraint = map_partition_varattnos(constraint, 1, root, parent);
+    constraint = list_concat_copy(parent_constraint, constraint);
+
+    if (desc->is_leaf[i]) {
+      PartitionLeaf leaf;
+      leaf.relid = desc->oids[i];
+      leaf.relkind = get_rel_relkind(leaf.relid);
+      leaf.constraint = constraint;
+      leaf.bound_index = parent == root ? i : -1;
+      metadata->partitions.push_back(leaf);
+      continue;
+    }
+    Relation child = table_open(desc->oids[i], AccessShareLock);
+    LoadPartitions(root, child, constraint, metadata);
+    table_close(child, AccessShareLock);
+  }
+}
+
+bool MetadataAccessor::PartitionBoundsMatch(Oid table_a, Oid table_b) {
+  TableCache *cache = GetCache();
+  auto it = cache->bounds_match.find(TablePairKey(table_a, table_b));
+  if (it != cache->bounds_match.end())
+    return it->second;
+
+  bool match = provider_->LoadPartitionBoundsMatch(table_a, table_b);
+  cache->bounds_match.emplace(TablePairKey(table_a, table_b), match);
+  return match;
+}
+
+bool PgCatalogProvider::LoadPartitionBoundsMatch(Oid table_a, Oid table_b) {
+  // Both tables were locked when their metadata was loaded.
+  Relation a = table_open(table_a, NoLock);
+  Relation b = table_open(table_b, NoLock);
+  PartitionKey key_a = RelationGetPartitionKey(a);
+  PartitionKey key_b = RelationGetPartitionKey(b);
+  bool match = key_a->strategy == key_b->strategy &&
+               key_a->partnatts == key_b->partnatts;
+  for (int i = 0; match && i < key_a->partnatts; i++) {
+    match = key_a->partopfamily[i] == key_b->partopfamily[i] &&
+            key_a->partopcintype[i] == key_b->partopcintype[i] &&
+            key_a->partcollation[i] == key_b->partcollation[i];
+  }
+  if (match) {
+    PartitionDesc desc_a = RelationGetPartitionDesc(a, true);
+    PartitionDesc desc_b = RelationGetPartitionDesc(b, true);
+    match = desc_a->nparts == desc_b->nparts &&
+            partition_bounds_equal(key_a->partnatts, key_a->parttyplen,
+                                   key_a->parttypbyval, desc_a->boundinfo,
+                                   desc_b->boundinfo);
+  }
+  table_close(b, NoLock);
+  table_close(a, NoLock);
+  return match;
+}
+
+void PgCatalogProvider::LoadColumns(Relation rel, TableMetadata *metadata) {
+  TupleDesc tupdesc = RelationGetDescr(rel);
+  metadata->row_type = rel->rd_rel->reltype;
+  for (int i = 0; i < tupdesc->natts; i++) {
+    Form_pg_attribute attr = TupleDescAttr(tupdesc, i);
+    if (attr->attisdropped)
+      continue;
+    ColumnMetadata column;
+    column.attnum = attr->attnum;
+    column.type = attr->atttypid;
+    column.typmod = attr->atttypmod;
+    column.collation = attr->attcollation;
+    metadata->columns.push_back(column);
+  }
+}
+
+void PgCatalogProvider::LoadUniqueKeys(Relation rel, TableMetadata *metadata) {
+  ListCell *lc;
+  foreach (lc, RelationGetIndexList(rel)) {
+    Relation index = index_open(lfirst_oid(lc), AccessShareLock);
+    Form_pg_index form = index->rd_index;
+    // Uniqueness checked at the end of the statement (or transaction) does
+    // not hold while it runs.
+    bool usable = form->indisunique && form->indimmediate &&
+                  form->indisvalid &&
+                  heap_attisnull(index->rd_indextuple, Anum_pg_index_indpred,
+                                 nullptr);
+    UniqueKey key;
+    for (int i = 0; usable && i < form->indnkeyatts; i++) {
+      AttrNumber attnum = form->indkey.values[i];
+      if (attnum == 0) {
+        usable = false;
+        break;
+      }
+      key.columns.push_back(attnum);
+      key.opfamilies.push_back(index->rd_opfamily[i]);
+    }
+    if (usable)
+      metadata->unique_keys.push_back(std::move(key));
+    index_close(index, AccessShareLock);
+  }
+}
+
+void PgCatalogProvider::LoadForeignKeys(Relation rel,
+                                       TableMetadata *metadata) {
+  Oid table_oid = RelationGetRelid(rel);
+  ListCell *lc;
+  foreach (lc, RelationGetFKeyList(rel)) {
+    auto *info = (ForeignKeyCacheInfo *)lfirst(lc);
+    HeapTuple tuple =
+        SearchSysCache1(CONSTROID, ObjectIdGetDatum(info->conoid));
+    if (!HeapTupleIsValid(tuple))
+      continue;
+    auto *form = (Form_pg_constraint)GETSTRUCT(tuple);
+    // A deferred constraint does not hold until the transaction commits,
+    // so rows without a match may be visible until then.
+    bool usable = form->convalidated && !form->condeferrable;
+    ReleaseSysCache(tuple);
+    if (!usable)
+      continue;
+
+    ForeignKey key;
+    key.referenced_table = info->confrelid;
+    bool not_null = true;
+    for (int i = 0; i < info->nkeys; i++) {
+      not_null &= get_attnotnull(table_oid, info->conkey[i]);
+      key.columns.push_back(info->conkey[i]);
+      key.referenced_columns.push_back(info->confkey[i]);
+      key.operators.push_back(info->conpfeqop[i]);
+    }
+    if (not_null)
+      metadata->foreign_keys.push_back(std::move(key));
+  }
+}
+
+void PgCatalogProvider::LoadIndexes(Relation rel, TableMetadata *metadata) {
+  // The indexes of a partitioned table only exist on its partitions.
+  if (rel->rd_rel->relkind == RELKIND_PARTITIONED_TABLE)
+    return;
+  ListCell *lc;
+  foreach (lc, RelationGetIndexList(rel)) {
+    Relation index = index_open(lfirst_oid(lc), AccessShareLock);
+    Form_pg_index form = index->rd_index;
+    // Without predicate proofs a partial index cannot be shown to hold the
+    // rows a scan is after.
+    if (index->rd_rel->relam != BTREE_AM_OID || !form->indisvalid ||
+        !heap_attisnull(index->rd_indextuple, Anum_pg_index_indpred,
+                        nullptr)) {
+      index_close(index, AccessShareLock);
+      continue;
+    }
+    IndexMetadata info;
+    info.oid = RelationGetRelid(index);
+    info.unique = form->indisunique && form->indimmediate;
+    for (int i = 0; i < form->indnkeyatts; i++) {
+      info.columns.push_back(form->indkey.values[i]);
+      info.opfamilies.push_back(index->rd_opfamily[i]);
+      info.collations.push_back(index->rd_indcollation[i]);
+      int16 option = index->rd_indoption[i];
+      info.descending.push_back((option & INDOPTION_DESC) != 0);
+      info.nulls_first.push_back((option & INDOPTION_NULLS_FIRST) != 0);
+    }
+    // As in get_relation_info(): a non-partial index has an entry per row.
+    info.pages = RelationGetNumberOfBlocks(index);
+    info.tuples = metadata->rows;
+    info.tree_height = _bt_getrootheight(index);
+    metadata->indexes.push_back(std::move(info));
+    index_close(index, AccessShareLock);
+  }
+}
+
 double MetadataAccessor::GetTableRows(Oid table_oid) {
-  // Mock implementation.
-  // In reality, we would open the relation and check pg_class or statistics.
-  // For now, return a dummy value.
-  return 1000.0;
+  return GetTableMetadata(table_oid)->rows;
+}
+
+double MetadataAccessor::GetTablePages(Oid table_oid) {
+  return GetTableMetadata(table_oid)->pages;
+}
+
+const IndexMetadata *MetadataAccessor::GetIndexMetadata(Oid table_oid,
+                                                       Oid index_oid) {
+  for (const IndexMetadata &index : GetTableMetadata(table_oid)->indexes) {
+    if (index.oid == index_oid)
+      return &index;
+  }
+  return nullptr;
+}
+
+int32 MetadataAccessor::GetColumnWidth(Oid table_oid, AttrNumber attr_num,
+                                       Oid type_oid, int32 type_mod) {
+  // System columns have no statistics
+  if (attr_num > 0) {
+    TableCache *cache = GetCache();
+    uint64 key = ColumnKey(table_oid, attr_num);
+    auto it = cache->column_widths.find(key);
+    int32 width = 0;
+    if (it != cache->column_widths.end()) {
+      width = it->second;
+    } else {
+      width = provider_->LoadColumnWidth(table_oid, attr_num);
+      cache->column_widths.emplace(key, width);
+    }
+    if (width > 0)
+      return width;
+  }
+  return get_typavgwidth(type_oid, type_mod);
+}
+
+ColumnStats MetadataAccessor::GetColumnStats(Oid table_oid,
+                                             AttrNumber attr_num) {
+  ColumnStats stats;
+
+  // ctid and friends are unique by construction
+  if (attr_num < 0) {
+    stats.ndistinct = GetTableRows(table_oid);
+    return stats;
+  }
+
+  TableCache *cache = GetCache();
+  uint64 key = ColumnKey(table_oid, attr_num);
+  auto it = cache->column_stats.find(key);
+  if (it != cache->column_stats.end())
+    return it->second;
+
+  stats = provider_->LoadColumnStats(table_oid, attr_num);
+  cache->column_stats.emplace(key, stats);
+  return stats;
+}
+
+int32 PgCatalogProvider::LoadColumnWidth(Oid table_oid, AttrNumber attr_num) {
+  return get_attavgwidth(table_oid, attr_num);
+}
+
+ColumnStats PgCatalogProvider::LoadColumnStats(Oid table_oid,
+                                               AttrNumber attr_num) {
+  ColumnStats stats;
+  HeapTuple tuple =
+      SearchSysCache3(STATRELATTINH, ObjectIdGetDatum(table_oid),
+                      Int16GetDatum(attr_num), BoolGetDatum(false));
+  if (!HeapTupleIsValid(tuple))
+    return stats;
+
+  auto *form = (Form_pg_statistic)GETSTRUCT(tuple);
+  stats.null_frac = form->stanullfrac;
+  if (form->stadistinct > 0)
+    stats.ndistinct = form->stadistinct;
+  else if (form->stadistinct < 0)
+    stats.ndistinct =
+        -form->stadistinct * MetadataAccessor::GetTableRows(table_oid);
+
+  AttStatsSlot slot;
+  if (get_attstatsslot(&slot, tuple, STATISTIC_KIND_MCV, InvalidOid,
+                       ATTSTATSSLOT_VALUES | ATTSTATSSLOT_NUMBERS)) {
+    int16 typlen;
+    bool typbyval;
+    get_typlenbyval(slot.valuetype, &typlen, &typbyval);
+    stats.mcv_type = slot.valuetype;
+    for (int i = 0; i < slot.nvalues && i < slot.nnumbers; i++) {
+      stats.mcv_values.push_back(datumCopy(slot.values[i], typbyval, typlen));
+      stats.mcv_freqs.push_back(slot.numbers[i]);
+    }
+    free_attstatsslot(&slot);
+  }
+  ReleaseSysCache(tuple);
+  return stats;
 }
 
 } // namespace pg_carbon
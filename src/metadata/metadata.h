@@ -3,13 +3,182 @@
 
 #include "../common/memory.h"
 
+extern "C" {
+#include "nodes/pg_list.h"
+#include "utils/relcache.h"
+}
+
 namespace pg_carbon {
 
+// What pg_statistic knows about a column. ndistinct is an absolute count
+// (PG stores it as a fraction of the row count for columns whose number of
+// distinct values scales with the table); 0 means unknown.
+struct ColumnStats {
+  double ndistinct = 0.0;
+  double null_frac = 0.0;
+  // Most common values (copied out of the syscache) and their frequencies
+  Oid mcv_type = InvalidOid;
+  PgVector<Datum> mcv_values;
+  PgVector<double> mcv_freqs;
+};
+
+// A column of a table that has not been dropped
+struct ColumnMetadata {
+  AttrNumber attnum = InvalidAttrNumber;
+  Oid type = InvalidOid;
+  int32 typmod = -1;
+  Oid collation = InvalidOid;
+};
+
+// A unique index proving that no two rows share a key: immediate, not
+// partial, and on plain columns only.
+struct UniqueKey {
+  PgVector<AttrNumber> columns;
+  PgVector<Oid> opfamilies;
+};
+
+// A valid, non-partial btree index. columns holds the key columns (0 for
+// an expression), with the operator family, collation and sort direction of
+// each.
+struct IndexMetadata {
+  Oid oid = InvalidOid;
+  bool unique = false;
+  PgVector<AttrNumber> columns;
+  PgVector<Oid> opfamilies;
+  PgVector<Oid> collations;
+  PgVector<bool> descending;
+  PgVector<bool> nulls_first;
+  double pages = 0.0;
+  double tuples = 0.0;
+  int tree_height = 0;
+};
+
+// A validated foreign key whose referencing columns are all NOT NULL, so
+// every row has exactly one match in the referenced table.
+struct ForeignKey {
+  Oid referenced_table = InvalidOid;
+  PgVector<AttrNumber> columns;
+  PgVector<AttrNumber> referenced_columns;
+  PgVector<Oid> operators;
+};
+
+// A leaf partition of a partitioned table. The constraint is in terms of the
+// partitioned table's columns (Vars with varno 1), ancestors' bounds
+// included. bound_index is the partition's position in the table's
+// partition bounds, or -1 below a sub-partitioned partition.
+struct PartitionLeaf {
+  Oid relid = InvalidOid;
+  char relkind = 0;
+  List *constraint = NIL;
+  int bound_index = -1;
+};
+
+// What the optimizer needs to know about a table, looked up once per query.
+struct TableMetadata : public PgObject {
+  double rows = 0.0;
+  double pages = 0.0;
+  PgVector<ColumnMetadata> columns;
+  Oid row_type = InvalidOid; // type of a whole-row reference
+  PgVector<UniqueKey> unique_keys;
+  PgVector<IndexMetadata> indexes;
+  PgVector<ForeignKey> foreign_keys;
+
+  // For a partitioned table: its leaf partitions in bound order, and the
+  // partition key columns (0 for an expression) with their operator
+  // families.
+  bool partitioned = false;
+  char partition_strategy = 0;
+  PgVector<PartitionLeaf> partitions;
+  PgVector<AttrNumber> partition_key;
+  PgVector<Oid> partition_opfamilies;
+};
+
+// Where MetadataAccessor looks up what it has not cached yet: the catalogs
+// (PgCatalogProvider), a dump being replayed, or the synthetic tables of the
+// benchmarks.
+class CatalogProvider : public PgObject {
+public:
+  virtual ~CatalogProvider() = default;
+
+  virtual TableMetadata *LoadTable(Oid table_oid) = 0;
+  // Average width of a column in its statistics, or 0 if there are none
+  virtual int32 LoadColumnWidth(Oid table_oid, AttrNumber attr_num) = 0;
+  virtual ColumnStats LoadColumnStats(Oid table_oid, AttrNumber attr_num) = 0;
+  virtual bool LoadPartitionBoundsMatch(Oid table_a, Oid table_b) = 0;
+};
+
+class PgCatalogProvider : public CatalogProvider {
+public:
+  TableMetadata *LoadTable(Oid table_oid) override;
+  int32 LoadColumnWidth(Oid table_oid, AttrNumber attr_num) override;
+  ColumnStats LoadColumnStats(Oid table_oid, AttrNumber attr_num) override;
+  bool LoadPartitionBoundsMatch(Oid table_a, Oid table_b) override;
+
+private:
+  static void LoadUniqueKeys(Relation rel, TableMetadata *metadata);
+  static void LoadForeignKeys(Relation rel, TableMetadata *metadata);
+  static void LoadColumns(Relation rel, TableMetadata *metadata);
+  static void LoadIndexes(Relation rel, TableMetadata *metadata);
+  static void LoadPartitions(Relation root, Relation parent,
+                             List *parent_constraint, TableMetadata *metadata);
+};
+
+// Everything the optimizer learns about the tables of a query goes through
+// here and is cached for the query, which is also what a dump (QueryDump)
+// saves of the catalogs.
 class MetadataAccessor {
 public:
-  // Mock method to get table rows. In a real implementation, this would call
-  // PG's statistics API.
+  // Forgets what was cached for the previous query, and goes back to the
+  // catalogs; the cache lives in that query's memory context.
+  static void ResetCache();
+
+  // Looks up what is not cached in `provider` instead of the catalogs, until
+  // the next ResetCache().
+  static void SetProvider(CatalogProvider *provider) { provider_ = provider; }
+
+  static const TableMetadata *GetTableMetadata(Oid table_oid);
+
+  // Estimated number of rows and heap pages, computed the way the PG planner
+  // does (estimate_rel_size), so tables that were never vacuumed or analyzed
+  // still get a size based on their physical length.
   static double GetTableRows(Oid table_oid);
+  static double GetTablePages(Oid table_oid);
+
+  // Average width of a column: pg_statistic's stawidth when the table has
+  // been analyzed, otherwise a guess based on the column type.
+  static int32 GetColumnWidth(Oid table_oid, AttrNumber attr_num, Oid type_oid,
+                              int32 type_mod);
+
+  static ColumnStats GetColumnStats(Oid table_oid, AttrNumber attr_num);
+
+  // One of the table's btree indexes, or nullptr
+  static const IndexMetadata *GetIndexMetadata(Oid table_oid, Oid index_oid);
+
+  // Whether two partitioned tables have the same partition key types and
+  // the same partition bounds, so that their i-th partitions hold the same
+  // key values.
+  static bool PartitionBoundsMatch(Oid table_a, Oid table_b);
+
+private:
+  // Key of a column in the caches below
+  static uint64 ColumnKey(Oid table_oid, AttrNumber attr_num) {
+    return (uint64)table_oid << 16 | (uint16)attr_num;
+  }
+  static uint64 TablePairKey(Oid table_a, Oid table_b) {
+    return (uint64)table_a << 32 | table_b;
+  }
+
+  struct TableCache : public PgObject {
+    PgUnorderedMap<Oid, TableMetadata *> tables;
+    PgUnorderedMap<uint64, int32> column_widths;
+    PgUnorderedMap<uint64, ColumnStats> column_stats;
+    PgUnorderedMap<uint64, bool> bounds_match;
+  };
+  static TableCache *GetCache();
+  static TableCache *table_cache_;
+  static CatalogProvider *provider_;
+
+  friend class QueryDump;
 };
 
 } // namespace pg_carbon
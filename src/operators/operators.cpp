@@ -1,61 +1,166 @@
 #include "operators.h"
+#include "../metadata/metadata.h"
 #include "../optimizer/memo.h"
 
 extern "C" {
 #include "access/relation.h"
-#include "access/table.h"
+#include "access/sysattr.h"
+#include "catalog/heap.h"
 #include "catalog/pg_attribute.h"
+#include "nodes/makefuncs.h"
+#include "nodes/nodeFuncs.h"
+#include "optimizer/planner.h"
 #include "postgres.h"
 #include "utils/lsyscache.h"
 #include "utils/rel.h"
+#include "utils/selfuncs.h"
 }
 
+#include <algorithm>
+#include <cmath>
+
 namespace pg_carbon {
 
+// Same rounding as the PG planner's clamp_row_est(): at least one row, and a
+// whole number of them.
+static double ClampRows(double rows) {
+  if (rows <= 1.0 || std::isnan(rows))
+    return 1.0;
+  return std::rint(rows);
+}
+
+static double ApplySelectivity(double rows, const PredicateList &predicates) {
+  for (const Predicate *pred : predicates)
+    rows *= pred->GetSelectivity();
+  return ClampRows(rows);
+}
+
+bool LogicalOperator::EqualRequiredColumns(
+    const LogicalOperator *other) const {
+  if (!required_columns_ || !other->required_columns_)
+    return required_columns_ == other->required_columns_;
+  return required_columns_->Equals(*other->required_columns_);
+}
+
+size_t LogicalOperator::HashPredicates(const PredicateList &predicates) {
+  // Order-insensitive, so that the same conjuncts in a different order
+  // still land in the same bucket.
+  size_t hash = 0;
+  for (const Predicate *pred : predicates)
+    hash += std::hash<const Predicate *>()(pred);
+  return hash;
+}
+
+bool LogicalOperator::EqualPredicates(const PredicateList &a,
+                                      const PredicateList &b) {
+  if (a.size() != b.size())
+    return false;
+  for (const Predicate *pred : a) {
+    if (std::find(b.begin(), b.end(), pred) == b.end())
+      return false;
+  }
+  return true;
+}
+
+ColSet LogicalOperator::PruneColumns(Memo *memo, const ColSet &columns) const {
+  if (!required_columns_)
+    return ColSet(columns);
+
+  ColSet pruned;
+  columns.ForEach([&](int col_id) {
+    CarbonColumn *col = memo->GetColumn(col_id);
+    if (col && col->GetType() == CarbonColumnType::TABLE_COLUMN) {
+      auto *tc = static_cast<TableColumn *>(col);
+      if (!required_columns_->Contains(tc->GetRtIndex(), tc->GetAttrNum()))
+        return;
+    }
+    // Expression columns are only created because something needs them.
+    pruned.Add(col_id);
+  });
+  return pruned;
+}
+
+// The column `producer` computes for `expr`
+static int InternExprColumn(Memo *memo, const void *producer, Node *expr) {
+  int id = memo->FindExprColumn(producer, expr);
+  if (id >= 0)
+    return id;
+  int32 width = get_typavgwidth(exprType(expr), exprTypmod(expr));
+  return memo->AddExprColumn(producer, expr, 0, new ExprColumn(expr, width));
+}
+
 // --- LogicalGet ---
 
 LogicalProperties *
 LogicalGet::DeriveLogicalProps(Memo *memo,
-                               const PgVector<Group *> &input_groups) const {
-  // For a Leaf Node (Scan), we get columns from the Catalog.
+                               const GroupInputs &input_groups) const {
+  // For a Leaf Node (Scan), we get columns from the Catalog. Only the
+  // attributes required above are registered, so every operator on top of
+  // the scan (and the SeqScan target list itself) stays as narrow as the
+  // query allows.
   ColSet output_columns;
+  const AttrSet *required = GetRequiredColumns();
+  const TableMetadata *metadata =
+      MetadataAccessor::GetTableMetadata(table_oid_);
 
-  // Open relation to get tuple descriptor
-  Relation rel = table_open(table_oid_, AccessShareLock);
-  TupleDesc tupdesc = RelationGetDescr(rel);
+  auto AddColumn = [&](AttrNumber attnum, Oid type_oid, int32 type_mod,
+                       Oid collation) {
+    int id = memo->FindRelationColumn(rtindex_, attnum);
+    if (id < 0) {
+      int32 width = MetadataAccessor::GetColumnWidth(table_oid_, attnum,
+                                                     type_oid, type_mod);
+      // Allow column to outlive this function (Memo takes ownership)
+      auto *col = new TableColumn(table_oid_, rtindex_, attnum, type_oid,
+                                  type_mod, collation, width);
+      id = memo->AddRelationColumn(rtindex_, attnum, col);
+    }
+    output_columns.Add(id);
+  };
 
-  for (int i = 0; i < tupdesc->natts; i++) {
-    Form_pg_attribute attr = TupleDescAttr(tupdesc, i);
+  // System columns (ctid, ...) are only produced on request.
+  if (required) {
+    for (AttrNumber attnum = FirstLowInvalidHeapAttributeNumber + 1;
+         attnum < 0; attnum++) {
+      if (!required->IsMember(rtindex_, attnum))
+        continue;
+      const FormData_pg_attribute *attr = SystemAttributeDefinition(attnum);
+      AddColumn(attnum, attr->atttypid, attr->atttypmod, attr->attcollation);
+    }
 
-    // Skip dropped columns
-    if (attr->attisdropped)
-      continue;
+    // Whole-row reference
+    if (required->IsMember(rtindex_, InvalidAttrNumber))
+      AddColumn(InvalidAttrNumber, metadata->row_type, -1, InvalidOid);
+  }
 
-    // Create a TableColumn
-    auto *col = new TableColumn(table_oid_, rtindex_, attr->attnum);
+  for (const ColumnMetadata &column : metadata->columns) {
+    // Skip columns nobody references
+    if (required && !required->Contains(rtindex_, column.attnum))
+      continue;
 
-    // Allow column to outlive this function (Memo takes ownership)
-    // Note: In real system we might use a pool or smart pointers.
-    // Here we rely on Memo's vector to hold pointers.
-    int col_id = memo->AddColumn(col);
-    output_columns.Add(col_id);
+    AddColumn(column.attnum, column.type, column.typmod, column.collation);
   }
 
-  table_close(rel, AccessShareLock);
-
-  // Default cardinality for leaf
-  double cardinality = 1000.0; // Simple default
+  Oid scanned = IsPartition() ? partition_oid_ : table_oid_;
+  double cardinality = ClampRows(MetadataAccessor::GetTableRows(scanned));
+  double width = memo->GetTupleWidth(output_columns);
 
-  return new LogicalProperties(std::move(output_columns), cardinality);
+  return new LogicalProperties(std::move(output_columns),
+                               ColSet::MakeSingleton(rtindex_), cardinality,
+                               width);
 }
 
 // --- Other Logical Operators (Pass-through or Union) ---
 
-LogicalProperties *LogicalInnerJoin::DeriveLogicalProps(
-    Memo *memo, const PgVector<Group *> &input_groups) const {
-  // Join: Union of child output columns.
-  ColSet output_columns;
-  double cardinality = 1000.0;
+LogicalProperties *
+LogicalJoin::DeriveJoinProps(Memo *memo, const GroupInputs &input_groups,
+                             bool keep_left, bool keep_right) const {
+  // Join: Union of child output columns, minus those only needed by the
+  // join itself. The cardinality is the cross product reduced by the join
+  // predicates, but an outer join returns at least every row of the inputs
+  // it preserves (as in calc_joinrel_size_estimate()).
+  ColSet input_columns;
+  ColSet relids;
+  double cardinality = 1.0;
 
   for (Group *child_group : input_groups) {
     if (!child_group)
@@ -63,33 +168,98 @@ LogicalProperties *LogicalInnerJoin::DeriveLogicalProps(
 
     LogicalProperties *child_props = child_group->GetLogicalProperties();
     if (child_props) {
-      output_columns.Union(child_props->GetOutputColumns());
+      input_columns.Union(child_props->GetOutputColumns());
+      relids.Union(child_props->GetRelids());
+      cardinality *= child_props->GetCardinality();
     }
   }
 
-  return new LogicalProperties(std::move(output_columns), cardinality);
+  cardinality = ApplySelectivity(cardinality, predicates_);
+  if (input_groups.size() == 2) {
+    LogicalProperties *left = input_groups[0]->GetLogicalProperties();
+    LogicalProperties *right = input_groups[1]->GetLogicalProperties();
+    if (keep_left && left)
+      cardinality = std::max(cardinality, left->GetCardinality());
+    if (keep_right && right)
+      cardinality = std::max(cardinality, right->GetCardinality());
+  }
+
+  ColSet output_columns = PruneColumns(memo, input_columns);
+  double width = memo->GetTupleWidth(output_columns);
+  return new LogicalProperties(std::move(output_columns), std::move(relids),
+                               cardinality, width);
+}
+
+LogicalProperties *LogicalInnerJoin::DeriveLogicalProps(
+    Memo *memo, const GroupInputs &input_groups) const {
+  return DeriveJoinProps(memo, input_groups, false, false);
+}
+
+LogicalProperties *LogicalLeftJoin::DeriveLogicalProps(
+    Memo *memo, const GroupInputs &input_groups) const {
+  return DeriveJoinProps(memo, input_groups, true, false);
+}
+
+LogicalProperties *LogicalFullJoin::DeriveLogicalProps(
+    Memo *memo, const GroupInputs &input_groups) const {
+  return DeriveJoinProps(memo, input_groups, true, true);
+}
+
+LogicalProperties *
+LogicalJoin::DeriveSemiJoinProps(Memo *memo, const GroupInputs &input_groups,
+                                 bool anti) const {
+  // The selectivity of a semi or anti join predicate is the fraction of
+  // left rows that find a match (see SelectivityEstimator::EstimateSemiJoin).
+  if (input_groups.size() != 2 || !input_groups[0]->GetLogicalProperties())
+    return new LogicalProperties(ColSet(), ColSet(), 0.0);
+
+  const auto *left_props = input_groups[0]->GetLogicalProperties();
+  double matched = 1.0;
+  for (const Predicate *pred : predicates_)
+    matched *= pred->GetSelectivity();
+  double fraction = anti ? 1.0 - matched : matched;
+
+  ColSet output_columns = PruneColumns(memo, left_props->GetOutputColumns());
+  double width = memo->GetTupleWidth(output_columns);
+  return new LogicalProperties(
+      std::move(output_columns), ColSet(left_props->GetRelids()),
+      ClampRows(left_props->GetCardinality() * fraction), width);
+}
+
+LogicalProperties *LogicalSemiJoin::DeriveLogicalProps(
+    Memo *memo, const GroupInputs &input_groups) const {
+  return DeriveSemiJoinProps(memo, input_groups, false);
+}
+
+LogicalProperties *LogicalAntiJoin::DeriveLogicalProps(
+    Memo *memo, const GroupInputs &input_groups) const {
+  return DeriveSemiJoinProps(memo, input_groups, true);
 }
 
 LogicalProperties *
 LogicalFilter::DeriveLogicalProps(Memo *memo,
-                                  const PgVector<Group *> &input_groups) const {
-  // Filter: Preserves input columns of the single child.
+                                  const GroupInputs &input_groups) const {
+  // Filter: Preserves the input columns of the single child that are still
+  // needed once the qual has been evaluated.
   if (input_groups.empty())
-    return new LogicalProperties(ColSet(), 0.0);
+    return new LogicalProperties(ColSet(), ColSet(), 0.0);
 
   Group *child = input_groups[0];
   if (child && child->GetLogicalProperties()) {
     const auto *child_props = child->GetLogicalProperties();
     double cardinality =
-        child_props->GetCardinality() * 0.5; // Default selectivity
-    ColSet output_columns(child_props->GetOutputColumns());
-    return new LogicalProperties(std::move(output_columns), cardinality);
+        ApplySelectivity(child_props->GetCardinality(), predicates_);
+    ColSet output_columns = PruneColumns(memo, child_props->GetOutputColumns());
+    double width = memo->GetTupleWidth(output_columns);
+    return new LogicalProperties(std::move(output_columns),
+                                 ColSet(child_props->GetRelids()), cardinality,
+                                 width);
   }
-  return new LogicalProperties(ColSet(), 0.0);
+  return new LogicalProperties(ColSet(), ColSet(), 0.0);
 }
 
 LogicalProperties *LogicalProjection::DeriveLogicalProps(
-    Memo *memo, const PgVector<Group *> &input_groups) const {
+    Memo *memo, const GroupInputs &input_groups) const {
   // Projection: Defines new output columns based on TargetList.
   ColSet output_columns;
 
@@ -97,55 +267,345 @@ LogicalProperties *LogicalProjection::DeriveLogicalProps(
     ListCell *lc;
     foreach (lc, target_list_) {
       TargetEntry *tle = (TargetEntry *)lfirst(lc);
-      // Create ExprColumn for the expression in TLE
-      auto *col = new ExprColumn((Node *)tle->expr);
-      int col_id = memo->AddColumn(col);
-      output_columns.Add(col_id);
+      output_columns.Add(
+          InternExprColumn(memo, target_list_, (Node *)tle->expr));
     }
   }
 
   // Projection preserves cardinality
   double cardinality = 0.0;
+  ColSet relids;
 
   if (!input_groups.empty() && input_groups[0]->GetLogicalProperties()) {
     cardinality = input_groups[0]->GetLogicalProperties()->GetCardinality();
+    relids = input_groups[0]->GetLogicalProperties()->GetRelids();
   }
 
-  return new LogicalProperties(std::move(output_columns), cardinality);
+  double width = memo->GetTupleWidth(output_columns);
+  return new LogicalProperties(std::move(output_columns), std::move(relids),
+                               cardinality, width);
 }
 
 LogicalProperties *
 LogicalSort::DeriveLogicalProps(Memo *memo,
-                                const PgVector<Group *> &input_groups) const {
+                                const GroupInputs &input_groups) const {
   // Sort: Preserves input columns.
   if (input_groups.empty())
-    return new LogicalProperties(ColSet(), 0.0);
+    return new LogicalProperties(ColSet(), ColSet(), 0.0);
 
   Group *child = input_groups[0];
   if (child && child->GetLogicalProperties()) {
     const auto *child_props = child->GetLogicalProperties();
     return new LogicalProperties(ColSet(child_props->GetOutputColumns()),
-                                 child_props->GetCardinality());
+                                 ColSet(child_props->GetRelids()),
+                                 child_props->GetCardinality(),
+                                 child_props->GetWidth());
+  }
+  return new LogicalProperties(ColSet(), ColSet(), 0.0);
+}
+
+SortKeyList MakeSortKeys(List *sort_clauses, List *target_list) {
+  SortKeyList keys;
+  ListCell *lc;
+  foreach (lc, sort_clauses) {
+    SortGroupClause *sgc = (SortGroupClause *)lfirst(lc);
+    keys.push_back({get_sortgroupclause_expr(sgc, target_list), sgc->sortop,
+                    sgc->nulls_first});
+  }
+  return keys;
+}
+
+size_t LogicalAggregate::Hash() const {
+  return Operator::Hash() ^ (keys_.size() << 4) ^
+         (static_cast<size_t>(list_length(aggregates_)) << 8) ^
+         static_cast<size_t>(split_);
+}
+
+bool LogicalAggregate::Equals(const Operator *other) const {
+  if (other->GetType() != GetType())
+    return false;
+  auto *agg = static_cast<const LogicalAggregate *>(other);
+  if (agg->split_ != split_ || agg->keys_.size() != keys_.size() ||
+      !equal(agg->aggregates_, aggregates_))
+    return false;
+  for (size_t i = 0; i < keys_.size(); i++) {
+    if (!equal(agg->keys_[i].expr, keys_[i].expr))
+      return false;
+  }
+  return true;
+}
+
+double KeyDistinct(Memo *memo, Node *expr) {
+  if (IsA(expr, Var)) {
+    Var *var = (Var *)expr;
+    CarbonColumn *col =
+        memo->GetColumn(memo->FindRelationColumn(var->varno, var->varattno));
+    if (col && col->GetType() == CarbonColumnType::TABLE_COLUMN) {
+      auto *tc = static_cast<TableColumn *>(col);
+      double ndistinct =
+          MetadataAccessor::GetColumnStats(tc->GetTableOid(), var->varattno)
+              .ndistinct;
+      if (ndistinct > 0.0)
+        return ndistinct;
+    }
   }
-  return new LogicalProperties(ColSet(), 0.0);
+  return DEFAULT_NUM_DISTINCT;
+}
+
+LogicalProperties *LogicalAggregate::DeriveLogicalProps(
+    Memo *memo, const GroupInputs &input_groups) const {
+  // Aggregate: one row per group, with a column for every grouping
+  // expression and every aggregate, in the form this phase computes. The
+  // number of groups is the product of the keys' distinct counts, capped
+  // by the input.
+  ColSet output_columns;
+  for (const GroupKey &key : keys_)
+    output_columns.Add(InternExprColumn(memo, origin_, key.expr));
+  // Each phase's aggregate is a column of its own, keyed by the aggregate
+  // of the query
+  ListCell *lc;
+  foreach (lc, aggregates_) {
+    Node *aggref = (Node *)lfirst(lc);
+    int id = memo->FindExprColumn(origin_, aggref, split_);
+    if (id < 0) {
+      Node *expr = aggref;
+      if (split_ == AGGSPLIT_INITIAL_SERIAL) {
+        expr = (Node *)copyObjectImpl(aggref);
+        mark_partial_aggref((Aggref *)expr, split_);
+      }
+      int32 width = get_typavgwidth(exprType(expr), exprTypmod(expr));
+      id = memo->AddExprColumn(origin_, aggref, split_,
+                               new ExprColumn(expr, width));
+    }
+    output_columns.Add(id);
+  }
+
+  double input_rows = 0.0;
+  ColSet relids;
+  if (!input_groups.empty() && input_groups[0]->GetLogicalProperties()) {
+    input_rows = input_groups[0]->GetLogicalProperties()->GetCardinality();
+    relids = input_groups[0]->GetLogicalProperties()->GetRelids();
+  }
+
+  double groups = 1.0;
+  for (const GroupKey &key : keys_)
+    groups *= KeyDistinct(memo, key.expr);
+  double cardinality =
+      keys_.empty() ? 1.0 : ClampRows(std::min(groups, input_rows));
+
+  double width = memo->GetTupleWidth(output_columns);
+  return new LogicalProperties(std::move(output_columns), std::move(relids),
+                               cardinality, width);
+}
+
+LogicalProperties *
+LogicalWindow::DeriveLogicalProps(Memo *memo,
+                                  const GroupInputs &input_groups) const {
+  // Window: the input's rows and columns, and a column for each window
+  // function.
+  if (input_groups.empty() || !input_groups[0]->GetLogicalProperties())
+    return new LogicalProperties(ColSet(), ColSet(), 0.0);
+
+  const auto *child_props = input_groups[0]->GetLogicalProperties();
+  ColSet output_columns(child_props->GetOutputColumns());
+  ListCell *lc;
+  foreach (lc, window_funcs_)
+    output_columns.Add(
+        InternExprColumn(memo, clause_, (Node *)lfirst(lc)));
+
+  double width = memo->GetTupleWidth(output_columns);
+  return new LogicalProperties(std::move(output_columns),
+                               ColSet(child_props->GetRelids()),
+                               child_props->GetCardinality(), width);
+}
+
+LogicalProperties *
+LogicalAppend::DeriveLogicalProps(Memo *memo,
+                                  const GroupInputs &input_groups) const {
+  // Append: the columns of the first input (the others produce the same
+  // ones) and the rows of all of them.
+  ColSet output_columns;
+  ColSet relids;
+  double cardinality = 0.0;
+  for (size_t i = 0; i < input_groups.size(); i++) {
+    const LogicalProperties *props = input_groups[i]->GetLogicalProperties();
+    if (!props)
+      continue;
+    if (i == 0)
+      output_columns = props->GetOutputColumns();
+    relids.Union(props->GetRelids());
+    cardinality += props->GetCardinality();
+  }
+  if (!input_groups.empty())
+    cardinality = ClampRows(cardinality);
+
+  double width = memo->GetTupleWidth(output_columns);
+  return new LogicalProperties(std::move(output_columns), std::move(relids),
+                               cardinality, width);
+}
+
+// --- LogicalSetOperation ---
+
+bool LogicalSetOperation::IsColumnNeeded(AttrNumber k) const {
+  const AttrSet *required = GetRequiredColumns();
+  return !IsUnionAll() || !required || required->Contains(rtindex_, k);
+}
+
+namespace {
+struct MapToInputContext {
+  Index rtindex;
+  List *columns;
+  bool whole_row;
+};
+} // namespace
+
+static Node *MapToInputMutator(Node *node, void *context) {
+  auto *map = (MapToInputContext *)context;
+  if (!node)
+    return nullptr;
+  if (IsA(node, Var) && ((Var *)node)->varno == (int)map->rtindex &&
+      ((Var *)node)->varlevelsup == 0) {
+    AttrNumber k = ((Var *)node)->varattno;
+    if (k <= 0 || k > list_length(map->columns)) {
+      map->whole_row = true;
+      return node;
+    }
+    return (Node *)copyObjectImpl(list_nth(map->columns, k - 1));
+  }
+  return expression_tree_mutator(node, MapToInputMutator, context);
+}
+
+Node *LogicalSetOperation::MapToInput(Node *expr, int input) const {
+  MapToInputContext map = {rtindex_, input_columns_[input], false};
+  Node *mapped = MapToInputMutator(expr, &map);
+  return map.whole_row ? nullptr : mapped;
+}
+
+// Distinct rows of a set operation input, by the same estimate as its
+// columns' distinct counts
+static double InputGroups(Memo *memo, List *columns, double rows) {
+  double groups = 1.0;
+  ListCell *lc;
+  foreach (lc, columns)
+    groups *= KeyDistinct(memo, (Node *)lfirst(lc));
+  return ClampRows(std::min(groups, rows));
+}
+
+LogicalProperties *LogicalSetOperation::DeriveLogicalProps(
+    Memo *memo, const GroupInputs &input_groups) const {
+  // Set operation: a column for every output the parent needs. UNION ALL
+  // returns the rows of all inputs and UNION their distinct rows; like the
+  // PG planner, INTERSECT returns at most the smaller input's and EXCEPT
+  // the left input's.
+  ColSet output_columns;
+  List *first = input_columns_[0];
+  for (int k = 1; k <= GetNumColumns(); k++) {
+    if (!IsColumnNeeded(k))
+      continue;
+    int id = memo->FindRelationColumn(rtindex_, k);
+    if (id < 0) {
+      Node *expr = (Node *)list_nth(first, k - 1);
+      Var *var = makeVar(rtindex_, k, exprType(expr), exprTypmod(expr),
+                         exprCollation(expr), 0);
+      int32 width = get_typavgwidth(var->vartype, var->vartypmod);
+      id = memo->AddRelationColumn(rtindex_, k,
+                                   new ExprColumn((Node *)var, width));
+    }
+    output_columns.Add(id);
+  }
+
+  PgVector<double> rows;
+  PgVector<double> groups;
+  for (size_t i = 0; i < input_groups.size(); i++) {
+    const LogicalProperties *props = input_groups[i]->GetLogicalProperties();
+    rows.push_back(props ? props->GetCardinality() : 1.0);
+    groups.push_back(InputGroups(memo, input_columns_[i], rows.back()));
+  }
+
+  double cardinality = 0.0;
+  switch (op_) {
+  case SETOP_UNION:
+    for (size_t i = 0; i < rows.size(); i++)
+      cardinality += all_ ? rows[i] : groups[i];
+    break;
+  case SETOP_INTERSECT:
+    cardinality = all_ ? std::min(rows[0], rows[1])
+                       : std::min(groups[0], groups[1]);
+    break;
+  default:
+    cardinality = all_ ? rows[0] : groups[0];
+    break;
+  }
+
+  ColSet relids;
+  relids.Add(rtindex_);
+  double width = memo->GetTupleWidth(output_columns);
+  return new LogicalProperties(std::move(output_columns), std::move(relids),
+                               ClampRows(cardinality), width);
+}
+
+// --- LogicalCteScan ---
+
+LogicalProperties *LogicalCteScan::DeriveLogicalProps(
+    Memo *memo, const GroupInputs &input_groups) const {
+  // CTE reference: a column for every output the parent needs, and the rows
+  // of the shared plan, whose group the Memo holds already.
+  ColSet output_columns;
+  const AttrSet *required = GetRequiredColumns();
+  for (int k = 1; k <= list_length(cte_->ctecoltypes); k++) {
+    if (required && !required->Contains(rtindex_, k))
+      continue;
+    int id = memo->FindRelationColumn(rtindex_, k);
+    if (id < 0) {
+      Var *var = makeVar(rtindex_, k, list_nth_oid(cte_->ctecoltypes, k - 1),
+                         list_nth_int(cte_->ctecoltypmods, k - 1),
+                         list_nth_oid(cte_->ctecolcollations, k - 1), 0);
+      int32 width = get_typavgwidth(var->vartype, var->vartypmod);
+      id = memo->AddRelationColumn(rtindex_, k,
+                                   new ExprColumn((Node *)var, width));
+    }
+    output_columns.Add(id);
+  }
+
+  const Group *producer = memo->GetCteProducer(cte_index_);
+  double cardinality = producer && producer->GetLogicalProperties()
+                           ? producer->GetLogicalProperties()->GetCardinality()
+                           : 1.0;
+  ColSet relids;
+  relids.Add(rtindex_);
+  double width = memo->GetTupleWidth(output_columns);
+  return new LogicalProperties(std::move(output_columns), std::move(relids),
+                               ClampRows(cardinality), width);
 }
 
 LogicalProperties *
 LogicalLimit::DeriveLogicalProps(Memo *memo,
-                                 const PgVector<Group *> &input_groups) const {
+                                 const GroupInputs &input_groups) const {
   // Limit: Preserves input columns.
   if (input_groups.empty())
-    return new LogicalProperties(ColSet(), 0.0);
+    return new LogicalProperties(ColSet(), ColSet(), 0.0);
 
   Group *child = input_groups[0];
   if (child && child->GetLogicalProperties()) {
     const auto *child_props = child->GetLogicalProperties();
-    // Limit changes cardinality
-    double cardinality = 10.0; // Mock limit
+    // Only constant LIMIT/OFFSET values are known at plan time; anything
+    // else (parameters, expressions) keeps the input estimate.
+    double cardinality = child_props->GetCardinality();
+    if (limit_offset_ && IsA(limit_offset_, Const) &&
+        !((Const *)limit_offset_)->constisnull) {
+      cardinality -= DatumGetInt64(((Const *)limit_offset_)->constvalue);
+    }
+    if (limit_count_ && IsA(limit_count_, Const) &&
+        !((Const *)limit_count_)->constisnull) {
+      double count = DatumGetInt64(((Const *)limit_count_)->constvalue);
+      cardinality = std::min(cardinality, count);
+    }
     return new LogicalProperties(ColSet(child_props->GetOutputColumns()),
-                                 cardinality);
+                                 ColSet(child_props->GetRelids()),
+                                 ClampRows(cardinality),
+                                 child_props->GetWidth());
   }
-  return new LogicalProperties(ColSet(), 0.0);
+  return new LogicalProperties(ColSet(), ColSet(), 0.0);
 }
 
 } // namespace pg_carbon
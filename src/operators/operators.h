@@ -2,10 +2,14 @@
 #define PG_CARBON_OPERATORS_H
 
 #include "../common/memory.h"
+#include "../optimizer/column.h"
+#include "../optimizer/predicate.h"
+#include <cstddef>
 #include <string>
 #include <vector>
 
 extern "C" {
+#include "nodes/nodes.h"
 #include "nodes/parsenodes.h"
 #include "nodes/pg_list.h"
 #include "postgres.h"
@@ -18,13 +22,61 @@ class Group;
 class Memo;
 class LogicalProperties;
 
+// Input groups of an expression. Only Append and set operations have more
+// than two.
+using GroupInputs = PgSmallArray<Group *, 2>;
+
+enum class OperatorType {
+  LOGICAL_GET,
+  LOGICAL_INNER_JOIN,
+  LOGICAL_SEMI_JOIN,
+  LOGICAL_ANTI_JOIN,
+  LOGICAL_LEFT_JOIN,
+  LOGICAL_FULL_JOIN,
+  LOGICAL_FILTER,
+  LOGICAL_PROJECTION,
+  LOGICAL_SORT,
+  LOGICAL_LIMIT,
+  LOGICAL_AGGREGATE,
+  LOGICAL_WINDOW,
+  LOGICAL_APPEND,
+  LOGICAL_SET_OPERATION,
+  LOGICAL_CTE_SCAN,
+  PHYSICAL_TABLE_SCAN,
+  PHYSICAL_INDEX_SCAN,
+  PHYSICAL_NESTED_LOOP_JOIN,
+  PHYSICAL_HASH_JOIN,
+  PHYSICAL_MERGE_JOIN,
+  PHYSICAL_MEMOIZE,
+  PHYSICAL_FILTER,
+  PHYSICAL_PROJECTION,
+  PHYSICAL_SORT,
+  PHYSICAL_INCREMENTAL_SORT,
+  PHYSICAL_AGGREGATE,
+  PHYSICAL_WINDOW_AGG,
+  PHYSICAL_APPEND,
+  PHYSICAL_MERGE_APPEND,
+  PHYSICAL_SET_OP,
+  PHYSICAL_CTE_SCAN,
+  PHYSICAL_LIMIT,
+  PHYSICAL_EMPTY_RESULT
+};
+
 class Operator : public PgObject {
 public:
   virtual ~Operator() = default;
+  virtual OperatorType GetType() const = 0;
   virtual bool IsLogical() const = 0;
   virtual bool IsPhysical() const = 0;
   virtual std::string ToString() const = 0;
 
+  // Operator identity for duplicate detection in the Memo. Operators that
+  // carry arguments have to override both.
+  virtual size_t Hash() const { return static_cast<size_t>(GetType()); }
+  virtual bool Equals(const Operator *other) const {
+    return GetType() == other->GetType();
+  }
+
   void AddInput(Operator *input) { inputs_.push_back(input); }
   const PgVector<Operator *> &GetInputs() const { return inputs_; }
 
@@ -50,11 +102,30 @@ public:
   bool IsLogical() const override { return true; }
   bool IsPhysical() const override { return false; }
 
-  // Key method for Logical Property Derivation
   // Key method for Logical Property Derivation
   virtual LogicalProperties *
-  DeriveLogicalProps(Memo *memo,
-                     const PgVector<Group *> &input_groups) const = 0;
+  DeriveLogicalProps(Memo *memo, const GroupInputs &input_groups) const = 0;
+
+  // Base-relation columns the parent needs from this operator, filled in
+  // top-down by the translator. nullptr means every column is kept.
+  void SetRequiredColumns(const AttrSet *required) {
+    required_columns_ = required;
+  }
+  const AttrSet *GetRequiredColumns() const { return required_columns_; }
+
+protected:
+  // Drops the table columns in `columns` that nobody above needs.
+  ColSet PruneColumns(Memo *memo, const ColSet &columns) const;
+
+  // The same operator producing different columns is a different group.
+  bool EqualRequiredColumns(const LogicalOperator *other) const;
+
+  // Predicate lists compare as sets of (shared) Predicate objects.
+  static size_t HashPredicates(const PredicateList &predicates);
+  static bool EqualPredicates(const PredicateList &a, const PredicateList &b);
+
+private:
+  const AttrSet *required_columns_ = nullptr;
 };
 
 class PhysicalOperator : public Operator {
@@ -65,80 +136,488 @@ public:
 
 // --- Logical Operators ---
 
+// Scan of a table. A scan of one leaf partition of a partitioned table
+// produces the partitioned table's columns under its range table index; the
+// egest step gives the partition a range table entry of its own.
 class LogicalGet : public LogicalOperator {
 public:
-  LogicalGet(Oid table_oid, Index rtindex)
-      : table_oid_(table_oid), rtindex_(rtindex) {}
+  LogicalGet(Oid table_oid, Index rtindex, Oid partition_oid = InvalidOid)
+      : table_oid_(table_oid), rtindex_(rtindex),
+        partition_oid_(partition_oid) {}
 
+  OperatorType GetType() const override { return OperatorType::LOGICAL_GET; }
   std::string ToString() const override {
     return "LogicalGet(" + std::to_string(table_oid_) + ")";
   }
   Oid GetTableOid() const { return table_oid_; }
   Index GetRtIndex() const { return rtindex_; }
+  Oid GetPartitionOid() const { return partition_oid_; }
+  bool IsPartition() const { return OidIsValid(partition_oid_); }
+
+  size_t Hash() const override {
+    return (table_oid_ * 31 + rtindex_) ^ partition_oid_;
+  }
+  bool Equals(const Operator *other) const override {
+    if (other->GetType() != GetType())
+      return false;
+    auto *get = static_cast<const LogicalGet *>(other);
+    return get->table_oid_ == table_oid_ && get->rtindex_ == rtindex_ &&
+           get->partition_oid_ == partition_oid_ && EqualRequiredColumns(get);
+  }
 
   LogicalProperties *
   DeriveLogicalProps(Memo *memo,
-                     const PgVector<Group *> &input_groups) const override;
+                     const GroupInputs &input_groups) const override;
 
 private:
   Oid table_oid_;
   Index rtindex_;
+  Oid partition_oid_;
 };
 
-class LogicalInnerJoin : public LogicalOperator {
+// Base of the binary joins. The predicates are evaluated for every pair of
+// input rows; what becomes of rows without a match depends on the join type.
+class LogicalJoin : public LogicalOperator {
 public:
-  LogicalInnerJoin() = default;
+  const PredicateList &GetPredicates() const { return predicates_; }
+  virtual JoinType GetJoinType() const = 0;
+  // The same kind of join with different predicates
+  virtual LogicalJoin *WithPredicates(PredicateList predicates) const = 0;
 
+  size_t Hash() const override {
+    return Operator::Hash() ^ HashPredicates(predicates_);
+  }
+  bool Equals(const Operator *other) const override {
+    if (other->GetType() != GetType())
+      return false;
+    auto *join = static_cast<const LogicalJoin *>(other);
+    return EqualPredicates(join->predicates_, predicates_) &&
+           EqualRequiredColumns(join);
+  }
+
+protected:
+  explicit LogicalJoin(PredicateList predicates)
+      : predicates_(std::move(predicates)) {}
+
+  // Inner and outer joins: both inputs' columns, and the inner join row
+  // count raised to the number of rows the outer join preserves.
+  LogicalProperties *DeriveJoinProps(Memo *memo,
+                                     const GroupInputs &input_groups,
+                                     bool keep_left, bool keep_right) const;
+  // Semi and anti joins produce (some of) the left input's rows.
+  LogicalProperties *DeriveSemiJoinProps(Memo *memo,
+                                         const GroupInputs &input_groups,
+                                         bool anti) const;
+
+  PredicateList predicates_;
+};
+
+// Inner join of its two inputs; an empty predicate list is a cross join.
+class LogicalInnerJoin : public LogicalJoin {
+public:
+  explicit LogicalInnerJoin(PredicateList predicates = PredicateList())
+      : LogicalJoin(std::move(predicates)) {}
+
+  OperatorType GetType() const override {
+    return OperatorType::LOGICAL_INNER_JOIN;
+  }
   std::string ToString() const override { return "LogicalInnerJoin"; }
+  JoinType GetJoinType() const override { return JOIN_INNER; }
+  LogicalJoin *WithPredicates(PredicateList predicates) const override {
+    return new LogicalInnerJoin(std::move(predicates));
+  }
+
+  LogicalProperties *
+  DeriveLogicalProps(Memo *memo,
+                     const GroupInputs &input_groups) const override;
+};
+
+// Rows of the left input with at least one match on the right: EXISTS and
+// IN subqueries. Only the left input's columns are visible above it.
+class LogicalSemiJoin : public LogicalJoin {
+public:
+  explicit LogicalSemiJoin(PredicateList predicates)
+      : LogicalJoin(std::move(predicates)) {}
+
+  OperatorType GetType() const override {
+    return OperatorType::LOGICAL_SEMI_JOIN;
+  }
+  std::string ToString() const override { return "LogicalSemiJoin"; }
+  JoinType GetJoinType() const override { return JOIN_SEMI; }
+  LogicalJoin *WithPredicates(PredicateList predicates) const override {
+    return new LogicalSemiJoin(std::move(predicates));
+  }
 
   LogicalProperties *
   DeriveLogicalProps(Memo *memo,
-                     const PgVector<Group *> &input_groups) const override;
+                     const GroupInputs &input_groups) const override;
 };
 
+// Rows of the left input without any match on the right: NOT EXISTS.
+class LogicalAntiJoin : public LogicalJoin {
+public:
+  explicit LogicalAntiJoin(PredicateList predicates)
+      : LogicalJoin(std::move(predicates)) {}
+
+  OperatorType GetType() const override {
+    return OperatorType::LOGICAL_ANTI_JOIN;
+  }
+  std::string ToString() const override { return "LogicalAntiJoin"; }
+  JoinType GetJoinType() const override { return JOIN_ANTI; }
+  LogicalJoin *WithPredicates(PredicateList predicates) const override {
+    return new LogicalAntiJoin(std::move(predicates));
+  }
+
+  LogicalProperties *
+  DeriveLogicalProps(Memo *memo,
+                     const GroupInputs &input_groups) const override;
+};
+
+// Conjunction of predicates over its input.
 class LogicalFilter : public LogicalOperator {
 public:
-  explicit LogicalFilter(Node *qual) : qual_(qual) {}
+  explicit LogicalFilter(PredicateList predicates)
+      : predicates_(std::move(predicates)) {}
 
+  OperatorType GetType() const override {
+    return OperatorType::LOGICAL_FILTER;
+  }
   std::string ToString() const override { return "LogicalFilter"; }
-  Node *GetQual() const { return qual_; }
+  const PredicateList &GetPredicates() const { return predicates_; }
+
+  size_t Hash() const override {
+    return Operator::Hash() ^ HashPredicates(predicates_);
+  }
+  bool Equals(const Operator *other) const override {
+    if (other->GetType() != GetType())
+      return false;
+    auto *filter = static_cast<const LogicalFilter *>(other);
+    return EqualPredicates(filter->predicates_, predicates_) &&
+           EqualRequiredColumns(filter);
+  }
 
   LogicalProperties *
   DeriveLogicalProps(Memo *memo,
-                     const PgVector<Group *> &input_groups) const override;
+                     const GroupInputs &input_groups) const override;
 
 private:
-  Node *qual_;
+  PredicateList predicates_;
 };
 
 class LogicalProjection : public LogicalOperator {
 public:
   explicit LogicalProjection(List *target_list) : target_list_(target_list) {}
 
+  OperatorType GetType() const override {
+    return OperatorType::LOGICAL_PROJECTION;
+  }
   std::string ToString() const override { return "LogicalProjection"; }
   List *GetTargetList() const { return target_list_; }
 
+  size_t Hash() const override {
+    return Operator::Hash() ^ reinterpret_cast<size_t>(target_list_);
+  }
+  bool Equals(const Operator *other) const override {
+    return other->GetType() == GetType() &&
+           static_cast<const LogicalProjection *>(other)->target_list_ ==
+               target_list_;
+  }
+
   LogicalProperties *
   DeriveLogicalProps(Memo *memo,
-                     const PgVector<Group *> &input_groups) const override;
+                     const GroupInputs &input_groups) const override;
 
 private:
   List *target_list_;
 };
 
+// One key of a sort order: rows ordered on `expr` by `sortop`, a btree
+// "<" or ">" operator, with NULLs first or last
+struct SortKey {
+  Node *expr;
+  Oid sortop;
+  bool nulls_first;
+};
+using SortKeyList = PgVector<SortKey>;
+
+// Keys of a list of SortGroupClauses referring to entries of `target_list`
+SortKeyList MakeSortKeys(List *sort_clauses, List *target_list);
+
+// Number of distinct values of `expr`: the column statistics for a plain
+// column, otherwise the standard planner's default guess
+double KeyDistinct(Memo *memo, Node *expr);
+
+// ORDER BY. The sort clause refers to entries of `target_list`, the query's
+// target list.
 class LogicalSort : public LogicalOperator {
 public:
-  explicit LogicalSort(List *sort_clause) : sort_clause_(sort_clause) {}
+  explicit LogicalSort(List *sort_clause, List *target_list = NIL)
+      : sort_clause_(sort_clause), target_list_(target_list) {}
 
+  OperatorType GetType() const override { return OperatorType::LOGICAL_SORT; }
   std::string ToString() const override { return "LogicalSort"; }
   List *GetSortClause() const { return sort_clause_; }
+  List *GetTargetList() const { return target_list_; }
+  SortKeyList GetSortKeys() const {
+    return MakeSortKeys(sort_clause_, target_list_);
+  }
+
+  size_t Hash() const override {
+    return Operator::Hash() ^ reinterpret_cast<size_t>(sort_clause_);
+  }
+  bool Equals(const Operator *other) const override {
+    return other->GetType() == GetType() &&
+           static_cast<const LogicalSort *>(other)->sort_clause_ ==
+               sort_clause_;
+  }
 
   LogicalProperties *
   DeriveLogicalProps(Memo *memo,
-                     const PgVector<Group *> &input_groups) const override;
+                     const GroupInputs &input_groups) const override;
 
 private:
   List *sort_clause_;
+  List *target_list_;
+};
+
+// Grouping expression of an aggregate, with the operators needed to group
+// on it by hashing or by sorting
+struct GroupKey {
+  Node *expr;
+  Oid eqop;
+  Oid sortop;
+  bool hashable;
+};
+using GroupKeyList = PgVector<GroupKey>;
+
+// GROUP BY and aggregate functions. `split` is the phase of a split
+// aggregation: eager aggregation computes partial states below a join
+// (AGGSPLIT_INITIAL_SERIAL) and combines them above it
+// (AGGSPLIT_FINAL_DESERIAL). The aggregates are always the query's own
+// Aggrefs; each phase derives the form it computes from them. Aggregates a
+// rule makes of `origin` compute its columns.
+class LogicalAggregate : public LogicalOperator {
+public:
+  LogicalAggregate(GroupKeyList keys, List *aggregates, AggSplit split,
+                   bool partial_aggregable,
+                   const LogicalAggregate *origin = nullptr)
+      : keys_(std::move(keys)), aggregates_(aggregates), split_(split),
+        partial_aggregable_(partial_aggregable),
+        origin_(origin ? origin->origin_ : this) {}
+
+  OperatorType GetType() const override {
+    return OperatorType::LOGICAL_AGGREGATE;
+  }
+  std::string ToString() const override { return "LogicalAggregate"; }
+  const GroupKeyList &GetKeys() const { return keys_; }
+  List *GetAggregates() const { return aggregates_; }
+  AggSplit GetSplit() const { return split_; }
+  // Whether every aggregate can be split into partial and final phases
+  bool IsPartialAggregable() const { return partial_aggregable_; }
+
+  size_t Hash() const override;
+  bool Equals(const Operator *other) const override;
+
+  LogicalProperties *
+  DeriveLogicalProps(Memo *memo,
+                     const GroupInputs &input_groups) const override;
+
+private:
+  GroupKeyList keys_;
+  List *aggregates_;
+  AggSplit split_;
+  bool partial_aggregable_;
+  const LogicalAggregate *origin_;
+};
+
+// The window functions of one window clause, computed over the input
+// sorted on `sort_clauses`: the clause's PARTITION BY and then ORDER BY keys
+// (which refer to entries of `target_list`, the query's target list). The
+// translator stacks the windows of a query so that one whose keys are a
+// prefix of those of the window below can use that window's sort.
+class LogicalWindow : public LogicalOperator {
+public:
+  LogicalWindow(WindowClause *clause, List *sort_clauses, List *window_funcs,
+                List *target_list)
+      : clause_(clause), sort_clauses_(sort_clauses),
+        window_funcs_(window_funcs), target_list_(target_list) {}
+
+  OperatorType GetType() const override {
+    return OperatorType::LOGICAL_WINDOW;
+  }
+  std::string ToString() const override { return "LogicalWindow"; }
+  WindowClause *GetClause() const { return clause_; }
+  List *GetWindowFuncs() const { return window_funcs_; }
+  List *GetTargetList() const { return target_list_; }
+  SortKeyList GetSortKeys() const {
+    return MakeSortKeys(sort_clauses_, target_list_);
+  }
+
+  size_t Hash() const override {
+    return Operator::Hash() ^ reinterpret_cast<size_t>(clause_);
+  }
+  bool Equals(const Operator *other) const override {
+    return other->GetType() == GetType() &&
+           static_cast<const LogicalWindow *>(other)->clause_ == clause_;
+  }
+
+  LogicalProperties *
+  DeriveLogicalProps(Memo *memo,
+                     const GroupInputs &input_groups) const override;
+
+private:
+  WindowClause *clause_;
+  List *sort_clauses_;
+  List *window_funcs_;
+  List *target_list_;
+};
+
+// Concatenation of its inputs, which produce the same columns. An Append
+// over the leaf partitions of a partitioned table records which partition
+// (an index into TableMetadata::partitions) each input scans, for the
+// partition-wise rules.
+class LogicalAppend : public LogicalOperator {
+public:
+  LogicalAppend() = default;
+  LogicalAppend(Oid table_oid, Index rtindex, PgVector<int> partitions)
+      : table_oid_(table_oid), rtindex_(rtindex),
+        partitions_(std::move(partitions)) {}
+
+  OperatorType GetType() const override {
+    return OperatorType::LOGICAL_APPEND;
+  }
+  std::string ToString() const override { return "LogicalAppend"; }
+  bool IsPartitioned() const { return OidIsValid(table_oid_); }
+  Oid GetTableOid() const { return table_oid_; }
+  Index GetRtIndex() const { return rtindex_; }
+  const PgVector<int> &GetPartitions() const { return partitions_; }
+
+  size_t Hash() const override {
+    return Operator::Hash() ^ table_oid_ ^ (partitions_.size() << 8);
+  }
+  bool Equals(const Operator *other) const override {
+    if (other->GetType() != GetType())
+      return false;
+    auto *append = static_cast<const LogicalAppend *>(other);
+    return append->table_oid_ == table_oid_ &&
+           append->rtindex_ == rtindex_ && append->partitions_ == partitions_;
+  }
+
+  LogicalProperties *
+  DeriveLogicalProps(Memo *memo,
+                     const GroupInputs &input_groups) const override;
+
+private:
+  Oid table_oid_ = InvalidOid;
+  Index rtindex_ = 0;
+  PgVector<int> partitions_;
+};
+
+// UNION, INTERSECT or EXCEPT of its inputs, which line up by position: input
+// i computes output column k as the k-th expression of GetInputColumns(i).
+// Above the operator the outputs are Var(rtindex, k), `rtindex` being the
+// subquery's range table entry, or the leftmost leaf's for the query's own
+// set operation. Only UNION ALL drops the columns nobody needs; the others
+// compare whole rows. `group_clauses` are the SortGroupClauses comparing
+// each column.
+class LogicalSetOperation : public LogicalOperator {
+public:
+  LogicalSetOperation(SetOperation op, bool all, Index rtindex,
+                      PgVector<List *> input_columns, List *group_clauses)
+      : op_(op), all_(all), rtindex_(rtindex),
+        input_columns_(std::move(input_columns)),
+        group_clauses_(group_clauses) {}
+
+  OperatorType GetType() const override {
+    return OperatorType::LOGICAL_SET_OPERATION;
+  }
+  std::string ToString() const override { return "LogicalSetOperation"; }
+  SetOperation GetOperation() const { return op_; }
+  bool IsAll() const { return all_; }
+  bool IsUnionAll() const { return op_ == SETOP_UNION && all_; }
+  Index GetRtIndex() const { return rtindex_; }
+  const PgVector<List *> &GetInputColumns() const { return input_columns_; }
+  List *GetGroupClauses() const { return group_clauses_; }
+  int GetNumColumns() const { return list_length(input_columns_[0]); }
+  // Whether output column `k` is produced at all
+  bool IsColumnNeeded(AttrNumber k) const;
+  // `expr`, over the output columns, rewritten over input `input`'s;
+  // nullptr if it needs the whole row.
+  Node *MapToInput(Node *expr, int input) const;
+
+  size_t Hash() const override {
+    return (Operator::Hash() * 31 + op_ * 2 + all_) ^ (rtindex_ << 8) ^
+           (input_columns_.size() << 16);
+  }
+  bool Equals(const Operator *other) const override {
+    if (other->GetType() != GetType())
+      return false;
+    auto *setop = static_cast<const LogicalSetOperation *>(other);
+    return setop->op_ == op_ && setop->all_ == all_ &&
+           setop->rtindex_ == rtindex_ &&
+           setop->input_columns_ == input_columns_ &&
+           EqualRequiredColumns(setop);
+  }
+
+  LogicalProperties *
+  DeriveLogicalProps(Memo *memo,
+                     const GroupInputs &input_groups) const override;
+
+private:
+  SetOperation op_;
+  bool all_;
+  Index rtindex_;
+  PgVector<List *> input_columns_;
+  List *group_clauses_;
+};
+
+// Reference to a CTE (WITH query) at range table index `rtindex`, whose
+// output columns are Var(rtindex, k); `cte_index` is the CTE's position in
+// the query's cteList. It reads the rows of the CTE's shared plan, which
+// the Memo optimizes once for all the references. RuleInlineCte adds
+// `inlined` as the alternative, if the CTE may be inlined: a single-input
+// UNION ALL over a copy of the CTE's query planned along with the rest of
+// the query, so predicates can move into it.
+class LogicalCteScan : public LogicalOperator {
+public:
+  LogicalCteScan(int cte_index, Index rtindex, CommonTableExpr *cte,
+                 Operator *inlined)
+      : cte_index_(cte_index), rtindex_(rtindex), cte_(cte),
+        inlined_(inlined) {}
+
+  OperatorType GetType() const override {
+    return OperatorType::LOGICAL_CTE_SCAN;
+  }
+  std::string ToString() const override {
+    return "LogicalCteScan(" + std::string(cte_->ctename) + ")";
+  }
+  int GetCteIndex() const { return cte_index_; }
+  Index GetRtIndex() const { return rtindex_; }
+  CommonTableExpr *GetCte() const { return cte_; }
+  // References the shared plan's cost is spread over
+  int GetShares() const { return cte_->cterefcount; }
+  Operator *GetInlined() const { return inlined_; }
+
+  size_t Hash() const override {
+    return Operator::Hash() ^ (cte_index_ << 8) ^ (rtindex_ << 16);
+  }
+  bool Equals(const Operator *other) const override {
+    if (other->GetType() != GetType())
+      return false;
+    auto *scan = static_cast<const LogicalCteScan *>(other);
+    return scan->cte_index_ == cte_index_ && scan->rtindex_ == rtindex_ &&
+           EqualRequiredColumns(scan);
+  }
+
+  LogicalProperties *
+  DeriveLogicalProps(Memo *memo,
+                     const GroupInputs &input_groups) const override;
+
+private:
+  int cte_index_;
+  Index rtindex_;
+  CommonTableExpr *cte_;
+  Operator *inlined_;
 };
 
 class LogicalLimit : public LogicalOperator {
@@ -146,59 +625,273 @@ public:
   LogicalLimit(Node *limit_offset, Node *limit_count)
       : limit_offset_(limit_offset), limit_count_(limit_count) {}
 
+  OperatorType GetType() const override { return OperatorType::LOGICAL_LIMIT; }
   std::string ToString() const override { return "LogicalLimit"; }
+
+  size_t Hash() const override {
+    return Operator::Hash() ^ reinterpret_cast<size_t>(limit_count_);
+  }
+  bool Equals(const Operator *other) const override {
+    if (other->GetType() != GetType())
+      return false;
+    auto *limit = static_cast<const LogicalLimit *>(other);
+    return limit->limit_offset_ == limit_offset_ &&
+           limit->limit_count_ == limit_count_;
+  }
   Node *GetLimitOffset() const { return limit_offset_; }
   Node *GetLimitCount() const { return limit_count_; }
 
   LogicalProperties *
   DeriveLogicalProps(Memo *memo,
-                     const PgVector<Group *> &input_groups) const override;
+                     const GroupInputs &input_groups) const override;
 
 private:
   Node *limit_offset_;
   Node *limit_count_;
 };
 
+// All rows of the left input, joined with their matches on the right or
+// with NULLs if there are none. RIGHT JOIN is translated with its inputs
+// swapped; physical implementations may still swap them back.
+class LogicalLeftJoin : public LogicalJoin {
+public:
+  explicit LogicalLeftJoin(PredicateList predicates)
+      : LogicalJoin(std::move(predicates)) {}
+
+  OperatorType GetType() const override {
+    return OperatorType::LOGICAL_LEFT_JOIN;
+  }
+  std::string ToString() const override { return "LogicalLeftJoin"; }
+  JoinType GetJoinType() const override { return JOIN_LEFT; }
+  LogicalJoin *WithPredicates(PredicateList predicates) const override {
+    return new LogicalLeftJoin(std::move(predicates));
+  }
+
+  LogicalProperties *
+  DeriveLogicalProps(Memo *memo,
+                     const GroupInputs &input_groups) const override;
+};
+
+// Left join in both directions: unmatched rows of either input are kept.
+// Only hash and merge joins implement it, so every predicate has to be a
+// hash or merge key; a full join with any other qual leaves the query
+// without a plan, and it falls back to PostgreSQL's planner. Full joins
+// never take part in join reordering.
+class LogicalFullJoin : public LogicalJoin {
+public:
+  explicit LogicalFullJoin(PredicateList predicates)
+      : LogicalJoin(std::move(predicates)) {}
+
+  OperatorType GetType() const override {
+    return OperatorType::LOGICAL_FULL_JOIN;
+  }
+  std::string ToString() const override { return "LogicalFullJoin"; }
+  JoinType GetJoinType() const override { return JOIN_FULL; }
+  LogicalJoin *WithPredicates(PredicateList predicates) const override {
+    return new LogicalFullJoin(std::move(predicates));
+  }
+
+  LogicalProperties *
+  DeriveLogicalProps(Memo *memo,
+                     const GroupInputs &input_groups) const override;
+};
+
 // --- Physical Operators ---
 
 class PhysicalTableScan : public PhysicalOperator {
 public:
-  PhysicalTableScan(Oid table_oid, Index rtindex)
-      : table_oid_(table_oid), rtindex_(rtindex) {}
+  PhysicalTableScan(Oid table_oid, Index rtindex,
+                    Oid partition_oid = InvalidOid)
+      : table_oid_(table_oid), rtindex_(rtindex),
+        partition_oid_(partition_oid) {}
 
+  OperatorType GetType() const override {
+    return OperatorType::PHYSICAL_TABLE_SCAN;
+  }
   std::string ToString() const override {
     return "PhysicalTableScan(" + std::to_string(table_oid_) + ")";
   }
   Oid GetTableOid() const { return table_oid_; }
   Index GetRtIndex() const { return rtindex_; }
+  Oid GetPartitionOid() const { return partition_oid_; }
+  // The relation actually read: the partition, for a partition scan
+  Oid GetScannedOid() const {
+    return OidIsValid(partition_oid_) ? partition_oid_ : table_oid_;
+  }
+
+private:
+  Oid table_oid_;
+  Index rtindex_;
+  Oid partition_oid_;
+};
+
+// Scan of a table through one of its btree indexes. Each index predicate
+// compares key column `index_columns[i]` (1-based) with a value; those of
+// the inner input of a parameterized nested loop read the outer row, which
+// makes the scan's cost and row count per outer row. `selectivity` is the
+// fraction of the index read per scan and `loops` the number of scans.
+// The other predicates are checked on the fetched rows.
+class PhysicalIndexScan : public PhysicalOperator {
+public:
+  PhysicalIndexScan(Oid table_oid, Index rtindex, Oid index_oid,
+                    PredicateList index_predicates,
+                    PgVector<AttrNumber> index_columns,
+                    PredicateList predicates, double selectivity,
+                    double loops = 1.0)
+      : table_oid_(table_oid), rtindex_(rtindex), index_oid_(index_oid),
+        index_predicates_(std::move(index_predicates)),
+        index_columns_(std::move(index_columns)),
+        predicates_(std::move(predicates)), selectivity_(selectivity),
+        loops_(loops) {}
+
+  OperatorType GetType() const override {
+    return OperatorType::PHYSICAL_INDEX_SCAN;
+  }
+  std::string ToString() const override {
+    return "PhysicalIndexScan(" + std::to_string(index_oid_) + ")";
+  }
+  Oid GetTableOid() const { return table_oid_; }
+  Index GetRtIndex() const { return rtindex_; }
+  Oid GetIndexOid() const { return index_oid_; }
+  const PredicateList &GetIndexPredicates() const {
+    return index_predicates_;
+  }
+  const PgVector<AttrNumber> &GetIndexColumns() const {
+    return index_columns_;
+  }
+  const PredicateList &GetPredicates() const { return predicates_; }
+  double GetSelectivity() const { return selectivity_; }
+  double GetLoops() const { return loops_; }
 
 private:
   Oid table_oid_;
   Index rtindex_;
+  Oid index_oid_;
+  PredicateList index_predicates_;
+  PgVector<AttrNumber> index_columns_;
+  PredicateList predicates_;
+  double selectivity_;
+  double loops_;
 };
 
-class PhysicalNestedLoopJoin : public PhysicalOperator {
+// Base of the physical joins. The predicates are the ones checked for every
+// candidate pair (PG's joinqual); hash and merge joins find the candidates
+// through their key predicates.
+class PhysicalJoin : public PhysicalOperator {
 public:
-  PhysicalNestedLoopJoin() = default;
+  JoinType GetJoinType() const { return join_type_; }
+  const PredicateList &GetPredicates() const { return predicates_; }
+
+protected:
+  PhysicalJoin(JoinType join_type, PredicateList predicates)
+      : join_type_(join_type), predicates_(std::move(predicates)) {}
 
+private:
+  JoinType join_type_;
+  PredicateList predicates_;
+};
+
+// Rescans the right input for every left row. A parameterized right input
+// reads the columns of the current left row (PG's nestParams) and is
+// rescanned as is; otherwise it is materialized once.
+class PhysicalNestedLoopJoin : public PhysicalJoin {
+public:
+  PhysicalNestedLoopJoin(JoinType join_type, PredicateList predicates,
+                         bool parameterized = false)
+      : PhysicalJoin(join_type, std::move(predicates)),
+        parameterized_(parameterized) {}
+
+  OperatorType GetType() const override {
+    return OperatorType::PHYSICAL_NESTED_LOOP_JOIN;
+  }
   std::string ToString() const override { return "PhysicalNestedLoopJoin"; }
+  bool IsParameterized() const { return parameterized_; }
+
+private:
+  bool parameterized_;
+};
+
+// Caches the rows its parameterized input returns for each value of the
+// cache keys (expressions of the outer row of the nested loop above), so
+// repeated values do not rescan the input. `calls` and `distinct` are the
+// estimated number of rescans and of distinct key values among them.
+class PhysicalMemoize : public PhysicalOperator {
+public:
+  PhysicalMemoize(List *cache_keys, double calls, double distinct)
+      : cache_keys_(cache_keys), calls_(calls), distinct_(distinct) {}
+
+  OperatorType GetType() const override {
+    return OperatorType::PHYSICAL_MEMOIZE;
+  }
+  std::string ToString() const override { return "PhysicalMemoize"; }
+  List *GetCacheKeys() const { return cache_keys_; }
+  double GetCalls() const { return calls_; }
+  double GetDistinct() const { return distinct_; }
+
+private:
+  List *cache_keys_;
+  double calls_;
+  double distinct_;
+};
+
+// Builds a hash table on the right input and probes it with the left one.
+class PhysicalHashJoin : public PhysicalJoin {
+public:
+  PhysicalHashJoin(JoinType join_type, PredicateList hash_predicates,
+                   PredicateList predicates)
+      : PhysicalJoin(join_type, std::move(predicates)),
+        hash_predicates_(std::move(hash_predicates)) {}
+
+  OperatorType GetType() const override {
+    return OperatorType::PHYSICAL_HASH_JOIN;
+  }
+  std::string ToString() const override { return "PhysicalHashJoin"; }
+  const PredicateList &GetHashPredicates() const { return hash_predicates_; }
+
+private:
+  PredicateList hash_predicates_;
+};
+
+// Merges both inputs, each sorted on its side of the merge predicates.
+class PhysicalMergeJoin : public PhysicalJoin {
+public:
+  PhysicalMergeJoin(JoinType join_type, PredicateList merge_predicates,
+                    PredicateList predicates)
+      : PhysicalJoin(join_type, std::move(predicates)),
+        merge_predicates_(std::move(merge_predicates)) {}
+
+  OperatorType GetType() const override {
+    return OperatorType::PHYSICAL_MERGE_JOIN;
+  }
+  std::string ToString() const override { return "PhysicalMergeJoin"; }
+  const PredicateList &GetMergePredicates() const { return merge_predicates_; }
+
+private:
+  PredicateList merge_predicates_;
 };
 
 class PhysicalFilter : public PhysicalOperator {
 public:
-  explicit PhysicalFilter(Node *qual) : qual_(qual) {}
+  explicit PhysicalFilter(PredicateList predicates)
+      : predicates_(std::move(predicates)) {}
 
+  OperatorType GetType() const override {
+    return OperatorType::PHYSICAL_FILTER;
+  }
   std::string ToString() const override { return "PhysicalFilter"; }
-  Node *GetQual() const { return qual_; }
+  const PredicateList &GetPredicates() const { return predicates_; }
 
 private:
-  Node *qual_;
+  PredicateList predicates_;
 };
 
 class PhysicalProjection : public PhysicalOperator {
 public:
   explicit PhysicalProjection(List *target_list) : target_list_(target_list) {}
 
+  OperatorType GetType() const override {
+    return OperatorType::PHYSICAL_PROJECTION;
+  }
   std::string ToString() const override { return "PhysicalProjection"; }
   List *GetTargetList() const { return target_list_; }
 
@@ -206,29 +899,193 @@ private:
   List *target_list_;
 };
 
+// Sorts all of its input on the keys of `sort_clause`.
 class PhysicalSort : public PhysicalOperator {
 public:
-  explicit PhysicalSort(List *sort_clause) : sort_clause_(sort_clause) {}
+  PhysicalSort(List *sort_clause, SortKeyList keys)
+      : sort_clause_(sort_clause), keys_(std::move(keys)) {}
 
+  OperatorType GetType() const override { return OperatorType::PHYSICAL_SORT; }
   std::string ToString() const override { return "PhysicalSort"; }
   List *GetSortClause() const { return sort_clause_; }
+  const SortKeyList &GetKeys() const { return keys_; }
 
 private:
   List *sort_clause_;
+  SortKeyList keys_;
 };
 
+// Sort that makes use of the order the input plan already produces: with
+// the rows sorted on a prefix of the keys, it only sorts each group of rows
+// that agree on the prefix, and with all of them it has nothing to do.
+class PhysicalIncrementalSort : public PhysicalOperator {
+public:
+  PhysicalIncrementalSort(List *sort_clause, SortKeyList keys)
+      : sort_clause_(sort_clause), keys_(std::move(keys)) {}
+
+  OperatorType GetType() const override {
+    return OperatorType::PHYSICAL_INCREMENTAL_SORT;
+  }
+  std::string ToString() const override { return "PhysicalIncrementalSort"; }
+  List *GetSortClause() const { return sort_clause_; }
+  const SortKeyList &GetKeys() const { return keys_; }
+
+private:
+  List *sort_clause_;
+  SortKeyList keys_;
+};
+
+// Agg node grouping by hashing (AGG_HASHED), on input sorted by the keys
+// (AGG_SORTED), or all rows at once (AGG_PLAIN).
 class PhysicalAggregate : public PhysicalOperator {
 public:
-  PhysicalAggregate(List *group_clause, Node *having_qual)
-      : group_clause_(group_clause), having_qual_(having_qual) {}
+  PhysicalAggregate(AggStrategy strategy, AggSplit split, GroupKeyList keys,
+                    List *aggregates)
+      : strategy_(strategy), split_(split), keys_(std::move(keys)),
+        aggregates_(aggregates) {}
 
+  OperatorType GetType() const override {
+    return OperatorType::PHYSICAL_AGGREGATE;
+  }
   std::string ToString() const override { return "PhysicalAggregate"; }
-  List *GetGroupClause() const { return group_clause_; }
-  Node *GetHavingQual() const { return having_qual_; }
+  AggStrategy GetStrategy() const { return strategy_; }
+  AggSplit GetSplit() const { return split_; }
+  const GroupKeyList &GetKeys() const { return keys_; }
+  List *GetAggregates() const { return aggregates_; }
+
+private:
+  AggStrategy strategy_;
+  AggSplit split_;
+  GroupKeyList keys_;
+  List *aggregates_;
+};
+
+// WindowAgg computing the window functions of one window clause. Its input
+// is sorted on `keys` first, as far as the input plan does not deliver its
+// rows in that order already.
+class PhysicalWindowAgg : public PhysicalOperator {
+public:
+  PhysicalWindowAgg(WindowClause *clause, List *window_funcs,
+                    List *target_list, SortKeyList keys)
+      : clause_(clause), window_funcs_(window_funcs),
+        target_list_(target_list), keys_(std::move(keys)) {}
+
+  OperatorType GetType() const override {
+    return OperatorType::PHYSICAL_WINDOW_AGG;
+  }
+  std::string ToString() const override { return "PhysicalWindowAgg"; }
+  WindowClause *GetClause() const { return clause_; }
+  List *GetWindowFuncs() const { return window_funcs_; }
+  List *GetTargetList() const { return target_list_; }
+  const SortKeyList &GetKeys() const { return keys_; }
+
+private:
+  WindowClause *clause_;
+  List *window_funcs_;
+  List *target_list_;
+  SortKeyList keys_;
+};
+
+// Runs its inputs one after the other. `rtindex` is the partitioned table
+// whose partitions the inputs scan, if any, or the output of a UNION ALL;
+// the inputs of the latter compute the output columns from
+// `input_columns` (see LogicalSetOperation).
+class PhysicalAppend : public PhysicalOperator {
+public:
+  explicit PhysicalAppend(Index rtindex = 0,
+                          PgVector<List *> input_columns = {})
+      : rtindex_(rtindex), input_columns_(std::move(input_columns)) {}
+
+  OperatorType GetType() const override {
+    return OperatorType::PHYSICAL_APPEND;
+  }
+  std::string ToString() const override { return "PhysicalAppend"; }
+  Index GetRtIndex() const { return rtindex_; }
+  bool IsSetOperation() const { return !input_columns_.empty(); }
+  const PgVector<List *> &GetInputColumns() const { return input_columns_; }
+
+private:
+  Index rtindex_;
+  PgVector<List *> input_columns_;
+};
+
+// UNION ALL keeping the order of its inputs: each is sorted on
+// `key_columns` (output column numbers, compared as `sort_clause` says) and
+// the sorted streams are merged.
+class PhysicalMergeAppend : public PhysicalOperator {
+public:
+  PhysicalMergeAppend(Index rtindex, PgVector<List *> input_columns,
+                      List *sort_clause, PgVector<AttrNumber> key_columns)
+      : rtindex_(rtindex), input_columns_(std::move(input_columns)),
+        sort_clause_(sort_clause), key_columns_(std::move(key_columns)) {}
+
+  OperatorType GetType() const override {
+    return OperatorType::PHYSICAL_MERGE_APPEND;
+  }
+  std::string ToString() const override { return "PhysicalMergeAppend"; }
+  Index GetRtIndex() const { return rtindex_; }
+  const PgVector<List *> &GetInputColumns() const { return input_columns_; }
+  List *GetSortClause() const { return sort_clause_; }
+  const PgVector<AttrNumber> &GetKeyColumns() const { return key_columns_; }
+
+private:
+  Index rtindex_;
+  PgVector<List *> input_columns_;
+  List *sort_clause_;
+  PgVector<AttrNumber> key_columns_;
+};
+
+// INTERSECT [ALL] or EXCEPT [ALL] of its two inputs, counting the
+// duplicates of each row in a hash table or over inputs sorted on every
+// column.
+class PhysicalSetOp : public PhysicalOperator {
+public:
+  PhysicalSetOp(SetOperation op, bool all, SetOpStrategy strategy,
+                Index rtindex, PgVector<List *> input_columns,
+                List *group_clauses)
+      : op_(op), all_(all), strategy_(strategy), rtindex_(rtindex),
+        input_columns_(std::move(input_columns)),
+        group_clauses_(group_clauses) {}
+
+  OperatorType GetType() const override {
+    return OperatorType::PHYSICAL_SET_OP;
+  }
+  std::string ToString() const override { return "PhysicalSetOp"; }
+  SetOperation GetOperation() const { return op_; }
+  bool IsAll() const { return all_; }
+  SetOpStrategy GetStrategy() const { return strategy_; }
+  Index GetRtIndex() const { return rtindex_; }
+  const PgVector<List *> &GetInputColumns() const { return input_columns_; }
+  List *GetGroupClauses() const { return group_clauses_; }
 
 private:
-  List *group_clause_;
-  Node *having_qual_;
+  SetOperation op_;
+  bool all_;
+  SetOpStrategy strategy_;
+  Index rtindex_;
+  PgVector<List *> input_columns_;
+  List *group_clauses_;
+};
+
+// Scan of the rows of a CTE's shared plan, which runs once, as an InitPlan,
+// and keeps them in a tuplestore for all of its `shares` readers
+class PhysicalCteScan : public PhysicalOperator {
+public:
+  PhysicalCteScan(int cte_index, Index rtindex, int shares)
+      : cte_index_(cte_index), rtindex_(rtindex), shares_(shares) {}
+
+  OperatorType GetType() const override {
+    return OperatorType::PHYSICAL_CTE_SCAN;
+  }
+  std::string ToString() const override { return "PhysicalCteScan"; }
+  int GetCteIndex() const { return cte_index_; }
+  Index GetRtIndex() const { return rtindex_; }
+  int GetShares() const { return shares_; }
+
+private:
+  int cte_index_;
+  Index rtindex_;
+  int shares_;
 };
 
 class PhysicalLimit : public PhysicalOperator {
@@ -236,6 +1093,9 @@ public:
   PhysicalLimit(Node *limit_offset, Node *limit_count)
       : limit_offset_(limit_offset), limit_count_(limit_count) {}
 
+  OperatorType GetType() const override {
+    return OperatorType::PHYSICAL_LIMIT;
+  }
   std::string ToString() const override { return "PhysicalLimit"; }
   Node *GetLimitOffset() const { return limit_offset_; }
   Node *GetLimitCount() const { return limit_count_; }
@@ -245,6 +1105,16 @@ private:
   Node *limit_count_;
 };
 
+// Produces no rows; replaces a filter or join whose predicates can never be
+// satisfied. Its input is not evaluated at all.
+class PhysicalEmptyResult : public PhysicalOperator {
+public:
+  OperatorType GetType() const override {
+    return OperatorType::PHYSICAL_EMPTY_RESULT;
+  }
+  std::string ToString() const override { return "PhysicalEmptyResult"; }
+};
+
 } // namespace pg_carbon
 
 #endif // PG_CARBON_OPERATORS_H
@@ -2,6 +2,7 @@
 #define PG_CARBON_COLUMN_H
 
 #include "../common/memory.h"
+#include <algorithm> // For std::min, std::max
 #include <string>
 
 // clang-format off
@@ -13,6 +14,167 @@ extern "C" {
 
 namespace pg_carbon {
 
+// Wrapper around PgVector<bool> to serve as ColSet (Decoupled from PG
+// Bitmapset)
+class ColSet : public PgObject {
+public:
+  ColSet() = default;
+
+  void Add(int col_id) {
+    if (col_id < 0)
+      return;
+    if (static_cast<size_t>(col_id) >= bits_.size()) {
+      bits_.resize(col_id + 1, false);
+    }
+    bits_[col_id] = true;
+  }
+
+  void Union(const ColSet &other) {
+    if (other.bits_.size() > bits_.size()) {
+      bits_.resize(other.bits_.size(), false);
+    }
+    for (size_t i = 0; i < other.bits_.size(); ++i) {
+      if (other.bits_[i]) {
+        bits_[i] = true;
+      }
+    }
+  }
+
+  bool IsMember(int col_id) const {
+    return col_id >= 0 && static_cast<size_t>(col_id) < bits_.size() &&
+           bits_[col_id];
+  }
+
+  bool IsEmpty() const {
+    for (bool bit : bits_) {
+      if (bit)
+        return false;
+    }
+    return true;
+  }
+
+  int Size() const {
+    int count = 0;
+    for (bool bit : bits_) {
+      if (bit)
+        count++;
+    }
+    return count;
+  }
+
+  bool IsSubset(const ColSet &other) const {
+    // return true if *this* is a subset of *other*
+    if (bits_.size() > other.bits_.size()) {
+      // If we have bits beyond other's size, check if any are set
+      for (size_t i = other.bits_.size(); i < bits_.size(); ++i) {
+        if (bits_[i])
+          return false;
+      }
+    }
+    size_t check_len = std::min(bits_.size(), other.bits_.size());
+    for (size_t i = 0; i < check_len; ++i) {
+      if (bits_[i] && !other.bits_[i])
+        return false;
+    }
+    return true;
+  }
+
+  bool Overlaps(const ColSet &other) const {
+    size_t check_len = std::min(bits_.size(), other.bits_.size());
+    for (size_t i = 0; i < check_len; ++i) {
+      if (bits_[i] && other.bits_[i])
+        return true;
+    }
+    return false;
+  }
+
+  bool Equals(const ColSet &other) const {
+    return IsSubset(other) && other.IsSubset(*this);
+  }
+
+  // Calls fn(col_id) for every member, in ascending id order.
+  template <typename Fn> void ForEach(Fn fn) const {
+    for (size_t i = 0; i < bits_.size(); ++i) {
+      if (bits_[i])
+        fn(static_cast<int>(i));
+    }
+  }
+
+  static ColSet MakeSingleton(int col_id) {
+    ColSet s;
+    s.Add(col_id);
+    return s;
+  }
+
+private:
+  PgVector<bool> bits_;
+};
+
+// Set of base-relation attributes, keyed by range table index. Column ids are
+// only assigned once an operator is inserted into the Memo, so the translator
+// uses this to describe which attributes each operator has to produce.
+// Attribute numbers are offset by FirstLowInvalidHeapAttributeNumber (the
+// pull_varattnos() convention) so system columns fit.
+class AttrSet : public PgObject {
+public:
+  void Add(Index rt_index, AttrNumber attr_num) {
+    if (rt_index >= attrs_.size()) {
+      attrs_.resize(rt_index + 1);
+    }
+    attrs_[rt_index].Add(attr_num - FirstLowInvalidHeapAttributeNumber);
+  }
+
+  // Exact membership test; a whole-row reference does not imply the
+  // individual attributes.
+  bool IsMember(Index rt_index, AttrNumber attr_num) const {
+    return rt_index < attrs_.size() &&
+           attrs_[rt_index].IsMember(attr_num -
+                                     FirstLowInvalidHeapAttributeNumber);
+  }
+
+  // True if the attribute has to be produced, either because it is referenced
+  // directly or because the whole row of the relation is.
+  bool Contains(Index rt_index, AttrNumber attr_num) const {
+    return IsMember(rt_index, attr_num) ||
+           (attr_num > 0 && IsMember(rt_index, InvalidAttrNumber));
+  }
+
+  void Union(const AttrSet &other) {
+    if (other.attrs_.size() > attrs_.size()) {
+      attrs_.resize(other.attrs_.size());
+    }
+    for (size_t i = 0; i < other.attrs_.size(); ++i) {
+      attrs_[i].Union(other.attrs_[i]);
+    }
+  }
+
+  bool Equals(const AttrSet &other) const {
+    size_t size = std::max(attrs_.size(), other.attrs_.size());
+    for (size_t i = 0; i < size; ++i) {
+      bool empty = i >= attrs_.size() || attrs_[i].IsEmpty();
+      bool other_empty = i >= other.attrs_.size() || other.attrs_[i].IsEmpty();
+      if (empty != other_empty)
+        return false;
+      if (!empty && !attrs_[i].Equals(other.attrs_[i]))
+        return false;
+    }
+    return true;
+  }
+
+  // Range table indexes with at least one referenced attribute
+  ColSet GetRelids() const {
+    ColSet relids;
+    for (size_t i = 0; i < attrs_.size(); ++i) {
+      if (!attrs_[i].IsEmpty())
+        relids.Add(static_cast<int>(i));
+    }
+    return relids;
+  }
+
+private:
+  PgVector<ColSet> attrs_;
+};
+
 enum class CarbonColumnType { TABLE_COLUMN, EXPR_COLUMN, UNKNOWN };
 
 class CarbonColumn : public PgObject {
@@ -21,6 +183,9 @@ public:
   virtual CarbonColumnType GetType() const = 0;
   virtual std::string ToString() const = 0;
 
+  // Estimated average width in bytes, used for tuple width estimates.
+  virtual int32 GetWidth() const = 0;
+
   // Unique ID assigned by Memo when registered
   void SetId(int id) { id_ = id; }
   int GetId() const { return id_; }
@@ -31,8 +196,11 @@ private:
 
 class TableColumn : public CarbonColumn {
 public:
-  TableColumn(Oid table_oid, Index rt_index, AttrNumber attr_num)
-      : table_oid_(table_oid), rt_index_(rt_index), attr_num_(attr_num) {}
+  TableColumn(Oid table_oid, Index rt_index, AttrNumber attr_num, Oid type_oid,
+              int32 type_mod, Oid collation, int32 width)
+      : table_oid_(table_oid), rt_index_(rt_index), attr_num_(attr_num),
+        type_oid_(type_oid), type_mod_(type_mod), collation_(collation),
+        width_(width) {}
 
   CarbonColumnType GetType() const override {
     return CarbonColumnType::TABLE_COLUMN;
@@ -44,19 +212,28 @@ public:
            ", Attr=" + std::to_string(attr_num_) + ")";
   }
 
+  int32 GetWidth() const override { return width_; }
+
   Oid GetTableOid() const { return table_oid_; }
   Index GetRtIndex() const { return rt_index_; }
   AttrNumber GetAttrNum() const { return attr_num_; }
+  Oid GetTypeOid() const { return type_oid_; }
+  int32 GetTypeMod() const { return type_mod_; }
+  Oid GetCollation() const { return collation_; }
 
 private:
   Oid table_oid_;
   Index rt_index_;
   AttrNumber attr_num_;
+  Oid type_oid_;
+  int32 type_mod_;
+  Oid collation_;
+  int32 width_;
 };
 
 class ExprColumn : public CarbonColumn {
 public:
-  explicit ExprColumn(Node *expr) : expr_(expr) {}
+  ExprColumn(Node *expr, int32 width) : expr_(expr), width_(width) {}
 
   CarbonColumnType GetType() const override {
     return CarbonColumnType::EXPR_COLUMN;
@@ -66,10 +243,13 @@ public:
     return "ExprColumn"; // Simplified for now
   }
 
+  int32 GetWidth() const override { return width_; }
+
   Node *GetExpr() const { return expr_; }
 
 private:
   Node *expr_;
+  int32 width_;
 };
 
 } // namespace pg_carbon
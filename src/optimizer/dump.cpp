@@ -0,0 +1,507 @@
+#include "dump.h"
+#include "../metadata/metadata.h"
+#include "memo.h"
+#include "optimizer.h"
+#include "translator.h"
+#include <algorithm>
+#include <sstream>
+
+extern "C" {
+#include "lib/stringinfo.h"
+#include "nodes/makefuncs.h"
+#include "nodes/readfuncs.h"
+#include "portability/instr_time.h"
+#include "storage/fd.h"
+#include "utils/guc.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+}
+
+namespace pg_carbon {
+
+static const int kDumpVersion = 1;
+
+// Settings the translator and the search read, restored when replaying
+static const char *const kDumpedSettings[] = {
+    "pg_carbon.search_time_budget",
+    "pg_carbon.search_task_budget",
+    "pg_carbon.memo_memory_budget",
+    "pg_carbon.stage0_cost_limit",
+    "pg_carbon.stage1_cost_limit",
+    "seq_page_cost",
+    "random_page_cost",
+    "cpu_tuple_cost",
+    "cpu_index_tuple_cost",
+    "cpu_operator_cost",
+    "effective_cache_size",
+    "work_mem",
+    "hash_mem_multiplier",
+};
+
+// --- Writing ---
+
+static void AppendNode(StringInfo buf, const char *text) {
+  appendStringInfo(buf, " %zu ", strlen(text));
+  appendStringInfoString(buf, text);
+}
+
+static void AppendTable(StringInfo buf, Oid table_oid,
+                        const TableMetadata *metadata) {
+  appendStringInfo(buf, "table %u %.17g %.17g %u %d %d\n", table_oid,
+                   metadata->rows, metadata->pages, metadata->row_type,
+                   metadata->partitioned, metadata->partition_strategy);
+  for (const ColumnMetadata &column : metadata->columns)
+    appendStringInfo(buf, "column %d %u %d %u\n", column.attnum, column.type,
+                     column.typmod, column.collation);
+  for (const UniqueKey &key : metadata->unique_keys) {
+    appendStringInfo(buf, "unique_key %zu", key.columns.size());
+    for (size_t i = 0; i < key.columns.size(); i++)
+      appendStringInfo(buf, " %d %u", key.columns[i], key.opfamilies[i]);
+    appendStringInfoChar(buf, '\n');
+  }
+  for (const IndexMetadata &index : metadata->indexes) {
+    appendStringInfo(buf, "index %u %d %.17g %.17g %d %zu", index.oid,
+                     index.unique, index.pages, index.tuples,
+                     index.tree_height, index.columns.size());
+    for (size_t i = 0; i < index.columns.size(); i++)
+      appendStringInfo(buf, " %d %u %u %d %d", index.columns[i],
+                       index.opfamilies[i], index.collations[i],
+                       (int)index.descending[i], (int)index.nulls_first[i]);
+    appendStringInfoChar(buf, '\n');
+  }
+  for (const ForeignKey &key : metadata->foreign_keys) {
+    appendStringInfo(buf, "foreign_key %u %zu", key.referenced_table,
+                     key.columns.size());
+    for (size_t i = 0; i < key.columns.size(); i++)
+      appendStringInfo(buf, " %d %d %u", key.columns[i],
+                       key.referenced_columns[i], key.operators[i]);
+    appendStringInfoChar(buf, '\n');
+  }
+  if (metadata->partitioned) {
+    appendStringInfo(buf, "partition_key %zu",
+                     metadata->partition_key.size());
+    for (size_t i = 0; i < metadata->partition_key.size(); i++)
+      appendStringInfo(buf, " %d %u", metadata->partition_key[i],
+                       metadata->partition_opfamilies[i]);
+    appendStringInfoChar(buf, '\n');
+  }
+  for (const PartitionLeaf &leaf : metadata->partitions) {
+    appendStringInfo(buf, "partition %u %d %d", leaf.relid, leaf.relkind,
+                     leaf.bound_index);
+    AppendNode(buf, nodeToString(leaf.constraint));
+    appendStringInfoChar(buf, '\n');
+  }
+}
+
+// The MCVs go in as Consts, whose values nodeToString() writes out byte by
+// byte, so reading them back needs no type input functions.
+static void AppendColumnStats(StringInfo buf, uint64 key,
+                              const ColumnStats &stats) {
+  List *mcvs = NIL;
+  if (!stats.mcv_values.empty()) {
+    int16 typlen;
+    bool typbyval;
+    get_typlenbyval(stats.mcv_type, &typlen, &typbyval);
+    for (Datum value : stats.mcv_values)
+      mcvs = lappend(mcvs, makeConst(stats.mcv_type, -1, InvalidOid, typlen,
+                                     value, false, typbyval));
+  }
+  appendStringInfo(buf, "stats %u %d %.17g %.17g %u %zu", (Oid)(key >> 16),
+                   (int)(int16)(key & 0xFFFF), stats.ndistinct,
+                   stats.null_frac, stats.mcv_type, stats.mcv_freqs.size());
+  for (double freq : stats.mcv_freqs)
+    appendStringInfo(buf, " %.17g", freq);
+  AppendNode(buf, nodeToString(mcvs));
+  appendStringInfoChar(buf, '\n');
+}
+
+void QueryDump::Write(uint64 query_id, const char *query,
+                      double upper_bound) {
+  StringInfoData buf;
+  initStringInfo(&buf);
+  appendStringInfo(&buf, "pg_carbon dump %d\n", kDumpVersion);
+  for (const char *name : kDumpedSettings) {
+    const char *value = GetConfigOption(name, true, false);
+    if (value)
+      appendStringInfo(&buf, "setting %s %s\n", name, value);
+  }
+  appendStringInfo(&buf, "upper_bound %.17g\n", upper_bound);
+  appendStringInfoString(&buf, "query");
+  AppendNode(&buf, query);
+  appendStringInfoChar(&buf, '\n');
+
+  // Sorted, so that dumps of the same query compare equal
+  MetadataAccessor::TableCache *cache = MetadataAccessor::GetCache();
+  PgVector<Oid> tables;
+  for (const auto &entry : cache->tables)
+    tables.push_back(entry.first);
+  std::sort(tables.begin(), tables.end());
+  for (Oid table_oid : tables)
+    AppendTable(&buf, table_oid, cache->tables.at(table_oid));
+
+  PgVector<uint64> columns;
+  for (const auto &entry : cache->column_widths)
+    columns.push_back(entry.first);
+  std::sort(columns.begin(), columns.end());
+  for (uint64 key : columns)
+    appendStringInfo(&buf, "width %u %d %d\n", (Oid)(key >> 16),
+                     (int)(int16)(key & 0xFFFF),
+                     cache->column_widths.at(key));
+
+  columns.clear();
+  for (const auto &entry : cache->column_stats)
+    columns.push_back(entry.first);
+  std::sort(columns.begin(), columns.end());
+  for (uint64 key : columns)
+    AppendColumnStats(&buf, key, cache->column_stats.at(key));
+
+  for (const auto &entry : cache->bounds_match)
+    appendStringInfo(&buf, "bounds_match %u %u %d\n",
+                     (Oid)(entry.first >> 32), (Oid)(entry.first & 0xFFFFFFFF),
+                     entry.second);
+  appendStringInfoString(&buf, "end\n");
+
+  char *path = psprintf("%s/pg_carbon_" UINT64_FORMAT ".dump",
+                        pg_carbon_dump_directory, query_id);
+  FILE *file = AllocateFile(path, PG_BINARY_W);
+  if (!file || fwrite(buf.data, 1, buf.len, file) != (size_t)buf.len) {
+    ereport(WARNING, (errcode_for_file_access(),
+                      errmsg("could not write pg_carbon dump \"%s\": %m",
+                             path)));
+  }
+  if (file && FreeFile(file) != 0) {
+    ereport(WARNING, (errcode_for_file_access(),
+                      errmsg("could not close pg_carbon dump \"%s\": %m",
+                             path)));
+  }
+  pfree(buf.data);
+  pfree(path);
+}
+
+// --- Reading ---
+
+// The fields of a dump, read one after the other
+class DumpReader {
+public:
+  DumpReader(const char *path, const char *data) : path_(path), pos_(data) {}
+
+  // The next field, in a buffer that the next call reuses
+  const char *Word() {
+    SkipSpace();
+    size_t len = strcspn(pos_, " \t\r\n");
+    if (len == 0)
+      Fail("unexpected end of file");
+    if (len >= sizeof(word_))
+      Fail("field too long");
+    memcpy(word_, pos_, len);
+    word_[len] = '\0';
+    pos_ += len;
+    return word_;
+  }
+
+  void Expect(const char *word) {
+    if (strcmp(Word(), word) != 0)
+      Fail(psprintf("expected \"%s\", found \"%s\"", word, word_));
+  }
+
+  double Double() {
+    const char *word = Word();
+    char *end;
+    double value = strtod(word, &end);
+    if (*end != '\0')
+      Fail(psprintf("invalid number \"%s\"", word));
+    return value;
+  }
+
+  int64 Int() {
+    const char *word = Word();
+    char *end;
+    long long value = strtoll(word, &end, 10);
+    if (*end != '\0')
+      Fail(psprintf("invalid integer \"%s\"", word));
+    return value;
+  }
+
+  Oid ObjectId() { return (Oid)Int(); }
+
+  // A node tree behind its length
+  Node *NodeTree() {
+    int64 len = Int();
+    if (len < 0 || *pos_ != ' ' || (int64)strnlen(pos_ + 1, len) < len)
+      Fail("truncated node tree");
+    char *text = pnstrdup(pos_ + 1, len);
+    pos_ += len + 1;
+    return (Node *)stringToNode(text);
+  }
+
+  [[noreturn]] void Fail(const char *detail) {
+    ereport(ERROR, (errcode(ERRCODE_DATA_CORRUPTED),
+                    errmsg("invalid pg_carbon dump \"%s\"", path_),
+                    errdetail("%s", detail)));
+    pg_unreachable();
+  }
+
+private:
+  void SkipSpace() {
+    while (*pos_ == ' ' || *pos_ == '\t' || *pos_ == '\r' || *pos_ == '\n')
+      pos_++;
+  }
+
+  const char *path_;
+  const char *pos_;
+  char word_[256];
+};
+
+char *QueryDump::ReadFile(const char *path) {
+  FILE *file = AllocateFile(path, PG_BINARY_R);
+  if (!file)
+    ereport(ERROR, (errcode_for_file_access(),
+                    errmsg("could not open pg_carbon dump \"%s\": %m", path)));
+
+  StringInfoData buf;
+  initStringInfo(&buf);
+  size_t nread;
+  do {
+    enlargeStringInfo(&buf, BLCKSZ);
+    nread = fread(buf.data + buf.len, 1, BLCKSZ, file);
+    buf.len += nread;
+  } while (nread == BLCKSZ);
+  buf.data[buf.len] = '\0';
+  if (ferror(file))
+    ereport(ERROR, (errcode_for_file_access(),
+                    errmsg("could not read pg_carbon dump \"%s\": %m", path)));
+  FreeFile(file);
+  return buf.data;
+}
+
+// Lookups a dump has no answer for get what a table that was never analyzed
+// would, rather than what the catalogs of this database say.
+class DumpCatalogProvider : public CatalogProvider {
+public:
+  TableMetadata *LoadTable(Oid table_oid) override {
+    elog(ERROR, "pg_carbon: table %u is not in the dump", table_oid);
+  }
+  int32 LoadColumnWidth(Oid, AttrNumber) override { return 0; }
+  ColumnStats LoadColumnStats(Oid, AttrNumber) override {
+    return ColumnStats();
+  }
+  bool LoadPartitionBoundsMatch(Oid, Oid) override { return false; }
+};
+
+static DumpCatalogProvider dump_provider;
+
+QueryDump::Contents QueryDump::Read(const char *path, const char *data) {
+  DumpReader reader(path, data);
+  Contents contents;
+  reader.Expect("pg_carbon");
+  reader.Expect("dump");
+  if (reader.Int() != kDumpVersion)
+    reader.Fail("unsupported version");
+
+  MetadataAccessor::ResetCache();
+  MetadataAccessor::TableCache *cache = MetadataAccessor::GetCache();
+  TableMetadata *table = nullptr;
+  while (true) {
+    char *record = pstrdup(reader.Word());
+    if (strcmp(record, "end") == 0)
+      break;
+
+    if (strcmp(record, "setting") == 0) {
+      contents.settings =
+          lappend(contents.settings, pstrdup(reader.Word()));
+      contents.settings =
+          lappend(contents.settings, pstrdup(reader.Word()));
+    } else if (strcmp(record, "upper_bound") == 0) {
+      contents.upper_bound = reader.Double();
+    } else if (strcmp(record, "query") == 0) {
+      contents.query = (Query *)reader.NodeTree();
+      if (!contents.query || !IsA(contents.query, Query))
+        reader.Fail("the query is not a Query");
+    } else if (strcmp(record, "table") == 0) {
+      Oid table_oid = reader.ObjectId();
+      table = new TableMetadata();
+      table->rows = reader.Double();
+      table->pages = reader.Double();
+      table->row_type = reader.ObjectId();
+      table->partitioned = reader.Int() != 0;
+      table->partition_strategy = (char)reader.Int();
+      cache->tables[table_oid] = table;
+    } else if (!table && strcmp(record, "width") != 0 &&
+               strcmp(record, "stats") != 0 &&
+               strcmp(record, "bounds_match") != 0) {
+      reader.Fail(psprintf("\"%s\" outside of a table", record));
+    } else if (strcmp(record, "column") == 0) {
+      ColumnMetadata column;
+      column.attnum = (AttrNumber)reader.Int();
+      column.type = reader.ObjectId();
+      column.typmod = (int32)reader.Int();
+      column.collation = reader.ObjectId();
+      table->columns.push_back(column);
+    } else if (strcmp(record, "unique_key") == 0) {
+      UniqueKey key;
+      for (int64 n = reader.Int(); n > 0; n--) {
+        key.columns.push_back((AttrNumber)reader.Int());
+        key.opfamilies.push_back(reader.ObjectId());
+      }
+      table->unique_keys.push_back(std::move(key));
+    } else if (strcmp(record, "index") == 0) {
+      IndexMetadata index;
+      index.oid = reader.ObjectId();
+      index.unique = reader.Int() != 0;
+      index.pages = reader.Double();
+      index.tuples = reader.Double();
+      index.tree_height = (int)reader.Int();
+      for (int64 n = reader.Int(); n > 0; n--) {
+        index.columns.push_back((AttrNumber)reader.Int());
+        index.opfamilies.push_back(reader.ObjectId());
+        index.collations.push_back(reader.ObjectId());
+        index.descending.push_back(reader.Int() != 0);
+        index.nulls_first.push_back(reader.Int() != 0);
+      }
+      table->indexes.push_back(std::move(index));
+    } else if (strcmp(record, "foreign_key") == 0) {
+      ForeignKey key;
+      key.referenced_table = reader.ObjectId();
+      for (int64 n = reader.Int(); n > 0; n--) {
+        key.columns.push_back((AttrNumber)reader.Int());
+        key.referenced_columns.push_back((AttrNumber)reader.Int());
+        key.operators.push_back(reader.ObjectId());
+      }
+      table->foreign_keys.push_back(std::move(key));
+    } else if (strcmp(record, "partition_key") == 0) {
+      for (int64 n = reader.Int(); n > 0; n--) {
+        table->partition_key.push_back((AttrNumber)reader.Int());
+        table->partition_opfamilies.push_back(reader.ObjectId());
+      }
+    } else if (strcmp(record, "partition") == 0) {
+      PartitionLeaf leaf;
+      leaf.relid = reader.ObjectId();
+      leaf.relkind = (char)reader.Int();
+      leaf.bound_index = (int)reader.Int();
+      leaf.constraint = (List *)reader.NodeTree();
+      table->partitions.push_back(leaf);
+    } else if (strcmp(record, "width") == 0) {
+      Oid table_oid = reader.ObjectId();
+      AttrNumber attnum = (AttrNumber)reader.Int();
+      cache->column_widths[MetadataAccessor::ColumnKey(table_oid, attnum)] =
+          (int32)reader.Int();
+    } else if (strcmp(record, "stats") == 0) {
+      Oid table_oid = reader.ObjectId();
+      AttrNumber attnum = (AttrNumber)reader.Int();
+      ColumnStats stats;
+      stats.ndistinct = reader.Double();
+      stats.null_frac = reader.Double();
+      stats.mcv_type = reader.ObjectId();
+      for (int64 n = reader.Int(); n > 0; n--)
+        stats.mcv_freqs.push_back(reader.Double());
+      ListCell *lc;
+      foreach (lc, (List *)reader.NodeTree())
+        stats.mcv_values.push_back(((Const *)lfirst(lc))->constvalue);
+      if (stats.mcv_values.size() != stats.mcv_freqs.size())
+        reader.Fail("MCV values and frequencies do not match");
+      cache->column_stats[MetadataAccessor::ColumnKey(table_oid, attnum)] =
+          std::move(stats);
+    } else if (strcmp(record, "bounds_match") == 0) {
+      Oid table_a = reader.ObjectId();
+      Oid table_b = reader.ObjectId();
+      cache->bounds_match[MetadataAccessor::TablePairKey(table_a, table_b)] =
+          reader.Int() != 0;
+    } else {
+      reader.Fail(psprintf("unknown record \"%s\"", record));
+    }
+    pfree(record);
+  }
+  if (!contents.query)
+    reader.Fail("no query");
+
+  MetadataAccessor::SetProvider(&dump_provider);
+  return contents;
+}
+
+// One replay of a dump; see pg_carbon_replay_dump()
+static double ReplayOnce(const QueryDump::Contents &contents,
+                         CarbonStats *stats, char **plan,
+                         Cost *total_cost) {
+  instr_time start, duration;
+
+  memset(stats, 0, sizeof(CarbonStats));
+  INSTR_TIME_SET_CURRENT(start);
+  Translator translator;
+  Optimizer optimizer(stats);
+  Operator *root_op = translator.TranslateQueryToCarbon(contents.query);
+  if (root_op)
+    optimizer.Optimize(root_op, translator.GetCteProducers(),
+                       contents.upper_bound);
+  else
+    stats->fallback = CARBON_FALLBACK_UNSUPPORTED;
+  INSTR_TIME_SET_CURRENT(duration);
+  INSTR_TIME_SUBTRACT(duration, start);
+  stats->time_ms = INSTR_TIME_GET_MILLISEC(duration);
+
+  // The winner of the root group, even if it lost to the upper bound
+  GroupExpression *best =
+      root_op ? optimizer.GetRootGroup()->GetBestExpression() : nullptr;
+  if (plan && best) {
+    std::ostringstream os;
+    optimizer.GetMemo()->PrintPlan(os, best);
+    *plan = pstrdup(os.str().c_str());
+    *total_cost = best->GetCost().total;
+  }
+  return stats->time_ms;
+}
+
+} // namespace pg_carbon
+
+extern "C" {
+void pg_carbon_replay_dump(const char *path, int iterations,
+                           bool dump_settings, CarbonReplay *result) {
+  MemoryContext caller = CurrentMemoryContext;
+  char *data = pg_carbon::QueryDump::ReadFile(path);
+  int nestlevel = -1;
+  double total_time = 0.0;
+
+  memset(result, 0, sizeof(CarbonReplay));
+  result->min_time_ms = DBL_MAX;
+  for (int i = 0; i < iterations; i++) {
+    // Each run gets a memory context of its own, so the memory counted is
+    // what a planning run would use.
+    MemoryContext context = AllocSetContextCreate(
+        caller, "pg_carbon replay", ALLOCSET_DEFAULT_SIZES);
+    MemoryContextSwitchTo(context);
+    pg_carbon::QueryDump::Contents contents =
+        pg_carbon::QueryDump::Read(path, data);
+
+    if (i == 0 && dump_settings) {
+      ListCell *lc;
+      nestlevel = NewGUCNestLevel();
+      for (lc = list_head(contents.settings); lc;
+           lc = lnext(contents.settings, lnext(contents.settings, lc))) {
+        ListCell *value = lnext(contents.settings, lc);
+        (void)set_config_option((char *)lfirst(lc), (char *)lfirst(value),
+                                PGC_USERSET, PGC_S_SESSION, GUC_ACTION_SAVE,
+                                true, 0, false);
+      }
+    }
+
+    char *plan = nullptr;
+    bool last = i == iterations - 1;
+    double time_ms = pg_carbon::ReplayOnce(contents, &result->stats,
+                                           last ? &plan : nullptr,
+                                           &result->total_cost);
+    total_time += time_ms;
+    result->min_time_ms = std::min(result->min_time_ms, time_ms);
+    result->max_time_ms = std::max(result->max_time_ms, time_ms);
+    if (plan)
+      result->plan = MemoryContextStrdup(caller, plan);
+
+    MemoryContextSwitchTo(caller);
+    pg_carbon::MetadataAccessor::ResetCache();
+    MemoryContextDelete(context);
+  }
+  result->mean_time_ms = total_time / iterations;
+
+  if (nestlevel >= 0)
+    AtEOXact_GUC(false, nestlevel);
+  pfree(data);
+}
+}
@@ -0,0 +1,51 @@
+#ifndef PG_CARBON_OPTIMIZER_DUMP_H
+#define PG_CARBON_OPTIMIZER_DUMP_H
+
+#include "../common/memory.h"
+
+// clang-format off
+extern "C" {
+#include "postgres.h"
+#include "nodes/parsenodes.h"
+#include "nodes/pg_list.h"
+}
+// clang-format on
+
+namespace pg_carbon {
+
+// A query dump (pg_carbon.dump_directory): the preprocessed query the
+// translator was given, the settings the search depends on, and everything
+// MetadataAccessor served while pg_carbon planned it. Replaying a dump runs
+// the translator and the search again without reading the catalogs for the
+// tables, so it works in any database with pg_carbon installed. Operators,
+// types and functions are still looked up in the catalogs of that database,
+// which have the built-in ones.
+//
+// The file is text: records of whitespace-separated fields, with node trees
+// in nodeToString() form behind their length.
+class QueryDump {
+public:
+  // A dump read back by Read()
+  struct Contents {
+    Query *query = nullptr;
+    double upper_bound = 0.0;
+    List *settings = NIL; // names and values, alternating
+  };
+
+  // Writes the dump of the query planned last to
+  // <pg_carbon.dump_directory>/pg_carbon_<query_id>.dump. `query` is
+  // nodeToString() of the preprocessed query. Failing to write is only a
+  // warning.
+  static void Write(uint64 query_id, const char *query, double upper_bound);
+
+  // Reads the file at `path` into memory
+  static char *ReadFile(const char *path);
+
+  // Parses a dump read by ReadFile(). MetadataAccessor's cache is filled
+  // from it, and what the dump lacks is not looked up in the catalogs.
+  static Contents Read(const char *path, const char *data);
+};
+
+} // namespace pg_carbon
+
+#endif // PG_CARBON_OPTIMIZER_DUMP_H
@@ -0,0 +1,181 @@
+#include "equivalence.h"
+
+extern "C" {
+#include "access/stratnum.h"
+#include "catalog/pg_type.h"
+#include "nodes/makefuncs.h"
+#include "nodes/nodeFuncs.h"
+#include "optimizer/optimizer.h"
+#include "utils/lsyscache.h"
+}
+
+namespace pg_carbon {
+
+static Node *StripRelabel(Node *node) {
+  while (node && IsA(node, RelabelType))
+    node = (Node *)((RelabelType *)node)->arg;
+  return node;
+}
+
+static bool SameMember(Node *a, Node *b) {
+  return equal(StripRelabel(a), StripRelabel(b));
+}
+
+// Splits `clause` into its operands if it can join a class
+static bool IsEquivalenceClause(Node *clause, Node **left, Node **right) {
+  if (!IsA(clause, OpExpr) || list_length(((OpExpr *)clause)->args) != 2)
+    return false;
+
+  OpExpr *opexpr = (OpExpr *)clause;
+  *left = (Node *)linitial(opexpr->args);
+  *right = (Node *)lsecond(opexpr->args);
+  if (!op_mergejoinable(opexpr->opno, exprType(*left)))
+    return false;
+
+  for (Node *operand : {*left, *right}) {
+    Node *stripped = StripRelabel(operand);
+    if (IsA(stripped, Var) && ((Var *)stripped)->varlevelsup == 0)
+      continue;
+    if (IsA(stripped, Const) && !((Const *)stripped)->constisnull)
+      continue;
+    return false;
+  }
+  // Two constants compare nothing
+  return IsA(StripRelabel(*left), Var) || IsA(StripRelabel(*right), Var);
+}
+
+EquivalenceClasses::EquivalenceClass *
+EquivalenceClasses::FindClass(Node *member) const {
+  for (EquivalenceClass *ec : classes_) {
+    for (Node *existing : ec->members) {
+      if (SameMember(existing, member))
+        return ec;
+    }
+  }
+  return nullptr;
+}
+
+bool EquivalenceClasses::HasClause(Node *left, Node *right) const {
+  for (const auto &clause : clauses_) {
+    if ((SameMember(clause.first, left) && SameMember(clause.second, right)) ||
+        (SameMember(clause.first, right) && SameMember(clause.second, left)))
+      return true;
+  }
+  return false;
+}
+
+void EquivalenceClasses::AddClause(Node *clause) {
+  Node *left;
+  Node *right;
+  if (!IsEquivalenceClause(clause, &left, &right) ||
+      contain_volatile_functions(clause))
+    return;
+
+  OpExpr *opexpr = (OpExpr *)clause;
+  List *opfamilies = get_mergejoin_opfamilies(opexpr->opno);
+  clauses_.emplace_back(left, right);
+
+  // Classes only merge if they agree on what "equal" means.
+  auto Compatible = [&](EquivalenceClass *ec) {
+    return equal(ec->opfamilies, opfamilies) &&
+           ec->collation == opexpr->inputcollid;
+  };
+
+  EquivalenceClass *merged = nullptr;
+  for (Node *operand : {left, right}) {
+    Node *stripped = StripRelabel(operand);
+    if (IsA(stripped, Const)) {
+      if (merged && !merged->constant)
+        merged->constant = (Const *)stripped;
+      continue;
+    }
+
+    EquivalenceClass *ec = FindClass(operand);
+    if (ec && !Compatible(ec))
+      return;
+    if (!ec) {
+      if (!merged) {
+        merged = new EquivalenceClass();
+        merged->opfamilies = opfamilies;
+        merged->collation = opexpr->inputcollid;
+        classes_.push_back(merged);
+      }
+      merged->members.push_back(operand);
+    } else if (!merged) {
+      merged = ec;
+    } else if (ec != merged) {
+      // Fold ec into merged
+      merged->members.insert(merged->members.end(), ec->members.begin(),
+                             ec->members.end());
+      if (!merged->constant)
+        merged->constant = ec->constant;
+      ec->members.clear();
+      ec->constant = nullptr;
+    }
+  }
+
+  // A leading constant (5 = x) is only seen before the class exists.
+  Node *stripped_left = StripRelabel(left);
+  if (merged && !merged->constant && IsA(stripped_left, Const))
+    merged->constant = (Const *)stripped_left;
+}
+
+// Equality operator comparing `member` with the class constant; it has to
+// exist for these exact input types.
+static Oid FindConstOperator(List *opfamilies, Node *member, Const *constant) {
+  ListCell *lc;
+  foreach (lc, opfamilies) {
+    Oid opno = get_opfamily_member(lfirst_oid(lc), exprType(member),
+                                   constant->consttype, BTEqualStrategyNumber);
+    if (OidIsValid(opno))
+      return opno;
+  }
+  return InvalidOid;
+}
+
+bool EquivalenceClasses::IsPinned(const EquivalenceClass *ec,
+                                  Node *member) const {
+  return HasClause(member, (Node *)ec->constant) ||
+         OidIsValid(FindConstOperator(ec->opfamilies, member, ec->constant));
+}
+
+List *EquivalenceClasses::GetImpliedClauses() const {
+  List *implied = NIL;
+
+  for (const EquivalenceClass *ec : classes_) {
+    if (!ec->constant || ec->members.size() < 2)
+      continue;
+
+    for (Node *member : ec->members) {
+      if (HasClause(member, (Node *)ec->constant))
+        continue;
+
+      Oid opno = FindConstOperator(ec->opfamilies, member, ec->constant);
+      if (!OidIsValid(opno))
+        continue;
+
+      Expr *clause = make_opclause(
+          opno, BOOLOID, false, (Expr *)copyObjectImpl(member),
+          (Expr *)copyObjectImpl(ec->constant), InvalidOid, ec->collation);
+      set_opfuncid((OpExpr *)clause);
+      implied = lappend(implied, clause);
+    }
+  }
+
+  return implied;
+}
+
+bool EquivalenceClasses::IsRedundant(Node *clause) const {
+  Node *left;
+  Node *right;
+  if (!IsEquivalenceClause(clause, &left, &right))
+    return false;
+  if (!IsA(StripRelabel(left), Var) || !IsA(StripRelabel(right), Var))
+    return false;
+
+  EquivalenceClass *ec = FindClass(left);
+  return ec && ec->constant && ec == FindClass(right) && IsPinned(ec, left) &&
+         IsPinned(ec, right);
+}
+
+} // namespace pg_carbon
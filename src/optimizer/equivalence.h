@@ -0,0 +1,57 @@
+#ifndef PG_CARBON_EQUIVALENCE_H
+#define PG_CARBON_EQUIVALENCE_H
+
+#include "../common/memory.h"
+
+// clang-format off
+extern "C" {
+#include "postgres.h"
+#include "nodes/primnodes.h"
+}
+// clang-format on
+
+namespace pg_carbon {
+
+// Equivalence classes over the equality conjuncts of one inner-join scope
+// (the WHERE clause together with the ON clauses of inner joins), in the
+// spirit of PG's equivclass.c but limited to what the search uses: once a
+// class contains a constant, every column in it can be compared with that
+// constant directly, so `a.x = b.x AND b.x = 5` also yields `a.x = 5` and
+// both scans can filter early.
+class EquivalenceClasses {
+public:
+  // Feeds one conjunct. Only mergejoinable equalities between columns and
+  // constants take part; everything else is ignored.
+  void AddClause(Node *clause);
+
+  // `column = constant` clauses implied by the classes that were not among
+  // the input clauses
+  List *GetImpliedClauses() const;
+
+  // True if `clause` equates two columns of a class that also has a
+  // constant. Once the constant comparisons are applied such a clause
+  // removes no further rows, which matters for its selectivity.
+  bool IsRedundant(Node *clause) const;
+
+private:
+  struct EquivalenceClass {
+    PgVector<Node *> members; // Vars, as written in the clauses
+    Const *constant = nullptr;
+    List *opfamilies = NIL;
+    Oid collation = InvalidOid;
+  };
+
+  EquivalenceClass *FindClass(Node *member) const;
+  bool HasClause(Node *left, Node *right) const;
+  // True if `member` is compared with the class constant, explicitly or by
+  // an implied clause
+  bool IsPinned(const EquivalenceClass *ec, Node *member) const;
+
+  PgVector<EquivalenceClass *> classes_;
+  // Input clauses as (left, right) operand pairs
+  PgVector<std::pair<Node *, Node *>> clauses_;
+};
+
+} // namespace pg_carbon
+
+#endif // PG_CARBON_EQUIVALENCE_H
@@ -0,0 +1,97 @@
+#ifndef PG_CARBON_INSTRUMENTATION_H
+#define PG_CARBON_INSTRUMENTATION_H
+
+// Counters of one pg_carbon planning run, filled in by the optimizer and
+// aggregated per query fingerprint by the extension. Plain C, as the
+// bridge reads it too.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include "postgres.h"
+#ifdef __cplusplus
+}
+#endif
+
+// Search tasks, by type
+typedef enum CarbonTaskType {
+  CARBON_TASK_O_GROUP,
+  CARBON_TASK_E_GROUP,
+  CARBON_TASK_O_EXPR,
+  CARBON_TASK_APPLY_RULE,
+  CARBON_TASK_O_INPUTS,
+  CARBON_NUM_TASK_TYPES
+} CarbonTaskType;
+
+// Why the standard planner planned the query instead
+typedef enum CarbonFallback {
+  CARBON_FALLBACK_NONE,
+  CARBON_FALLBACK_UNSUPPORTED, // the translator rejected the query
+  CARBON_FALLBACK_NO_PLAN,     // the search found no plan
+  CARBON_FALLBACK_NOT_CHEAPER, // no plan beat the seeded upper bound
+  CARBON_FALLBACK_EGEST,       // the plan could not be turned into PG's
+  CARBON_FALLBACK_ERROR,       // planning raised an error (shadow mode)
+  CARBON_NUM_FALLBACKS
+} CarbonFallback;
+
+// Rules are identified by their index in the rule set, which the
+// applied-rule mask of a GroupExpression limits to 64.
+#define CARBON_MAX_RULES 64
+
+typedef struct CarbonStats {
+  int64 tasks[CARBON_NUM_TASK_TYPES];
+  int64 rule_fires[CARBON_MAX_RULES];     // rule applications
+  int64 rule_successes[CARBON_MAX_RULES]; // ... that added an expression
+  int64 groups;
+  int64 expressions; // logical and physical
+  Size memory;       // most planner memory the search had allocated
+  int stage;         // highest search stage reached
+  bool exhausted;    // the search budget ran out
+  double time_ms;    // wall time of the whole pg_carbon run
+  CarbonFallback fallback;
+} CarbonStats;
+
+// Where a node of pg_carbon's plan comes from in the Memo
+typedef struct CarbonExplainNode {
+  const struct Plan *plan;
+  int group;           // Memo group of the expression the node was made from
+  double startup_cost; // ... and pg_carbon's estimates for it
+  double total_cost;
+  double rows;
+} CarbonExplainNode;
+
+// Renderings of a planning run for EXPLAIN (CARBON), made on request
+typedef struct CarbonExplain {
+  bool want_memo; // render the Memo too
+  char *plan;     // the chosen plan with pg_carbon's estimates, or NULL
+  char *memo;     // the Memo, or NULL
+  // The nodes of the plan pg_carbon egested, if it did
+  CarbonExplainNode *nodes;
+  int num_nodes;
+} CarbonExplain;
+
+// Outcome of replaying a dump (pg_carbon_replay_dump())
+typedef struct CarbonReplay {
+  char *plan;         // the chosen plan with pg_carbon's estimates, or NULL
+  double total_cost;  // ... and its cost
+  CarbonStats stats;  // counters of the last run
+  double min_time_ms; // translation and search, over the runs
+  double mean_time_ms;
+  double max_time_ms;
+} CarbonReplay;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Name of the rule with index `rule_id`, or NULL if there is none
+const char *pg_carbon_rule_name(int rule_id);
+
+// Name of a fallback reason, as shown by the stats views
+const char *pg_carbon_fallback_name(CarbonFallback fallback);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PG_CARBON_INSTRUMENTATION_H
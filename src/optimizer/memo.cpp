@@ -1,10 +1,36 @@
 #include "memo.h"
+#include <iomanip>
+
+extern "C" {
+#include "nodes/nodeFuncs.h"
+#include "optimizer/optimizer.h"
+}
 
 namespace pg_carbon {
 
+size_t GroupExpression::ComputeHash() const {
+  size_t hash = op_->Hash();
+  for (Group *child : children_)
+    hash = hash * 31 + static_cast<size_t>(child->GetId());
+  return hash;
+}
+
+bool GroupExpression::Equals(const GroupExpression *other) const {
+  return op_type_ == other->op_type_ && children_ == other->children_ &&
+         op_->Equals(other->op_);
+}
+
+bool Group::UpdateBestExpression(GroupExpression *expr) {
+  if (best_expression_ &&
+      best_expression_->GetCost().total <= expr->GetCost().total)
+    return false;
+  best_expression_ = expr;
+  return true;
+}
+
 void Group::AddExpression(GroupExpression *expr) {
   expr->SetGroup(this);
-  if (expr->GetOperator()->IsLogical()) {
+  if (expr->IsLogical()) {
     logical_exprs_.push_back(expr);
   } else {
     physical_exprs_.push_back(expr);
@@ -17,7 +43,7 @@ Group *Memo::InsertExpression(GroupExpression *expr) {
   // expressions.
 
   LogicalProperties *props = nullptr;
-  if (expr->GetOperator()->IsLogical()) {
+  if (expr->IsLogical()) {
     auto *log_op = static_cast<LogicalOperator *>(expr->GetOperator());
     // Step 1: Derive properties (Bottom-Up)
     props = log_op->DeriveLogicalProps(this, expr->GetChildren());
@@ -35,6 +61,33 @@ Group *Memo::InsertExpression(GroupExpression *expr) {
   return group;
 }
 
+GroupExpression *Memo::CopyIn(GroupExpression *expr, Group *target) {
+  // Physical expressions are generated once per logical expression (rules
+  // fire once), so only logical ones need duplicate detection. Only
+  // expressions of equal hash are compared.
+  if (expr->IsLogical()) {
+    size_t hash = expr->ComputeHash();
+    if (GroupExpression *const *first = expr_index_.Find(hash)) {
+      for (GroupExpression *it = *first; it; it = it->next_same_hash_) {
+        if (it->Equals(expr))
+          return it;
+      }
+      expr->next_same_hash_ = (*first)->next_same_hash_;
+      (*first)->next_same_hash_ = expr;
+    } else {
+      expr_index_.Insert(hash, expr);
+    }
+    expr->hash_ = hash;
+    expr->interned_ = true;
+  }
+
+  if (target)
+    target->AddExpression(expr);
+  else
+    InsertExpression(expr);
+  return expr;
+}
+
 Group *Memo::InitMemo(Operator *root_op) {
   if (!root_op)
     return nullptr;
@@ -45,11 +98,70 @@ Group *Memo::InitMemo(Operator *root_op) {
   }
 
   auto expr = new GroupExpression(root_op, child_groups);
-  return InsertExpression(expr);
+  return CopyIn(expr, nullptr)->GetGroup();
+}
+
+// Hash of an expression that equal() expressions share: the node types and
+// the fields that tell most expressions apart, equal() settling the rest
+static bool HashExprWalker(Node *node, size_t *hash) {
+  if (!node)
+    return false;
+  size_t h = static_cast<size_t>(nodeTag(node));
+  switch (nodeTag(node)) {
+  case T_Var: {
+    Var *var = (Var *)node;
+    h = (h * 31 + var->varno) * 31 + static_cast<size_t>(var->varattno);
+    h = h * 31 + var->varlevelsup;
+    break;
+  }
+  case T_Const:
+    h = h * 31 + ((Const *)node)->consttype;
+    break;
+  case T_Param:
+    h = h * 31 + static_cast<size_t>(((Param *)node)->paramid);
+    break;
+  case T_FuncExpr:
+    h = h * 31 + ((FuncExpr *)node)->funcid;
+    break;
+  case T_OpExpr:
+    h = h * 31 + ((OpExpr *)node)->opno;
+    break;
+  case T_Aggref:
+    h = h * 31 + ((Aggref *)node)->aggfnoid;
+    break;
+  case T_WindowFunc:
+    h = (h * 31 + ((WindowFunc *)node)->winfnoid) * 31 +
+        ((WindowFunc *)node)->winref;
+    break;
+  default:
+    break;
+  }
+  *hash = *hash * 31 + h;
+  return expression_tree_walker(node, HashExprWalker, hash);
+}
+
+Memo::ExprKey Memo::MakeExprKey(const void *producer, const Node *expr,
+                                int variant) {
+  ExprKey key{expr, producer, variant, false, 0};
+  key.by_address = contain_volatile_functions((Node *)expr);
+  if (key.by_address)
+    key.hash = std::hash<const Node *>()(expr);
+  else
+    HashExprWalker((Node *)expr, &key.hash);
+  key.hash ^= std::hash<const void *>()(producer) ^
+              static_cast<size_t>(variant);
+  return key;
+}
+
+bool Memo::ExprKey::operator==(const ExprKey &other) const {
+  if (producer != other.producer || variant != other.variant ||
+      by_address != other.by_address)
+    return false;
+  return by_address ? expr == other.expr : equal(expr, other.expr);
 }
 
 Group *Memo::NewGroup(LogicalProperties *props) {
-  Group *group = new Group();
+  Group *group = new Group(static_cast<int>(groups_.size()));
   if (props) {
     group->SetLogicalProperties(props);
   }
@@ -57,4 +169,54 @@ Group *Memo::NewGroup(LogicalProperties *props) {
   return group;
 }
 
+static void PrintEstimates(std::ostream &os, const GroupExpression *expr) {
+  const LogicalProperties *props = expr->GetGroup()->GetLogicalProperties();
+  os << std::fixed << std::setprecision(2) << "  (cost="
+     << expr->GetCost().startup << ".." << expr->GetCost().total;
+  if (props)
+    os << std::setprecision(0) << " rows=" << props->GetCardinality();
+  os << ")";
+}
+
+void Memo::PrintPlan(std::ostream &os, const GroupExpression *expr,
+                     int level) const {
+  for (int i = 0; i < level; ++i) {
+    os << "  ";
+  }
+  if (level > 0) {
+    os << "-> ";
+  }
+  os << expr->GetOperator()->ToString();
+  PrintEstimates(os, expr);
+  os << "\n";
+  for (const Group *child : expr->GetChildren()) {
+    if (child->GetBestExpression())
+      PrintPlan(os, child->GetBestExpression(), level + 1);
+  }
+}
+
+void Memo::Print(std::ostream &os) const {
+  auto PrintExpression = [&](const GroupExpression *expr) {
+    os << (expr == expr->GetGroup()->GetBestExpression() ? "  * " : "    ")
+       << expr->GetOperator()->ToString();
+    if (!expr->GetChildren().empty()) {
+      os << " [";
+      for (size_t i = 0; i < expr->GetChildren().size(); i++)
+        os << (i ? " " : "") << expr->GetChildren()[i]->GetId();
+      os << "]";
+    }
+    if (expr->HasCost())
+      PrintEstimates(os, expr);
+    os << "\n";
+  };
+
+  for (const Group *group : groups_) {
+    os << "Group " << group->GetId() << "\n";
+    for (const GroupExpression *expr : group->GetLogicalExpressions())
+      PrintExpression(expr);
+    for (const GroupExpression *expr : group->GetPhysicalExpressions())
+      PrintExpression(expr);
+  }
+}
+
 } // namespace pg_carbon
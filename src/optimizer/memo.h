@@ -10,102 +10,106 @@ extern "C" {
 #include "../common/memory.h"
 #include "../operators/operators.h"
 #include "column.h"
-#include <algorithm> // For std::min
 #include <cstddef>
 #include <cstdint>
 
 namespace pg_carbon {
 
-// Wrapper around PgVector<bool> to serve as ColSet (Decoupled from PG
-// Bitmapset)
-class ColSet : public PgObject {
-public:
-  ColSet() = default;
-
-  void Add(int col_id) {
-    if (col_id < 0)
-      return;
-    if (static_cast<size_t>(col_id) >= bits_.size()) {
-      bits_.resize(col_id + 1, false);
-    }
-    bits_[col_id] = true;
-  }
-
-  void Union(const ColSet &other) {
-    if (other.bits_.size() > bits_.size()) {
-      bits_.resize(other.bits_.size(), false);
-    }
-    for (size_t i = 0; i < other.bits_.size(); ++i) {
-      if (other.bits_[i]) {
-        bits_[i] = true;
-      }
-    }
-  }
-
-  bool IsSubset(const ColSet &other) const {
-    // return true if *this* is a subset of *other*
-    if (bits_.size() > other.bits_.size()) {
-      // If we have bits beyond other's size, check if any are set
-      for (size_t i = other.bits_.size(); i < bits_.size(); ++i) {
-        if (bits_[i])
-          return false;
-      }
-    }
-    size_t check_len = std::min(bits_.size(), other.bits_.size());
-    for (size_t i = 0; i < check_len; ++i) {
-      if (bits_[i] && !other.bits_[i])
-        return false;
-    }
-    return true;
-  }
-
-  static ColSet MakeSingleton(int col_id) {
-    ColSet s;
-    s.Add(col_id);
-    return s;
-  }
-
-  // Helper to iterate (if needed by implementation)
-  // For now internal representation is simple vector
-
-private:
-  PgVector<bool> bits_;
-};
-
 class Group;
 class Memo;
 
+// Estimated cost of a physical plan, in PG planner units. As in PG, the
+// startup cost is what is spent before the first row comes out.
+struct PlanCost {
+  double startup = 0.0;
+  double total = 0.0;
+};
+
+// The search visits expressions far more often than their operators: the
+// operator's type and the input groups are kept in the expression itself,
+// so matching rules and walking the Memo need not load the operator.
 class GroupExpression : public PgObject {
 public:
-  GroupExpression(Operator *op, PgVector<Group *> children)
-      : op_(op), children_(children), group_(nullptr) {}
+  GroupExpression(Operator *op, const GroupInputs &children)
+      : op_(op), children_(children), group_(nullptr),
+        op_type_(op->GetType()), logical_(op->IsLogical()) {}
 
   void SetGroup(Group *group) { group_ = group; }
   Group *GetGroup() const { return group_; }
   Operator *GetOperator() const { return op_; }
-  const PgVector<Group *> &GetChildren() const { return children_; }
+  OperatorType GetOperatorType() const { return op_type_; }
+  bool IsLogical() const { return logical_; }
+  const GroupInputs &GetChildren() const { return children_; }
+
+  // Operator identity combined with the child groups. Rules may still set
+  // up the operator until it is copied into the Memo; CopyIn() then stores
+  // the hash, and later calls return it.
+  size_t Hash() const { return interned_ ? hash_ : ComputeHash(); }
+  bool Equals(const GroupExpression *other) const;
+
+  // Every rule fires at most once per expression.
+  bool HasAppliedRule(int rule_id) const {
+    return (applied_rules_ >> rule_id) & 1;
+  }
+  void SetAppliedRule(int rule_id) { applied_rules_ |= uint64_t(1) << rule_id; }
+  void ClearAppliedRule(int rule_id) {
+    applied_rules_ &= ~(uint64_t(1) << rule_id);
+  }
+
+  // Cumulative cost, set once all inputs have been optimized
+  void SetCost(const PlanCost &cost) {
+    cost_ = cost;
+    has_cost_ = true;
+  }
+  const PlanCost &GetCost() const { return cost_; }
+  bool HasCost() const { return has_cost_; }
+  void ResetCost() { has_cost_ = false; }
 
 private:
+  friend class Memo;
+  size_t ComputeHash() const;
+
   Operator *op_;
-  PgVector<Group *> children_;
+  GroupInputs children_;
   Group *group_; // Back pointer to the group this expression belongs to
+  // The next interned expression with the same hash
+  GroupExpression *next_same_hash_ = nullptr;
+  size_t hash_ = 0;
+  uint64_t applied_rules_ = 0;
+  PlanCost cost_;
+  OperatorType op_type_;
+  bool logical_;
+  bool has_cost_ = false;
+  bool interned_ = false;
 };
 
 class LogicalProperties : public PgObject {
 public:
-  LogicalProperties(ColSet output_columns, double cardinality)
-      : output_columns_(std::move(output_columns)), cardinality_(cardinality) {}
+  LogicalProperties(ColSet output_columns, ColSet relids, double cardinality,
+                    double width = 0.0)
+      : output_columns_(std::move(output_columns)),
+        relids_(std::move(relids)), cardinality_(cardinality), width_(width) {}
 
   const ColSet &GetOutputColumns() const { return output_columns_; }
+  // Range table indexes of the base relations below this group
+  const ColSet &GetRelids() const { return relids_; }
   double GetCardinality() const { return cardinality_; }
+  // Estimated average output tuple width in bytes
+  double GetWidth() const { return width_; }
 
 private:
   ColSet output_columns_; // Schema (ColSet)
-  double cardinality_;    // Statistics
+  ColSet relids_;
+  double cardinality_; // Statistics
+  double width_;
 };
 
 class Group : public PgObject {
 public:
+  explicit Group(int id) : id_(id) {}
+
+  int GetId() const { return id_; }
+
   void AddExpression(GroupExpression *expr);
   const PgVector<GroupExpression *> &GetLogicalExpressions() const {
     return logical_exprs_;
@@ -120,12 +124,14 @@ public:
   void SetImplemented(bool implemented) { implemented_ = implemented; }
   bool IsImplemented() const { return implemented_; }
 
-  // For simplicity in this skeleton, we just store the best plan directly.
-  // In a real optimizer, this would be a map of RequiredProperties -> Best
-  // Plan.
+  // Cheapest costed physical expression seen so far. In a real optimizer,
+  // this would be a map of RequiredProperties -> Best Plan.
   void SetBestExpression(GroupExpression *expr) { best_expression_ = expr; }
   GroupExpression *GetBestExpression() const { return best_expression_; }
 
+  // Replaces the winner if `expr` is cheaper. Returns true if it did.
+  bool UpdateBestExpression(GroupExpression *expr);
+
   void SetLogicalProperties(LogicalProperties *props) {
     logical_properties_ = props;
   }
@@ -134,6 +140,7 @@ public:
   }
 
 private:
+  int id_;
   PgVector<GroupExpression *> logical_exprs_;
   PgVector<GroupExpression *> physical_exprs_;
   bool explored_ = false;
@@ -146,13 +153,69 @@ class Memo : public PgObject {
 public:
   Group *InsertExpression(GroupExpression *expr);
   Group *InitMemo(Operator *root_op);
+
+  // Adds `expr` to `target`, or to a new group when target is nullptr,
+  // unless the Memo already holds an identical logical expression. Returns
+  // the expression that ends up in the Memo, so callers can tell whether
+  // `expr` was new.
+  GroupExpression *CopyIn(GroupExpression *expr, Group *target);
+
   Group *NewGroup(LogicalProperties *props = nullptr);
   const PgVector<Group *> &GetGroups() const { return groups_; }
 
-  int AddColumn(CarbonColumn *col) {
-    col->SetId(columns_.size());
-    columns_.push_back(col);
-    return col->GetId();
+  // Renders the plan of `expr` over the winners of its input groups, in the
+  // shape of Operator::Print, with pg_carbon's estimates
+  void PrintPlan(std::ostream &os, const GroupExpression *expr,
+                 int level = 0) const;
+  // Renders every group with its expressions: input group ids, costs, and
+  // which expression wins
+  void Print(std::ostream &os) const;
+
+  // Root group of the shared plan of the CTE at position `cte` of the
+  // query's cteList, which LogicalCteScan reads; nullptr if it has none
+  void SetCteProducer(int cte, Group *group) {
+    if (static_cast<size_t>(cte) >= cte_producers_.size())
+      cte_producers_.resize(cte + 1, nullptr);
+    cte_producers_[cte] = group;
+  }
+  Group *GetCteProducer(int cte) const {
+    return static_cast<size_t>(cte) < cte_producers_.size()
+               ? cte_producers_[cte]
+               : nullptr;
+  }
+
+  // Columns are registered once per query, however often the operators
+  // producing them derive their properties, so equivalent expressions see
+  // the same ids. Column `attr_num` of range table entry `rt_index` (a
+  // table, set operation or CTE reference) is one column, and so is each
+  // expression an operator computes, told apart by `variant` where the
+  // operator computes it in several forms. `producer` identifies the
+  // operator, and the copies rules make of it: equal expressions of two
+  // operators, such as the count(*) of two aggregations, are two values.
+  // Expressions are compared with equal(), so copies of one are one column,
+  // except volatile ones: those are compared by address, as two calls of
+  // random() are two columns. Find*() return -1 for columns not registered
+  // yet.
+  int FindRelationColumn(Index rt_index, AttrNumber attr_num) const {
+    const int *id = relation_columns_.Find(RelationKey(rt_index, attr_num));
+    return id ? *id : -1;
+  }
+  int AddRelationColumn(Index rt_index, AttrNumber attr_num,
+                        CarbonColumn *col) {
+    int id = AddColumn(col);
+    relation_columns_.Insert(RelationKey(rt_index, attr_num), id);
+    return id;
+  }
+  int FindExprColumn(const void *producer, const Node *expr,
+                     int variant = 0) const {
+    const int *id = expr_columns_.Find(MakeExprKey(producer, expr, variant));
+    return id ? *id : -1;
+  }
+  int AddExprColumn(const void *producer, const Node *expr, int variant,
+                    CarbonColumn *col) {
+    int id = AddColumn(col);
+    expr_columns_.Insert(MakeExprKey(producer, expr, variant), id);
+    return id;
   }
 
   CarbonColumn *GetColumn(int id) const {
@@ -162,11 +225,49 @@ public:
     return nullptr;
   }
 
+  // Sum of the average widths of the given columns
+  double GetTupleWidth(const ColSet &cols) const {
+    double width = 0.0;
+    cols.ForEach([&](int col_id) {
+      if (CarbonColumn *col = GetColumn(col_id))
+        width += col->GetWidth();
+    });
+    return width;
+  }
+
 private:
+  int AddColumn(CarbonColumn *col) {
+    col->SetId(columns_.size());
+    columns_.push_back(col);
+    return col->GetId();
+  }
+
+  static uint64 RelationKey(Index rt_index, AttrNumber attr_num) {
+    return (uint64)rt_index << 16 | (uint16)attr_num;
+  }
+  // An expression column; `hash` is structural unless `by_address`
+  struct ExprKey {
+    const Node *expr;
+    const void *producer;
+    int variant;
+    bool by_address;
+    size_t hash;
+    bool operator==(const ExprKey &other) const;
+  };
+  struct ExprKeyHash {
+    size_t operator()(const ExprKey &key) const { return key.hash; }
+  };
+  static ExprKey MakeExprKey(const void *producer, const Node *expr,
+                             int variant);
+
   PgVector<Group *> groups_;
   PgVector<CarbonColumn *> columns_;
-  // In a real implementation, we would have a hash map to detect duplicate
-  // expressions.
+  PgFlatMap<uint64, int> relation_columns_;
+  PgFlatMap<ExprKey, int, ExprKeyHash> expr_columns_;
+  PgVector<Group *> cte_producers_;
+  // The first logical expression with each GroupExpression::Hash(); the
+  // others with that hash follow it through next_same_hash_
+  PgFlatMap<size_t, GroupExpression *> expr_index_;
 };
 
 } // namespace pg_carbon
@@ -1,66 +1,184 @@
 #include "optimizer.h"
+#include "../metadata/metadata.h"
+#include "dump.h"
 #include "memo.h"
 #include "preprocess.h"
 #include "scheduler.h"
+#include "setrefs.h"
 #include "translator.h"
+#include <sstream>
 
 extern "C" {
 #include "access/htup_details.h"
 #include "catalog/pg_aggregate.h"
 #include "catalog/pg_type.h"
 #include "nodes/nodeFuncs.h"
+#include "nodes/nodes.h"
 #include "parser/parse_agg.h"
+#include "portability/instr_time.h"
 #include "utils/lsyscache.h"
+#include "utils/memutils.h"
 #include "utils/syscache.h"
 }
 
 namespace pg_carbon {
 
+// Searches `group` in `context` in stages, escalating while its best plan
+// costs more than the stage's limit, and completes it if the budget runs
+// out.
+static void OptimizeGroup(TaskScheduler *scheduler, Group *group,
+                          Context *context) {
+  const double stage_limits[] = {pg_carbon_stage0_cost_limit,
+                                 pg_carbon_stage1_cost_limit};
+  scheduler->SetStage(0);
+  scheduler->ScheduleTask(new O_Group(group, context));
+  scheduler->Run();
+  while (!scheduler->IsExhausted() &&
+         scheduler->GetStage() + 1 < TaskScheduler::kNumStages &&
+         (!group->GetBestExpression() ||
+          group->GetBestExpression()->GetCost().total >
+              stage_limits[scheduler->GetStage()])) {
+    scheduler->Escalate(group, context);
+    scheduler->Run();
+  }
+  if (scheduler->IsExhausted())
+    scheduler->Complete(group);
+}
+
+// Queries on a single plain table with at most one Filter, under any of
+// Projection, Sort and Limit. No rewrite applies to them, so the cheapest
+// implementation of the tree as written is the best plan.
+static bool IsSingleTableQuery(const Operator *op) {
+  bool filtered = false;
+  while (op->GetType() != OperatorType::LOGICAL_GET) {
+    switch (op->GetType()) {
+    case OperatorType::LOGICAL_FILTER:
+      if (filtered)
+        return false;
+      filtered = true;
+      break;
+    case OperatorType::LOGICAL_PROJECTION:
+    case OperatorType::LOGICAL_SORT:
+    case OperatorType::LOGICAL_LIMIT:
+      break;
+    default:
+      return false;
+    }
+    op = op->GetInputs()[0];
+  }
+  return true;
+}
+
 // Optimize: Carbon Operator Tree (Root) -> Best Carbon Physical Plan
-GroupExpression *Optimizer::Optimize(Operator *root_op) {
-  // 1. Initialize Memo with the operator tree
-  Group *root_group = memo_.InitMemo(root_op);
+GroupExpression *Optimizer::Optimize(Operator *root_op,
+                                     const PgVector<Operator *> &ctes,
+                                     double upper_bound) {
+  // 1. Initialize Scheduler. Once the budget is used up the search stops,
+  // and groups still without a plan get the first one that can be found.
+  SearchBudget budget;
+  budget.time_us = pg_carbon_search_time_budget;
+  budget.tasks = pg_carbon_search_task_budget;
+  budget.memory = (Size)pg_carbon_memo_memory_budget * 1024;
+  TaskScheduler scheduler(&memo_, budget, stats_);
 
-  // 2. Initialize Scheduler
-  TaskScheduler scheduler;
+  // 2. Optimize the shared plans of CTEs first: the cost of reading one
+  // depends on the plan's, and so does the row count of the reference.
+  for (size_t i = 0; i < ctes.size(); i++) {
+    if (!ctes[i])
+      continue;
+    Group *cte_group = memo_.InitMemo(ctes[i]);
+    memo_.SetCteProducer(i, cte_group);
+    OptimizeGroup(&scheduler, cte_group, nullptr);
+  }
 
-  // 3. Schedule optimization of the root group
-  // In a real system, we would pass required properties (e.g., sort order).
-  scheduler.ScheduleTask(new O_Group(root_group, nullptr));
+  // 3. Initialize Memo with the operator tree
+  Group *root_group = memo_.InitMemo(root_op);
+  root_group_ = root_group;
 
-  // 4. Run Scheduler
-  scheduler.Run();
+  // Fast path: single-table queries skip the search. Completing the root
+  // still costs every implementation of each operator, such as the index
+  // scans and the sequential scan of a filtered table.
+  if (pg_carbon_single_table_fast_path && IsSingleTableQuery(root_op)) {
+    scheduler.Complete(root_group);
+  } else {
+    // 4. Optimize the root group
+    // In a real system, we would pass required properties (e.g., sort
+    // order).
+    OptimizeGroup(&scheduler, root_group, new Context(upper_bound));
+  }
 
   // 5. Extract best plan
   // In a real system, we extract based on required properties.
-  // Here we just take the best expression stored in the group.
+  // Here we just take the cheapest expression of the root group.
   auto best_expr = root_group->GetBestExpression();
+  bool cheaper = best_expr && best_expr->GetCost().total < upper_bound;
 
-  return best_expr;
+  if (stats_) {
+    stats_->groups = memo_.GetGroups().size();
+    for (const Group *group : memo_.GetGroups())
+      stats_->expressions += group->GetLogicalExpressions().size() +
+                             group->GetPhysicalExpressions().size();
+    stats_->memory = scheduler.GetPeakMemory();
+    if (!best_expr)
+      stats_->fallback = CARBON_FALLBACK_NO_PLAN;
+    else if (!cheaper)
+      stats_->fallback = CARBON_FALLBACK_NOT_CHEAPER;
+  }
+  return cheaper ? best_expr : nullptr;
 }
 
-} // namespace pg_carbon
-
-extern "C" {
-Plan *pg_carbon_optimize_query(Query *parse, int cursorOptions,
-                               ParamListInfo boundParams) {
-  // We ignore cursorOptions and boundParams for this skeleton
+// Plans the query; see pg_carbon_optimize_query(). If `dump_query` is
+// given, it is set to the preprocessed query for a dump.
+static Plan *PlanQuery(Query *original_parse, ParamListInfo boundParams,
+                       Cost upper_bound, Query **planned_query,
+                       List **param_exec_types, List **subplans,
+                       CarbonStats *stats, CarbonExplain *explain,
+                       char **dump_query) {
+  // Preprocessing rewrites the query in place. Work on a copy so the
+  // standard planner still gets the original if we have to fall back.
+  Query *parse = (Query *)copyObjectImpl(original_parse);
+  MetadataAccessor::ResetCache();
 
-  // 0. Preprocess TargetList and Aggregates
-  pg_carbon::Preprocess::PreprocessTargetList(parse);
+  // 0. Preprocess TargetList, sublinks, join aliases, expressions, CTEs and
+  // set operations
+  Preprocess::PreprocessTargetList(parse);
+  Preprocess::PullUpSublinks(parse);
+  Preprocess::FlattenJoinAliasVars(parse);
+  Preprocess::PreprocessExpressions(parse, boundParams);
+  Preprocess::ReduceOuterJoins(parse);
+  Preprocess::PreprocessCtes(parse, boundParams);
+  Preprocess::FlattenSetOperations(parse, boundParams);
+  if (dump_query)
+    *dump_query = nodeToString(parse);
 
   // 1. Translate PG Query -> Carbon Operator Tree
-  pg_carbon::Translator translator;
-  pg_carbon::Operator *root_op = translator.TranslateQueryToCarbon(parse);
+  Translator translator;
+  Operator *root_op = translator.TranslateQueryToCarbon(parse);
 
   if (!root_op) {
-    // Fallback or error
+    stats->fallback = CARBON_FALLBACK_UNSUPPORTED;
     return nullptr;
   }
 
   // 2. Optimization
-  pg_carbon::Optimizer optimizer;
-  pg_carbon::GroupExpression *best_plan = optimizer.Optimize(root_op);
+  Optimizer optimizer(stats);
+  GroupExpression *best_plan =
+      optimizer.Optimize(root_op, translator.GetCteProducers(), upper_bound);
+
+  if (explain) {
+    // The winner of the root group, even if it lost to the upper bound
+    Group *root_group = optimizer.GetRootGroup();
+    std::ostringstream os;
+    if (root_group->GetBestExpression()) {
+      optimizer.GetMemo()->PrintPlan(os, root_group->GetBestExpression());
+      explain->plan = pstrdup(os.str().c_str());
+    }
+    if (explain->want_memo) {
+      os.str("");
+      optimizer.GetMemo()->Print(os);
+      explain->memo = pstrdup(os.str().c_str());
+    }
+  }
 
   if (!best_plan) {
     return nullptr;
@@ -70,14 +188,105 @@ Plan *pg_carbon_optimize_query(Query *parse, int cursorOptions,
   Plan *plan =
       translator.TranslatePlanToPG(optimizer.GetMemo(), best_plan, parse);
 
-  // Fix Aggref variables in the final plan
-  // We need to traverse the plan to find Agg nodes, or just fix the root if we
-  // know it's Agg. For now, let's fix the root's targetlist and qual if it has
-  // them. Actually, FixVarsToOuter expects minimal Node* (TargetList or
-  // expression). TranslatePlanToPG already called it on the specific Agg node
-  // targetlist. Since we saw targetlist pointer change, we need to apply it to
-  // the CURRENT targetlist of the plan.
+  // 4. Resolve Vars above the scans into references to the node inputs.
+  // The CTEs scanned are InitPlans of the top node.
+  if (!plan || !SetRefs::SetPlanReferences(plan, translator.GetSubplans())) {
+    stats->fallback = CARBON_FALLBACK_EGEST;
+    return nullptr;
+  }
+  plan->initPlan = translator.GetInitPlans();
+
+  if (explain) {
+    const auto &plan_exprs = translator.GetPlanExpressions();
+    explain->nodes = static_cast<CarbonExplainNode *>(
+        palloc(plan_exprs.size() * sizeof(CarbonExplainNode)));
+    for (const auto &plan_expr : plan_exprs) {
+      const GroupExpression *expr = plan_expr.second;
+      const LogicalProperties *props =
+          expr->GetGroup()->GetLogicalProperties();
+      CarbonExplainNode *entry = &explain->nodes[explain->num_nodes++];
+      entry->plan = plan_expr.first;
+      entry->group = expr->GetGroup()->GetId();
+      entry->startup_cost = expr->GetCost().startup;
+      entry->total_cost = expr->GetCost().total;
+      entry->rows = props ? props->GetCardinality() : 0;
+    }
+  }
+
+  *planned_query = parse;
+  *param_exec_types = translator.GetParamExecTypes();
+  *subplans = translator.GetSubplans();
+  return plan;
+}
+
+} // namespace pg_carbon
+
+extern "C" {
+// The settings live here rather than with their GUC definitions in lib.c so
+// that the optimizer also links without the extension, as in the
+// benchmarks.
+
+// Search budgets; 0 disables a budget
+int pg_carbon_search_time_budget = 1000000;
+int pg_carbon_search_task_budget = 0;
+int pg_carbon_memo_memory_budget = 0;
+// Plan costs above which the search moves on from stage 0 and stage 1
+double pg_carbon_stage0_cost_limit = 100.0;
+double pg_carbon_stage1_cost_limit = 10000.0;
+// Whether single-table queries skip the search
+bool pg_carbon_single_table_fast_path = true;
+// Where planning runs are dumped for pg_carbon_replay(), and how long they
+// have to take to be dumped
+char *pg_carbon_dump_directory = NULL;
+int pg_carbon_dump_min_duration = 0;
+
+Plan *pg_carbon_optimize_query(Query *original_parse, int cursorOptions,
+                               ParamListInfo boundParams, Cost upper_bound,
+                               Query **planned_query,
+                               List **param_exec_types, List **subplans,
+                               CarbonStats *stats, CarbonExplain *explain) {
+  // We ignore cursorOptions for this skeleton
+  instr_time start, duration;
+  bool dump = pg_carbon_dump_directory && pg_carbon_dump_directory[0];
+  char *dump_query = NULL;
 
+  memset(stats, 0, sizeof(CarbonStats));
+  INSTR_TIME_SET_CURRENT(start);
+  Plan *plan =
+      pg_carbon::PlanQuery(original_parse, boundParams, upper_bound,
+                           planned_query, param_exec_types, subplans, stats,
+                           explain, dump ? &dump_query : NULL);
+  INSTR_TIME_SET_CURRENT(duration);
+  INSTR_TIME_SUBTRACT(duration, start);
+  stats->time_ms = INSTR_TIME_GET_MILLISEC(duration);
+
+  // The metadata cache still holds what the run looked up.
+  if (dump_query && stats->time_ms >= pg_carbon_dump_min_duration)
+    pg_carbon::QueryDump::Write(original_parse->queryId, dump_query,
+                                upper_bound);
   return plan;
 }
+
+const char *pg_carbon_rule_name(int rule_id) {
+  return pg_carbon::TaskScheduler::GetRuleName(rule_id);
+}
+
+const char *pg_carbon_fallback_name(CarbonFallback fallback) {
+  switch (fallback) {
+  case CARBON_FALLBACK_NONE:
+    return "none";
+  case CARBON_FALLBACK_UNSUPPORTED:
+    return "unsupported";
+  case CARBON_FALLBACK_NO_PLAN:
+    return "no plan";
+  case CARBON_FALLBACK_NOT_CHEAPER:
+    return "not cheaper";
+  case CARBON_FALLBACK_EGEST:
+    return "plan conversion failed";
+  case CARBON_FALLBACK_ERROR:
+    return "error";
+  default:
+    return "unknown";
+  }
+}
 }
@@ -13,21 +13,36 @@ struct _dummy;
 }
 #endif
 
+#include "instrumentation.h"
+
 #ifdef __cplusplus
 #include "../common/memory.h"
 #include "memo.h"
+#include <cfloat>
 
 namespace pg_carbon {
 
 class Optimizer : public PgObject {
 public:
-  // Optimize: Carbon Operator Tree (Root) -> Best Carbon Physical Plan
-  GroupExpression *Optimize(Operator *root_op);
+  // Counts the search and its outcome in `stats`, if given
+  explicit Optimizer(CarbonStats *stats = nullptr) : stats_(stats) {}
+
+  // Optimize: Carbon Operator Tree (Root) -> Best Carbon Physical Plan.
+  // `ctes` are the shared plans of the query's CTEs
+  // (Translator::GetCteProducers()). Returns nullptr unless the plan costs
+  // less than `upper_bound`.
+  GroupExpression *Optimize(Operator *root_op,
+                            const PgVector<Operator *> &ctes = {},
+                            double upper_bound = DBL_MAX);
 
   Memo *GetMemo() { return &memo_; }
+  // Group of the query's root operator, once Optimize() has built it
+  Group *GetRootGroup() const { return root_group_; }
 
 private:
   Memo memo_;
+  CarbonStats *stats_;
+  Group *root_group_ = nullptr;
 };
 
 } // namespace pg_carbon
@@ -36,8 +51,38 @@ private:
 #ifdef __cplusplus
 extern "C" {
 #endif
+// GUCs pg_carbon.search_time_budget (microseconds),
+// pg_carbon.search_task_budget and pg_carbon.memo_memory_budget (kB)
+extern int pg_carbon_search_time_budget;
+extern int pg_carbon_search_task_budget;
+extern int pg_carbon_memo_memory_budget;
+// GUCs pg_carbon.stage0_cost_limit and pg_carbon.stage1_cost_limit
+extern double pg_carbon_stage0_cost_limit;
+extern double pg_carbon_stage1_cost_limit;
+// GUC pg_carbon.single_table_fast_path
+extern bool pg_carbon_single_table_fast_path;
+// GUCs pg_carbon.dump_directory and pg_carbon.dump_min_duration (ms)
+extern char *pg_carbon_dump_directory;
+extern int pg_carbon_dump_min_duration;
+
+// Plans `parse`, or returns NULL if the standard planner has to, which
+// includes finding no plan cheaper than `upper_bound` (DBL_MAX for no
+// bound). The plan refers to the range table of *planned_query, the
+// preprocessed copy of `parse` it was built from, to PARAM_EXEC parameters
+// of the types in *param_exec_types and to the CTE plans in *subplans.
+// *stats is set to the counters of the run, including the reason for
+// returning NULL, and *explain, if given, to the renderings of the search.
 Plan *pg_carbon_optimize_query(Query *parse, int cursorOptions,
-                               ParamListInfo boundParams);
+                               ParamListInfo boundParams, Cost upper_bound,
+                               Query **planned_query,
+                               List **param_exec_types, List **subplans,
+                               CarbonStats *stats, CarbonExplain *explain);
+
+// Translates and optimizes the query of the dump at `path` `iterations`
+// times, with the settings it was planned with if `dump_settings`, and
+// describes the outcome in *result.
+void pg_carbon_replay_dump(const char *path, int iterations,
+                           bool dump_settings, CarbonReplay *result);
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,159 @@
+#include "ordering.h"
+#include "../metadata/metadata.h"
+
+extern "C" {
+#include "access/stratnum.h"
+#include "nodes/makefuncs.h"
+#include "nodes/nodeFuncs.h"
+#include "postgres.h"
+#include "utils/lsyscache.h"
+#include "utils/typcache.h"
+}
+
+namespace pg_carbon {
+
+// Nulling markers aside, as in SetRefs: the orders passed up are those of
+// the preserved side of joins.
+static bool SameKeyExpr(Node *a, Node *b) {
+  if (IsA(a, Var) && IsA(b, Var))
+    return ((Var *)a)->varno == ((Var *)b)->varno &&
+           ((Var *)a)->varattno == ((Var *)b)->varattno &&
+           ((Var *)a)->varlevelsup == ((Var *)b)->varlevelsup;
+  return equal(a, b);
+}
+
+int Ordering::PresortedKeys(const SortKeyList &delivered,
+                            const SortKeyList &required) {
+  size_t n = 0;
+  while (n < delivered.size() && n < required.size() &&
+         delivered[n].sortop == required[n].sortop &&
+         delivered[n].nulls_first == required[n].nulls_first &&
+         SameKeyExpr(delivered[n].expr, required[n].expr))
+    n++;
+  return static_cast<int>(n);
+}
+
+int Ordering::PresortedKeys(const Group *input, const SortKeyList &required) {
+  const GroupExpression *best = input->GetBestExpression();
+  return best ? PresortedKeys(Delivered(best), required) : 0;
+}
+
+Oid Ordering::MergeOpfamily(Oid opno) {
+  ListCell *lc;
+  foreach (lc, get_mergejoin_opfamilies(opno)) {
+    if (get_op_opfamily_strategy(opno, lfirst_oid(lc)) ==
+        BTEqualStrategyNumber)
+      return lfirst_oid(lc);
+  }
+  return InvalidOid;
+}
+
+// A forward scan of a btree index returns the rows in index order: each
+// column ascending or descending, with NULLs where the index keeps them.
+// The order ends at the first column the type's default operators do not
+// sort the same way.
+static SortKeyList IndexOrder(const PhysicalIndexScan *scan) {
+  SortKeyList keys;
+  const IndexMetadata *index = MetadataAccessor::GetIndexMetadata(
+      scan->GetTableOid(), scan->GetIndexOid());
+  if (!index)
+    return keys;
+  for (size_t i = 0; i < index->columns.size(); i++) {
+    AttrNumber attnum = index->columns[i];
+    if (attnum == 0)
+      break;
+    Oid type;
+    int32 typmod;
+    Oid collation;
+    get_atttypetypmodcoll(scan->GetTableOid(), attnum, &type, &typmod,
+                          &collation);
+    TypeCacheEntry *entry =
+        lookup_type_cache(type, TYPECACHE_LT_OPR | TYPECACHE_GT_OPR);
+    bool descending = index->descending[i];
+    Oid sortop = descending ? entry->gt_opr : entry->lt_opr;
+    int strategy = descending ? BTGreaterStrategyNumber : BTLessStrategyNumber;
+    if (!OidIsValid(sortop) ||
+        get_op_opfamily_strategy(sortop, index->opfamilies[i]) != strategy ||
+        index->collations[i] != collation)
+      break;
+    Var *var = makeVar(scan->GetRtIndex(), attnum, type, typmod, collation, 0);
+    keys.push_back({(Node *)var, sortop, index->nulls_first[i]});
+  }
+  return keys;
+}
+
+// A merge join returns its rows in the order of the outer input's keys,
+// which the translator sorts it on. Unmatched inner rows of a full join
+// come out in between.
+static SortKeyList MergeJoinOrder(const GroupExpression *expr,
+                                  const PhysicalMergeJoin *join) {
+  SortKeyList keys;
+  if (join->GetJoinType() == JOIN_FULL)
+    return keys;
+  const ColSet &outer_relids =
+      expr->GetChildren()[0]->GetLogicalProperties()->GetRelids();
+  for (const Predicate *pred : join->GetMergePredicates()) {
+    OpExpr *clause = (OpExpr *)pred->GetExpr();
+    Node *key = (Node *)(pred->GetLeftRelids().IsSubset(outer_relids)
+                             ? linitial(clause->args)
+                             : lsecond(clause->args));
+    Oid opfamily = Ordering::MergeOpfamily(clause->opno);
+    Oid type = exprType(key);
+    Oid sortop = OidIsValid(opfamily)
+                     ? get_opfamily_member(opfamily, type, type,
+                                           BTLessStrategyNumber)
+                     : InvalidOid;
+    if (!OidIsValid(sortop) || clause->inputcollid != exprCollation(key))
+      break;
+    keys.push_back({strip_implicit_coercions(key), sortop, false});
+  }
+  return keys;
+}
+
+SortKeyList Ordering::Delivered(const GroupExpression *expr) {
+  Operator *op = expr->GetOperator();
+  auto InputOrder = [&]() {
+    const GroupExpression *best =
+        expr->GetChildren()[0]->GetBestExpression();
+    return best ? Delivered(best) : SortKeyList();
+  };
+  // Sorts that find their input sorted on all keys leave it as it is,
+  // which may be sorted on more.
+  auto SortedOn = [&](const SortKeyList &keys) {
+    SortKeyList input = InputOrder();
+    return PresortedKeys(input, keys) == (int)keys.size() ? input : keys;
+  };
+
+  switch (op->GetType()) {
+  case OperatorType::PHYSICAL_INDEX_SCAN:
+    return IndexOrder(static_cast<PhysicalIndexScan *>(op));
+  case OperatorType::PHYSICAL_MERGE_JOIN:
+    return MergeJoinOrder(expr, static_cast<PhysicalMergeJoin *>(op));
+  case OperatorType::PHYSICAL_NESTED_LOOP_JOIN:
+    // The inner input is scanned once per outer row, in outer row order.
+  case OperatorType::PHYSICAL_FILTER:
+  case OperatorType::PHYSICAL_PROJECTION:
+  case OperatorType::PHYSICAL_LIMIT:
+    return InputOrder();
+  case OperatorType::PHYSICAL_SORT:
+    return static_cast<PhysicalSort *>(op)->GetKeys();
+  case OperatorType::PHYSICAL_INCREMENTAL_SORT:
+    return SortedOn(static_cast<PhysicalIncrementalSort *>(op)->GetKeys());
+  case OperatorType::PHYSICAL_WINDOW_AGG:
+    return SortedOn(static_cast<PhysicalWindowAgg *>(op)->GetKeys());
+  case OperatorType::PHYSICAL_AGGREGATE: {
+    // Sorted grouping emits the groups in key order.
+    auto *agg = static_cast<PhysicalAggregate *>(op);
+    SortKeyList keys;
+    if (agg->GetStrategy() == AGG_SORTED) {
+      for (const GroupKey &key : agg->GetKeys())
+        keys.push_back({key.expr, key.sortop, false});
+    }
+    return keys;
+  }
+  default:
+    return SortKeyList();
+  }
+}
+
+} // namespace pg_carbon
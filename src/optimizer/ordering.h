@@ -0,0 +1,38 @@
+#ifndef PG_CARBON_ORDERING_H
+#define PG_CARBON_ORDERING_H
+
+#include "../common/memory.h"
+#include "../operators/operators.h"
+#include "memo.h"
+
+namespace pg_carbon {
+
+// Sort orders of the plans in the Memo.
+//
+// The search does not ask its inputs for an order (there are no required
+// physical properties). Operators that need sorted input instead look at
+// the order the winning plan of their input group happens to return its
+// rows in, and only sort on what is left: nothing if the input is sorted on
+// all keys, the groups of rows that agree on a presorted prefix otherwise.
+// Costing and egest see the same winners, so they agree on what is sorted.
+class Ordering {
+public:
+  // The order the plan of `expr`, over the winners of its input groups,
+  // returns its rows in, as far as it is known; empty if unordered
+  static SortKeyList Delivered(const GroupExpression *expr);
+
+  // Number of leading keys of `required` that rows in `delivered` order are
+  // sorted on already
+  static int PresortedKeys(const SortKeyList &delivered,
+                           const SortKeyList &required);
+  // Likewise for the rows of the winning plan of `input`
+  static int PresortedKeys(const Group *input, const SortKeyList &required);
+
+  // The btree operator family whose equality the mergejoinable `opno` is,
+  // which orders the inputs of a merge join on it
+  static Oid MergeOpfamily(Oid opno);
+};
+
+} // namespace pg_carbon
+
+#endif // PG_CARBON_ORDERING_H
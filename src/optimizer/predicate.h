@@ -0,0 +1,120 @@
+#ifndef PG_CARBON_PREDICATE_H
+#define PG_CARBON_PREDICATE_H
+
+#include "../common/memory.h"
+#include "column.h"
+
+// clang-format off
+extern "C" {
+#include "postgres.h"
+#include "nodes/primnodes.h"
+}
+// clang-format on
+
+namespace pg_carbon {
+
+// A plain column of a base relation
+struct ColumnRef {
+  Index rt_index = 0;
+  Oid table_oid = InvalidOid;
+  AttrNumber attr_num = InvalidAttrNumber;
+  // Read above an outer join that can set it to NULL
+  bool nullable = false;
+};
+
+// One conjunct of a WHERE or JOIN ... ON clause.
+//
+// The translator splits quals into predicates and works out up front what the
+// search needs to know about each of them (the relations and attributes it
+// reads, its selectivity). Rules then move predicates between operators
+// without walking PG expression trees, and the Memo compares them by
+// identity.
+class Predicate : public PgObject {
+public:
+  Predicate(Node *expr, AttrSet attrs, double selectivity, bool is_volatile)
+      : expr_(expr), attrs_(std::move(attrs)), relids_(attrs_.GetRelids()),
+        selectivity_(selectivity), is_volatile_(is_volatile) {}
+
+  Node *GetExpr() const { return expr_; }
+  const AttrSet &GetAttrs() const { return attrs_; }
+  // Range table indexes of the relations the predicate reads
+  const ColSet &GetRelids() const { return relids_; }
+
+  double GetSelectivity() const { return selectivity_; }
+  void SetSelectivity(double selectivity) { selectivity_ = selectivity; }
+
+  // Volatile predicates stay where the query put them.
+  bool IsVolatile() const { return is_volatile_; }
+
+  // For `left op right` clauses: the relations each operand reads, and
+  // whether the operator can drive a hash or merge join. Join rules use this
+  // to find join keys without looking at the expression.
+  void SetOperands(ColSet left_relids, ColSet right_relids, bool hashjoinable,
+                   bool mergejoinable) {
+    left_relids_ = std::move(left_relids);
+    right_relids_ = std::move(right_relids);
+    hashjoinable_ = hashjoinable;
+    mergejoinable_ = mergejoinable;
+  }
+  const ColSet &GetLeftRelids() const { return left_relids_; }
+  const ColSet &GetRightRelids() const { return right_relids_; }
+  bool IsHashJoinable() const { return hashjoinable_; }
+  bool IsMergeJoinable() const { return mergejoinable_; }
+
+  // True if one operand only reads `outer` and the other only `inner`
+  bool IsJoinKey(const ColSet &outer, const ColSet &inner) const {
+    if (left_relids_.IsEmpty() || right_relids_.IsEmpty())
+      return false;
+    return (left_relids_.IsSubset(outer) && right_relids_.IsSubset(inner)) ||
+           (left_relids_.IsSubset(inner) && right_relids_.IsSubset(outer));
+  }
+
+  // For `column op column` clauses: the operator and the two columns,
+  // which join elimination matches against unique and foreign keys
+  void SetColumnOperands(Oid opno, ColumnRef left, ColumnRef right) {
+    opno_ = opno;
+    left_column_ = left;
+    right_column_ = right;
+  }
+  bool HasColumnOperands() const { return OidIsValid(opno_); }
+  Oid GetOperatorOid() const { return opno_; }
+  const ColumnRef &GetLeftColumn() const { return left_column_; }
+  const ColumnRef &GetRightColumn() const { return right_column_; }
+
+  // Relations whose rows the predicate rejects when all their columns are
+  // NULL (find_nonnullable_rels()), such as the nullable side of an outer
+  // join that did not find a match.
+  void SetNonNullableRelids(ColSet relids) {
+    nonnullable_relids_ = std::move(relids);
+  }
+  const ColSet &GetNonNullableRelids() const { return nonnullable_relids_; }
+
+  // Constant FALSE or NULL, which is what preprocessing reduces
+  // self-contradictory quals to. No row can pass such a predicate.
+  bool IsConstantFalse() const {
+    return IsA(expr_, Const) &&
+           (((Const *)expr_)->constisnull ||
+            !DatumGetBool(((Const *)expr_)->constvalue));
+  }
+
+private:
+  Node *expr_;
+  AttrSet attrs_;
+  ColSet relids_;
+  double selectivity_;
+  bool is_volatile_;
+  ColSet left_relids_;
+  ColSet right_relids_;
+  ColSet nonnullable_relids_;
+  bool hashjoinable_ = false;
+  bool mergejoinable_ = false;
+  Oid opno_ = InvalidOid;
+  ColumnRef left_column_;
+  ColumnRef right_column_;
+};
+
+using PredicateList = PgVector<Predicate *>;
+
+} // namespace pg_carbon
+
+#endif // PG_CARBON_PREDICATE_H
@@ -1,19 +1,25 @@
 #include "preprocess.h"
+#include <utility>
 
 extern "C" {
 #include "access/htup_details.h"
 #include "catalog/pg_aggregate.h"
 #include "catalog/pg_type.h"
+#include "nodes/makefuncs.h"
 #include "nodes/nodeFuncs.h"
 #include "nodes/pathnodes.h"
 #include "nodes/pg_list.h"
+#include "optimizer/clauses.h"
+#include "optimizer/optimizer.h"
+#include "optimizer/prep.h"
 #include "parser/parse_agg.h"
+#include "parser/parsetree.h"
+#include "rewrite/rewriteManip.h"
 #include "utils/builtins.h"
 #include "utils/datum.h"
 #include "utils/fmgroids.h"
 #include "utils/lsyscache.h"
 #include "utils/syscache.h"
-extern bool contain_volatile_functions(Node *clause);
 }
 
 namespace pg_carbon {
@@ -33,4 +39,495 @@ void Preprocess::PreprocessTargetList(Query *parse) {
   // planner that creates root->processed_tlist).
 }
 
+static void FlattenJoinTreeQuals(Query *parse, Node *jtnode) {
+  if (IsA(jtnode, JoinExpr)) {
+    JoinExpr *join = (JoinExpr *)jtnode;
+    join->quals = flatten_join_alias_vars(nullptr, parse, join->quals);
+    FlattenJoinTreeQuals(parse, join->larg);
+    FlattenJoinTreeQuals(parse, join->rarg);
+  } else if (IsA(jtnode, FromExpr)) {
+    FromExpr *from = (FromExpr *)jtnode;
+    from->quals = flatten_join_alias_vars(nullptr, parse, from->quals);
+    ListCell *lc;
+    foreach (lc, from->fromlist)
+      FlattenJoinTreeQuals(parse, (Node *)lfirst(lc));
+  }
+}
+
+void Preprocess::FlattenJoinAliasVars(Query *parse) {
+  bool has_join_rtes = false;
+  ListCell *lc;
+  foreach (lc, parse->rtable) {
+    if (((RangeTblEntry *)lfirst(lc))->rtekind == RTE_JOIN)
+      has_join_rtes = true;
+  }
+  if (!has_join_rtes)
+    return;
+
+  parse->targetList = (List *)flatten_join_alias_vars(
+      nullptr, parse, (Node *)parse->targetList);
+  parse->havingQual =
+      flatten_join_alias_vars(nullptr, parse, parse->havingQual);
+  FlattenJoinTreeQuals(parse, (Node *)parse->jointree);
+}
+
+// A subquery whose rows only matter for whether they exist, and whose join
+// tree can therefore be joined into the outer query as is. DISTINCT and
+// ORDER BY make no difference to that.
+static bool IsPullableSubquery(Query *subselect) {
+  return subselect->commandType == CMD_SELECT && !subselect->utilityStmt &&
+         !subselect->setOperations && !subselect->hasAggs &&
+         !subselect->groupClause && !subselect->groupingSets &&
+         !subselect->havingQual && !subselect->hasWindowFuncs &&
+         !subselect->hasTargetSRFs && !subselect->hasSubLinks &&
+         !subselect->cteList && !subselect->rowMarks &&
+         !subselect->hasForUpdate && !subselect->limitOffset &&
+         !subselect->limitCount && subselect->jointree &&
+         subselect->jointree->fromlist;
+}
+
+// Replaces the PARAM_SUBLINK Params of an IN comparison with the subquery
+// target list entries they stand for.
+static Node *ReplaceSublinkParamsMutator(Node *node, List *target_list) {
+  if (!node)
+    return nullptr;
+  if (IsA(node, Param) && ((Param *)node)->paramkind == PARAM_SUBLINK) {
+    TargetEntry *tle =
+        get_tle_by_resno(target_list, ((Param *)node)->paramid);
+    return tle ? (Node *)copyObjectImpl(tle->expr) : node;
+  }
+  return expression_tree_mutator(node, ReplaceSublinkParamsMutator,
+                                 target_list);
+}
+
+// The semi (anti, for NOT EXISTS) join replacing `sublink`, with its left
+// input still to be filled in, or nullptr if the sublink has to stay. This
+// follows convert_EXISTS_sublink_to_join(), and treats IN the same way
+// instead of planning the subquery separately: the comparison simply joins
+// the subquery's WHERE clause. NOT IN is left alone, since a NULL on either
+// side makes it neither true nor false.
+static JoinExpr *ConvertSublinkToJoin(Query *parse, SubLink *sublink,
+                                      bool under_not) {
+  if (sublink->subLinkType != EXISTS_SUBLINK &&
+      (sublink->subLinkType != ANY_SUBLINK || under_not))
+    return nullptr;
+
+  Query *subselect = (Query *)copyObjectImpl(sublink->subselect);
+  if (!IsPullableSubquery(subselect))
+    return nullptr;
+
+  // Only the WHERE clause and the IN comparison may reference the outer
+  // query; everything else has to be evaluable on its own.
+  Node *quals = subselect->jointree->quals;
+  subselect->jointree->quals = nullptr;
+  List *target_list = subselect->targetList;
+  subselect->targetList = NIL;
+  subselect->sortClause = NIL;
+  subselect->distinctClause = NIL;
+  if (contain_vars_of_level((Node *)subselect, 1))
+    return nullptr;
+
+  Node *testexpr = nullptr;
+  if (sublink->subLinkType == ANY_SUBLINK)
+    testexpr = (Node *)copyObjectImpl(sublink->testexpr);
+  if (contain_volatile_functions(quals) ||
+      contain_volatile_functions(testexpr) ||
+      (testexpr && contain_volatile_functions((Node *)target_list)))
+    return nullptr;
+
+  // Renumber the subquery's relations to follow the outer query's, and
+  // make its outer references plain Vars.
+  int rtoffset = list_length(parse->rtable);
+  OffsetVarNodes((Node *)subselect, rtoffset, 0);
+  OffsetVarNodes(quals, rtoffset, 0);
+  IncrementVarSublevelsUp(quals, -1, 1);
+  if (testexpr) {
+    OffsetVarNodes((Node *)target_list, rtoffset, 0);
+    IncrementVarSublevelsUp((Node *)target_list, -1, 1);
+    testexpr = ReplaceSublinkParamsMutator(testexpr, target_list);
+  }
+  CombineRangeTables(&parse->rtable, &parse->rteperminfos, subselect->rtable,
+                     subselect->rteperminfos);
+
+  JoinExpr *join = makeNode(JoinExpr);
+  join->jointype = under_not ? JOIN_ANTI : JOIN_SEMI;
+  if (list_length(subselect->jointree->fromlist) == 1)
+    join->rarg = (Node *)linitial(subselect->jointree->fromlist);
+  else
+    join->rarg = (Node *)subselect->jointree;
+  List *join_quals = list_concat(make_ands_implicit((Expr *)testexpr),
+                                 make_ands_implicit((Expr *)quals));
+  join->quals = join_quals ? (Node *)make_ands_explicit(join_quals) : nullptr;
+  return join;
+}
+
+void Preprocess::PullUpSublinks(Query *parse) {
+  if (!parse->hasSubLinks || !parse->jointree)
+    return;
+
+  FromExpr *from = parse->jointree;
+  Node *join_tree = nullptr;
+  List *remaining = NIL;
+  ListCell *lc;
+  foreach (lc, make_ands_implicit((Expr *)from->quals)) {
+    Node *clause = (Node *)lfirst(lc);
+    bool under_not = false;
+    if (is_notclause(clause)) {
+      clause = (Node *)get_notclausearg((Expr *)clause);
+      under_not = true;
+    }
+
+    JoinExpr *join =
+        IsA(clause, SubLink)
+            ? ConvertSublinkToJoin(parse, (SubLink *)clause, under_not)
+            : nullptr;
+    if (!join) {
+      remaining = lappend(remaining, lfirst(lc));
+      continue;
+    }
+
+    // Each converted sublink filters everything joined so far.
+    if (!join_tree) {
+      join_tree = list_length(from->fromlist) == 1
+                      ? (Node *)linitial(from->fromlist)
+                      : (Node *)makeFromExpr(from->fromlist, nullptr);
+    }
+    join->larg = join_tree;
+    join_tree = (Node *)join;
+  }
+  if (!join_tree)
+    return;
+
+  from->fromlist = list_make1(join_tree);
+  from->quals = remaining ? (Node *)make_ands_explicit(remaining) : nullptr;
+  parse->hasSubLinks =
+      checkExprHasSubLink((Node *)parse->targetList) ||
+      checkExprHasSubLink(parse->havingQual) ||
+      checkExprHasSubLink(parse->limitOffset) ||
+      checkExprHasSubLink(parse->limitCount) ||
+      checkExprHasSubLink((Node *)parse->jointree);
+}
+
+static bool IsConstantTrue(Node *clause) {
+  return IsA(clause, Const) && !((Const *)clause)->constisnull &&
+         DatumGetBool(((Const *)clause)->constvalue);
+}
+
+// Puts a binary comparison into canonical operand order, if the operator
+// has a commutator to make that possible.
+static Node *NormalizeComparison(Node *clause) {
+  if (!IsA(clause, OpExpr) || list_length(((OpExpr *)clause)->args) != 2)
+    return clause;
+
+  OpExpr *opexpr = (OpExpr *)clause;
+  Node *left = strip_implicit_coercions((Node *)linitial(opexpr->args));
+  Node *right = strip_implicit_coercions((Node *)lsecond(opexpr->args));
+
+  bool swap = false;
+  if (IsA(left, Const) && !IsA(right, Const)) {
+    swap = true;
+  } else if (IsA(left, Var) && IsA(right, Var)) {
+    Var *lvar = (Var *)left;
+    Var *rvar = (Var *)right;
+    swap = lvar->varlevelsup == rvar->varlevelsup &&
+           (lvar->varno > rvar->varno ||
+            (lvar->varno == rvar->varno && lvar->varattno > rvar->varattno));
+  }
+
+  if (swap && OidIsValid(get_commutator(opexpr->opno)))
+    CommuteOpExpr(opexpr);
+  return clause;
+}
+
+List *Preprocess::SimplifyConjuncts(List *conjuncts) {
+  List *result = NIL;
+  ListCell *lc;
+
+  foreach (lc, conjuncts) {
+    Node *clause = (Node *)lfirst(lc);
+    if (IsConstantTrue(clause))
+      continue;
+    if (IsA(clause, Const))
+      return list_make1(makeBoolConst(false, false));
+
+    clause = NormalizeComparison(clause);
+    if (!list_member(result, clause))
+      result = lappend(result, clause);
+  }
+
+  // Self-contradictory clauses, such as x = 1 AND x = 2 or x < 1 AND x > 5,
+  // checked the way relation_excluded_by_constraints() does. Only immutable
+  // clauses can be reasoned about.
+  List *safe_clauses = NIL;
+  foreach (lc, result) {
+    if (!contain_mutable_functions((Node *)lfirst(lc)))
+      safe_clauses = lappend(safe_clauses, lfirst(lc));
+  }
+  if (list_length(safe_clauses) > 1 &&
+      predicate_refuted_by(safe_clauses, safe_clauses, true))
+    return list_make1(makeBoolConst(false, false));
+
+  return result;
+}
+
+static Node *PreprocessQual(PlannerInfo *root, Node *qual) {
+  if (!qual)
+    return nullptr;
+  qual = eval_const_expressions(root, qual);
+  qual = (Node *)canonicalize_qual((Expr *)qual, false);
+  List *conjuncts =
+      Preprocess::SimplifyConjuncts(make_ands_implicit((Expr *)qual));
+  return conjuncts ? (Node *)make_ands_explicit(conjuncts) : nullptr;
+}
+
+static void PreprocessJoinTree(PlannerInfo *root, Node *jtnode) {
+  if (IsA(jtnode, JoinExpr)) {
+    JoinExpr *join = (JoinExpr *)jtnode;
+    join->quals = PreprocessQual(root, join->quals);
+    PreprocessJoinTree(root, join->larg);
+    PreprocessJoinTree(root, join->rarg);
+  } else if (IsA(jtnode, FromExpr)) {
+    FromExpr *from = (FromExpr *)jtnode;
+    from->quals = PreprocessQual(root, from->quals);
+    ListCell *lc;
+    foreach (lc, from->fromlist)
+      PreprocessJoinTree(root, (Node *)lfirst(lc));
+  }
+}
+
+static Relids JoinTreeRelids(Node *jtnode) {
+  if (IsA(jtnode, RangeTblRef))
+    return bms_make_singleton(((RangeTblRef *)jtnode)->rtindex);
+  Relids relids = nullptr;
+  if (IsA(jtnode, JoinExpr)) {
+    JoinExpr *join = (JoinExpr *)jtnode;
+    relids = bms_union(JoinTreeRelids(join->larg), JoinTreeRelids(join->rarg));
+  } else if (IsA(jtnode, FromExpr)) {
+    ListCell *lc;
+    foreach (lc, ((FromExpr *)jtnode)->fromlist)
+      relids = bms_join(relids, JoinTreeRelids((Node *)lfirst(lc)));
+  }
+  return relids;
+}
+
+// `nonnullable_rels` are the relations some qual above `jtnode` rejects
+// NULL rows of. Outer joins turned into inner joins are added to `reduced`.
+static void ReduceOuterJoinsRecurse(Query *parse, Node *jtnode,
+                                    Relids nonnullable_rels,
+                                    Relids *reduced) {
+  if (IsA(jtnode, FromExpr)) {
+    FromExpr *from = (FromExpr *)jtnode;
+    Relids pass_nonnullable_rels = bms_union(
+        nonnullable_rels, find_nonnullable_rels(from->quals));
+    ListCell *lc;
+    foreach (lc, from->fromlist)
+      ReduceOuterJoinsRecurse(parse, (Node *)lfirst(lc),
+                              pass_nonnullable_rels, reduced);
+    return;
+  }
+  if (!IsA(jtnode, JoinExpr))
+    return;
+
+  JoinExpr *join = (JoinExpr *)jtnode;
+  JoinType jointype = join->jointype;
+  Relids left_rels = JoinTreeRelids(join->larg);
+  Relids right_rels = JoinTreeRelids(join->rarg);
+  switch (jointype) {
+  case JOIN_LEFT:
+    if (bms_overlap(nonnullable_rels, right_rels))
+      jointype = JOIN_INNER;
+    break;
+  case JOIN_RIGHT:
+    if (bms_overlap(nonnullable_rels, left_rels))
+      jointype = JOIN_INNER;
+    break;
+  case JOIN_FULL:
+    if (bms_overlap(nonnullable_rels, left_rels)) {
+      jointype = bms_overlap(nonnullable_rels, right_rels) ? JOIN_INNER
+                                                            : JOIN_LEFT;
+    } else if (bms_overlap(nonnullable_rels, right_rels)) {
+      jointype = JOIN_RIGHT;
+    }
+    break;
+  default:
+    break;
+  }
+  if (jointype == JOIN_INNER && join->jointype != JOIN_INNER)
+    *reduced = bms_add_member(*reduced, join->rtindex);
+
+  if (jointype == JOIN_RIGHT) {
+    std::swap(join->larg, join->rarg);
+    jointype = JOIN_LEFT;
+  }
+  if (jointype != join->jointype) {
+    join->jointype = jointype;
+    if (join->rtindex)
+      rt_fetch(join->rtindex, parse->rtable)->jointype = jointype;
+  }
+
+  // Quals of this join constrain its inputs too, except that an outer join
+  // returns preserved rows whatever its quals say.
+  Relids local_nonnullable_rels = nullptr;
+  if (jointype != JOIN_FULL) {
+    local_nonnullable_rels = find_nonnullable_rels(join->quals);
+    if (jointype == JOIN_INNER || jointype == JOIN_SEMI)
+      local_nonnullable_rels =
+          bms_add_members(local_nonnullable_rels, nonnullable_rels);
+  }
+  ReduceOuterJoinsRecurse(parse, join->larg,
+                          jointype == JOIN_INNER || jointype == JOIN_SEMI
+                              ? local_nonnullable_rels
+                              : nonnullable_rels,
+                          reduced);
+  ReduceOuterJoinsRecurse(parse, join->rarg, local_nonnullable_rels,
+                          reduced);
+}
+
+void Preprocess::ReduceOuterJoins(Query *parse) {
+  if (!parse->jointree)
+    return;
+  Relids reduced = nullptr;
+  ReduceOuterJoinsRecurse(parse, (Node *)parse->jointree, nullptr, &reduced);
+  if (bms_is_empty(reduced))
+    return;
+
+  // Columns above a reduced join are no longer nulled by it.
+  parse->targetList = (List *)remove_nulling_relids(
+      (Node *)parse->targetList, reduced, nullptr);
+  parse->jointree = (FromExpr *)remove_nulling_relids(
+      (Node *)parse->jointree, reduced, nullptr);
+  parse->havingQual = remove_nulling_relids(parse->havingQual, reduced,
+                                            nullptr);
+}
+
+// Moves the HAVING conjuncts that do not need the aggregated rows to WHERE,
+// so they filter before grouping, as subquery_planner() does. Without GROUP
+// BY a copy stays behind: an empty input still forms a group that the qual
+// has to reject.
+static void MoveHavingToWhere(Query *parse) {
+  if (!parse->havingQual || parse->groupingSets || !parse->jointree)
+    return;
+
+  List *having = NIL;
+  List *where = NIL;
+  ListCell *lc;
+  foreach (lc, make_ands_implicit((Expr *)parse->havingQual)) {
+    Node *clause = (Node *)lfirst(lc);
+    if (contain_agg_clause(clause) || contain_volatile_functions(clause) ||
+        checkExprHasSubLink(clause)) {
+      having = lappend(having, clause);
+      continue;
+    }
+    where = lappend(where, clause);
+    if (!parse->groupClause)
+      having = lappend(having, copyObjectImpl(clause));
+  }
+  if (!where)
+    return;
+
+  List *quals = make_ands_implicit((Expr *)parse->jointree->quals);
+  parse->jointree->quals =
+      (Node *)make_ands_explicit(list_concat(quals, where));
+  parse->havingQual = having ? (Node *)make_ands_explicit(having) : nullptr;
+}
+
+void Preprocess::PreprocessExpressions(Query *parse,
+                                       ParamListInfo bound_params) {
+  // eval_const_expressions() only needs the bound parameters and somewhere
+  // to record the functions it inlines.
+  PlannerGlobal *glob = makeNode(PlannerGlobal);
+  glob->boundParams = bound_params;
+  PlannerInfo *root = makeNode(PlannerInfo);
+  root->parse = parse;
+  root->glob = glob;
+  root->query_level = 1;
+  root->planner_cxt = CurrentMemoryContext;
+
+  // Grouped queries reference their grouping expressions through the
+  // query's RTE_GROUP entry; put the expressions themselves back.
+  if (parse->hasGroupRTE) {
+    parse->targetList = (List *)flatten_group_exprs(
+        nullptr, parse, (Node *)parse->targetList);
+    parse->havingQual =
+        flatten_group_exprs(nullptr, parse, parse->havingQual);
+  }
+
+  parse->targetList =
+      (List *)eval_const_expressions(root, (Node *)parse->targetList);
+  parse->limitOffset = eval_const_expressions(root, parse->limitOffset);
+  parse->limitCount = eval_const_expressions(root, parse->limitCount);
+  parse->havingQual = PreprocessQual(root, parse->havingQual);
+  MoveHavingToWhere(parse);
+  if (parse->jointree)
+    PreprocessJoinTree(root, (Node *)parse->jointree);
+
+  // The executor needs every aggregate numbered, and its transition type
+  // resolved, before it can share transition states between them.
+  if (parse->hasAggs) {
+    preprocess_aggrefs(root, (Node *)parse->targetList);
+    preprocess_aggrefs(root, parse->havingQual);
+  }
+}
+
+void Preprocess::PreprocessCtes(Query *parse, ParamListInfo bound_params) {
+  ListCell *lc;
+  foreach (lc, parse->cteList) {
+    CommonTableExpr *cte = (CommonTableExpr *)lfirst(lc);
+    Query *ctequery = (Query *)cte->ctequery;
+    if (cte->cterecursive || ctequery->commandType != CMD_SELECT ||
+        ctequery->utilityStmt || ctequery->setOperations)
+      continue;
+    PullUpSublinks(ctequery);
+    FlattenJoinAliasVars(ctequery);
+    PreprocessExpressions(ctequery, bound_params);
+    ReduceOuterJoins(ctequery);
+  }
+}
+
+// Adds the range table indexes of the leaves of a set operation tree
+static void CollectSetOperationLeaves(Node *node, Bitmapset **leaves) {
+  if (IsA(node, RangeTblRef)) {
+    *leaves = bms_add_member(*leaves, ((RangeTblRef *)node)->rtindex);
+  } else if (IsA(node, SetOperationStmt)) {
+    CollectSetOperationLeaves(((SetOperationStmt *)node)->larg, leaves);
+    CollectSetOperationLeaves(((SetOperationStmt *)node)->rarg, leaves);
+  }
+}
+
+void Preprocess::FlattenSetOperations(Query *parse,
+                                      ParamListInfo bound_params) {
+  Bitmapset *leaves = nullptr;
+  if (parse->setOperations)
+    CollectSetOperationLeaves(parse->setOperations, &leaves);
+
+  // Entries merged in are visited in turn, so nested set operations are
+  // flattened all the way down.
+  for (int rtindex = 1; rtindex <= list_length(parse->rtable); rtindex++) {
+    RangeTblEntry *rte = rt_fetch(rtindex, parse->rtable);
+    if (rte->rtekind != RTE_SUBQUERY || rte->lateral ||
+        rte->security_barrier || !rte->subquery->rtable)
+      continue;
+    Query *subquery = rte->subquery;
+    if (!subquery->setOperations && !bms_is_member(rtindex, leaves))
+      continue;
+    if (subquery->commandType != CMD_SELECT || subquery->utilityStmt ||
+        contain_vars_of_level((Node *)subquery, 1))
+      continue;
+
+    PullUpSublinks(subquery);
+    FlattenJoinAliasVars(subquery);
+    PreprocessExpressions(subquery, bound_params);
+    ReduceOuterJoins(subquery);
+
+    int rtoffset = list_length(parse->rtable);
+    OffsetVarNodes((Node *)subquery, rtoffset, 0);
+    CombineRangeTables(&parse->rtable, &parse->rteperminfos,
+                       subquery->rtable, subquery->rteperminfos);
+    subquery->rtable = NIL;
+    subquery->rteperminfos = NIL;
+    if (subquery->setOperations)
+      CollectSetOperationLeaves(subquery->setOperations, &leaves);
+  }
+}
+
 } // namespace pg_carbon
@@ -7,6 +7,7 @@ extern "C" {
 
 #include "postgres.h"
 struct _dummy;
+#include "nodes/params.h"
 #include "nodes/parsenodes.h"
 #include "nodes/pathnodes.h"
 // #include "nodes/pg_list.h" // Removed to match optimizer.h pattern,
@@ -25,6 +26,53 @@ struct PreprocessingContext {
 class Preprocess {
 public:
   static void PreprocessTargetList(Query *parse);
+
+  // Replaces references to join alias Vars (JOIN ... USING columns, or any
+  // column referenced through a join's alias) with the underlying base
+  // relation Vars, like the standard planner does early on.
+  static void FlattenJoinAliasVars(Query *parse);
+
+  // Turns EXISTS, NOT EXISTS and IN sublinks among the WHERE conjuncts into
+  // semi and anti joins against the subquery's join tree, which is merged
+  // into the query's. Sublinks that cannot be converted are left alone.
+  // Runs before FlattenJoinAliasVars, which has to see the merged range
+  // table.
+  static void PullUpSublinks(Query *parse);
+
+  // Counterpart of the standard planner's preprocess_expression(): folds
+  // constants and immutable functions (substituting bound parameter values
+  // where a custom plan allows it) in every expression of the query, and
+  // canonicalizes and simplifies the quals. HAVING conjuncts that do not
+  // involve aggregates move to WHERE, and aggregates get numbered as
+  // preprocess_aggrefs() does for the executor.
+  static void PreprocessExpressions(Query *parse, ParamListInfo bound_params);
+
+  // Counterpart of the standard planner's reduce_outer_joins(): an outer
+  // join whose nullable side is constrained by a strict qual above it (in
+  // WHERE or an enclosing inner join) cannot produce NULL-extended rows, so
+  // it is turned into an inner join (or a full join into a left one). Right
+  // joins are then flipped into left joins. Runs after
+  // PreprocessExpressions(), which simplifies the quals it looks at.
+  static void ReduceOuterJoins(Query *parse);
+
+  // Preprocesses the query of every CTE in the WITH list like the query
+  // itself. The translator merges a copy of it into the query's range table
+  // for each place it is planned.
+  static void PreprocessCtes(Query *parse, ParamListInfo bound_params);
+
+  // Merges the range tables of set operation leaves and of set operation
+  // subqueries in FROM into the query's, after preprocessing each of them
+  // like the query itself. Their expressions then reference the query's
+  // range table directly, and an empty range table marks the subquery as
+  // flattened; the set operation tree and the leaves' target lists are
+  // left for the translator. Runs last.
+  static void FlattenSetOperations(Query *parse, ParamListInfo bound_params);
+
+  // Drops constant-true and duplicate conjuncts and normalizes comparisons
+  // to `column op constant` form (lower range table index first for two
+  // columns), so equivalent quals look the same to the Memo. A
+  // self-contradictory list is reduced to a single constant FALSE.
+  static List *SimplifyConjuncts(List *conjuncts);
 };
 
 } // namespace pg_carbon
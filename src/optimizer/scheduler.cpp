@@ -1,47 +1,250 @@
 #include "scheduler.h"
+#include "../cost/cost_model.h"
+#include <algorithm>
 #include <iostream>
 
+extern "C" {
+#include "utils/memutils.h"
+#include "utils/timestamp.h"
+}
+
 namespace pg_carbon {
 
-class RuleGetToScan; // Forward decl
-class RuleFilterToPhysical;
-class RuleSortToPhysical;
-class RuleAggregateToPhysical;
-class RuleLimitToPhysical;
-class RuleProjectionToPhysical;
+// Rule names by index, kept for the life of the backend
+static const char *rule_names[CARBON_MAX_RULES];
+
+TaskScheduler::TaskScheduler(Memo *memo, const SearchBudget &budget,
+                             CarbonStats *stats)
+    : memo_(memo), stats_(stats), budget_(budget),
+      start_time_(GetCurrentTimestamp()),
+      start_memory_(MemoryContextMemAllocated(CurrentMemoryContext, true)) {}
 
 void TaskScheduler::ScheduleTask(Task *task) { task_stack_.push(task); }
 
-void TaskScheduler::Run() {
-  // Initialize rules (Simplification: just add one rule)
+void TaskScheduler::AddRule(Rule *rule, int stage) {
+  Assert(rules_.size() < CARBON_MAX_RULES);
+  rule->SetId(rules_.size());
+  rule->SetStage(stage);
+  rules_.push_back(rule);
+  if (!rule_names[rule->GetId()])
+    rule_names[rule->GetId()] =
+        MemoryContextStrdup(TopMemoryContext, rule->ToString().c_str());
+}
+
+const char *TaskScheduler::GetRuleName(int rule_id) {
+  if (!rule_names[0]) {
+    TaskScheduler scheduler(nullptr);
+    scheduler.InitRules();
+  }
+  return rule_id >= 0 && rule_id < CARBON_MAX_RULES ? rule_names[rule_id]
+                                                     : nullptr;
+}
+
+void TaskScheduler::CountRule(const Rule *rule, bool success) {
+  if (!stats_)
+    return;
+  stats_->rule_fires[rule->GetId()]++;
+  if (success)
+    stats_->rule_successes[rule->GetId()]++;
+}
+
+void TaskScheduler::InitRules() {
   if (rules_.empty()) {
-    rules_.push_back(new RuleGetToScan());
-    rules_.push_back(new RuleFilterToPhysical());
-    rules_.push_back(new RuleSortToPhysical());
+    // Stage 1: cheap rewrites
+    AddRule(new RuleFilterPushThroughJoin(), 1);
+    AddRule(new RuleJoinPredicatePushDown(), 1);
+    AddRule(new RuleFilterMerge(), 1);
+    AddRule(new RuleJoinCommutativity(), 1);
+    AddRule(new RuleJoinElimination(), 1);
+    AddRule(new RuleFilterPushThroughAppend(), 1);
+    AddRule(new RuleFilterPushThroughUnionAll(), 1);
+    AddRule(new RuleLimitPushThroughUnionAll(), 1);
+    AddRule(new RuleInlineCte(), 1);
+
+    // Stage 2: join reordering and aggregate placement
+    AddRule(new RuleJoinAssociativity(), 2);
+    AddRule(new RuleLeftJoinAssociativity(), 2);
+    AddRule(new RuleInnerJoinPastLeftJoin(), 2);
+    AddRule(new RuleLeftJoinPastInnerJoin(), 2);
+    AddRule(new RuleEagerAggregation(), 2);
+    AddRule(new RulePartitionwiseJoin(), 2);
+    AddRule(new RulePartitionwiseAggregate(), 2);
+
+    // Stage 0: DISTINCT UNIONs have no implementation of their own
+    AddRule(new RuleUnionToAggregate(), 0);
+
+    // Implementation rules
+    AddRule(new RuleGetToScan(), 0);
+    AddRule(new RuleJoinToNestedLoop(), 0);
+    AddRule(new RuleJoinToIndexNestedLoop(), 0);
+    AddRule(new RuleFilterToIndexScan(), 0);
+    AddRule(new RuleJoinToHashJoin(), 0);
+    AddRule(new RuleJoinToMergeJoin(), 0);
+    AddRule(new RuleFilterToPhysical(), 0);
+    AddRule(new RuleFilterToEmptyResult(), 0);
+    AddRule(new RuleSortToPhysical(), 0);
+    AddRule(new RuleSortToIncrementalSort(), 0);
+    AddRule(new RuleAggregateToSortedAggregate(), 0);
+    AddRule(new RuleAggregateToHashedAggregate(), 0);
+    AddRule(new RuleWindowToPhysical(), 0);
+    AddRule(new RuleAppendToPhysical(), 0);
+    AddRule(new RuleSetOperationToAppend(), 0);
+    AddRule(new RuleSortToMergeAppend(), 0);
+    AddRule(new RuleSetOperationToSortedSetOp(), 0);
+    AddRule(new RuleSetOperationToHashedSetOp(), 0);
+    AddRule(new RuleCteScanToPhysical(), 0);
 
-    rules_.push_back(new RuleLimitToPhysical());
-    rules_.push_back(new RuleProjectionToPhysical());
+    AddRule(new RuleLimitToPhysical(), 0);
+    AddRule(new RuleProjectionToPhysical(), 0);
   }
+}
+
+Size TaskScheduler::SampleMemory() {
+  Size allocated = MemoryContextMemAllocated(CurrentMemoryContext, true);
+  Size memory = allocated > start_memory_ ? allocated - start_memory_ : 0;
+  peak_memory_ = Max(peak_memory_, memory);
+  return memory;
+}
+
+Size TaskScheduler::GetPeakMemory() {
+  SampleMemory();
+  return peak_memory_;
+}
+
+bool TaskScheduler::IsOverBudget() {
+  if (budget_.tasks > 0 && tasks_performed_ >= budget_.tasks)
+    return true;
+  // Reading the clock and walking the memory contexts cost more than most
+  // tasks, so the time and memory budgets are only checked, and the peak
+  // memory sampled, every so often.
+  if (tasks_performed_ % kBudgetCheckInterval != 0)
+    return false;
+  if (budget_.time_us > 0 &&
+      GetCurrentTimestamp() - start_time_ >= budget_.time_us)
+    return true;
+  Size memory = SampleMemory();
+  return budget_.memory > 0 && memory >= budget_.memory;
+}
+
+void TaskScheduler::Run() {
+  InitRules();
 
   while (!task_stack_.empty()) {
     Task *task = task_stack_.top();
     task_stack_.pop();
-    task->perform(this);
+    if (!exhausted_ && IsOverBudget()) {
+      exhausted_ = true;
+      if (stats_)
+        stats_->exhausted = true;
+      elog(DEBUG1,
+           "pg_carbon: search budget used up after " INT64_FORMAT " tasks",
+           tasks_performed_);
+    }
+    if (exhausted_) {
+      task->Drop();
+    } else {
+      task->perform(this);
+      tasks_performed_++;
+      if (stats_)
+        stats_->tasks[task->GetType()]++;
+    }
     delete task;
   }
 }
 
+void TaskScheduler::ResetGroup(Group *group, PgVector<bool> &reset) {
+  if (reset[group->GetId()])
+    return;
+  reset[group->GetId()] = true;
+  group->SetExplored(false);
+  group->SetImplemented(false);
+  group->SetBestExpression(nullptr);
+  for (GroupExpression *expr : group->GetLogicalExpressions()) {
+    for (Group *child : expr->GetChildren())
+      ResetGroup(child, reset);
+  }
+  for (GroupExpression *expr : group->GetPhysicalExpressions()) {
+    expr->ResetCost();
+    for (Group *child : expr->GetChildren())
+      ResetGroup(child, reset);
+  }
+}
+
+void TaskScheduler::Escalate(Group *group, Context *context) {
+  Assert(stage_ + 1 < kNumStages);
+  stage_++;
+  if (stats_)
+    stats_->stage = std::max(stats_->stage, stage_);
+  // The new rules may improve any group below, and the plans above it
+  // have to be costed over the new winner.
+  PgVector<bool> reset(memo_->GetGroups().size(), false);
+  ResetGroup(group, reset);
+  ScheduleTask(new O_Group(group, context));
+}
+
+void TaskScheduler::CostPhysicalExpressions(Group *group) {
+  // Implementation rules may add expressions to the group meanwhile.
+  const auto &physical_exprs = group->GetPhysicalExpressions();
+  for (size_t i = 0; i < physical_exprs.size(); i++) {
+    GroupExpression *expr = physical_exprs[i];
+    if (expr->HasCost())
+      continue;
+    bool complete = true;
+    for (Group *child : expr->GetChildren())
+      complete = complete && Complete(child);
+    if (!complete)
+      continue;
+    expr->SetCost(CostModel::Compute(memo_, expr));
+    group->UpdateBestExpression(expr);
+  }
+}
+
+bool TaskScheduler::Complete(Group *group) {
+  if (group->GetBestExpression())
+    return true;
+  if (std::find(completing_.begin(), completing_.end(), group) !=
+      completing_.end())
+    return false;
+  InitRules();
+  completing_.push_back(group);
+
+  // Plans generated before the search stopped come first, then those of
+  // the logical expressions, starting with the one the group was made for.
+  CostPhysicalExpressions(group);
+  const auto &logical_exprs = group->GetLogicalExpressions();
+  for (size_t i = 0; i < logical_exprs.size() && !group->GetBestExpression();
+       i++) {
+    GroupExpression *expr = logical_exprs[i];
+    for (Rule *rule : rules_) {
+      if (rule->GetStage() > 0 || expr->HasAppliedRule(rule->GetId()) ||
+          !rule->Matches(expr))
+        continue;
+      expr->SetAppliedRule(rule->GetId());
+      bool success = false;
+      for (GroupExpression *new_expr : rule->Transform(expr, memo_))
+        success |= memo_->CopyIn(new_expr, group) == new_expr;
+      CountRule(rule, success);
+    }
+    CostPhysicalExpressions(group);
+  }
+
+  completing_.pop_back();
+  return group->GetBestExpression() != nullptr;
+}
+
 const PgVector<Rule *> &TaskScheduler::GetRules() const { return rules_; }
 
 // 1. O_Group (Optimize Group)
 // Logic: Traverse Group Exprs, schedule O_Expr or O_Inputs.
 void O_Group::perform(TaskScheduler *scheduler) {
-  // In a real implementation:
-  // 1. Check if group is already optimized for the context. If so, return.
-  // 2. Mark group as being optimized.
+  // A group shared by several parents is only optimized once.
+  if (group_->IsImplemented()) {
+    return;
+  }
+  group_->SetImplemented(true);
 
-  // For this simplified version, we just iterate over all logical expressions
-  // and optimize them. Lower bounds / cost pruning would happen here.
+  // Iterate over all logical expressions and optimize them. Lower bounds /
+  // cost pruning would happen here.
 
   const auto &logical_exprs = group_->GetLogicalExpressions();
   // Reverse iteration to push tasks in correct order (stack)
@@ -50,6 +253,13 @@ void O_Group::perform(TaskScheduler *scheduler) {
     // Schedule O_Expr for each logical expression
     scheduler->ScheduleTask(new O_Expr(expr, context_, false));
   }
+
+  // Groups built by implementation rules (the parameterized inputs of
+  // nested loops) only hold physical expressions, which still need costing.
+  for (auto *expr : group_->GetPhysicalExpressions()) {
+    if (!expr->HasCost())
+      scheduler->ScheduleTask(new O_Inputs(expr, context_));
+  }
 }
 
 // 2. E_Group (Explore Group)
@@ -78,29 +288,25 @@ void O_Expr::perform(TaskScheduler *scheduler) {
   const auto &rules = scheduler->GetRules();
   for (int i = rules.size() - 1; i >= 0; --i) {
     auto *rule = rules[i];
+    if (expr_->HasAppliedRule(rule->GetId()) ||
+        rule->GetStage() > scheduler->GetStage()) {
+      continue;
+    }
+    // Exploring only looks for logical alternatives; implementations are
+    // generated when the group itself is optimized.
+    if (exploring_ && rule->GetRuleType() == RuleType::IMPLEMENTATION) {
+      continue;
+    }
     if (rule->Matches(expr_)) {
+      expr_->SetAppliedRule(rule->GetId());
       // Schedule Apply_Rule
       scheduler->ScheduleTask(
           new Apply_Rule(rule, expr_, context_, exploring_));
     }
   }
 
-  // 2. If we are NOT merely exploring, we also need to optimize the inputs of
-  // this expression. This usually happens after exploration (rules
-  // application). However, in Columbia, O_Expr typically triggers exploration
-  // of children groups first if needed. And if it's a physical operator
-  // (implementation), we optimize inputs.
-
-  if (!exploring_) {
-    // If this is a physical operator, we need to optimize its inputs to cost
-    // it.
-    if (expr_->GetOperator()->IsPhysical()) {
-      scheduler->ScheduleTask(new O_Inputs(expr_, context_));
-    }
-  }
-
-  // 3. Ensure children groups are explored (if this is a logical operator or we
-  // need to match patterns) For simplicity, we assume we explore all input
+  // 2. Ensure children groups are explored before any rule looks at them
+  // (patterns such as Filter over Join inspect the child group).
   const auto &children = expr_->GetChildren();
   for (int i = children.size() - 1; i >= 0; --i) {
     scheduler->ScheduleTask(new E_Group(children[i], context_));
@@ -112,7 +318,7 @@ void O_Expr::perform(TaskScheduler *scheduler) {
 // O_Expr or O_Inputs.
 void Apply_Rule::perform(TaskScheduler *scheduler) {
   // 1. Transform: Generate new expressions (binding generation)
-  auto new_exprs = rule_->Transform(expr_);
+  auto new_exprs = rule_->Transform(expr_, scheduler->GetMemo());
 
   // 2. Insert into Memo
   auto *group =
@@ -121,31 +327,30 @@ void Apply_Rule::perform(TaskScheduler *scheduler) {
   // might target the same group too.
 
   // Reverse order for stack
+  bool success = false;
   for (int i = new_exprs.size() - 1; i >= 0; --i) {
     auto *new_expr = new_exprs[i];
-    // CopyIn logic is essentially asking the Memo to insert it.
-    // In our simplified memo, InsertExpression takes care of adding to group.
-    new_expr->SetGroup(group);
-    group->AddExpression(new_expr);
+    // Alternatives the Memo already knows need no further work.
+    if (scheduler->GetMemo()->CopyIn(new_expr, group) != new_expr) {
+      continue;
+    }
+    success = true;
 
     // 3. Schedule further work
-    if (new_expr->GetOperator()->IsLogical()) {
+    if (new_expr->IsLogical()) {
       // If result is logical, we might need to explore/optimize it further
       // Usually, we schedule O_Expr on the new expression if we are exploring,
       // or if we are optimizing and want to consider this new logical path.
       scheduler->ScheduleTask(new O_Expr(new_expr, context_, exploring_));
     } else {
       // If result is physical (Implementation Rule), we need to optimize its
-      // inputs
+      // inputs, which also costs it.
       if (!exploring_) {
         scheduler->ScheduleTask(new O_Inputs(new_expr, context_));
       }
-
-      // Also update best plan if applicable (omitted cost model for now)
-      // In this skeleton, we just pick the last physical one as best.
-      group->SetBestExpression(new_expr);
     }
   }
+  scheduler->CountRule(rule_, success);
 }
 
 // 5. O_Inputs
@@ -155,11 +360,32 @@ void O_Inputs::perform(TaskScheduler *scheduler) {
 
   // If we have processed all inputs
   if (current_input_index_ >= children.size()) {
-    // All inputs optimized. We can now cost this expression (Physical).
-    // (Costing logic omitted)
+    // All inputs optimized. An input without any plan makes this expression
+    // unusable; otherwise cost it and let it compete for its group.
+    for (auto *child : children) {
+      if (!child->GetBestExpression()) {
+        return;
+      }
+    }
+    expr_->SetCost(CostModel::Compute(scheduler->GetMemo(), expr_));
+    expr_->GetGroup()->UpdateBestExpression(expr_);
     return;
   }
 
+  // Branch and bound: once the inputs optimized so far cost more than the
+  // bound, so does the expression, and its remaining inputs are not worth
+  // optimizing. It is left without a cost.
+  bool covers_inputs = CostModel::CoversInputs(expr_);
+  if (context_ && covers_inputs) {
+    double inputs_cost = 0.0;
+    for (size_t i = 0; i < current_input_index_; i++)
+      inputs_cost += children[i]->GetBestExpression()
+                         ? children[i]->GetBestExpression()->GetCost().total
+                         : 0.0;
+    if (inputs_cost > context_->GetUpperBound())
+      return;
+  }
+
   // We have more inputs to process.
 
   // 1. Push self back onto stack with incremented index
@@ -170,9 +396,11 @@ void O_Inputs::perform(TaskScheduler *scheduler) {
   next_step->current_input_index_ = current_input_index_ + 1;
   scheduler->ScheduleTask(next_step);
 
-  // 2. Push optimization task for the current input group
+  // 2. Push optimization task for the current input group. The bound only
+  // carries over to inputs whose whole cost the expression pays.
   auto *child_group = children[current_input_index_];
-  scheduler->ScheduleTask(new O_Group(child_group, context_));
+  scheduler->ScheduleTask(
+      new O_Group(child_group, covers_inputs ? context_ : nullptr));
 }
 
 } // namespace pg_carbon
@@ -3,9 +3,14 @@
 
 #include "../common/memory.h"
 #include "../rules/rules.h"
+#include "instrumentation.h"
 #include "memo.h"
 #include <stack>
 
+extern "C" {
+#include "datatype/timestamp.h"
+}
+
 namespace pg_carbon {
 
 class TaskScheduler;
@@ -13,7 +18,14 @@ class TaskScheduler;
 // Context for optimization (e.g., cost limits, required properties)
 class Context : public PgObject {
 public:
-  // For now, empty or basic. In real Columbia, holds cost definitions, etc.
+  explicit Context(double upper_bound) : upper_bound_(upper_bound) {}
+
+  // Plans costing more are of no use: branch and bound drops expressions
+  // whose inputs alone cost more
+  double GetUpperBound() const { return upper_bound_; }
+
+private:
+  double upper_bound_;
 };
 
 // ID Types
@@ -26,20 +38,97 @@ public:
   virtual ~Task() = default;
   // perform returns void in this design, logic is inside.
   virtual void perform(TaskScheduler *scheduler) = 0;
+  virtual CarbonTaskType GetType() const = 0;
+  // Called instead of perform() when the search stops first
+  virtual void Drop() {}
+};
+
+// Limits on the search, counted from the creation of the scheduler; 0
+// means no limit
+// The task budget is exact; the others are checked every 64 tasks.
+struct SearchBudget {
+  int64 time_us = 0; // wall-clock time
+  int64 tasks = 0;   // tasks performed
+  Size memory = 0;   // bytes allocated in the planner's memory context
 };
 
+// The rules come in stages, each adding to the ones before: stage 0
+// implements the query as written, stage 1 adds cheap rewrites such as
+// predicate pushdown and join commutativity, stage 2 the expensive
+// exploration of join orders and aggregate placement. The search starts
+// with stage 0 and escalates while the best plan costs too much.
 class TaskScheduler : public PgObject {
 public:
+  static constexpr int kNumStages = 3;
+
+  // Counts the search in `stats`, if given
+  explicit TaskScheduler(Memo *memo, const SearchBudget &budget = {},
+                         CarbonStats *stats = nullptr);
+
   void ScheduleTask(Task *task);
+  // Performs tasks until none are left or the budget runs out. The tasks
+  // still scheduled then are dropped, and so are any scheduled later.
   void Run();
+  bool IsExhausted() const { return exhausted_; }
+  // Most memory the search has had allocated in the planner's memory
+  // context, sampled with the budget checks and once more now
+  Size GetPeakMemory();
+
+  int GetStage() const { return stage_; }
+  void SetStage(int stage) { stage_ = stage; }
+  // Records an application of `rule`, successful if it added an expression
+  void CountRule(const Rule *rule, bool success);
+  // Moves on to the next stage and schedules the search of `group` in
+  // `context` with its rules. The Memo is kept: the expressions found so
+  // far are not explored again, but the plans of `group` and of the groups
+  // below it are costed again.
+  void Escalate(Group *group, Context *context);
+
+  // Fast path for groups an interrupted search left without a winner:
+  // applies the stage 0 rules to the group's logical expressions in order,
+  // without exploring, until one of them has a plan, completing the input
+  // groups the same way first. Ignores the budget. Returns whether `group`
+  // has a winner.
+  bool Complete(Group *group);
 
   // Helper to get available rules, effectively part of the scheduler/optimizer
   // context
   const PgVector<Rule *> &GetRules() const;
 
+  Memo *GetMemo() const { return memo_; }
+
+  // Name of the rule with index `rule_id` in the rule set, or nullptr
+  static const char *GetRuleName(int rule_id);
+
 private:
+  // Tasks performed between checks of the time and memory budgets
+  static constexpr int64 kBudgetCheckInterval = 64;
+
+  void AddRule(Rule *rule, int stage);
+  void InitRules();
+  // Clears the search state of `group` and the groups below it
+  void ResetGroup(Group *group, PgVector<bool> &reset);
+  bool IsOverBudget();
+  // Memory allocated since the search started; updates the peak
+  Size SampleMemory();
+  // Costs the physical expressions of `group` whose inputs can be
+  // completed
+  void CostPhysicalExpressions(Group *group);
+
+  Memo *memo_;
   PgStack<Task *> task_stack_;
   PgVector<Rule *> rules_; // Simplification: Rules stored here
+
+  int stage_ = 0;
+  CarbonStats *stats_;
+  SearchBudget budget_;
+  TimestampTz start_time_;
+  Size start_memory_;
+  Size peak_memory_ = 0;
+  int64 tasks_performed_ = 0;
+  bool exhausted_ = false;
+  // Groups Complete() is working on, which cannot serve as inputs yet
+  PgVector<Group *> completing_;
 };
 
 // 1. O_Group (Optimize Group)
@@ -47,6 +136,7 @@ class O_Group : public Task {
 public:
   O_Group(GroupID group, Context *context) : group_(group), context_(context) {}
   void perform(TaskScheduler *scheduler) override;
+  CarbonTaskType GetType() const override { return CARBON_TASK_O_GROUP; }
 
 private:
   GroupID group_;
@@ -58,6 +148,7 @@ class E_Group : public Task {
 public:
   E_Group(GroupID group, Context *context) : group_(group), context_(context) {}
   void perform(TaskScheduler *scheduler) override;
+  CarbonTaskType GetType() const override { return CARBON_TASK_E_GROUP; }
 
 private:
   GroupID group_;
@@ -70,6 +161,7 @@ public:
   O_Expr(MExprID expr, Context *context, bool exploring)
       : expr_(expr), context_(context), exploring_(exploring) {}
   void perform(TaskScheduler *scheduler) override;
+  CarbonTaskType GetType() const override { return CARBON_TASK_O_EXPR; }
 
 private:
   MExprID expr_;
@@ -83,6 +175,9 @@ public:
   Apply_Rule(RuleID rule, MExprID expr, Context *context, bool exploring)
       : rule_(rule), expr_(expr), context_(context), exploring_(exploring) {}
   void perform(TaskScheduler *scheduler) override;
+  CarbonTaskType GetType() const override { return CARBON_TASK_APPLY_RULE; }
+  // Leaves the rule to TaskScheduler::Complete()
+  void Drop() override { expr_->ClearAppliedRule(rule_->GetId()); }
 
 private:
   RuleID rule_;
@@ -96,6 +191,7 @@ class O_Inputs : public Task {
 public:
   O_Inputs(MExprID expr, Context *context) : expr_(expr), context_(context) {}
   void perform(TaskScheduler *scheduler) override;
+  CarbonTaskType GetType() const override { return CARBON_TASK_O_INPUTS; }
 
 private:
   MExprID expr_;
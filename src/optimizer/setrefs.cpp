@@ -0,0 +1,310 @@
+#include "setrefs.h"
+
+extern "C" {
+#include "nodes/makefuncs.h"
+#include "nodes/nodeFuncs.h"
+#include "nodes/primnodes.h"
+#include "optimizer/planner.h"
+}
+
+namespace pg_carbon {
+
+struct FixExprContext {
+  List *outer_tlist;
+  List *inner_tlist;
+  bool failed;
+};
+
+// Finds the entry of `tlist` producing `var`. Nulling markers are ignored:
+// the executor does not use them, and a column is the same column on both
+// sides of an outer join.
+static TargetEntry *FindVar(List *tlist, Var *var) {
+  ListCell *lc;
+  foreach (lc, tlist) {
+    TargetEntry *tle = (TargetEntry *)lfirst(lc);
+    Var *candidate = (Var *)tle->expr;
+    if (IsA(candidate, Var) && candidate->varno == var->varno &&
+        candidate->varattno == var->varattno &&
+        candidate->varlevelsup == 0)
+      return tle;
+  }
+  return nullptr;
+}
+
+// Finds an entry computing `node` as a whole (an expression evaluated by
+// the input node).
+static TargetEntry *FindExpr(List *tlist, Node *node) {
+  ListCell *lc;
+  foreach (lc, tlist) {
+    TargetEntry *tle = (TargetEntry *)lfirst(lc);
+    if (!IsA(tle->expr, Var) && equal(tle->expr, node))
+      return tle;
+  }
+  return nullptr;
+}
+
+static Var *MakeInputRef(Node *node, TargetEntry *tle, int varno) {
+  Var *ref;
+  if (IsA(node, Var)) {
+    ref = (Var *)copyObjectImpl(node);
+  } else {
+    ref = makeVar(varno, tle->resno, exprType(node), exprTypmod(node),
+                  exprCollation(node), 0);
+  }
+  ref->varno = varno;
+  ref->varattno = tle->resno;
+  ref->varnullingrels = nullptr;
+  return ref;
+}
+
+static Node *FixUpperExprMutator(Node *node, FixExprContext *context) {
+  if (!node)
+    return nullptr;
+
+  if (IsA(node, Var)) {
+    Var *var = (Var *)node;
+    if (var->varlevelsup == 0) {
+      if (TargetEntry *tle = FindVar(context->outer_tlist, var))
+        return (Node *)MakeInputRef(node, tle, OUTER_VAR);
+      if (TargetEntry *tle = FindVar(context->inner_tlist, var))
+        return (Node *)MakeInputRef(node, tle, INNER_VAR);
+      context->failed = true;
+    }
+    return (Node *)copyObjectImpl(node);
+  }
+
+  if (!IsA(node, Const) && !IsA(node, List) && !IsA(node, TargetEntry)) {
+    if (TargetEntry *tle = FindExpr(context->outer_tlist, node))
+      return (Node *)MakeInputRef(node, tle, OUTER_VAR);
+    if (TargetEntry *tle = FindExpr(context->inner_tlist, node))
+      return (Node *)MakeInputRef(node, tle, INNER_VAR);
+  }
+
+  return expression_tree_mutator(node, FixUpperExprMutator, context);
+}
+
+// The aggregates of an Agg that combines partial results take the partial
+// result computed below as their only argument, as in the standard planner's
+// convert_combining_aggrefs().
+static Node *ConvertCombiningAggrefsMutator(Node *node, void *context) {
+  if (!node)
+    return nullptr;
+  if (IsA(node, Aggref)) {
+    Aggref *partial = (Aggref *)copyObjectImpl(node);
+    mark_partial_aggref(partial, AGGSPLIT_INITIAL_SERIAL);
+    Aggref *combining = (Aggref *)copyObjectImpl(node);
+    combining->args =
+        list_make1(makeTargetEntry((Expr *)partial, 1, nullptr, false));
+    combining->aggfilter = nullptr;
+    mark_partial_aggref(combining, AGGSPLIT_FINAL_DESERIAL);
+    return (Node *)combining;
+  }
+  return expression_tree_mutator(node, ConvertCombiningAggrefsMutator,
+                                 context);
+}
+
+static List *ConvertCombiningAggrefs(List *exprs) {
+  return (List *)ConvertCombiningAggrefsMutator((Node *)exprs, nullptr);
+}
+
+static Node *FixScanExprMutator(Node *node, void *context) {
+  if (!node)
+    return nullptr;
+  if (IsA(node, Var)) {
+    Var *var = (Var *)copyObjectImpl(node);
+    var->varnullingrels = nullptr;
+    return (Node *)var;
+  }
+  return expression_tree_mutator(node, FixScanExprMutator, context);
+}
+
+// Expressions built by the optimizer itself (inferred predicates) do not
+// have their function oids filled in yet.
+static List *FixScanExpr(List *exprs) {
+  Node *result = FixScanExprMutator((Node *)exprs, nullptr);
+  fix_opfuncids(result);
+  return (List *)result;
+}
+
+static List *FixUpperExpr(List *exprs, FixExprContext *context) {
+  Node *result = FixUpperExprMutator((Node *)exprs, context);
+  fix_opfuncids(result);
+  return (List *)result;
+}
+
+List *SetRefs::BuildPassThroughTargetList(List *child_tlist) {
+  List *target_list = NIL;
+  ListCell *lc;
+  foreach (lc, child_tlist) {
+    TargetEntry *tle = (TargetEntry *)lfirst(lc);
+    Var *var = makeVar(OUTER_VAR, tle->resno, exprType((Node *)tle->expr),
+                       exprTypmod((Node *)tle->expr),
+                       exprCollation((Node *)tle->expr), 0);
+    target_list = lappend(target_list, makeTargetEntry((Expr *)var, tle->resno,
+                                                       tle->resname,
+                                                       tle->resjunk));
+  }
+  return target_list;
+}
+
+bool SetRefs::FixPlan(Plan *plan, int *next_node_id) {
+  if (!plan)
+    return true;
+
+  plan->plan_node_id = (*next_node_id)++;
+
+  // Children still carry their own Var-based target lists at this point,
+  // which is what the references are resolved against.
+  FixExprContext context = {nullptr, nullptr, false};
+  if (plan->lefttree)
+    context.outer_tlist = plan->lefttree->targetlist;
+  if (plan->righttree)
+    context.inner_tlist = plan->righttree->targetlist;
+
+  switch (nodeTag(plan)) {
+  case T_SeqScan:
+  case T_CteScan:
+    plan->targetlist = FixScanExpr(plan->targetlist);
+    plan->qual = FixScanExpr(plan->qual);
+    break;
+  case T_IndexScan: {
+    // Index quals reference the index columns (INDEX_VAR) already.
+    IndexScan *scan = (IndexScan *)plan;
+    plan->targetlist = FixScanExpr(plan->targetlist);
+    plan->qual = FixScanExpr(plan->qual);
+    scan->indexqual = FixScanExpr(scan->indexqual);
+    scan->indexqualorig = FixScanExpr(scan->indexqualorig);
+    break;
+  }
+  case T_Result:
+    // A childless Result references base relations directly; a gating one
+    // projects its input. The one-time qual reads no columns either way.
+    if (plan->lefttree) {
+      plan->targetlist = FixUpperExpr(plan->targetlist, &context);
+      plan->qual = FixUpperExpr(plan->qual, &context);
+    } else {
+      plan->targetlist = FixScanExpr(plan->targetlist);
+    }
+    ((Result *)plan)->resconstantqual =
+        (Node *)FixScanExpr((List *)((Result *)plan)->resconstantqual);
+    break;
+  case T_Append: {
+    // Children produce the same columns in the same order.
+    Append *append = (Append *)plan;
+    plan->targetlist = BuildPassThroughTargetList(
+        ((Plan *)linitial(append->appendplans))->targetlist);
+    ListCell *lc;
+    foreach (lc, append->appendplans) {
+      if (!FixPlan((Plan *)lfirst(lc), next_node_id))
+        return false;
+    }
+    break;
+  }
+  case T_MergeAppend: {
+    // Likewise for the sorted inputs of a MergeAppend
+    MergeAppend *merge = (MergeAppend *)plan;
+    plan->targetlist = BuildPassThroughTargetList(
+        ((Plan *)linitial(merge->mergeplans))->targetlist);
+    ListCell *lc;
+    foreach (lc, merge->mergeplans) {
+      if (!FixPlan((Plan *)lfirst(lc), next_node_id))
+        return false;
+    }
+    break;
+  }
+  case T_NestLoop:
+  case T_HashJoin:
+  case T_MergeJoin: {
+    Join *join = (Join *)plan;
+    plan->targetlist = FixUpperExpr(plan->targetlist, &context);
+    plan->qual = FixUpperExpr(plan->qual, &context);
+    join->joinqual = FixUpperExpr(join->joinqual, &context);
+    if (IsA(plan, HashJoin)) {
+      HashJoin *hash_join = (HashJoin *)plan;
+      hash_join->hashclauses =
+          FixUpperExpr(hash_join->hashclauses, &context);
+      // The probe keys are evaluated on outer tuples only.
+      FixExprContext outer_context = {context.outer_tlist, nullptr, false};
+      hash_join->hashkeys = FixUpperExpr(hash_join->hashkeys, &outer_context);
+      context.failed |= outer_context.failed;
+    } else if (IsA(plan, MergeJoin)) {
+      MergeJoin *merge_join = (MergeJoin *)plan;
+      merge_join->mergeclauses =
+          FixUpperExpr(merge_join->mergeclauses, &context);
+    } else {
+      // Parameter values come from the outer tuple.
+      FixExprContext outer_context = {context.outer_tlist, nullptr, false};
+      ListCell *lc;
+      foreach (lc, ((NestLoop *)plan)->nestParams) {
+        NestLoopParam *param = (NestLoopParam *)lfirst(lc);
+        param->paramval = (Var *)FixUpperExprMutator(
+            (Node *)param->paramval, &outer_context);
+      }
+      context.failed |= outer_context.failed;
+    }
+    break;
+  }
+  case T_Hash: {
+    // The build keys are evaluated on the Hash node's own input.
+    Hash *hash = (Hash *)plan;
+    hash->hashkeys = FixUpperExpr(hash->hashkeys, &context);
+    plan->targetlist =
+        BuildPassThroughTargetList(plan->lefttree->targetlist);
+    break;
+  }
+  case T_Agg:
+    if (DO_AGGSPLIT_COMBINE(((Agg *)plan)->aggsplit)) {
+      plan->targetlist = ConvertCombiningAggrefs(plan->targetlist);
+      plan->qual = ConvertCombiningAggrefs(plan->qual);
+    }
+    plan->targetlist = FixUpperExpr(plan->targetlist, &context);
+    plan->qual = FixUpperExpr(plan->qual, &context);
+    break;
+  case T_WindowAgg: {
+    // The frame offsets are evaluated once, like scan expressions.
+    WindowAgg *window = (WindowAgg *)plan;
+    plan->targetlist = FixUpperExpr(plan->targetlist, &context);
+    window->startOffset = (Node *)FixScanExpr((List *)window->startOffset);
+    window->endOffset = (Node *)FixScanExpr((List *)window->endOffset);
+    break;
+  }
+  case T_Memoize:
+    // The cache keys are Params set by the nested loop above.
+    ((Memoize *)plan)->param_exprs =
+        FixScanExpr(((Memoize *)plan)->param_exprs);
+    plan->targetlist =
+        BuildPassThroughTargetList(plan->lefttree->targetlist);
+    break;
+  case T_Sort:
+  case T_IncrementalSort:
+  case T_Limit:
+  case T_Material:
+  case T_SetOp:
+    plan->targetlist =
+        BuildPassThroughTargetList(plan->lefttree->targetlist);
+    break;
+  default:
+    elog(DEBUG1, "pg_carbon: unexpected plan node %d in set references",
+         (int)nodeTag(plan));
+    return false;
+  }
+
+  if (context.failed)
+    return false;
+
+  return FixPlan(plan->lefttree, next_node_id) &&
+         FixPlan(plan->righttree, next_node_id);
+}
+
+bool SetRefs::SetPlanReferences(Plan *plan, List *subplans) {
+  // Node ids are unique across all the plans of the statement.
+  int next_node_id = 0;
+  ListCell *lc;
+  foreach (lc, subplans) {
+    if (!FixPlan((Plan *)lfirst(lc), &next_node_id))
+      return false;
+  }
+  return FixPlan(plan, &next_node_id);
+}
+
+} // namespace pg_carbon
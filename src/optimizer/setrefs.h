@@ -0,0 +1,40 @@
+#ifndef PG_CARBON_SETREFS_H
+#define PG_CARBON_SETREFS_H
+
+#include "../common/memory.h"
+
+// clang-format off
+extern "C" {
+#include "postgres.h"
+#include "nodes/plannodes.h"
+}
+// clang-format on
+
+namespace pg_carbon {
+
+// Last pass over the plan built by the Translator, the counterpart of PG's
+// set_plan_references().
+//
+// The Translator gives every node a target list and quals in terms of the
+// query's range table Vars. Above the scans the executor instead expects
+// references to the input tuples (OUTER_VAR / INNER_VAR), and nodes that
+// cannot project (Sort, Limit, Material) have to pass their input through
+// unchanged. This pass rewrites the tree top-down accordingly, fills in the
+// operator function oids and numbers the nodes.
+class SetRefs {
+public:
+  // Finishes `plan` and the CTE plans in `subplans`. Returns false if an
+  // expression needs a column its inputs do not produce; the plan is
+  // unusable then.
+  static bool SetPlanReferences(Plan *plan, List *subplans = NIL);
+
+  // OUTER_VAR references to every column of `child_tlist`
+  static List *BuildPassThroughTargetList(List *child_tlist);
+
+private:
+  static bool FixPlan(Plan *plan, int *next_node_id);
+};
+
+} // namespace pg_carbon
+
+#endif // PG_CARBON_SETREFS_H
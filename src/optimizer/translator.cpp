@@ -1,73 +1,221 @@
 #include "translator.h"
+#include "../cost/cost_model.h"
+#include "../metadata/metadata.h"
 #include "../operators/operators.h"
+#include "ordering.h"
+#include <algorithm>
 #include <iostream>
 
 extern "C" {
+#include "access/htup_details.h"
+#include "access/table.h"
+#include "catalog/pg_aggregate.h"
+#include "catalog/pg_class.h"
+#include "catalog/pg_inherits.h"
+#include "access/stratnum.h"
 #include "catalog/pg_type.h"
 #include "nodes/makefuncs.h"
 #include "nodes/nodeFuncs.h"
 #include "nodes/primnodes.h"
+#include "optimizer/appendinfo.h"
+#include "optimizer/clauses.h"
+#include "optimizer/optimizer.h"
+#include "optimizer/tlist.h"
+#include "parser/parse_coerce.h"
 #include "parser/parse_collate.h"
+#include "parser/parsetree.h"
+#include "rewrite/rewriteManip.h"
+#include "storage/lmgr.h"
 #include "utils/lsyscache.h"
+#include "utils/rel.h"
+#include "utils/syscache.h"
+#include "utils/typcache.h"
 }
 
 namespace pg_carbon {
 
-// Helper walker to change Vars to OUTER_VAR in place
+// Helper walker collecting the attributes referenced by an expression.
+// Sublinks are descended into so that outer references made by a subquery
+// count as well.
+struct CollectAttrsContext {
+  AttrSet *attrs;
+  Index sublevels_up;
+};
 
-Operator *Translator::TranslateQueryToCarbon(Query *pg_query) {
-  // 1. Translation of the FROM clause (Join Tree)
-  // For now, we still assume a simple relation scan or single table.
-  // In the future, this should handle joins recursively.
-  Operator *current_op = nullptr;
-
-  if (pg_query->rtable && pg_query->jointree && pg_query->jointree->fromlist) {
-    List *fromlist = pg_query->jointree->fromlist;
-    if (list_length(fromlist) == 1) {
-      Node *node = (Node *)linitial(fromlist);
-      if (IsA(node, RangeTblRef)) {
-        RangeTblRef *rtr = (RangeTblRef *)node;
-        RangeTblEntry *rte =
-            (RangeTblEntry *)list_nth(pg_query->rtable, rtr->rtindex - 1);
-
-        if (rte->rtekind == RTE_RELATION) {
-          current_op = new LogicalGet(rte->relid, rtr->rtindex);
-        }
-      }
+static bool CollectAttrsWalker(Node *node, CollectAttrsContext *context) {
+  if (!node)
+    return false;
+  if (IsA(node, Var)) {
+    Var *var = (Var *)node;
+    if (var->varlevelsup == context->sublevels_up)
+      context->attrs->Add(var->varno, var->varattno);
+    return false;
+  }
+  if (IsA(node, Query)) {
+    context->sublevels_up++;
+    bool result =
+        query_tree_walker((Query *)node, CollectAttrsWalker, context, 0);
+    context->sublevels_up--;
+    return result;
+  }
+  return expression_tree_walker(node, CollectAttrsWalker, context);
+}
+
+void Translator::CollectAttrs(Node *node, AttrSet *attrs) {
+  CollectAttrsContext context = {attrs, 0};
+  CollectAttrsWalker(node, &context);
+}
+
+// Adds the conjuncts of every ON clause reachable from `jtnode` through
+// inner joins only. Below an outer join, quals no longer hold for the whole
+// query; the left input of a semi, anti or left join is still in scope,
+// though.
+static void CollectInnerJoinQuals(Node *jtnode, List **quals) {
+  if (IsA(jtnode, JoinExpr)) {
+    JoinExpr *join = (JoinExpr *)jtnode;
+    if (join->jointype == JOIN_SEMI || join->jointype == JOIN_ANTI ||
+        join->jointype == JOIN_LEFT) {
+      CollectInnerJoinQuals(join->larg, quals);
+      return;
     }
+    if (join->jointype != JOIN_INNER)
+      return;
+    *quals = list_concat(*quals, make_ands_implicit((Expr *)join->quals));
+    CollectInnerJoinQuals(join->larg, quals);
+    CollectInnerJoinQuals(join->rarg, quals);
+  } else if (IsA(jtnode, FromExpr)) {
+    ListCell *lc;
+    foreach (lc, ((FromExpr *)jtnode)->fromlist)
+      CollectInnerJoinQuals((Node *)lfirst(lc), quals);
   }
+}
 
-  if (!current_op) {
-    return nullptr;
+// Adds to `restrictions` the quals in `quals` or in the join tree below
+// `jtnode` that every row a base relation contributes has to satisfy: the
+// non-volatile ones that only read that relation. Quals above an outer
+// join do not restrict its nullable side, where failing rows would turn
+// into null-extended ones instead of disappearing.
+static void CollectRestrictions(Node *jtnode, List *quals,
+                                PgUnorderedMap<Index, List *> *restrictions) {
+  if (IsA(jtnode, RangeTblRef)) {
+    Index rtindex = ((RangeTblRef *)jtnode)->rtindex;
+    ColSet relids = ColSet::MakeSingleton(rtindex);
+    ListCell *lc;
+    foreach (lc, quals) {
+      Node *qual = (Node *)lfirst(lc);
+      AttrSet attrs;
+      Translator::CollectAttrs(qual, &attrs);
+      if (attrs.GetRelids().Equals(relids) &&
+          !contain_volatile_functions(qual))
+        (*restrictions)[rtindex] = lappend((*restrictions)[rtindex], qual);
+    }
+  } else if (IsA(jtnode, JoinExpr)) {
+    JoinExpr *join = (JoinExpr *)jtnode;
+    List *join_quals = make_ands_implicit((Expr *)join->quals);
+    switch (join->jointype) {
+    case JOIN_INNER:
+      quals = list_concat_copy(quals, join_quals);
+      CollectRestrictions(join->larg, quals, restrictions);
+      CollectRestrictions(join->rarg, quals, restrictions);
+      break;
+    case JOIN_LEFT:
+    case JOIN_SEMI:
+    case JOIN_ANTI:
+      CollectRestrictions(join->larg, quals, restrictions);
+      CollectRestrictions(join->rarg, join_quals, restrictions);
+      break;
+    case JOIN_RIGHT:
+      CollectRestrictions(join->larg, join_quals, restrictions);
+      CollectRestrictions(join->rarg, quals, restrictions);
+      break;
+    default:
+      break;
+    }
+  } else if (IsA(jtnode, FromExpr)) {
+    FromExpr *from = (FromExpr *)jtnode;
+    quals = list_concat_copy(quals, make_ands_implicit((Expr *)from->quals));
+    ListCell *lc;
+    foreach (lc, from->fromlist)
+      CollectRestrictions((Node *)lfirst(lc), quals, restrictions);
   }
+}
 
-  // 2. Filter (WHERE clause)
-  if (pg_query->jointree->quals) {
-    auto filter = new LogicalFilter(pg_query->jointree->quals);
-    filter->AddInput(current_op);
-    current_op = filter;
+bool Translator::IsSupportedQuery(Query *pg_query) const {
+  if (pg_query->commandType != CMD_SELECT || pg_query->utilityStmt)
+    return false;
+  if (pg_query->hasSubLinks || pg_query->hasTargetSRFs ||
+      pg_query->hasRecursive || pg_query->hasModifyingCTE ||
+      pg_query->hasForUpdate)
+    return false;
+  if ((pg_query->cteList && pg_query != query_) ||
+      pg_query->distinctClause || pg_query->groupingSets ||
+      pg_query->rowMarks)
+    return false;
+  // The leaves of a set operation are checked as they are translated.
+  if (pg_query->setOperations)
+    return true;
+  return pg_query->jointree && pg_query->jointree->fromlist;
+}
+
+// A set operation subquery whose leaves Preprocess::FlattenSetOperations()
+// has merged into the query. ORDER BY and LIMIT would need a Sort and a
+// Limit below whatever reads it, which only the query's own set operation
+// gets.
+static bool IsFlattenedSetOperation(Query *subquery) {
+  return subquery->setOperations && !subquery->rtable &&
+         !subquery->sortClause && !subquery->limitOffset &&
+         !subquery->limitCount &&
+         list_length(subquery->targetList) ==
+             list_length(((SetOperationStmt *)subquery->setOperations)
+                             ->colTypes);
+}
+
+// Leftmost leaf of a set operation tree. The standard planner's target
+// lists refer to the output columns through it, and so do ours for set
+// operations without a range table entry of their own.
+static Index LeftmostLeaf(Node *node) {
+  while (IsA(node, SetOperationStmt))
+    node = ((SetOperationStmt *)node)->larg;
+  return ((RangeTblRef *)node)->rtindex;
+}
+
+Operator *Translator::TranslateQueryToCarbon(Query *pg_query) {
+  query_ = pg_query;
+  if (!IsSupportedQuery(pg_query)) {
+    return nullptr;
   }
 
-  // 3. Aggregation (GROUP BY / HAVING / Aggs) -> UNSUPPORTED
-  if (pg_query->groupClause || pg_query->hasAggs || pg_query->havingQual) {
+  selectivity_ = new SelectivityEstimator(pg_query);
+  cte_producers_.assign(list_length(pg_query->cteList), nullptr);
+
+  // 0.-4. FROM, WHERE, aggregation and windows, or the set operation over
+  // the leaves that have them
+  Operator *current_op =
+      pg_query->setOperations
+          ? TranslateSetOperation(
+                (SetOperationStmt *)pg_query->setOperations,
+                LeftmostLeaf(pg_query->setOperations))
+          : TranslateSelect(pg_query);
+
+  if (!current_op) {
     return nullptr;
   }
 
-  // 4. Sort (ORDER BY)
+  // 5. Sort (ORDER BY)
   if (pg_query->sortClause) {
-    auto sort = new LogicalSort(pg_query->sortClause);
+    auto sort = new LogicalSort(pg_query->sortClause, pg_query->targetList);
     sort->AddInput(current_op);
     current_op = sort;
   }
 
-  // 5. Limit (LIMIT / OFFSET)
+  // 6. Limit (LIMIT / OFFSET)
   if (pg_query->limitOffset || pg_query->limitCount) {
     auto limit = new LogicalLimit(pg_query->limitOffset, pg_query->limitCount);
     limit->AddInput(current_op);
     current_op = limit;
   }
 
-  // 6. Projection (TargetList)
+  // 7. Projection (TargetList)
   // We always add a projection node at the top to represent the final output
   // targets.
   if (pg_query->targetList) {
@@ -76,9 +224,851 @@ Operator *Translator::TranslateQueryToCarbon(Query *pg_query) {
     current_op = projection;
   }
 
+  // 8. Column pruning: work out top-down which columns every operator has to
+  // produce. Without a target list nothing is needed from the scans at all.
+  // The shared plans of CTEs produce all of their columns.
+  DeriveRequiredColumns(current_op, new AttrSet());
+  for (Operator *producer : cte_producers_) {
+    if (producer)
+      DeriveRequiredColumns(producer, new AttrSet());
+  }
+
   return current_op;
 }
 
+Operator *Translator::TranslateSelect(Query *select) {
+  if (!IsSupportedQuery(select))
+    return nullptr;
+
+  // 0. Equivalence classes over the WHERE clause and the inner join quals
+  List *where_clauses = make_ands_implicit((Expr *)select->jointree->quals);
+  List *join_clauses = NIL;
+  CollectInnerJoinQuals((Node *)select->jointree, &join_clauses);
+
+  // Set operation leaves are translated in the middle of the query's own
+  // translation and have classes of their own.
+  EquivalenceClasses *outer_classes = equivalence_classes_;
+  equivalence_classes_ = new EquivalenceClasses();
+  ListCell *lc;
+  foreach (lc, where_clauses)
+    equivalence_classes_->AddClause((Node *)lfirst(lc));
+  foreach (lc, join_clauses)
+    equivalence_classes_->AddClause((Node *)lfirst(lc));
+
+  // The WHERE clause together with the constant comparisons the
+  // equivalence classes imply, which also take part in partition pruning
+  where_clauses = list_concat(where_clauses,
+                              equivalence_classes_->GetImpliedClauses());
+  foreach (lc, select->jointree->fromlist)
+    CollectRestrictions((Node *)lfirst(lc), where_clauses, &restrictions_);
+
+  // 1. Translation of the FROM clause (Join Tree)
+  Operator *current_op = TranslateFromList(select->jointree->fromlist);
+
+  // 2. Filter (WHERE clause). Predicate pushdown moves each predicate as far
+  // down as it can go.
+  if (current_op && where_clauses) {
+    auto filter = new LogicalFilter(MakePredicates(where_clauses));
+    filter->AddInput(current_op);
+    current_op = filter;
+  }
+
+  // 3. Aggregation (GROUP BY / HAVING / Aggs)
+  if (current_op &&
+      (select->groupClause || select->hasAggs || select->havingQual)) {
+    current_op = TranslateAggregation(select, current_op);
+  }
+
+  // 4. Window functions
+  if (current_op && select->hasWindowFuncs)
+    current_op = TranslateWindows(select, current_op);
+
+  equivalence_classes_ = outer_classes;
+  return current_op;
+}
+
+// Adds the inputs of a UNION, looking through the nested UNIONs whose rows
+// it can take as they are, as recurse_union_children() does
+static void CollectUnionInputs(Node *node, SetOperationStmt *top,
+                               PgVector<Node *> *inputs) {
+  if (IsA(node, SetOperationStmt)) {
+    auto *setop = (SetOperationStmt *)node;
+    if (setop->op == top->op && (setop->all == top->all || setop->all) &&
+        equal(setop->colTypes, top->colTypes) &&
+        equal(setop->colCollations, top->colCollations)) {
+      CollectUnionInputs(setop->larg, top, inputs);
+      CollectUnionInputs(setop->rarg, top, inputs);
+      return;
+    }
+  }
+  inputs->push_back(node);
+}
+
+// `columns` converted to the column types of `setop`, as
+// generate_setop_tlist() does for the standard planner's leaves
+static List *CoerceSetOperationColumns(List *columns,
+                                       SetOperationStmt *setop) {
+  List *result = NIL;
+  for (int k = 0; k < list_length(columns); k++) {
+    Node *expr = (Node *)copyObjectImpl(list_nth(columns, k));
+    Oid type = list_nth_oid(setop->colTypes, k);
+    int32 typmod = list_nth_int(setop->colTypmods, k);
+    Oid collation = list_nth_oid(setop->colCollations, k);
+    if (exprType(expr) != type)
+      expr = coerce_to_common_type(nullptr, expr, type,
+                                   "UNION/INTERSECT/EXCEPT");
+    if (exprTypmod(expr) != typmod || exprCollation(expr) != collation)
+      expr = applyRelabelType(expr, type, typmod, collation,
+                              COERCE_IMPLICIT_CAST, -1, false);
+    result = lappend(result, expr);
+  }
+  return result;
+}
+
+// Var(rtindex, k) for every output column of `setop`
+static List *SetOperationOutputs(SetOperationStmt *setop, Index rtindex) {
+  List *outputs = NIL;
+  for (int k = 0; k < list_length(setop->colTypes); k++) {
+    outputs = lappend(outputs,
+                      makeVar(rtindex, k + 1, list_nth_oid(setop->colTypes, k),
+                              list_nth_int(setop->colTypmods, k),
+                              list_nth_oid(setop->colCollations, k), 0));
+  }
+  return outputs;
+}
+
+Operator *Translator::TranslateSetOperation(SetOperationStmt *setop,
+                                            Index rtindex) {
+  PgVector<Node *> args;
+  if (setop->op == SETOP_UNION) {
+    CollectUnionInputs(setop->larg, setop, &args);
+    CollectUnionInputs(setop->rarg, setop, &args);
+  } else {
+    args = {setop->larg, setop->rarg};
+  }
+
+  PgVector<Operator *> inputs;
+  PgVector<List *> input_columns;
+  for (Node *arg : args) {
+    List *columns = NIL;
+    Operator *input = TranslateSetOperationInput(arg, &columns);
+    if (!input || list_length(columns) != list_length(setop->colTypes))
+      return nullptr;
+    inputs.push_back(input);
+    input_columns.push_back(CoerceSetOperationColumns(columns, setop));
+  }
+
+  auto *op = new LogicalSetOperation(setop->op, setop->all, rtindex,
+                                     std::move(input_columns),
+                                     setop->groupClauses);
+  for (Operator *input : inputs)
+    op->AddInput(input);
+  return op;
+}
+
+Operator *Translator::TranslateSetOperationInput(Node *arg, List **columns) {
+  // A nested set operation produces its columns under its leftmost leaf.
+  if (IsA(arg, SetOperationStmt)) {
+    auto *setop = (SetOperationStmt *)arg;
+    *columns = SetOperationOutputs(setop, LeftmostLeaf(arg));
+    return TranslateSetOperation(setop, LeftmostLeaf(arg));
+  }
+
+  Index rtindex = ((RangeTblRef *)arg)->rtindex;
+  Query *subquery = rt_fetch(rtindex, query_->rtable)->subquery;
+  if (subquery->setOperations) {
+    if (!IsFlattenedSetOperation(subquery) || !IsSupportedQuery(subquery))
+      return nullptr;
+    auto *setop = (SetOperationStmt *)subquery->setOperations;
+    *columns = SetOperationOutputs(setop, rtindex);
+    return TranslateSetOperation(setop, rtindex);
+  }
+
+  // A SELECT whose range table has been merged into the query's; ORDER BY
+  // and LIMIT would have to be applied below the set operation.
+  if (subquery->rtable || subquery->sortClause || subquery->limitOffset ||
+      subquery->limitCount)
+    return nullptr;
+  ListCell *lc;
+  foreach (lc, subquery->targetList) {
+    TargetEntry *tle = (TargetEntry *)lfirst(lc);
+    if (!tle->resjunk)
+      *columns = lappend(*columns, tle->expr);
+  }
+  return TranslateSelect(subquery);
+}
+
+Operator *Translator::TranslateFromList(List *fromlist) {
+  // Comma-separated FROM items are cross joined; the WHERE clause above
+  // supplies the join predicates.
+  Operator *result = nullptr;
+  ListCell *lc;
+  foreach (lc, fromlist) {
+    Operator *item = TranslateFromItem((Node *)lfirst(lc));
+    if (!item)
+      return nullptr;
+    if (!result) {
+      result = item;
+      continue;
+    }
+    auto join = new LogicalInnerJoin();
+    join->AddInput(result);
+    join->AddInput(item);
+    result = join;
+  }
+  return result;
+}
+
+Operator *Translator::TranslateFromItem(Node *item) {
+  if (IsA(item, RangeTblRef)) {
+    RangeTblRef *rtr = (RangeTblRef *)item;
+    RangeTblEntry *rte = rt_fetch(rtr->rtindex, query_->rtable);
+
+    if (rte->rtekind == RTE_RELATION &&
+        rte->relkind == RELKIND_PARTITIONED_TABLE && rte->inh &&
+        !rte->tablesample)
+      return TranslatePartitionedTable(rte, rtr->rtindex);
+
+    // UNION ALL views and other set operations in FROM
+    if (rte->rtekind == RTE_SUBQUERY &&
+        IsFlattenedSetOperation(rte->subquery) &&
+        IsSupportedQuery(rte->subquery))
+      return TranslateSetOperation(
+          (SetOperationStmt *)rte->subquery->setOperations, rtr->rtindex);
+
+    if (rte->rtekind == RTE_CTE)
+      return TranslateCteReference(rte, rtr->rtindex);
+
+    // Plain tables only: inheritance parents would need their children
+    // scanned as well, and foreign tables need their FDW.
+    if (rte->rtekind != RTE_RELATION || rte->tablesample ||
+        (rte->relkind != RELKIND_RELATION && rte->relkind != RELKIND_MATVIEW) ||
+        (rte->inh && has_subclass(rte->relid)))
+      return nullptr;
+
+    return new LogicalGet(rte->relid, rtr->rtindex);
+  }
+
+  if (IsA(item, JoinExpr)) {
+    JoinExpr *join_expr = (JoinExpr *)item;
+    Operator *left = TranslateFromItem(join_expr->larg);
+    Operator *right = TranslateFromItem(join_expr->rarg);
+    if (!left || !right)
+      return nullptr;
+    // A right join is a left join with its inputs swapped.
+    if (join_expr->jointype == JOIN_RIGHT)
+      std::swap(left, right);
+
+    List *quals = make_ands_implicit((Expr *)join_expr->quals);
+    LogicalJoin *join;
+    switch (join_expr->jointype) {
+    case JOIN_INNER:
+      join = new LogicalInnerJoin(MakePredicates(quals));
+      break;
+    case JOIN_SEMI:
+      join = new LogicalSemiJoin(
+          MakeSemiJoinPredicates(quals, join_expr->rarg));
+      break;
+    case JOIN_ANTI:
+      join = new LogicalAntiJoin(
+          MakeSemiJoinPredicates(quals, join_expr->rarg));
+      break;
+    case JOIN_LEFT:
+    case JOIN_RIGHT:
+      join = new LogicalLeftJoin(MakePredicates(quals));
+      break;
+    case JOIN_FULL:
+      join = new LogicalFullJoin(MakePredicates(quals));
+      break;
+    default:
+      return nullptr;
+    }
+    join->AddInput(left);
+    join->AddInput(right);
+    return join;
+  }
+
+  // Nested join tree, as left behind by sublink pull-up
+  if (IsA(item, FromExpr)) {
+    FromExpr *from = (FromExpr *)item;
+    Operator *result = TranslateFromList(from->fromlist);
+    if (result && from->quals) {
+      auto filter = new LogicalFilter(
+          MakePredicates(make_ands_implicit((Expr *)from->quals)));
+      filter->AddInput(result);
+      result = filter;
+    }
+    return result;
+  }
+
+  return nullptr;
+}
+
+// Partition key values a partitioned table's quals compare the key columns
+// to, where those are only known at execution time: query parameters of a
+// generic plan, for instance. Substituted into a partition's constraint,
+// they turn it into a check that can skip the partition's scan.
+struct PartitionKeyValues {
+  Index rtindex;
+  const TableMetadata *metadata;
+  PgVector<Node *> values; // per key column, nullptr if unknown
+};
+
+static void FindPartitionKeyValues(List *quals, PartitionKeyValues *context) {
+  const TableMetadata *metadata = context->metadata;
+  int16 strategy = metadata->partition_strategy == PARTITION_STRATEGY_HASH
+                       ? HTEqualStrategyNumber
+                       : BTEqualStrategyNumber;
+  context->values.assign(metadata->partition_key.size(), nullptr);
+  ListCell *lc;
+  foreach (lc, quals) {
+    OpExpr *clause = (OpExpr *)lfirst(lc);
+    if (!IsA(clause, OpExpr) || list_length(clause->args) != 2)
+      continue;
+    for (int side = 0; side < 2; side++) {
+      Var *var = (Var *)list_nth(clause->args, side);
+      Node *value = (Node *)list_nth(clause->args, 1 - side);
+      if (!IsA(var, Var) || var->varno != (int)context->rtindex ||
+          IsA(value, Const) || contain_var_clause(value) ||
+          contain_volatile_functions(value) ||
+          exprType(value) != var->vartype ||
+          exprCollation(value) != var->varcollid)
+        continue;
+      for (size_t i = 0; i < metadata->partition_key.size(); i++) {
+        if (metadata->partition_key[i] == var->varattno &&
+            get_op_opfamily_strategy(clause->opno,
+                                     metadata->partition_opfamilies[i]) ==
+                strategy)
+          context->values[i] = value;
+      }
+    }
+  }
+}
+
+static Node *SubstituteKeyValuesMutator(Node *node, void *context) {
+  auto *key_values = (PartitionKeyValues *)context;
+  if (!node)
+    return nullptr;
+  if (IsA(node, Var) && ((Var *)node)->varno == (int)key_values->rtindex &&
+      ((Var *)node)->varlevelsup == 0) {
+    const TableMetadata *metadata = key_values->metadata;
+    for (size_t i = 0; i < metadata->partition_key.size(); i++) {
+      if (metadata->partition_key[i] == ((Var *)node)->varattno &&
+          key_values->values[i])
+        return (Node *)copyObjectImpl(key_values->values[i]);
+    }
+  }
+  return expression_tree_mutator(node, SubstituteKeyValuesMutator, context);
+}
+
+// The conjuncts of `constraint` that the key values decide on their own
+static List *PartitionGate(List *constraint,
+                           PartitionKeyValues *key_values) {
+  List *gate = NIL;
+  ListCell *lc;
+  foreach (lc, constraint) {
+    Node *conjunct = SubstituteKeyValuesMutator((Node *)lfirst(lc), key_values);
+    if (!contain_var_clause(conjunct))
+      gate = lappend(gate, conjunct);
+  }
+  return gate;
+}
+
+Operator *Translator::TranslatePartitionedTable(RangeTblEntry *rte,
+                                                Index rtindex) {
+  const TableMetadata *metadata =
+      MetadataAccessor::GetTableMetadata(rte->relid);
+  if (!metadata || !metadata->partitioned || metadata->partitions.empty())
+    return nullptr;
+
+  // Plan-time pruning: partitions whose constraint contradicts the quals
+  // are left out. The others are scanned behind a gate on the key values
+  // only known at execution time, if there are any.
+  List *quals = restrictions_[rtindex];
+  PartitionKeyValues key_values = {rtindex, metadata, {}};
+  FindPartitionKeyValues(quals, &key_values);
+  bool has_key_values = false;
+  for (Node *value : key_values.values)
+    has_key_values |= value != nullptr;
+
+  PgVector<int> live;
+  PgVector<Operator *> branches;
+  for (size_t i = 0; i < metadata->partitions.size(); i++) {
+    const PartitionLeaf &leaf = metadata->partitions[i];
+    List *constraint = (List *)copyObjectImpl(leaf.constraint);
+    ChangeVarNodes((Node *)constraint, 1, rtindex, 0);
+    if (quals && predicate_refuted_by(constraint, quals, false))
+      continue;
+    // Foreign partitions would need their FDW.
+    if (leaf.relkind != RELKIND_RELATION)
+      return nullptr;
+
+    Operator *branch = new LogicalGet(rte->relid, rtindex, leaf.relid);
+    List *gate =
+        has_key_values ? PartitionGate(constraint, &key_values) : NIL;
+    if (gate) {
+      auto *filter = new LogicalFilter(MakePredicates(gate));
+      filter->AddInput(branch);
+      branch = filter;
+    }
+    live.push_back(i);
+    branches.push_back(branch);
+  }
+
+  // With every partition pruned, one stands in for the table behind a
+  // false filter, so the plan still has the table's columns.
+  if (branches.empty()) {
+    auto *filter = new LogicalFilter(
+        MakePredicates(list_make1(makeBoolConst(false, false))));
+    filter->AddInput(
+        new LogicalGet(rte->relid, rtindex, metadata->partitions[0].relid));
+    branches.push_back(filter);
+  }
+
+  auto *append = new LogicalAppend(rte->relid, rtindex, std::move(live));
+  for (Operator *branch : branches)
+    append->AddInput(branch);
+  return append;
+}
+
+static bool CollectAggrefsWalker(Node *node, List **aggrefs) {
+  if (!node)
+    return false;
+  if (IsA(node, Aggref)) {
+    if (!list_member(*aggrefs, node))
+      *aggrefs = lappend(*aggrefs, node);
+    return false;
+  }
+  return expression_tree_walker(node, CollectAggrefsWalker, (void *)aggrefs);
+}
+
+// Whether every aggregate can be computed in a partial and a final phase:
+// plain aggregates with a combine function and, for an internal transition
+// state, functions to serialize it (the standard planner's
+// hasNonPartialAggs and hasNonSerialAggs).
+static bool IsPartialAggregable(List *aggrefs) {
+  ListCell *lc;
+  foreach (lc, aggrefs) {
+    Aggref *aggref = (Aggref *)lfirst(lc);
+    if (aggref->aggkind != AGGKIND_NORMAL || aggref->aggdistinct ||
+        aggref->aggorder)
+      return false;
+    HeapTuple tuple =
+        SearchSysCache1(AGGFNOID, ObjectIdGetDatum(aggref->aggfnoid));
+    if (!HeapTupleIsValid(tuple))
+      return false;
+    Form_pg_aggregate form = (Form_pg_aggregate)GETSTRUCT(tuple);
+    bool splittable = OidIsValid(form->aggcombinefn) &&
+                      (aggref->aggtranstype != INTERNALOID ||
+                       (OidIsValid(form->aggserialfn) &&
+                        OidIsValid(form->aggdeserialfn)));
+    ReleaseSysCache(tuple);
+    if (!splittable)
+      return false;
+  }
+  return true;
+}
+
+Operator *Translator::TranslateAggregation(Query *select, Operator *input) {
+  GroupKeyList keys;
+  ListCell *lc;
+  foreach (lc, select->groupClause) {
+    SortGroupClause *sgc = (SortGroupClause *)lfirst(lc);
+    keys.push_back({get_sortgroupclause_expr(sgc, select->targetList),
+                    sgc->eqop, sgc->sortop, sgc->hashable});
+  }
+
+  List *aggrefs = NIL;
+  CollectAggrefsWalker((Node *)select->targetList, &aggrefs);
+  CollectAggrefsWalker(select->havingQual, &aggrefs);
+
+  auto *agg = new LogicalAggregate(std::move(keys), aggrefs, AGGSPLIT_SIMPLE,
+                                   IsPartialAggregable(aggrefs));
+  agg->AddInput(input);
+  if (!select->havingQual)
+    return agg;
+
+  auto *having = new LogicalFilter(
+      MakePredicates(make_ands_implicit((Expr *)select->havingQual)));
+  having->AddInput(agg);
+  return having;
+}
+
+static bool CollectWindowFuncsWalker(Node *node, List **funcs) {
+  if (!node)
+    return false;
+  if (IsA(node, WindowFunc)) {
+    if (!list_member(*funcs, node))
+      *funcs = lappend(*funcs, node);
+    return false;
+  }
+  return expression_tree_walker(node, CollectWindowFuncsWalker,
+                                (void *)funcs);
+}
+
+// The keys a window sorts its input on: the PARTITION BY clauses followed
+// by the ORDER BY clauses, leaving out columns already partitioned on
+// (which are in order within each partition anyway)
+static List *WindowSortClauses(WindowClause *clause) {
+  List *clauses = list_copy(clause->partitionClause);
+  ListCell *lc;
+  foreach (lc, clause->orderClause) {
+    SortGroupClause *sgc = (SortGroupClause *)lfirst(lc);
+    bool partitioned = false;
+    ListCell *l;
+    foreach (l, clause->partitionClause) {
+      partitioned |= ((SortGroupClause *)lfirst(l))->tleSortGroupRef ==
+                     sgc->tleSortGroupRef;
+    }
+    if (!partitioned)
+      clauses = lappend(clauses, sgc);
+  }
+  return clauses;
+}
+
+// Whether the window sorting on `a` is computed below the one sorting on
+// `b`. As in the standard planner's common_prefix_cmp(), windows are
+// ordered on their sort clauses, so those sharing a prefix end up next to
+// each other, and a window comes before those whose keys are a prefix of
+// its own: they find the rows sorted already.
+static bool ComputedBefore(List *a, List *b) {
+  ListCell *la;
+  ListCell *lb;
+  forboth (la, a, lb, b) {
+    SortGroupClause *x = (SortGroupClause *)lfirst(la);
+    SortGroupClause *y = (SortGroupClause *)lfirst(lb);
+    if (x->tleSortGroupRef != y->tleSortGroupRef)
+      return x->tleSortGroupRef > y->tleSortGroupRef;
+    if (x->sortop != y->sortop)
+      return x->sortop > y->sortop;
+    if (x->nulls_first != y->nulls_first)
+      return x->nulls_first;
+  }
+  return list_length(a) > list_length(b);
+}
+
+Operator *Translator::TranslateWindows(Query *select, Operator *input) {
+  // Window functions can only appear in the target list (ORDER BY entries
+  // included).
+  List *funcs = NIL;
+  CollectWindowFuncsWalker((Node *)select->targetList, &funcs);
+
+  struct Window {
+    WindowClause *clause;
+    List *sort_clauses;
+    List *funcs;
+  };
+  PgVector<Window> windows;
+  ListCell *lc;
+  foreach (lc, select->windowClause) {
+    WindowClause *clause = (WindowClause *)lfirst(lc);
+    // Windows only referred to by other window definitions compute nothing.
+    List *window_funcs = NIL;
+    ListCell *l;
+    foreach (l, funcs) {
+      if (((WindowFunc *)lfirst(l))->winref == clause->winref)
+        window_funcs = lappend(window_funcs, lfirst(l));
+    }
+    if (window_funcs)
+      windows.push_back({clause, WindowSortClauses(clause), window_funcs});
+  }
+  std::stable_sort(windows.begin(), windows.end(),
+                   [](const Window &a, const Window &b) {
+                     return ComputedBefore(a.sort_clauses, b.sort_clauses);
+                   });
+
+  Operator *current_op = input;
+  for (const Window &window : windows) {
+    auto *op = new LogicalWindow(window.clause, window.sort_clauses,
+                                 window.funcs, select->targetList);
+    op->AddInput(current_op);
+    current_op = op;
+  }
+  return current_op;
+}
+
+Operator *Translator::TranslateCteReference(RangeTblEntry *rte,
+                                            Index rtindex) {
+  // References from set operation leaves and pulled-up sublinks name the
+  // CTEs of an enclosing query level.
+  if (rte->ctelevelsup != 0 || rte->self_reference)
+    return nullptr;
+  int cte_index = 0;
+  CommonTableExpr *cte = nullptr;
+  ListCell *lc;
+  foreach (lc, query_->cteList) {
+    auto *candidate = (CommonTableExpr *)lfirst(lc);
+    if (strcmp(candidate->ctename, rte->ctename) == 0) {
+      cte = candidate;
+      break;
+    }
+    cte_index++;
+  }
+  // Plain SELECTs without LIMIT, whose ORDER BY the query cannot rely on.
+  // A Sort below a LIMIT would have to find its keys in the CTE's target
+  // list rather than the query's.
+  Query *ctequery = cte ? (Query *)cte->ctequery : nullptr;
+  if (!ctequery || cte->cterecursive || ctequery->setOperations ||
+      ctequery->limitOffset || ctequery->limitCount ||
+      !IsSupportedQuery(ctequery))
+    return nullptr;
+  // CTEs of an enclosing query level are not looked up either.
+  foreach (lc, ctequery->rtable) {
+    if (((RangeTblEntry *)lfirst(lc))->rtekind == RTE_CTE)
+      return nullptr;
+  }
+
+  // As in the standard planner, a CTE is computed once if the query asks
+  // for that or its result could change from one evaluation to the next,
+  // and inlined if it is referenced once. Otherwise both are planned.
+  bool can_inline = cte->ctematerialized != CTEMaterializeAlways &&
+                    !contain_volatile_functions((Node *)ctequery);
+  bool shared = !can_inline || (cte->cterefcount > 1 &&
+                                cte->ctematerialized == CTEMaterializeDefault);
+
+  Operator *inlined = nullptr;
+  if (can_inline) {
+    List *target_list = NIL;
+    Operator *input = TranslateCteQuery(ctequery, &target_list);
+    if (!input)
+      return nullptr;
+    List *columns = NIL;
+    foreach (lc, target_list) {
+      TargetEntry *tle = (TargetEntry *)lfirst(lc);
+      if (!tle->resjunk)
+        columns = lappend(columns, tle->expr);
+    }
+    inlined = new LogicalSetOperation(SETOP_UNION, true, rtindex, {columns},
+                                      NIL);
+    inlined->AddInput(input);
+  }
+  if (!shared)
+    return inlined;
+
+  // The shared plan returns the CTE's target list, which the CteScan reads
+  // by position.
+  if (!cte_producers_[cte_index]) {
+    List *target_list = NIL;
+    Operator *input = TranslateCteQuery(ctequery, &target_list);
+    if (!input)
+      return nullptr;
+    auto *producer = new LogicalProjection(target_list);
+    producer->AddInput(input);
+    cte_producers_[cte_index] = producer;
+  }
+  return new LogicalCteScan(cte_index, rtindex, cte, inlined);
+}
+
+Operator *Translator::TranslateCteQuery(Query *ctequery, List **target_list) {
+  // Each copy gets range table entries of its own, like a set operation leaf
+  // (Preprocess::FlattenSetOperations()).
+  Query *copy = (Query *)copyObjectImpl(ctequery);
+  OffsetVarNodes((Node *)copy, list_length(query_->rtable), 0);
+  CombineRangeTables(&query_->rtable, &query_->rteperminfos, copy->rtable,
+                     copy->rteperminfos);
+  copy->rtable = NIL;
+  copy->rteperminfos = NIL;
+
+  Operator *current_op = TranslateSelect(copy);
+  *target_list = copy->targetList;
+  return current_op;
+}
+
+// Range table indexes of the base relations in a join tree
+static void CollectJoinTreeRelids(Node *jtnode, ColSet *relids) {
+  if (IsA(jtnode, RangeTblRef)) {
+    relids->Add(((RangeTblRef *)jtnode)->rtindex);
+  } else if (IsA(jtnode, JoinExpr)) {
+    CollectJoinTreeRelids(((JoinExpr *)jtnode)->larg, relids);
+    CollectJoinTreeRelids(((JoinExpr *)jtnode)->rarg, relids);
+  } else if (IsA(jtnode, FromExpr)) {
+    ListCell *lc;
+    foreach (lc, ((FromExpr *)jtnode)->fromlist)
+      CollectJoinTreeRelids((Node *)lfirst(lc), relids);
+  }
+}
+
+PredicateList Translator::MakeSemiJoinPredicates(List *clauses,
+                                                 Node *inner_item) {
+  ColSet inner_relids;
+  CollectJoinTreeRelids(inner_item, &inner_relids);
+
+  PredicateList predicates = MakePredicates(clauses);
+  for (Predicate *pred : predicates) {
+    pred->SetSelectivity(
+        selectivity_->EstimateSemiJoin(pred->GetExpr(), inner_relids));
+  }
+  return predicates;
+}
+
+// Fills in `ref` if `node` is a column of a base relation, possibly
+// relabeled to a binary-compatible type
+static bool MakeColumnRef(Query *query, Node *node, ColumnRef *ref) {
+  while (IsA(node, RelabelType))
+    node = (Node *)((RelabelType *)node)->arg;
+  if (!IsA(node, Var))
+    return false;
+  Var *var = (Var *)node;
+  if (var->varlevelsup != 0 || var->varattno <= 0)
+    return false;
+  RangeTblEntry *rte = rt_fetch(var->varno, query->rtable);
+  if (rte->rtekind != RTE_RELATION)
+    return false;
+  ref->rt_index = var->varno;
+  ref->table_oid = rte->relid;
+  ref->attr_num = var->varattno;
+  ref->nullable = !bms_is_empty(var->varnullingrels);
+  return true;
+}
+
+PredicateList Translator::MakePredicates(List *clauses) {
+  PredicateList predicates;
+  ListCell *lc;
+  foreach (lc, clauses)
+    predicates.push_back(MakePredicate((Node *)lfirst(lc)));
+  return predicates;
+}
+
+Predicate *Translator::MakePredicate(Node *clause) {
+  double selectivity = equivalence_classes_->IsRedundant(clause)
+                           ? 1.0
+                           : selectivity_->Estimate(clause);
+  Predicate *pred = DescribePredicate(clause, selectivity);
+
+  if (IsA(clause, OpExpr) && list_length(((OpExpr *)clause)->args) == 2) {
+    ColumnRef left_column;
+    ColumnRef right_column;
+    if (MakeColumnRef(query_, (Node *)linitial(((OpExpr *)clause)->args),
+                      &left_column) &&
+        MakeColumnRef(query_, (Node *)lsecond(((OpExpr *)clause)->args),
+                      &right_column))
+      pred->SetColumnOperands(((OpExpr *)clause)->opno, left_column,
+                              right_column);
+  }
+  return pred;
+}
+
+Predicate *Translator::DescribePredicate(Node *clause, double selectivity) {
+  AttrSet attrs;
+  CollectAttrs(clause, &attrs);
+  auto *pred = new Predicate(clause, std::move(attrs), selectivity,
+                             contain_volatile_functions(clause));
+
+  ColSet nonnullable;
+  Relids nonnullable_rels = find_nonnullable_rels(clause);
+  int relid = -1;
+  while ((relid = bms_next_member(nonnullable_rels, relid)) >= 0)
+    nonnullable.Add(relid);
+  pred->SetNonNullableRelids(std::move(nonnullable));
+
+  if (IsA(clause, OpExpr) && list_length(((OpExpr *)clause)->args) == 2) {
+    OpExpr *opexpr = (OpExpr *)clause;
+    Node *left = (Node *)linitial(opexpr->args);
+    Node *right = (Node *)lsecond(opexpr->args);
+    AttrSet left_attrs;
+    AttrSet right_attrs;
+    CollectAttrs(left, &left_attrs);
+    CollectAttrs(right, &right_attrs);
+
+    // Merge joins sort their inputs on the key columns, which have to be in
+    // the inputs' target lists; that is only guaranteed for plain columns.
+    Oid left_type = exprType(left);
+    bool mergejoinable = op_mergejoinable(opexpr->opno, left_type) &&
+                         IsA(strip_implicit_coercions(left), Var) &&
+                         IsA(strip_implicit_coercions(right), Var);
+    pred->SetOperands(left_attrs.GetRelids(), right_attrs.GetRelids(),
+                      op_hashjoinable(opexpr->opno, left_type),
+                      mergejoinable);
+  }
+  return pred;
+}
+
+void Translator::DeriveRequiredColumns(Operator *op, const AttrSet *required) {
+  auto *logical = dynamic_cast<LogicalOperator *>(op);
+  if (!logical)
+    return;
+
+  const AttrSet *input_required = required;
+
+  if (auto proj = dynamic_cast<LogicalProjection *>(op)) {
+    // The projection defines the output, so its input only has to provide
+    // what the target list reads (resjunk sort keys included).
+    auto *attrs = new AttrSet();
+    CollectAttrs((Node *)proj->GetTargetList(), attrs);
+    input_required = attrs;
+  } else if (auto filter = dynamic_cast<LogicalFilter *>(op)) {
+    // Columns only read by the qual are dropped right after the filter.
+    logical->SetRequiredColumns(required);
+    auto *attrs = new AttrSet();
+    attrs->Union(*required);
+    for (const Predicate *pred : filter->GetPredicates())
+      attrs->Union(pred->GetAttrs());
+    input_required = attrs;
+  } else if (auto join = dynamic_cast<LogicalJoin *>(op)) {
+    // Likewise for columns only read by the join predicates
+    logical->SetRequiredColumns(required);
+    auto *attrs = new AttrSet();
+    attrs->Union(*required);
+    for (const Predicate *pred : join->GetPredicates())
+      attrs->Union(pred->GetAttrs());
+    input_required = attrs;
+  } else if (auto agg = dynamic_cast<LogicalAggregate *>(op)) {
+    // Only the grouping keys and the aggregates' arguments are read from the
+    // input.
+    auto *attrs = new AttrSet();
+    for (const GroupKey &key : agg->GetKeys())
+      CollectAttrs(key.expr, attrs);
+    CollectAttrs((Node *)agg->GetAggregates(), attrs);
+    input_required = attrs;
+  } else if (auto window = dynamic_cast<LogicalWindow *>(op)) {
+    // The input also provides the window functions' arguments and the keys.
+    auto *attrs = new AttrSet();
+    attrs->Union(*required);
+    CollectAttrs((Node *)window->GetWindowFuncs(), attrs);
+    for (const SortKey &key : window->GetSortKeys())
+      CollectAttrs(key.expr, attrs);
+    input_required = attrs;
+  } else if (dynamic_cast<LogicalGet *>(op)) {
+    logical->SetRequiredColumns(required);
+  } else if (auto cte_scan = dynamic_cast<LogicalCteScan *>(op)) {
+    // The inlined CTE stands in for the scan.
+    logical->SetRequiredColumns(required);
+    if (cte_scan->GetInlined())
+      DeriveRequiredColumns(cte_scan->GetInlined(), required);
+    return;
+  } else if (auto setop = dynamic_cast<LogicalSetOperation *>(op)) {
+    // Each input computes the outputs needed above, or all of them if the
+    // operation compares whole rows.
+    logical->SetRequiredColumns(required);
+    const auto &inputs = op->GetInputs();
+    for (size_t i = 0; i < inputs.size(); i++) {
+      auto *attrs = new AttrSet();
+      for (int k = 1; k <= setop->GetNumColumns(); k++) {
+        if (setop->IsColumnNeeded(k))
+          CollectAttrs((Node *)list_nth(setop->GetInputColumns()[i], k - 1),
+                       attrs);
+      }
+      DeriveRequiredColumns(inputs[i], attrs);
+    }
+    return;
+  }
+  // Sort keys are target list entries, and LIMIT/OFFSET cannot reference the
+  // query's own relations, so both simply pass the requirement on.
+
+  for (auto *input : op->GetInputs()) {
+    DeriveRequiredColumns(input, input_required);
+  }
+}
+
+// The left operand of `clause`, under any RelabelTypes, which is where the
+// executor looks for the index column of an index qual
+static Node **IndexOperand(OpExpr *clause) {
+  Node **operand = (Node **)&linitial(clause->args);
+  while (IsA(*operand, RelabelType))
+    operand = (Node **)&((RelabelType *)*operand)->arg;
+  return operand;
+}
+
 Plan *Translator::TranslatePlanToPG(Memo *memo,
                                     GroupExpression *best_physical_plan,
                                     Query *pg_query) {
@@ -101,54 +1091,488 @@ Plan *Translator::TranslatePlanToPG(Memo *memo,
     return TranslatePlanToPG(memo, child_expr, pg_query);
   };
 
+  const LogicalProperties *props =
+      best_physical_plan->GetGroup()->GetLogicalProperties();
+
   if (auto scan = dynamic_cast<PhysicalTableScan *>(op)) {
     SeqScan *node = makeNode(SeqScan);
     node->scan.scanrelid = scan->GetRtIndex();
-    // In real system, targetlist and quals would be properly set
+    // Partitions get range table entries of their own. The target list and
+    // quals keep using the partitioned table's columns until the Append
+    // above translates them (TranslatePartitionVars).
+    if (OidIsValid(scan->GetPartitionOid()))
+      node->scan.scanrelid =
+          AddPartitionRte(scan->GetRtIndex(), scan->GetPartitionOid());
     // Construct TargetList from Logical Properties
-    node->scan.plan.targetlist = NIL;
-    if (best_physical_plan->GetGroup() &&
-        best_physical_plan->GetGroup()->GetLogicalProperties()) {
-      node->scan.plan.targetlist = BuildTargetList(
-          memo, best_physical_plan->GetGroup()->GetLogicalProperties());
+    node->scan.plan.targetlist = BuildTargetList(memo, props);
+    SetPlanEstimates((Plan *)node, best_physical_plan);
+    return (Plan *)node;
+  }
+
+  if (auto scan = dynamic_cast<PhysicalIndexScan *>(op)) {
+    const IndexMetadata *index = MetadataAccessor::GetIndexMetadata(
+        scan->GetTableOid(), scan->GetIndexOid());
+    if (!index)
+      return nullptr;
+    IndexScan *node = makeNode(IndexScan);
+    node->scan.scanrelid = scan->GetRtIndex();
+    node->indexid = scan->GetIndexOid();
+    node->indexorderdir = ForwardScanDirection;
+
+    // The executor wants `index column op value` clauses, in index column
+    // order, with the column referenced as INDEX_VAR.
+    const PredicateList &predicates = scan->GetIndexPredicates();
+    const PgVector<AttrNumber> &columns = scan->GetIndexColumns();
+    PgVector<size_t> order;
+    for (size_t i = 0; i < predicates.size(); i++)
+      order.push_back(i);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+      return columns[a] < columns[b];
+    });
+    for (size_t i : order) {
+      OpExpr *clause = (OpExpr *)copyObjectImpl(predicates[i]->GetExpr());
+      node->indexqualorig = lappend(node->indexqualorig, clause);
+      clause = (OpExpr *)copyObjectImpl(clause);
+      Node **operand = IndexOperand(clause);
+      Var *var = (Var *)*operand;
+      if (!IsA(var, Var) || var->varno != scan->GetRtIndex() ||
+          var->varattno != index->columns[columns[i] - 1]) {
+        CommuteOpExpr(clause);
+        operand = IndexOperand(clause);
+      }
+      var = (Var *)copyObjectImpl(*operand);
+      var->varno = INDEX_VAR;
+      var->varattno = columns[i];
+      *operand = (Node *)var;
+      node->indexqual = lappend(node->indexqual, clause);
+    }
+    node->scan.plan.qual = MakeQualList(scan->GetPredicates());
+    node->scan.plan.targetlist = BuildTargetList(memo, props);
+    SetPlanEstimates((Plan *)node, best_physical_plan);
+    return (Plan *)node;
+  }
+
+  if (auto scan = dynamic_cast<PhysicalCteScan *>(op)) {
+    SubPlan *init_plan = TranslateCtePlan(memo, scan->GetCteIndex());
+    if (!init_plan)
+      return nullptr;
+    CteScan *node = makeNode(CteScan);
+    node->scan.scanrelid = scan->GetRtIndex();
+    node->ctePlanId = init_plan->plan_id;
+    node->cteParam = linitial_int(init_plan->setParam);
+    node->scan.plan.targetlist = BuildTargetList(memo, props);
+    SetPlanEstimates((Plan *)node, best_physical_plan);
+    return (Plan *)node;
+  }
+
+  if (auto memoize = dynamic_cast<PhysicalMemoize *>(op)) {
+    Plan *child_plan = GetChildPlan(0);
+    if (!child_plan)
+      return nullptr;
+    // Keys are compared with their types' hash equality. The nested loop
+    // above turns them into the Params it sets.
+    Memoize *node = makeNode(Memoize);
+    int nkeys = list_length(memoize->GetCacheKeys());
+    node->numKeys = nkeys;
+    node->hashOperators = (Oid *)palloc(nkeys * sizeof(Oid));
+    node->collations = (Oid *)palloc(nkeys * sizeof(Oid));
+    int i = 0;
+    ListCell *lc;
+    foreach (lc, memoize->GetCacheKeys()) {
+      Node *key = (Node *)lfirst(lc);
+      TypeCacheEntry *type = lookup_type_cache(exprType(key),
+                                               TYPECACHE_EQ_OPR);
+      node->hashOperators[i] = type->eq_opr;
+      node->collations[i] = exprCollation(key);
+      i++;
     }
+    node->param_exprs =
+        (List *)copyObjectImpl(memoize->GetCacheKeys());
+    node->singlerow = false;
+    node->binary_mode = false;
+    node->est_entries = static_cast<uint32>(std::min(
+        CostModel::MemoizeEntries(child_plan->plan_rows,
+                                  child_plan->plan_width),
+        memoize->GetDistinct()));
+    node->plan.lefttree = child_plan;
+    node->plan.targetlist = (List *)copyObjectImpl(child_plan->targetlist);
+    SetPlanEstimates((Plan *)node, best_physical_plan);
+    return (Plan *)node;
+  }
+
+  if (dynamic_cast<PhysicalEmptyResult *>(op)) {
+    // A childless Result gated by a constant-false one-time filter, as the
+    // standard planner builds for provably empty relations.
+    Result *node = makeNode(Result);
+    node->plan.targetlist = BuildTargetList(memo, props);
+    node->resconstantqual =
+        (Node *)list_make1(makeBoolConst(false, false));
+    SetPlanEstimates((Plan *)node, best_physical_plan);
     return (Plan *)node;
   }
 
   if (auto filter = dynamic_cast<PhysicalFilter *>(op)) {
     Plan *child_plan = GetChildPlan(0);
-    // In PG, quals are often attached to the node itself (e.g. Scan)
-    // or we use a Result node.
-    // Simplifying: If child is Scan, attach qual. Else create Result.
-    if (child_plan && IsA(child_plan, SeqScan)) {
-      // qual is a List* in Plan, but Node* in our Operator.
-      // We must wrap the expression in a List.
-      Node *qual_copy = (Node *)copyObjectImpl(filter->GetQual());
-      ((SeqScan *)child_plan)->scan.plan.qual = list_make1(qual_copy);
+    // Filtering an empty result leaves it empty.
+    if (child_plan && IsA(child_plan, Result) && !child_plan->lefttree) {
+      child_plan->targetlist = BuildTargetList(memo, props);
       return child_plan;
-    } else {
-      // Create a Result node acting as filter
-      // Result *node = makeNode(Result);
-      // node->plan.lefttree = child_plan;
-      // node->plan.qual = (List *)copyObjectImpl(filter->GetQual());
-      // node->plan.targetlist = child_plan ? child_plan->targetlist : NIL;
-      // return (Plan *)node;
-
-      // Fallback: Attach to child plan's qual if possible?
-      // No, let's strictly return child_plan for now because we haven't handled
-      // creating Result nodes properly with all fields.
-      // Or just Warning and return child.
-      elog(WARNING, "Translator: PhysicalFilter text not fully implemented, "
-                    "attaching to child if Scan.");
+    }
+    // Predicates that read no column are checked once, by a gating Result
+    // that skips its input altogether if they fail.
+    List *quals = NIL;
+    List *gates = NIL;
+    for (const Predicate *pred : filter->GetPredicates()) {
+      Node *clause = (Node *)copyObjectImpl(pred->GetExpr());
+      if (pred->GetRelids().IsEmpty() && !pred->IsVolatile())
+        gates = lappend(gates, clause);
+      else
+        quals = lappend(quals, clause);
+    }
+    // PG has no filter node: the other predicates go to the child, or to a
+    // Result on top of it if the child cannot check them.
+    if (!child_plan)
+      return nullptr;
+    if (quals && !AttachQual(child_plan, quals)) {
+      Result *node = makeNode(Result);
+      node->plan.lefttree = child_plan;
+      node->plan.qual = quals;
+      child_plan = (Plan *)node;
+    }
+    // The child only has to emit what is still needed after the filter.
+    child_plan = ApplyTargetList(child_plan, BuildTargetList(memo, props));
+    SetPlanEstimates(child_plan, best_physical_plan);
+    if (!gates)
       return child_plan;
+
+    Result *node = makeNode(Result);
+    node->plan.lefttree = child_plan;
+    node->plan.targetlist = BuildTargetList(memo, props);
+    node->resconstantqual = (Node *)gates;
+    SetPlanEstimates((Plan *)node, best_physical_plan);
+    return (Plan *)node;
+  }
+
+  if (auto append = dynamic_cast<PhysicalAppend *>(op)) {
+    Append *node = makeNode(Append);
+    for (size_t i = 0; i < best_physical_plan->GetChildren().size(); i++) {
+      Plan *child_plan = GetChildPlan(i);
+      if (!child_plan)
+        return nullptr;
+      if (append->IsSetOperation())
+        child_plan = ApplyTargetList(
+            child_plan, SetOperationInputTargetList(
+                            memo, props, append->GetInputColumns(), i));
+      node->appendplans = lappend(node->appendplans, child_plan);
+    }
+    props->GetRelids().ForEach([&](int relid) {
+      node->apprelids = bms_add_member(node->apprelids, relid);
+    });
+    node->first_partial_plan = list_length(node->appendplans);
+    node->part_prune_index = -1;
+    // Every child emits the Append's columns, in the same order.
+    if (append->IsSetOperation()) {
+      node->plan.targetlist = BuildTargetList(memo, props);
+      setop_relids_ = bms_add_member(setop_relids_, append->GetRtIndex());
+    } else {
+      ApplyTargetList((Plan *)node, BuildTargetList(memo, props));
+    }
+    SetPlanEstimates((Plan *)node, best_physical_plan);
+    return (Plan *)node;
+  }
+
+  if (auto merge = dynamic_cast<PhysicalMergeAppend *>(op)) {
+    MergeAppend *node = makeNode(MergeAppend);
+    node->plan.targetlist = BuildTargetList(memo, props);
+    int nkeys = merge->GetKeyColumns().size();
+    node->numCols = nkeys;
+    node->sortColIdx = (AttrNumber *)palloc(nkeys * sizeof(AttrNumber));
+    node->sortOperators = (Oid *)palloc(nkeys * sizeof(Oid));
+    node->collations = (Oid *)palloc(nkeys * sizeof(Oid));
+    node->nullsFirst = (bool *)palloc(nkeys * sizeof(bool));
+    int i = 0;
+    ListCell *lc;
+    foreach (lc, merge->GetSortClause()) {
+      SortGroupClause *sgc = (SortGroupClause *)lfirst(lc);
+      TargetEntry *tle = nullptr;
+      ListCell *l;
+      foreach (l, node->plan.targetlist) {
+        Var *var = (Var *)((TargetEntry *)lfirst(l))->expr;
+        if (var->varattno == merge->GetKeyColumns()[i]) {
+          tle = (TargetEntry *)lfirst(l);
+          break;
+        }
+      }
+      if (!tle)
+        return nullptr;
+      node->sortColIdx[i] = tle->resno;
+      node->sortOperators[i] = sgc->sortop;
+      node->collations[i] = exprCollation((Node *)tle->expr);
+      node->nullsFirst[i] = sgc->nulls_first;
+      i++;
+    }
+
+    // Every input is sorted the same way, on the same column positions.
+    for (size_t j = 0; j < best_physical_plan->GetChildren().size(); j++) {
+      Plan *child_plan = GetChildPlan(j);
+      if (!child_plan)
+        return nullptr;
+      child_plan = ApplyTargetList(
+          child_plan, SetOperationInputTargetList(
+                          memo, props, merge->GetInputColumns(), j));
+      Sort *sort = MakeSort(child_plan, nkeys);
+      for (int k = 0; k < nkeys; k++) {
+        sort->sortColIdx[k] = node->sortColIdx[k];
+        sort->sortOperators[k] = node->sortOperators[k];
+        sort->collations[k] = node->collations[k];
+        sort->nullsFirst[k] = node->nullsFirst[k];
+      }
+      node->mergeplans = lappend(node->mergeplans, sort);
+    }
+    node->apprelids = bms_make_singleton(merge->GetRtIndex());
+    node->part_prune_index = -1;
+    setop_relids_ = bms_add_member(setop_relids_, merge->GetRtIndex());
+    SetPlanEstimates((Plan *)node, best_physical_plan);
+    return (Plan *)node;
+  }
+
+  if (auto setop = dynamic_cast<PhysicalSetOp *>(op)) {
+    SetOp *node = makeNode(SetOp);
+    if (setop->GetOperation() == SETOP_INTERSECT)
+      node->cmd = setop->IsAll() ? SETOPCMD_INTERSECT_ALL : SETOPCMD_INTERSECT;
+    else
+      node->cmd = setop->IsAll() ? SETOPCMD_EXCEPT_ALL : SETOPCMD_EXCEPT;
+    node->strategy = setop->GetStrategy();
+
+    // Whole rows are compared, on the columns in order.
+    int ncols = list_length(setop->GetGroupClauses());
+    node->numCols = ncols;
+    node->cmpColIdx = (AttrNumber *)palloc(ncols * sizeof(AttrNumber));
+    node->cmpOperators = (Oid *)palloc(ncols * sizeof(Oid));
+    node->cmpCollations = (Oid *)palloc(ncols * sizeof(Oid));
+    node->cmpNullsFirst = (bool *)palloc(ncols * sizeof(bool));
+    int i = 0;
+    ListCell *lc;
+    foreach (lc, setop->GetGroupClauses()) {
+      SortGroupClause *sgc = (SortGroupClause *)lfirst(lc);
+      node->cmpColIdx[i] = i + 1;
+      node->cmpOperators[i] =
+          setop->GetStrategy() == SETOP_HASHED ? sgc->eqop : sgc->sortop;
+      node->cmpCollations[i] =
+          exprCollation((Node *)list_nth(setop->GetInputColumns()[0], i));
+      node->cmpNullsFirst[i] = sgc->nulls_first;
+      i++;
+    }
+
+    for (int j = 0; j < 2; j++) {
+      Plan *child_plan = GetChildPlan(j);
+      if (!child_plan)
+        return nullptr;
+      child_plan = ApplyTargetList(
+          child_plan, SetOperationInputTargetList(
+                          memo, props, setop->GetInputColumns(), j));
+      // Sorted mode reads both inputs in the order of the columns.
+      if (setop->GetStrategy() == SETOP_SORTED) {
+        Sort *sort = MakeSort(child_plan, ncols);
+        for (int k = 0; k < ncols; k++) {
+          sort->sortColIdx[k] = node->cmpColIdx[k];
+          sort->sortOperators[k] = node->cmpOperators[k];
+          sort->collations[k] = node->cmpCollations[k];
+          sort->nullsFirst[k] = node->cmpNullsFirst[k];
+        }
+        child_plan = (Plan *)sort;
+      }
+      if (j == 0)
+        node->plan.lefttree = child_plan;
+      else
+        node->plan.righttree = child_plan;
+    }
+    node->plan.targetlist = BuildTargetList(memo, props);
+    SetPlanEstimates((Plan *)node, best_physical_plan);
+    node->numGroups = node->plan.plan_rows;
+    return (Plan *)node;
+  }
+
+  if (auto join = dynamic_cast<PhysicalNestedLoopJoin *>(op)) {
+    Plan *outer_plan = GetChildPlan(0);
+    Plan *inner_plan = GetChildPlan(1);
+    if (!outer_plan || !inner_plan)
+      return nullptr;
+
+    NestLoop *node = makeNode(NestLoop);
+    node->join.jointype = join->GetJoinType();
+    node->join.inner_unique = false;
+    node->join.joinqual = MakeQualList(join->GetPredicates());
+    node->join.plan.lefttree = outer_plan;
+    node->join.plan.targetlist = BuildTargetList(memo, props);
+    SetPlanEstimates((Plan *)node, best_physical_plan);
+
+    // A parameterized inner side looks its rows up for each outer row.
+    if (join->IsParameterized()) {
+      ParameterizeInnerPlan(
+          inner_plan,
+          best_physical_plan->GetChildren()[0]->GetLogicalProperties()
+              ->GetRelids(),
+          node);
+      node->join.plan.righttree = inner_plan;
+      return (Plan *)node;
+    }
+
+    // Otherwise the inner side is rescanned for every outer row;
+    // materialize it so a rescan does not run the subplan again.
+    Material *material = makeNode(Material);
+    material->plan.lefttree = inner_plan;
+    material->plan.targetlist = (List *)copyObjectImpl(inner_plan->targetlist);
+    material->plan.startup_cost = inner_plan->startup_cost;
+    material->plan.total_cost = inner_plan->total_cost;
+    material->plan.plan_rows = inner_plan->plan_rows;
+    material->plan.plan_width = inner_plan->plan_width;
+    node->join.plan.righttree = (Plan *)material;
+    return (Plan *)node;
+  }
+
+  if (auto join = dynamic_cast<PhysicalHashJoin *>(op)) {
+    Plan *outer_plan = GetChildPlan(0);
+    Plan *inner_plan = GetChildPlan(1);
+    if (!outer_plan || !inner_plan)
+      return nullptr;
+
+    const ColSet &outer_relids =
+        best_physical_plan->GetChildren()[0]->GetLogicalProperties()
+            ->GetRelids();
+    HashJoin *node = makeNode(HashJoin);
+    Hash *hash = makeNode(Hash);
+    for (const Predicate *pred : join->GetHashPredicates()) {
+      OpExpr *clause = OrientJoinClause(pred, outer_relids);
+      if (!clause)
+        return nullptr;
+      node->hashclauses = lappend(node->hashclauses, clause);
+      node->hashoperators = lappend_oid(node->hashoperators, clause->opno);
+      node->hashcollations =
+          lappend_oid(node->hashcollations, clause->inputcollid);
+      node->hashkeys = lappend(node->hashkeys, linitial(clause->args));
+      hash->hashkeys = lappend(hash->hashkeys, lsecond(clause->args));
     }
+
+    hash->plan.lefttree = inner_plan;
+    hash->plan.targetlist = (List *)copyObjectImpl(inner_plan->targetlist);
+    hash->plan.startup_cost = inner_plan->total_cost;
+    hash->plan.total_cost = inner_plan->total_cost;
+    hash->plan.plan_rows = inner_plan->plan_rows;
+    hash->plan.plan_width = inner_plan->plan_width;
+    hash->skewTable = InvalidOid;
+
+    node->join.jointype = join->GetJoinType();
+    node->join.inner_unique = false;
+    node->join.joinqual = MakeQualList(join->GetPredicates());
+    node->join.plan.lefttree = outer_plan;
+    node->join.plan.righttree = (Plan *)hash;
+    node->join.plan.targetlist = BuildTargetList(memo, props);
+    SetPlanEstimates((Plan *)node, best_physical_plan);
+    return (Plan *)node;
+  }
+
+  if (auto join = dynamic_cast<PhysicalMergeJoin *>(op)) {
+    Plan *outer_plan = GetChildPlan(0);
+    Plan *inner_plan = GetChildPlan(1);
+    if (!outer_plan || !inner_plan)
+      return nullptr;
+
+    const ColSet &outer_relids =
+        best_physical_plan->GetChildren()[0]->GetLogicalProperties()
+            ->GetRelids();
+    MergeJoin *node = makeNode(MergeJoin);
+    int nkeys = join->GetMergePredicates().size();
+    node->mergeFamilies = (Oid *)palloc(nkeys * sizeof(Oid));
+    node->mergeCollations = (Oid *)palloc(nkeys * sizeof(Oid));
+    node->mergeReversals = (bool *)palloc(nkeys * sizeof(bool));
+    node->mergeNullsFirst = (bool *)palloc(nkeys * sizeof(bool));
+
+    // Both inputs are sorted ascending on their side of each key, with the
+    // ordering of a btree family the operator is the equality of.
+    Sort *outer_sort = MakeSort(outer_plan, nkeys);
+    Sort *inner_sort = MakeSort(inner_plan, nkeys);
+    int i = 0;
+    for (const Predicate *pred : join->GetMergePredicates()) {
+      OpExpr *clause = OrientJoinClause(pred, outer_relids);
+      if (!clause)
+        return nullptr;
+      Node *outer_key = (Node *)linitial(clause->args);
+      Node *inner_key = (Node *)lsecond(clause->args);
+      Oid opfamily = Ordering::MergeOpfamily(clause->opno);
+      if (!OidIsValid(opfamily) ||
+          !AddSortKey(outer_sort, i, outer_key, opfamily,
+                      clause->inputcollid) ||
+          !AddSortKey(inner_sort, i, inner_key, opfamily,
+                      clause->inputcollid))
+        return nullptr;
+
+      node->mergeclauses = lappend(node->mergeclauses, clause);
+      node->mergeFamilies[i] = opfamily;
+      node->mergeCollations[i] = clause->inputcollid;
+      node->mergeReversals[i] = false;
+      node->mergeNullsFirst[i] = false;
+      i++;
+    }
+
+    node->skip_mark_restore = false;
+    node->join.jointype = join->GetJoinType();
+    node->join.inner_unique = false;
+    node->join.joinqual = MakeQualList(join->GetPredicates());
+    node->join.plan.lefttree = (Plan *)outer_sort;
+    node->join.plan.righttree = (Plan *)inner_sort;
+    node->join.plan.targetlist = BuildTargetList(memo, props);
+    SetPlanEstimates((Plan *)node, best_physical_plan);
+    return (Plan *)node;
+  }
+
+  if (auto agg = dynamic_cast<PhysicalAggregate *>(op)) {
+    Plan *child_plan = GetChildPlan(0);
+    if (!child_plan)
+      return nullptr;
+
+    const GroupKeyList &keys = agg->GetKeys();
+    int nkeys = keys.size();
+    Agg *node = makeNode(Agg);
+    node->aggstrategy = agg->GetStrategy();
+    node->aggsplit = agg->GetSplit();
+    node->numCols = nkeys;
+    node->grpColIdx = (AttrNumber *)palloc(nkeys * sizeof(AttrNumber));
+    node->grpOperators = (Oid *)palloc(nkeys * sizeof(Oid));
+    node->grpCollations = (Oid *)palloc(nkeys * sizeof(Oid));
+    for (int i = 0; i < nkeys; i++) {
+      node->grpColIdx[i] = AddInputColumn(child_plan, keys[i].expr);
+      if (node->grpColIdx[i] == InvalidAttrNumber)
+        return nullptr;
+      node->grpOperators[i] = keys[i].eqop;
+      node->grpCollations[i] = exprCollation(keys[i].expr);
+    }
+
+    // Sorted grouping reads its input in key order.
+    if (agg->GetStrategy() == AGG_SORTED) {
+      Sort *sort = MakeSort(child_plan, nkeys);
+      for (int i = 0; i < nkeys; i++) {
+        sort->sortColIdx[i] = node->grpColIdx[i];
+        sort->sortOperators[i] = keys[i].sortop;
+        sort->collations[i] = node->grpCollations[i];
+        sort->nullsFirst[i] = false;
+      }
+      child_plan = (Plan *)sort;
+    }
+
+    node->plan.lefttree = child_plan;
+    node->plan.targetlist = BuildTargetList(memo, props);
+    SetPlanEstimates((Plan *)node, best_physical_plan);
+    node->numGroups = (long)node->plan.plan_rows;
+    return (Plan *)node;
   }
 
   if (auto sort = dynamic_cast<PhysicalSort *>(op)) {
     Plan *child_plan = GetChildPlan(0);
     Sort *node = makeNode(Sort);
     node->plan.lefttree = child_plan;
-    node->plan.targetlist = child_plan->targetlist; // Pass through tlist
+    node->plan.targetlist = (List *)copyObjectImpl(child_plan->targetlist);
+    SetPlanEstimates((Plan *)node, best_physical_plan);
 
     int numCols = list_length(sort->GetSortClause());
     node->numCols = numCols;
@@ -189,11 +1613,102 @@ Plan *Translator::TranslatePlanToPG(Memo *memo,
     return (Plan *)node;
   }
 
+  if (auto sort = dynamic_cast<PhysicalIncrementalSort *>(op)) {
+    Plan *child_plan = GetChildPlan(0);
+    if (!child_plan)
+      return nullptr;
+    // Like those of PhysicalSort, the keys are the query's target list
+    // entries, which the projection makes the input's columns.
+    PgVector<AttrNumber> columns;
+    ListCell *lc;
+    foreach (lc, sort->GetSortClause()) {
+      columns.push_back(get_sortgroupclause_tle((SortGroupClause *)lfirst(lc),
+                                                pg_query->targetList)
+                            ->resno);
+    }
+    Plan *plan =
+        SortInput(memo, child_plan, best_physical_plan->GetChildren()[0],
+                  sort->GetKeys(), columns);
+    if (plan != child_plan)
+      SetPlanEstimates(plan, best_physical_plan);
+    return plan;
+  }
+
+  if (auto window = dynamic_cast<PhysicalWindowAgg *>(op)) {
+    Plan *child_plan = GetChildPlan(0);
+    if (!child_plan)
+      return nullptr;
+
+    WindowClause *clause = window->GetClause();
+    WindowAgg *node = makeNode(WindowAgg);
+    // EXPLAIN shows the window's name; unnamed windows are numbered, as in
+    // the standard planner.
+    node->winname =
+        clause->name ? clause->name : psprintf("w%u", clause->winref);
+    node->winref = clause->winref;
+
+    // Rows are in the same partition, and peers, if their partition and
+    // order columns are equal.
+    auto KeyColumns = [&](List *clauses, AttrNumber **columns, Oid **operators,
+                          Oid **collations) {
+      int ncols = list_length(clauses);
+      *columns = (AttrNumber *)palloc(ncols * sizeof(AttrNumber));
+      *operators = (Oid *)palloc(ncols * sizeof(Oid));
+      *collations = (Oid *)palloc(ncols * sizeof(Oid));
+      int i = 0;
+      ListCell *lc;
+      foreach (lc, clauses) {
+        SortGroupClause *sgc = (SortGroupClause *)lfirst(lc);
+        Node *expr = get_sortgroupclause_expr(sgc, window->GetTargetList());
+        (*columns)[i] = AddInputColumn(child_plan, expr);
+        if ((*columns)[i] == InvalidAttrNumber)
+          return false;
+        (*operators)[i] = sgc->eqop;
+        (*collations)[i] = exprCollation(expr);
+        i++;
+      }
+      return true;
+    };
+    node->partNumCols = list_length(clause->partitionClause);
+    node->ordNumCols = list_length(clause->orderClause);
+    if (!KeyColumns(clause->partitionClause, &node->partColIdx,
+                    &node->partOperators, &node->partCollations) ||
+        !KeyColumns(clause->orderClause, &node->ordColIdx,
+                    &node->ordOperators, &node->ordCollations))
+      return nullptr;
+
+    node->frameOptions = clause->frameOptions;
+    node->startOffset = (Node *)copyObjectImpl(clause->startOffset);
+    node->endOffset = (Node *)copyObjectImpl(clause->endOffset);
+    node->startInRangeFunc = clause->startInRangeFunc;
+    node->endInRangeFunc = clause->endInRangeFunc;
+    node->inRangeColl = clause->inRangeColl;
+    node->inRangeAsc = clause->inRangeAsc;
+    node->inRangeNullsFirst = clause->inRangeNullsFirst;
+
+    // The input is sorted on the keys, or delivered that way by the
+    // window below.
+    const SortKeyList &keys = window->GetKeys();
+    PgVector<AttrNumber> columns;
+    for (const SortKey &key : keys) {
+      columns.push_back(AddInputColumn(child_plan, key.expr));
+      if (columns.back() == InvalidAttrNumber)
+        return nullptr;
+    }
+    node->plan.lefttree =
+        SortInput(memo, child_plan, best_physical_plan->GetChildren()[0],
+                  keys, columns);
+    node->plan.targetlist = BuildTargetList(memo, props);
+    SetPlanEstimates((Plan *)node, best_physical_plan);
+    return (Plan *)node;
+  }
+
   if (auto limit = dynamic_cast<PhysicalLimit *>(op)) {
     Plan *child_plan = GetChildPlan(0);
     Limit *node = makeNode(Limit);
     node->plan.lefttree = child_plan;
-    node->plan.targetlist = child_plan->targetlist;
+    node->plan.targetlist = (List *)copyObjectImpl(child_plan->targetlist);
+    SetPlanEstimates((Plan *)node, best_physical_plan);
     node->limitOffset = limit->GetLimitOffset();
     node->limitCount = limit->GetLimitCount();
     return (Plan *)node;
@@ -205,8 +1720,8 @@ Plan *Translator::TranslatePlanToPG(Memo *memo,
     // Or create a Result node (Projection)
     // For now, let's just update the child plan's target list if it exists.
     if (child_plan) {
-      child_plan->targetlist = (List *)copyObjectImpl(proj->GetTargetList());
-      return child_plan;
+      return ApplyTargetList(child_plan,
+                             (List *)copyObjectImpl(proj->GetTargetList()));
     }
     // If no child (e.g. Result with constant), create Result.
     // Result *node = makeNode(Result);
@@ -217,64 +1732,512 @@ Plan *Translator::TranslatePlanToPG(Memo *memo,
   return nullptr;
 }
 
+// Whether `target_list` is `plan`'s own, column for column
+static bool SameColumns(List *target_list, Plan *plan) {
+  if (list_length(target_list) != list_length(plan->targetlist))
+    return false;
+  ListCell *lc1;
+  ListCell *lc2;
+  forboth (lc1, target_list, lc2, plan->targetlist) {
+    if (!equal(((TargetEntry *)lfirst(lc1))->expr,
+               ((TargetEntry *)lfirst(lc2))->expr))
+      return false;
+  }
+  return true;
+}
+
+Plan *Translator::ApplyTargetList(Plan *plan, List *target_list) {
+  // Sort and Limit cannot project: evaluate the target list below them and
+  // let them pass the resulting columns through (SetRefs turns their copy
+  // into input references). This also keeps sortColIdx (taken from the
+  // query's target list) pointing at the right columns.
+  if (IsA(plan, Sort) || IsA(plan, IncrementalSort) || IsA(plan, Limit) ||
+      IsA(plan, Material) || IsA(plan, Memoize)) {
+    plan->lefttree = ApplyTargetList(plan->lefttree, target_list);
+    plan->targetlist = (List *)copyObjectImpl(plan->lefttree->targetlist);
+    return plan;
+  }
+  // Nor can set operations, whose inputs each compute the columns their
+  // own way: a Result on top evaluates the target list, unless it only
+  // passes the columns through.
+  if (IsSetOperationPlan(plan)) {
+    if (SameColumns(target_list, plan)) {
+      plan->targetlist = target_list;
+      return plan;
+    }
+    Result *result = makeNode(Result);
+    result->plan.lefttree = plan;
+    result->plan.targetlist = target_list;
+    result->plan.startup_cost = plan->startup_cost;
+    result->plan.total_cost = plan->total_cost;
+    result->plan.plan_rows = plan->plan_rows;
+    result->plan.plan_width = plan->plan_width;
+    return (Plan *)result;
+  }
+  // Nor can an Append, whose children produce its columns in terms of
+  // their own partitions.
+  if (IsA(plan, Append)) {
+    ListCell *lc;
+    foreach (lc, ((Append *)plan)->appendplans) {
+      Plan *child = ApplyTargetList((Plan *)lfirst(lc),
+                                    (List *)copyObjectImpl(target_list));
+      TranslatePartitionVars(child);
+      lfirst(lc) = child;
+    }
+    plan->targetlist = target_list;
+    return plan;
+  }
+
+  plan->targetlist = target_list;
+  return plan;
+}
+
+bool Translator::IsSetOperationPlan(Plan *plan) const {
+  if (IsA(plan, MergeAppend) || IsA(plan, SetOp))
+    return true;
+  return IsA(plan, Append) &&
+         bms_overlap(((Append *)plan)->apprelids, setop_relids_);
+}
+
+bool Translator::AttachQual(Plan *plan, List *quals) {
+  // A partition Append's children check the quals instead.
+  if (IsA(plan, Append) && !IsSetOperationPlan(plan)) {
+    ListCell *lc;
+    foreach (lc, ((Append *)plan)->appendplans) {
+      Plan *child = (Plan *)lfirst(lc);
+      if (!AttachQual(child, (List *)copyObjectImpl(quals)))
+        return false;
+      TranslatePartitionVars(child);
+    }
+    return true;
+  }
+  // Scans, joins, aggregates and Results evaluate quals themselves. Nothing
+  // else ends up below a filter.
+  if (!(IsA(plan, SeqScan) || IsA(plan, IndexScan) || IsA(plan, NestLoop) ||
+        IsA(plan, HashJoin) || IsA(plan, MergeJoin) || IsA(plan, Agg) ||
+        IsA(plan, Result)))
+    return false;
+  plan->qual = list_concat(plan->qual, quals);
+  return true;
+}
+
+SubPlan *Translator::TranslateCtePlan(Memo *memo, int cte_index) {
+  auto it = cte_plans_.find(cte_index);
+  if (it != cte_plans_.end())
+    return it->second;
+
+  Group *producer = memo->GetCteProducer(cte_index);
+  Plan *plan = TranslatePlanToPG(memo, producer->GetBestExpression(), query_);
+  if (!plan)
+    return nullptr;
+  subplans_ = lappend(subplans_, plan);
+
+  // As in SS_process_ctes(): the CteScans find each other's tuplestore
+  // through a PARAM_EXEC parameter of no particular type, and the InitPlan
+  // is never run itself; the first CteScan to need rows pulls them from
+  // the plan.
+  CommonTableExpr *cte =
+      (CommonTableExpr *)list_nth(query_->cteList, cte_index);
+  SubPlan *init_plan = makeNode(SubPlan);
+  init_plan->subLinkType = CTE_SUBLINK;
+  init_plan->plan_id = list_length(subplans_);
+  init_plan->plan_name = psprintf("CTE %s", cte->ctename);
+  init_plan->firstColType = linitial_oid(cte->ctecoltypes);
+  init_plan->firstColTypmod = linitial_int(cte->ctecoltypmods);
+  init_plan->firstColCollation = linitial_oid(cte->ctecolcollations);
+  init_plan->setParam = list_make1_int(list_length(param_exec_types_));
+  param_exec_types_ = lappend_oid(param_exec_types_, InvalidOid);
+  init_plan->startup_cost = plan->startup_cost;
+  init_plan->per_call_cost = plan->total_cost - plan->startup_cost;
+  init_plans_ = lappend(init_plans_, init_plan);
+  cte_plans_[cte_index] = init_plan;
+  return init_plan;
+}
+
+Index Translator::AddPartitionRte(Index rtindex, Oid partition) {
+  for (AppendRelInfo *appinfo : append_rel_infos_) {
+    if (appinfo->parent_relid == rtindex &&
+        rt_fetch(appinfo->child_relid, query_->rtable)->relid == partition)
+      return appinfo->child_relid;
+  }
+
+  // Partitions that survived pruning are only locked now, as in the
+  // standard planner.
+  RangeTblEntry *parent_rte = rt_fetch(rtindex, query_->rtable);
+  LockRelationOid(partition, parent_rte->rellockmode);
+  Relation parent = table_open(parent_rte->relid, NoLock);
+  Relation child = table_open(partition, NoLock);
+
+  List *colnames = NIL;
+  TupleDesc desc = RelationGetDescr(child);
+  for (int i = 0; i < desc->natts; i++) {
+    Form_pg_attribute attr = TupleDescAttr(desc, i);
+    colnames = lappend(colnames,
+                       makeString(pstrdup(attr->attisdropped
+                                              ? ""
+                                              : NameStr(attr->attname))));
+  }
+  RangeTblEntry *child_rte = (RangeTblEntry *)copyObjectImpl(parent_rte);
+  child_rte->relid = partition;
+  child_rte->relkind = RelationGetForm(child)->relkind;
+  child_rte->inh = false;
+  // Permissions are checked on the partitioned table only.
+  child_rte->perminfoindex = 0;
+  child_rte->alias = child_rte->eref =
+      makeAlias(parent_rte->eref->aliasname, colnames);
+  query_->rtable = lappend(query_->rtable, child_rte);
+  Index child_rtindex = list_length(query_->rtable);
+
+  append_rel_infos_.push_back(
+      make_append_rel_info(parent, child, rtindex, child_rtindex));
+  table_close(child, NoLock);
+  table_close(parent, NoLock);
+  return child_rtindex;
+}
+
+static void CollectScanRelids(Plan *plan, Bitmapset **relids) {
+  if (!plan)
+    return;
+  if (IsA(plan, SeqScan) || IsA(plan, IndexScan))
+    *relids = bms_add_member(*relids, ((Scan *)plan)->scanrelid);
+  if (IsA(plan, Append)) {
+    ListCell *lc;
+    foreach (lc, ((Append *)plan)->appendplans)
+      CollectScanRelids((Plan *)lfirst(lc), relids);
+  }
+  CollectScanRelids(plan->lefttree, relids);
+  CollectScanRelids(plan->righttree, relids);
+}
+
+static void AdjustPlanExprs(Plan *plan, PlannerInfo *root, int nappinfos,
+                            AppendRelInfo **appinfos) {
+  if (!plan)
+    return;
+  auto adjust = [&](List *exprs) {
+    return (List *)adjust_appendrel_attrs(root, (Node *)exprs, nappinfos,
+                                          appinfos);
+  };
+  plan->targetlist = adjust(plan->targetlist);
+  plan->qual = adjust(plan->qual);
+  switch (nodeTag(plan)) {
+  case T_IndexScan:
+    ((IndexScan *)plan)->indexqualorig =
+        adjust(((IndexScan *)plan)->indexqualorig);
+    break;
+  case T_NestLoop:
+    ((Join *)plan)->joinqual = adjust(((Join *)plan)->joinqual);
+    break;
+  case T_HashJoin:
+    ((Join *)plan)->joinqual = adjust(((Join *)plan)->joinqual);
+    ((HashJoin *)plan)->hashclauses = adjust(((HashJoin *)plan)->hashclauses);
+    ((HashJoin *)plan)->hashkeys = adjust(((HashJoin *)plan)->hashkeys);
+    break;
+  case T_MergeJoin:
+    ((Join *)plan)->joinqual = adjust(((Join *)plan)->joinqual);
+    ((MergeJoin *)plan)->mergeclauses =
+        adjust(((MergeJoin *)plan)->mergeclauses);
+    break;
+  case T_Hash:
+    ((Hash *)plan)->hashkeys = adjust(((Hash *)plan)->hashkeys);
+    break;
+  case T_Append: {
+    ListCell *lc;
+    foreach (lc, ((Append *)plan)->appendplans)
+      AdjustPlanExprs((Plan *)lfirst(lc), root, nappinfos, appinfos);
+    break;
+  }
+  default:
+    break;
+  }
+  AdjustPlanExprs(plan->lefttree, root, nappinfos, appinfos);
+  AdjustPlanExprs(plan->righttree, root, nappinfos, appinfos);
+}
+
+void Translator::TranslatePartitionVars(Plan *plan) {
+  if (append_rel_infos_.empty())
+    return;
+  Bitmapset *scanned = nullptr;
+  CollectScanRelids(plan, &scanned);
+  int nappinfos = 0;
+  auto **appinfos = (AppendRelInfo **)palloc(append_rel_infos_.size() *
+                                             sizeof(AppendRelInfo *));
+  for (AppendRelInfo *appinfo : append_rel_infos_) {
+    if (bms_is_member(appinfo->child_relid, scanned))
+      appinfos[nappinfos++] = appinfo;
+  }
+  if (nappinfos == 0)
+    return;
+
+  // Plain Vars are all there is to translate, which needs nothing from the
+  // planner's state.
+  PlannerInfo *root = makeNode(PlannerInfo);
+  root->parse = query_;
+  AdjustPlanExprs(plan, root, nappinfos, appinfos);
+}
+
+OpExpr *Translator::OrientJoinClause(const Predicate *pred,
+                                     const ColSet &outer_relids) {
+  OpExpr *clause = (OpExpr *)copyObjectImpl(pred->GetExpr());
+  if (pred->GetLeftRelids().IsSubset(outer_relids))
+    return clause;
+
+  // The executor expects the outer input's side first.
+  if (!OidIsValid(get_commutator(clause->opno)))
+    return nullptr;
+  CommuteOpExpr(clause);
+  return clause;
+}
+
+AttrNumber Translator::AddInputColumn(Plan *input, Node *expr) {
+  ListCell *lc;
+  foreach (lc, input->targetlist) {
+    TargetEntry *tle = (TargetEntry *)lfirst(lc);
+    Node *candidate = (Node *)tle->expr;
+    if (IsA(candidate, Var) && IsA(expr, Var)) {
+      // Nulling markers aside, as in SetRefs
+      if (((Var *)candidate)->varno == ((Var *)expr)->varno &&
+          ((Var *)candidate)->varattno == ((Var *)expr)->varattno)
+        return tle->resno;
+    } else if (equal(candidate, expr)) {
+      return tle->resno;
+    }
+  }
+
+  // Nodes that cannot project only pass their input's columns through.
+  if (IsA(input, Sort) || IsA(input, IncrementalSort) || IsA(input, Limit) ||
+      IsA(input, Material) || IsA(input, Hash) || IsA(input, Append) ||
+      IsA(input, MergeAppend) || IsA(input, SetOp) || IsA(input, Result) ||
+      IsA(input, Memoize))
+    return InvalidAttrNumber;
+  AttrNumber resno = list_length(input->targetlist) + 1;
+  input->targetlist =
+      lappend(input->targetlist,
+              makeTargetEntry((Expr *)copyObjectImpl(expr), resno,
+                              pstrdup("key"), false));
+  return resno;
+}
+
+Sort *Translator::MakeSort(Plan *input, int nkeys, int presorted) {
+  Sort *sort;
+  if (presorted > 0) {
+    IncrementalSort *incremental = makeNode(IncrementalSort);
+    incremental->nPresortedCols = presorted;
+    sort = &incremental->sort;
+  } else {
+    sort = makeNode(Sort);
+  }
+  sort->plan.lefttree = input;
+  sort->plan.targetlist = (List *)copyObjectImpl(input->targetlist);
+  sort->plan.startup_cost = input->total_cost +
+                            CostModel::SortCost(input->plan_rows,
+                                                input->plan_width);
+  sort->plan.total_cost = sort->plan.startup_cost;
+  sort->plan.plan_rows = input->plan_rows;
+  sort->plan.plan_width = input->plan_width;
+  sort->numCols = nkeys;
+  sort->sortColIdx = (AttrNumber *)palloc(nkeys * sizeof(AttrNumber));
+  sort->sortOperators = (Oid *)palloc(nkeys * sizeof(Oid));
+  sort->collations = (Oid *)palloc(nkeys * sizeof(Oid));
+  sort->nullsFirst = (bool *)palloc(nkeys * sizeof(bool));
+  return sort;
+}
+
+Plan *Translator::SortInput(Memo *memo, Plan *input, const Group *input_group,
+                            const SortKeyList &keys,
+                            const PgVector<AttrNumber> &columns) {
+  int presorted;
+  PlanCost cost =
+      CostModel::SortedInputCost(memo, input_group, keys, &presorted);
+  if (presorted == (int)keys.size())
+    return input;
+
+  Sort *sort = MakeSort(input, keys.size(), presorted);
+  for (size_t i = 0; i < keys.size(); i++) {
+    sort->sortColIdx[i] = columns[i];
+    sort->sortOperators[i] = keys[i].sortop;
+    sort->collations[i] = exprCollation(keys[i].expr);
+    sort->nullsFirst[i] = keys[i].nulls_first;
+  }
+  sort->plan.startup_cost = cost.startup;
+  sort->plan.total_cost = cost.total;
+  return (Plan *)sort;
+}
+
+bool Translator::AddSortKey(Sort *sort, int index, Node *key, Oid opfamily,
+                            Oid collation) {
+  // Merge keys are plain columns (see MakePredicate), possibly relabeled
+  Var *var = (Var *)strip_implicit_coercions(key);
+  TargetEntry *tle = nullptr;
+  ListCell *lc;
+  foreach (lc, sort->plan.targetlist) {
+    TargetEntry *candidate = (TargetEntry *)lfirst(lc);
+    Var *candidate_var = (Var *)candidate->expr;
+    if (IsA(candidate_var, Var) && candidate_var->varno == var->varno &&
+        candidate_var->varattno == var->varattno) {
+      tle = candidate;
+      break;
+    }
+  }
+
+  Oid type = exprType(key);
+  Oid sortop = get_opfamily_member(opfamily, type, type, BTLessStrategyNumber);
+  if (!tle || !OidIsValid(sortop))
+    return false;
+
+  sort->sortColIdx[index] = tle->resno;
+  sort->sortOperators[index] = sortop;
+  sort->collations[index] = collation;
+  sort->nullsFirst[index] = false;
+  return true;
+}
+
+struct NestLoopParamsContext {
+  const ColSet *outer_relids;
+  List **nest_params;
+  List **param_types;
+  Bitmapset *paramids;
+};
+
+static Node *ReplaceNestLoopParamsMutator(Node *node,
+                                          NestLoopParamsContext *context) {
+  if (!node)
+    return nullptr;
+  if (IsA(node, Var) && ((Var *)node)->varlevelsup == 0 &&
+      context->outer_relids->IsMember(((Var *)node)->varno)) {
+    Var *var = (Var *)node;
+    // Every use of an outer column shares one Param.
+    NestLoopParam *param = nullptr;
+    ListCell *lc;
+    foreach (lc, *context->nest_params) {
+      NestLoopParam *candidate = (NestLoopParam *)lfirst(lc);
+      if (candidate->paramval->varno == var->varno &&
+          candidate->paramval->varattno == var->varattno) {
+        param = candidate;
+        break;
+      }
+    }
+    if (!param) {
+      param = makeNode(NestLoopParam);
+      param->paramno = list_length(*context->param_types);
+      param->paramval = (Var *)copyObjectImpl(var);
+      *context->param_types = lappend_oid(*context->param_types,
+                                          var->vartype);
+      *context->nest_params = lappend(*context->nest_params, param);
+    }
+    Param *ref = makeNode(Param);
+    ref->paramkind = PARAM_EXEC;
+    ref->paramid = param->paramno;
+    ref->paramtype = var->vartype;
+    ref->paramtypmod = var->vartypmod;
+    ref->paramcollid = var->varcollid;
+    ref->location = -1;
+    context->paramids = bms_add_member(context->paramids, param->paramno);
+    return (Node *)ref;
+  }
+  return expression_tree_mutator(node, ReplaceNestLoopParamsMutator,
+                                 context);
+}
+
+void Translator::ParameterizeInnerPlan(Plan *plan, const ColSet &outer_relids,
+                                       NestLoop *nest_loop) {
+  NestLoopParamsContext context = {&outer_relids, &nest_loop->nestParams,
+                                   &param_exec_types_, nullptr};
+  auto replace = [&](List *exprs) {
+    return (List *)ReplaceNestLoopParamsMutator((Node *)exprs, &context);
+  };
+  // An index scan, possibly under a Memoize
+  PgVector<Plan *> nodes;
+  for (Plan *node = plan; node; node = node->lefttree)
+    nodes.push_back(node);
+  for (Plan *node : nodes) {
+    node->qual = replace(node->qual);
+    if (IsA(node, IndexScan)) {
+      IndexScan *scan = (IndexScan *)node;
+      scan->indexqual = replace(scan->indexqual);
+      scan->indexqualorig = replace(scan->indexqualorig);
+    } else if (IsA(node, Memoize)) {
+      Memoize *memoize = (Memoize *)node;
+      context.paramids = nullptr;
+      memoize->param_exprs = replace(memoize->param_exprs);
+      memoize->keyparamids = context.paramids;
+    }
+  }
+  // What SS_finalize_plan() would compute: every node depends on all of
+  // the loop's parameters, so a new outer row invalidates its state.
+  Bitmapset *paramids = nullptr;
+  ListCell *lc;
+  foreach (lc, nest_loop->nestParams)
+    paramids = bms_add_member(paramids,
+                              ((NestLoopParam *)lfirst(lc))->paramno);
+  for (Plan *node : nodes) {
+    node->extParam = bms_copy(paramids);
+    node->allParam = bms_copy(paramids);
+  }
+}
+
+List *Translator::MakeQualList(const PredicateList &predicates) {
+  List *quals = NIL;
+  for (const Predicate *pred : predicates)
+    quals = lappend(quals, copyObjectImpl(pred->GetExpr()));
+  return quals;
+}
+
+void Translator::SetPlanEstimates(Plan *plan, const GroupExpression *expr) {
+  plan_exprs_[plan] = expr;
+  plan->startup_cost = expr->GetCost().startup;
+  plan->total_cost = expr->GetCost().total;
+  const LogicalProperties *props = expr->GetGroup()->GetLogicalProperties();
+  if (props) {
+    plan->plan_rows = props->GetCardinality();
+    plan->plan_width = static_cast<int>(props->GetWidth());
+  }
+}
+
+List *Translator::SetOperationInputTargetList(Memo *memo,
+                                              const LogicalProperties *props,
+                                              const PgVector<List *> &columns,
+                                              int input) {
+  // The output columns are Var(rtindex, k), see LogicalSetOperation.
+  List *target_list = NIL;
+  props->GetOutputColumns().ForEach([&](int col_id) {
+    auto *column = static_cast<ExprColumn *>(memo->GetColumn(col_id));
+    AttrNumber k = ((Var *)column->GetExpr())->varattno;
+    Node *expr = (Node *)copyObjectImpl(list_nth(columns[input], k - 1));
+    target_list = lappend(
+        target_list,
+        makeTargetEntry((Expr *)expr, (AttrNumber)list_length(target_list) + 1,
+                        pstrdup("expr"), false));
+  });
+  return target_list;
+}
+
 List *Translator::BuildTargetList(Memo *memo, const LogicalProperties *props) {
   List *target_list = NIL;
-  const ColSet &output_cols = props->GetOutputColumns();
-
-  // Iterate over columns.
-  // Since ColSet doesn't have an iterator for enabled bits easily exposed in
-  // this quick implementation, we might need to iterate up to a max (which is
-  // inefficient) or improve ColSet. For now, let's assume we iterate up to
-  // memo->columns_.size() and check IsSet.
-
-  // TODO: Improve ColSet iteration.
-  // TEMPORARY HACK: Iterate all Memo columns and check if in Output Cols.
-  for (int i = 0; i < 1000; ++i) { // Limit to avoid infinite loop if bug
-    // This is obviously not ideal.
-    // Better: ColSet should expose a way to iterate.
-    // Let's rely on checking common IDs if we knew them, but we don't.
-
-    // Let's modify ColSet in future. For now, we will iterate all columns in
-    // Memo.
-    CarbonColumn *col = memo->GetColumn(i);
+
+  props->GetOutputColumns().ForEach([&](int col_id) {
+    CarbonColumn *col = memo->GetColumn(col_id);
     if (!col)
-      break; // End of registered columns
-
-    // Check if this column is in the output set
-    // We need ColSet::Has(int)
-    // Since we don't have it exposed in the snippet, we added it in thought but
-    // maybe not in code? Re-checking memo.h content... ColSet has Add, Union,
-    // IsSubset. Missing IsMember/Has. I will add a IsMember to ColSet in memo.h
-    // after this or assume it exists/add it now. Wait, I can't modify memo.h
-    // here. I will add IsMember to memo.h in a separate step if needed.
-    // Actually I can access bits_ if protected/public? It is private.
-
-    // STOPGAP: I will add IsMember to ColSet in next step.
-    // For this step, I'll write the code assuming IsMember exists, then fix
-    // memo.h. Or I can use IsSubset with a singleton.
-
-    ColSet singleton = ColSet::MakeSingleton(i);
-    if (singleton.IsSubset(output_cols)) {
-      TargetEntry *tle = nullptr;
-      if (col->GetType() == CarbonColumnType::TABLE_COLUMN) {
-        auto *tc = static_cast<TableColumn *>(col);
-        Var *var = makeVar(tc->GetRtIndex(), tc->GetAttrNum(), INT4OID, -1,
-                           InvalidOid, 0); // Mock types for now
-        tle = makeTargetEntry((Expr *)var,
-                              (AttrNumber)list_length(target_list) + 1,
-                              pstrdup("col"), false);
-      } else if (col->GetType() == CarbonColumnType::EXPR_COLUMN) {
-        auto *ec = static_cast<ExprColumn *>(col);
-        tle = makeTargetEntry((Expr *)copyObjectImpl(ec->GetExpr()),
-                              (AttrNumber)list_length(target_list) + 1,
-                              pstrdup("expr"), false);
-      }
+      return;
 
-      if (tle) {
-        target_list = lappend(target_list, tle);
-      }
+    TargetEntry *tle = nullptr;
+    if (col->GetType() == CarbonColumnType::TABLE_COLUMN) {
+      auto *tc = static_cast<TableColumn *>(col);
+      Var *var = makeVar(tc->GetRtIndex(), tc->GetAttrNum(), tc->GetTypeOid(),
+                         tc->GetTypeMod(), tc->GetCollation(), 0);
+      tle = makeTargetEntry((Expr *)var,
+                            (AttrNumber)list_length(target_list) + 1,
+                            pstrdup("col"), false);
+    } else if (col->GetType() == CarbonColumnType::EXPR_COLUMN) {
+      auto *ec = static_cast<ExprColumn *>(col);
+      tle = makeTargetEntry((Expr *)copyObjectImpl(ec->GetExpr()),
+                            (AttrNumber)list_length(target_list) + 1,
+                            pstrdup("expr"), false);
     }
-  }
+
+    if (tle) {
+      target_list = lappend(target_list, tle);
+    }
+  });
 
   return target_list;
 }
@@ -2,10 +2,13 @@
 #define PG_CARBON_TRANSLATOR_H
 
 #include "../common/memory.h"
+#include "../cost/selectivity.h"
+#include "equivalence.h"
 #include "memo.h"
 
 extern "C" {
 #include "nodes/parsenodes.h"
+#include "nodes/pathnodes.h"
 #include "nodes/plannodes.h"
 #include "postgres.h"
 struct _dummy;
@@ -20,15 +23,145 @@ public:
   // Ingest: PG Query -> Carbon Operator Tree (Root)
   Operator *TranslateQueryToCarbon(Query *pg_query);
 
-  // Egest: Carbon Best Physical Plan -> PG Plan
-  // Egest: Carbon Best Physical Plan -> PG Plan
+  // Egest: Carbon Best Physical Plan -> PG Plan. Expressions still reference
+  // range table Vars; SetRefs::SetPlanReferences() finishes the plan.
   Plan *TranslatePlanToPG(Memo *memo, GroupExpression *best_physical_plan,
                           Query *pg_query);
 
-  static void FixVarsToOuter(Node *node);
+  // Adds every attribute referenced by `node` to `attrs`
+  static void CollectAttrs(Node *node, AttrSet *attrs);
+  // Predicate checking `clause`, with what join planning needs to know
+  // about its operands filled in
+  static Predicate *DescribePredicate(Node *clause, double selectivity);
+  // Column pruning: tells every operator below `op` which columns its
+  // parent needs, `required` being what is needed of `op`.
+  static void DeriveRequiredColumns(Operator *op, const AttrSet *required);
+
+  // Types of the PARAM_EXEC parameters the egested plan uses, by paramid
+  // (PlannedStmt.paramExecTypes)
+  List *GetParamExecTypes() const { return param_exec_types_; }
+
+  // Operator trees of the shared plans of the query's CTEs, by position in
+  // its cteList; nullptr for CTEs that are only ever inlined. The Memo has
+  // to optimize them before the query (Memo::SetCteProducer()).
+  const PgVector<Operator *> &GetCteProducers() const {
+    return cte_producers_;
+  }
+  // Plans of the CTEs the egested plan scans (PlannedStmt.subplans), and
+  // the InitPlans for the top plan node that make them available
+  List *GetSubplans() const { return subplans_; }
+  List *GetInitPlans() const { return init_plans_; }
+  // The Memo expression each node of the egested plan was made from, which
+  // gave it its estimates. Nodes the translator adds of its own accord,
+  // such as the Sort of a merge join input, have none.
+  const PgUnorderedMap<const Plan *, const GroupExpression *> &
+  GetPlanExpressions() const {
+    return plan_exprs_;
+  }
 
 private:
+  // Query shapes the optimizer does not handle yet. Only the query being
+  // planned may have a WITH list.
+  bool IsSupportedQuery(Query *pg_query) const;
+
+  // FROM, WHERE, aggregation and windows of a SELECT: the query itself or
+  // a set operation leaf
+  Operator *TranslateSelect(Query *select);
+  // Set operation whose output columns are Var(rtindex, k)
+  Operator *TranslateSetOperation(SetOperationStmt *setop, Index rtindex);
+  // One input of a set operation, with the expressions it computes for
+  // the output columns in `columns`
+  Operator *TranslateSetOperationInput(Node *arg, List **columns);
+
+  Operator *TranslateFromList(List *fromlist);
+  Operator *TranslateFromItem(Node *item);
+  // Append of the partitions of a partitioned table that the quals
+  // restricting it do not rule out
+  Operator *TranslatePartitionedTable(RangeTblEntry *rte, Index rtindex);
+  // Aggregate over `input`, with the HAVING filter on top
+  Operator *TranslateAggregation(Query *select, Operator *input);
+  // A window over `input` for every window clause with window functions
+  Operator *TranslateWindows(Query *select, Operator *input);
+  // Reference to a CTE of the query at `rtindex`: a CteScan, with the CTE
+  // inlined as its alternative where that is allowed, or only the inlined
+  // CTE if it is referenced once
+  Operator *TranslateCteReference(RangeTblEntry *rte, Index rtindex);
+  // A copy of a CTE's query, whose range table is merged into the query's,
+  // with the copy's target list in `target_list`
+  Operator *TranslateCteQuery(Query *ctequery, List **target_list);
+
+  // Splits quals into predicates and annotates them
+  PredicateList MakePredicates(List *clauses);
+  Predicate *MakePredicate(Node *clause);
+  // Predicates of a semi or anti join whose right input is `inner_item`
+  PredicateList MakeSemiJoinPredicates(List *clauses, Node *inner_item);
+
   List *BuildTargetList(Memo *memo, const LogicalProperties *props);
+  Plan *ApplyTargetList(Plan *plan, List *target_list);
+  // Append, MergeAppend or SetOp computing a set operation
+  bool IsSetOperationPlan(Plan *plan) const;
+  // Adds `quals` to those `plan` checks; false if it cannot check any
+  bool AttachQual(Plan *plan, List *quals);
+
+  // Range table index of the entry scanning `partition` for the partitioned
+  // table at `rtindex`, which is added to the range table on first use
+  Index AddPartitionRte(Index rtindex, Oid partition);
+  // Rewrites the expressions of `plan` and the plans below it from the
+  // columns of partitioned tables to those of the partitions scanned there
+  void TranslatePartitionVars(Plan *plan);
+  static List *MakeQualList(const PredicateList &predicates);
+  // Replaces the outer relations' Vars in the parameterized inner plan of
+  // `nest_loop` with PARAM_EXEC Params, which the nested loop sets from
+  // each outer row (replace_nestloop_params())
+  void ParameterizeInnerPlan(Plan *plan, const ColSet &outer_relids,
+                             NestLoop *nest_loop);
+  // Target list of input `input` of a set operation producing the columns
+  // in `props`: the input's expression for each of them, in the same order
+  static List *SetOperationInputTargetList(Memo *memo,
+                                           const LogicalProperties *props,
+                                           const PgVector<List *> &columns,
+                                           int input);
+
+  // Copy of a hash or merge join key with the outer input's operand first,
+  // or nullptr if the operator has no commutator to allow that
+  static OpExpr *OrientJoinClause(const Predicate *pred,
+                                  const ColSet &outer_relids);
+  // Position of `expr` in the target list of `input`, which gets it added if
+  // need be; InvalidAttrNumber if `input` cannot project
+  static AttrNumber AddInputColumn(Plan *input, Node *expr);
+  // Sort of `input` on `nkeys` keys, filled in by AddSortKey(); an
+  // IncrementalSort if `input` is sorted on the first `presorted` already
+  static Sort *MakeSort(Plan *input, int nkeys, int presorted = 0);
+  // `input`, the plan of the winner of `input_group`, sorted on `keys`,
+  // which are its columns `columns`: by a Sort, an IncrementalSort or not
+  // at all, as CostModel::SortedInputCost() decides
+  static Plan *SortInput(Memo *memo, Plan *input, const Group *input_group,
+                         const SortKeyList &keys,
+                         const PgVector<AttrNumber> &columns);
+  static bool AddSortKey(Sort *sort, int index, Node *key, Oid opfamily,
+                         Oid collation);
+  // InitPlan running the shared plan of CTE `cte_index`, whose plan is
+  // added to the subplans on first use
+  SubPlan *TranslateCtePlan(Memo *memo, int cte_index);
+  void SetPlanEstimates(Plan *plan, const GroupExpression *expr);
+
+  // The query being planned; set operation leaves share its range table
+  Query *query_ = nullptr;
+  SelectivityEstimator *selectivity_ = nullptr;
+  EquivalenceClasses *equivalence_classes_ = nullptr;
+  // Single-relation quals in scope at each base relation, by range table
+  // index; what partition pruning works from
+  PgUnorderedMap<Index, List *> restrictions_;
+  // One per partition scanned by the plan
+  PgVector<AppendRelInfo *> append_rel_infos_;
+  // Output range table indexes of the set operations in the plan
+  Bitmapset *setop_relids_ = nullptr;
+  List *param_exec_types_ = NIL;
+  PgVector<Operator *> cte_producers_;
+  PgUnorderedMap<int, SubPlan *> cte_plans_;
+  List *subplans_ = NIL;
+  List *init_plans_ = NIL;
+  PgUnorderedMap<const Plan *, const GroupExpression *> plan_exprs_;
 };
 
 } // namespace pg_carbon
@@ -1,20 +1,1171 @@
 #include "rules.h"
+#include "../metadata/metadata.h"
 #include "../operators/operators.h"
+#include "../optimizer/translator.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+extern "C" {
+#include "access/stratnum.h"
+#include "catalog/pg_type.h"
+#include "nodes/makefuncs.h"
+#include "nodes/nodeFuncs.h"
+#include "optimizer/optimizer.h"
+#include "optimizer/tlist.h"
+#include "utils/lsyscache.h"
+#include "utils/selfuncs.h"
+#include "utils/typcache.h"
+}
 
 namespace pg_carbon {
 
+// Predicates of one operator, sorted by where they can be evaluated
+struct PredicateSplit {
+  PredicateList left;  // only reads the left input
+  PredicateList right; // only reads the right input
+  PredicateList join;  // needs both (or neither)
+  PredicateList keep;  // volatile, must stay where it is
+};
+
+static PredicateSplit SplitPredicates(const PredicateList &predicates,
+                                      const ColSet &left_relids,
+                                      const ColSet &right_relids) {
+  PredicateSplit split;
+  for (Predicate *pred : predicates) {
+    const ColSet &relids = pred->GetRelids();
+    if (pred->IsVolatile())
+      split.keep.push_back(pred);
+    else if (!relids.IsEmpty() && relids.IsSubset(left_relids))
+      split.left.push_back(pred);
+    else if (!relids.IsEmpty() && relids.IsSubset(right_relids))
+      split.right.push_back(pred);
+    else
+      split.join.push_back(pred);
+  }
+  return split;
+}
+
+// Columns an operator placed below a parent has to produce: whatever the
+// parent has to output plus what the parent's own predicates read.
+static const AttrSet *RequiredBelow(const AttrSet *parent_required,
+                                    const PredicateList &predicates) {
+  if (!parent_required)
+    return nullptr;
+  auto *attrs = new AttrSet();
+  attrs->Union(*parent_required);
+  for (const Predicate *pred : predicates)
+    attrs->Union(pred->GetAttrs());
+  return attrs;
+}
+
+static const ColSet &GroupRelids(Group *group) {
+  return group->GetLogicalProperties()->GetRelids();
+}
+
+// Puts Filter(predicates) on top of `input`, reusing the group if the Memo
+// has seen that filter before.
+static Group *AddFilter(Memo *memo, Group *input,
+                        const PredicateList &predicates,
+                        const AttrSet *required) {
+  if (predicates.empty())
+    return input;
+  auto *filter = new LogicalFilter(predicates);
+  filter->SetRequiredColumns(required);
+  return memo->CopyIn(new GroupExpression(filter, {input}), nullptr)
+      ->GetGroup();
+}
+
+static PredicateList Concat(const PredicateList &a, const PredicateList &b) {
+  PredicateList result(a);
+  result.insert(result.end(), b.begin(), b.end());
+  return result;
+}
+
+// --- RuleFilterPushThroughJoin ---
+
+bool RuleFilterPushThroughJoin::Matches(GroupExpression *expr) const {
+  return expr->GetOperatorType() == OperatorType::LOGICAL_FILTER;
+}
+
+PgVector<GroupExpression *>
+RuleFilterPushThroughJoin::Transform(GroupExpression *expr, Memo *memo) const {
+  auto *filter = static_cast<LogicalFilter *>(expr->GetOperator());
+  PgVector<GroupExpression *> result;
+
+  Group *input = expr->GetChildren()[0];
+  for (GroupExpression *child : input->GetLogicalExpressions()) {
+    auto *join = dynamic_cast<LogicalJoin *>(child->GetOperator());
+    if (!join)
+      continue;
+    Group *left = child->GetChildren()[0];
+    Group *right = child->GetChildren()[1];
+
+    PredicateSplit split = SplitPredicates(
+        filter->GetPredicates(), GroupRelids(left), GroupRelids(right));
+    if (split.keep.size() == filter->GetPredicates().size())
+      continue;
+
+    LogicalJoin *new_join;
+    Group *new_left;
+    Group *new_right = right;
+    if (join->GetJoinType() == JOIN_FULL)
+      continue;
+    if (join->GetJoinType() == JOIN_INNER) {
+      // Everything that is not pushed further down becomes a join
+      // predicate; for an inner join that is the same as filtering its
+      // output.
+      PredicateList join_predicates =
+          Concat(join->GetPredicates(), split.join);
+      new_join = join->WithPredicates(join_predicates);
+      new_join->SetRequiredColumns(
+          RequiredBelow(filter->GetRequiredColumns(), split.keep));
+
+      const AttrSet *input_required =
+          RequiredBelow(new_join->GetRequiredColumns(), join_predicates);
+      new_left = AddFilter(memo, left, split.left, input_required);
+      new_right = AddFilter(memo, right, split.right, input_required);
+    } else {
+      // Semi and anti joins only output left rows, and a left join may
+      // fill the right columns with NULLs, so only filters on the left
+      // input can move below them.
+      if (split.left.empty())
+        continue;
+      split.keep = Concat(Concat(split.keep, split.right), split.join);
+      new_join = join->WithPredicates(join->GetPredicates());
+      new_join->SetRequiredColumns(
+          RequiredBelow(filter->GetRequiredColumns(), split.keep));
+
+      const AttrSet *input_required = RequiredBelow(
+          new_join->GetRequiredColumns(), join->GetPredicates());
+      new_left = AddFilter(memo, left, split.left, input_required);
+    }
+    auto *join_expr = new GroupExpression(new_join, {new_left, new_right});
+
+    if (split.keep.empty()) {
+      result.push_back(join_expr);
+      continue;
+    }
+
+    Group *join_group = memo->CopyIn(join_expr, nullptr)->GetGroup();
+    auto *remaining = new LogicalFilter(split.keep);
+    remaining->SetRequiredColumns(filter->GetRequiredColumns());
+    result.push_back(new GroupExpression(remaining, {join_group}));
+  }
+
+  return result;
+}
+
+// --- RuleJoinPredicatePushDown ---
+
+bool RuleJoinPredicatePushDown::Matches(GroupExpression *expr) const {
+  return expr->IsLogical() && dynamic_cast<LogicalJoin *>(expr->GetOperator());
+}
+
+PgVector<GroupExpression *>
+RuleJoinPredicatePushDown::Transform(GroupExpression *expr, Memo *memo) const {
+  auto *join = static_cast<LogicalJoin *>(expr->GetOperator());
+  Group *left = expr->GetChildren()[0];
+  Group *right = expr->GetChildren()[1];
+  PgVector<GroupExpression *> result;
+
+  PredicateSplit split = SplitPredicates(join->GetPredicates(),
+                                         GroupRelids(left), GroupRelids(right));
+  // A left row without a match is still returned by an anti or outer
+  // join, so predicates on a preserved input have to stay in the join.
+  JoinType join_type = join->GetJoinType();
+  if (join_type == JOIN_ANTI || join_type == JOIN_LEFT ||
+      join_type == JOIN_FULL) {
+    split.keep = Concat(split.keep, split.left);
+    split.left.clear();
+  }
+  if (join_type == JOIN_FULL) {
+    split.keep = Concat(split.keep, split.right);
+    split.right.clear();
+  }
+  if (split.left.empty() && split.right.empty())
+    return result;
+
+  PredicateList join_predicates = Concat(split.join, split.keep);
+  LogicalJoin *new_join = join->WithPredicates(join_predicates);
+  new_join->SetRequiredColumns(join->GetRequiredColumns());
+
+  const AttrSet *input_required =
+      RequiredBelow(join->GetRequiredColumns(), join_predicates);
+  Group *new_left = AddFilter(memo, left, split.left, input_required);
+  Group *new_right = AddFilter(memo, right, split.right, input_required);
+  result.push_back(new GroupExpression(new_join, {new_left, new_right}));
+  return result;
+}
+
+// Operators of `group` that are joins of type `join_type`
+static PgVector<GroupExpression *> JoinsOfType(Group *group,
+                                               OperatorType join_type) {
+  PgVector<GroupExpression *> joins;
+  for (GroupExpression *expr : group->GetLogicalExpressions()) {
+    if (expr->GetOperatorType() == join_type)
+      joins.push_back(expr);
+  }
+  return joins;
+}
+
+static bool HasVolatile(const PredicateList &predicates) {
+  for (const Predicate *pred : predicates) {
+    if (pred->IsVolatile())
+      return true;
+  }
+  return false;
+}
+
+// Whether none of `predicates` reads a relation of `relids`
+static bool NoneReads(const PredicateList &predicates, const ColSet &relids) {
+  for (const Predicate *pred : predicates) {
+    if (pred->GetRelids().Overlaps(relids))
+      return false;
+  }
+  return true;
+}
+
+static ColSet UnionRelids(Group *a, Group *b) {
+  ColSet relids = GroupRelids(a);
+  relids.Union(GroupRelids(b));
+  return relids;
+}
+
+// Builds top(lower(ll, lr), r) where the top join keeps the required
+// columns of `parent`, the join being rewritten.
+static GroupExpression *MakeJoinTree(Memo *memo, const LogicalJoin *parent,
+                                     LogicalJoin *top, LogicalJoin *lower,
+                                     Group *lower_left, Group *lower_right,
+                                     Group *other, bool lower_on_left) {
+  top->SetRequiredColumns(parent->GetRequiredColumns());
+  lower->SetRequiredColumns(
+      RequiredBelow(parent->GetRequiredColumns(), top->GetPredicates()));
+  Group *lower_group =
+      memo->CopyIn(new GroupExpression(lower, {lower_left, lower_right}),
+                   nullptr)
+          ->GetGroup();
+  if (lower_on_left)
+    return new GroupExpression(top, {lower_group, other});
+  return new GroupExpression(top, {other, lower_group});
+}
+
+// --- RuleJoinCommutativity ---
+
+bool RuleJoinCommutativity::Matches(GroupExpression *expr) const {
+  return expr->GetOperatorType() == OperatorType::LOGICAL_INNER_JOIN;
+}
+
+PgVector<GroupExpression *>
+RuleJoinCommutativity::Transform(GroupExpression *expr, Memo *memo) const {
+  auto *join = static_cast<LogicalJoin *>(expr->GetOperator());
+  LogicalJoin *swapped = join->WithPredicates(join->GetPredicates());
+  swapped->SetRequiredColumns(join->GetRequiredColumns());
+
+  PgVector<GroupExpression *> result;
+  result.push_back(new GroupExpression(
+      swapped, {expr->GetChildren()[1], expr->GetChildren()[0]}));
+  return result;
+}
+
+// --- RuleJoinAssociativity ---
+
+bool RuleJoinAssociativity::Matches(GroupExpression *expr) const {
+  return expr->GetOperatorType() == OperatorType::LOGICAL_INNER_JOIN;
+}
+
+PgVector<GroupExpression *>
+RuleJoinAssociativity::Transform(GroupExpression *expr, Memo *memo) const {
+  auto *join = static_cast<LogicalJoin *>(expr->GetOperator());
+  Group *c = expr->GetChildren()[1];
+  PgVector<GroupExpression *> result;
+  if (HasVolatile(join->GetPredicates()))
+    return result;
+
+  for (GroupExpression *child :
+       JoinsOfType(expr->GetChildren()[0], OperatorType::LOGICAL_INNER_JOIN)) {
+    auto *child_join = static_cast<LogicalJoin *>(child->GetOperator());
+    if (HasVolatile(child_join->GetPredicates()))
+      continue;
+    Group *a = child->GetChildren()[0];
+    Group *b = child->GetChildren()[1];
+
+    ColSet bc = UnionRelids(b, c);
+    PredicateList lower;
+    PredicateList upper;
+    for (Predicate *pred :
+         Concat(child_join->GetPredicates(), join->GetPredicates())) {
+      const ColSet &relids = pred->GetRelids();
+      if (!relids.IsEmpty() && relids.IsSubset(bc))
+        lower.push_back(pred);
+      else
+        upper.push_back(pred);
+    }
+    if (lower.empty())
+      continue;
+
+    result.push_back(MakeJoinTree(memo, join, join->WithPredicates(upper),
+                                  join->WithPredicates(lower), b, c, a,
+                                  false));
+  }
+  return result;
+}
+
+// --- RuleLeftJoinAssociativity ---
+
+bool RuleLeftJoinAssociativity::Matches(GroupExpression *expr) const {
+  return expr->GetOperatorType() == OperatorType::LOGICAL_LEFT_JOIN;
+}
+
+PgVector<GroupExpression *>
+RuleLeftJoinAssociativity::Transform(GroupExpression *expr, Memo *memo) const {
+  auto *join = static_cast<LogicalJoin *>(expr->GetOperator());
+  Group *c = expr->GetChildren()[1];
+  PgVector<GroupExpression *> result;
+  if (HasVolatile(join->GetPredicates()))
+    return result;
+
+  for (GroupExpression *child :
+       JoinsOfType(expr->GetChildren()[0], OperatorType::LOGICAL_LEFT_JOIN)) {
+    auto *child_join = static_cast<LogicalJoin *>(child->GetOperator());
+    if (HasVolatile(child_join->GetPredicates()))
+      continue;
+    Group *a = child->GetChildren()[0];
+    Group *b = child->GetChildren()[1];
+
+    if (!NoneReads(join->GetPredicates(), GroupRelids(a)))
+      continue;
+    bool strict_for_b = false;
+    for (const Predicate *pred : join->GetPredicates()) {
+      if (pred->GetNonNullableRelids().Overlaps(GroupRelids(b)))
+        strict_for_b = true;
+    }
+    if (!strict_for_b)
+      continue;
+
+    result.push_back(MakeJoinTree(
+        memo, join, child_join->WithPredicates(child_join->GetPredicates()),
+        join->WithPredicates(join->GetPredicates()), b, c, a, false));
+  }
+  return result;
+}
+
+// --- RuleInnerJoinPastLeftJoin ---
+
+bool RuleInnerJoinPastLeftJoin::Matches(GroupExpression *expr) const {
+  return expr->GetOperatorType() == OperatorType::LOGICAL_INNER_JOIN;
+}
+
+PgVector<GroupExpression *>
+RuleInnerJoinPastLeftJoin::Transform(GroupExpression *expr, Memo *memo) const {
+  auto *join = static_cast<LogicalJoin *>(expr->GetOperator());
+  Group *c = expr->GetChildren()[1];
+  PgVector<GroupExpression *> result;
+  if (HasVolatile(join->GetPredicates()))
+    return result;
+
+  for (GroupExpression *child :
+       JoinsOfType(expr->GetChildren()[0], OperatorType::LOGICAL_LEFT_JOIN)) {
+    auto *child_join = static_cast<LogicalJoin *>(child->GetOperator());
+    if (HasVolatile(child_join->GetPredicates()))
+      continue;
+    Group *a = child->GetChildren()[0];
+    Group *b = child->GetChildren()[1];
+    if (!NoneReads(join->GetPredicates(), GroupRelids(b)))
+      continue;
+
+    result.push_back(MakeJoinTree(
+        memo, join, child_join->WithPredicates(child_join->GetPredicates()),
+        join->WithPredicates(join->GetPredicates()), a, c, b, true));
+  }
+  return result;
+}
+
+// --- RuleLeftJoinPastInnerJoin ---
+
+bool RuleLeftJoinPastInnerJoin::Matches(GroupExpression *expr) const {
+  return expr->GetOperatorType() == OperatorType::LOGICAL_LEFT_JOIN;
+}
+
+PgVector<GroupExpression *>
+RuleLeftJoinPastInnerJoin::Transform(GroupExpression *expr, Memo *memo) const {
+  auto *join = static_cast<LogicalJoin *>(expr->GetOperator());
+  Group *c = expr->GetChildren()[1];
+  PgVector<GroupExpression *> result;
+  if (HasVolatile(join->GetPredicates()))
+    return result;
+
+  for (GroupExpression *child :
+       JoinsOfType(expr->GetChildren()[0], OperatorType::LOGICAL_INNER_JOIN)) {
+    auto *child_join = static_cast<LogicalJoin *>(child->GetOperator());
+    if (HasVolatile(child_join->GetPredicates()))
+      continue;
+    Group *a = child->GetChildren()[0];
+    Group *b = child->GetChildren()[1];
+    if (!NoneReads(join->GetPredicates(), GroupRelids(b)))
+      continue;
+
+    result.push_back(MakeJoinTree(
+        memo, join, child_join->WithPredicates(child_join->GetPredicates()),
+        join->WithPredicates(join->GetPredicates()), a, c, b, true));
+  }
+  return result;
+}
+
+// --- RuleJoinElimination ---
+
+bool RuleJoinElimination::Matches(GroupExpression *expr) const {
+  OperatorType type = expr->GetOperatorType();
+  return type == OperatorType::LOGICAL_INNER_JOIN ||
+         type == OperatorType::LOGICAL_LEFT_JOIN;
+}
+
+// The table `group` returns rows of, if it scans a single table (through
+// filters, if `allow_filters`)
+static LogicalGet *BaseTable(Group *group, bool allow_filters) {
+  for (GroupExpression *expr : group->GetLogicalExpressions()) {
+    Operator *op = expr->GetOperator();
+    // A partition only holds some of its table's rows.
+    if (op->GetType() == OperatorType::LOGICAL_GET)
+      return static_cast<LogicalGet *>(op)->IsPartition()
+                 ? nullptr
+                 : static_cast<LogicalGet *>(op);
+    if (allow_filters && op->GetType() == OperatorType::LOGICAL_FILTER) {
+      if (LogicalGet *get = BaseTable(expr->GetChildren()[0], true))
+        return get;
+    }
+  }
+  return nullptr;
+}
+
+// The column `pred` compares on relation `rt_index`, with the column it is
+// compared to in `other`; nullptr unless the predicate compares a column of
+// that relation with one of another relation.
+static const ColumnRef *ColumnOf(const Predicate *pred, Index rt_index,
+                                 const ColumnRef **other) {
+  if (!pred->HasColumnOperands() || pred->IsVolatile())
+    return nullptr;
+  const ColumnRef &left = pred->GetLeftColumn();
+  const ColumnRef &right = pred->GetRightColumn();
+  if (left.rt_index == rt_index && right.rt_index != rt_index) {
+    *other = &right;
+    return &left;
+  }
+  if (right.rt_index == rt_index && left.rt_index != rt_index) {
+    *other = &left;
+    return &right;
+  }
+  return nullptr;
+}
+
+// Whether `predicates` compare every column of a unique key of `get`'s
+// table for equality, so that at most one of its rows can match.
+static bool MatchesUniqueKey(const PredicateList &predicates,
+                             const LogicalGet *get) {
+  const TableMetadata *metadata =
+      MetadataAccessor::GetTableMetadata(get->GetTableOid());
+  for (const UniqueKey &key : metadata->unique_keys) {
+    bool covered = true;
+    for (size_t i = 0; covered && i < key.columns.size(); i++) {
+      covered = false;
+      for (const Predicate *pred : predicates) {
+        const ColumnRef *other;
+        const ColumnRef *column = ColumnOf(pred, get->GetRtIndex(), &other);
+        if (column && column->attr_num == key.columns[i] &&
+            get_op_opfamily_strategy(pred->GetOperatorOid(),
+                                     key.opfamilies[i]) ==
+                BTEqualStrategyNumber) {
+          covered = true;
+          break;
+        }
+      }
+    }
+    if (covered)
+      return true;
+  }
+  return false;
+}
+
+// Whether `predicates` are exactly the column pairs of a foreign key that
+// references `get`'s table, so that every row of the other input has one
+// match. Any other predicate could reject rows.
+static bool MatchesForeignKey(const PredicateList &predicates,
+                              const LogicalGet *get) {
+  if (predicates.empty())
+    return false;
+  const ColumnRef *referencing = nullptr;
+  for (const Predicate *pred : predicates) {
+    const ColumnRef *other;
+    if (!ColumnOf(pred, get->GetRtIndex(), &other) || other->nullable)
+      return false;
+    if (referencing && other->rt_index != referencing->rt_index)
+      return false;
+    referencing = other;
+  }
+
+  const TableMetadata *metadata =
+      MetadataAccessor::GetTableMetadata(referencing->table_oid);
+  for (const ForeignKey &key : metadata->foreign_keys) {
+    if (key.referenced_table != get->GetTableOid() ||
+        key.columns.size() != predicates.size())
+      continue;
+    PgVector<bool> matched(key.columns.size(), false);
+    size_t nmatched = 0;
+    for (const Predicate *pred : predicates) {
+      const ColumnRef *other;
+      const ColumnRef *column = ColumnOf(pred, get->GetRtIndex(), &other);
+      Oid opno = pred->GetOperatorOid();
+      for (size_t i = 0; i < key.columns.size(); i++) {
+        if (!matched[i] && other->attr_num == key.columns[i] &&
+            column->attr_num == key.referenced_columns[i] &&
+            (opno == key.operators[i] ||
+             opno == get_commutator(key.operators[i]))) {
+          matched[i] = true;
+          nmatched++;
+          break;
+        }
+      }
+    }
+    if (nmatched == key.columns.size())
+      return true;
+  }
+  return false;
+}
+
+PgVector<GroupExpression *>
+RuleJoinElimination::Transform(GroupExpression *expr, Memo *memo) const {
+  auto *join = static_cast<LogicalJoin *>(expr->GetOperator());
+  Group *left = expr->GetChildren()[0];
+  Group *right = expr->GetChildren()[1];
+  PgVector<GroupExpression *> result;
+
+  const AttrSet *required = join->GetRequiredColumns();
+  if (!required || required->GetRelids().Overlaps(GroupRelids(right)))
+    return result;
+
+  // An inner join also drops the rows a filter on the table rejects.
+  bool inner = join->GetJoinType() == JOIN_INNER;
+  LogicalGet *get = BaseTable(right, !inner);
+  if (!get)
+    return result;
+  if (inner ? !MatchesForeignKey(join->GetPredicates(), get)
+            : !MatchesUniqueKey(join->GetPredicates(), get))
+    return result;
+
+  auto *identity = new LogicalFilter(PredicateList());
+  identity->SetRequiredColumns(required);
+  result.push_back(new GroupExpression(identity, {left}));
+  return result;
+}
+
+// --- RuleEagerAggregation ---
+
+bool RuleEagerAggregation::Matches(GroupExpression *expr) const {
+  if (expr->GetOperatorType() != OperatorType::LOGICAL_AGGREGATE)
+    return false;
+  auto *agg = static_cast<LogicalAggregate *>(expr->GetOperator());
+  return agg->GetSplit() == AGGSPLIT_SIMPLE && agg->IsPartialAggregable();
+}
+
+static bool CollectVarsWalker(Node *node, List **vars) {
+  if (!node)
+    return false;
+  if (IsA(node, Var)) {
+    if (((Var *)node)->varlevelsup == 0)
+      *vars = lappend(*vars, node);
+    return false;
+  }
+  return expression_tree_walker(node, CollectVarsWalker, (void *)vars);
+}
+
+// Vars of the current query level in `node`, aggregate arguments included
+static List *CollectVars(Node *node) {
+  List *vars = NIL;
+  CollectVarsWalker(node, &vars);
+  return vars;
+}
+
+static bool AllVarsIn(List *vars, const ColSet &relids) {
+  ListCell *lc;
+  foreach (lc, vars) {
+    if (!relids.IsMember(((Var *)lfirst(lc))->varno))
+      return false;
+  }
+  return true;
+}
+
+// Grouping keys of a partial aggregate over the join input with `relids`:
+// the keys it can evaluate itself, its columns in the other keys and the
+// columns the join predicates read from it. False if one of those columns
+// cannot be grouped on.
+static bool MakePartialKeys(const GroupKeyList &keys,
+                            const PredicateList &predicates,
+                            const ColSet &relids, GroupKeyList *partial) {
+  auto AddKey = [&](const GroupKey &key) {
+    for (const GroupKey &existing : *partial) {
+      if (equal(existing.expr, key.expr))
+        return;
+    }
+    partial->push_back(key);
+  };
+  auto AddVars = [&](List *vars) {
+    ListCell *lc;
+    foreach (lc, vars) {
+      Var *var = (Var *)lfirst(lc);
+      if (!relids.IsMember(var->varno))
+        continue;
+      TypeCacheEntry *type = lookup_type_cache(
+          var->vartype,
+          TYPECACHE_EQ_OPR | TYPECACHE_LT_OPR | TYPECACHE_HASH_PROC);
+      if (!OidIsValid(type->eq_opr))
+        return false;
+      AddKey({(Node *)var, type->eq_opr, type->lt_opr,
+              OidIsValid(type->hash_proc)});
+    }
+    return true;
+  };
+
+  for (const GroupKey &key : keys) {
+    List *vars = CollectVars(key.expr);
+    if (AllVarsIn(vars, relids))
+      AddKey(key);
+    else if (!AddVars(vars))
+      return false;
+  }
+  for (const Predicate *pred : predicates) {
+    if (!AddVars(CollectVars(pred->GetExpr())))
+      return false;
+  }
+  return true;
+}
+
+PgVector<GroupExpression *>
+RuleEagerAggregation::Transform(GroupExpression *expr, Memo *memo) const {
+  auto *agg = static_cast<LogicalAggregate *>(expr->GetOperator());
+  PgVector<GroupExpression *> result;
+  if (contain_volatile_functions((Node *)agg->GetAggregates()))
+    return result;
+  List *agg_vars = CollectVars((Node *)agg->GetAggregates());
+
+  Group *input = expr->GetChildren()[0];
+  for (GroupExpression *child : input->GetLogicalExpressions()) {
+    OperatorType type = child->GetOperatorType();
+    if (type != OperatorType::LOGICAL_INNER_JOIN &&
+        type != OperatorType::LOGICAL_LEFT_JOIN)
+      continue;
+    auto *join = static_cast<LogicalJoin *>(child->GetOperator());
+    // Grouping first would change how often a volatile predicate runs.
+    if (HasVolatile(join->GetPredicates()))
+      continue;
+
+    // Only the preserved side of a left join: grouping the nullable side
+    // would leave NULL-extended rows without a partial result.
+    int sides = type == OperatorType::LOGICAL_LEFT_JOIN ? 1 : 2;
+    for (int side = 0; side < sides; side++) {
+      Group *pushed = child->GetChildren()[side];
+      Group *other = child->GetChildren()[1 - side];
+      const ColSet &relids = GroupRelids(pushed);
+      if (!AllVarsIn(agg_vars, relids))
+        continue;
+
+      GroupKeyList partial_keys;
+      if (!MakePartialKeys(agg->GetKeys(), join->GetPredicates(), relids,
+                           &partial_keys))
+        continue;
+
+      auto *partial = new LogicalAggregate(std::move(partial_keys),
+                                           agg->GetAggregates(),
+                                           AGGSPLIT_INITIAL_SERIAL, true, agg);
+      Group *partial_group =
+          memo->CopyIn(new GroupExpression(partial, {pushed}), nullptr)
+              ->GetGroup();
+
+      LogicalJoin *new_join = join->WithPredicates(join->GetPredicates());
+      new_join->SetRequiredColumns(join->GetRequiredColumns());
+      auto *join_expr =
+          side == 0
+              ? new GroupExpression(new_join, {partial_group, other})
+              : new GroupExpression(new_join, {other, partial_group});
+      Group *join_group = memo->CopyIn(join_expr, nullptr)->GetGroup();
+
+      auto *final_agg =
+          new LogicalAggregate(agg->GetKeys(), agg->GetAggregates(),
+                               AGGSPLIT_FINAL_DESERIAL, false, agg);
+      result.push_back(new GroupExpression(final_agg, {join_group}));
+    }
+  }
+  return result;
+}
+
+// --- RuleFilterPushThroughAppend ---
+
+bool RuleFilterPushThroughAppend::Matches(GroupExpression *expr) const {
+  return expr->GetOperatorType() == OperatorType::LOGICAL_FILTER;
+}
+
+// The Append of partitions among the operators of `group`, if any
+static GroupExpression *PartitionAppend(Group *group) {
+  for (GroupExpression *expr : group->GetLogicalExpressions()) {
+    if (expr->GetOperatorType() != OperatorType::LOGICAL_APPEND)
+      continue;
+    auto *append = static_cast<LogicalAppend *>(expr->GetOperator());
+    // Not the stand-in for a table whose partitions were all pruned
+    if (append->IsPartitioned() &&
+        append->GetPartitions().size() == expr->GetChildren().size())
+      return expr;
+  }
+  return nullptr;
+}
+
+static LogicalAppend *CopyAppend(const LogicalAppend *append) {
+  return new LogicalAppend(append->GetTableOid(), append->GetRtIndex(),
+                           append->GetPartitions());
+}
+
+PgVector<GroupExpression *>
+RuleFilterPushThroughAppend::Transform(GroupExpression *expr,
+                                       Memo *memo) const {
+  auto *filter = static_cast<LogicalFilter *>(expr->GetOperator());
+  PgVector<GroupExpression *> result;
+  GroupExpression *child = PartitionAppend(expr->GetChildren()[0]);
+  if (!child)
+    return result;
+
+  PgVector<Group *> branches;
+  for (Group *partition : child->GetChildren())
+    branches.push_back(AddFilter(memo, partition, filter->GetPredicates(),
+                                 filter->GetRequiredColumns()));
+  auto *append = CopyAppend(static_cast<LogicalAppend *>(child->GetOperator()));
+  result.push_back(new GroupExpression(append, std::move(branches)));
+  return result;
+}
+
+// --- RulePartitionwiseJoin ---
+
+bool RulePartitionwiseJoin::Matches(GroupExpression *expr) const {
+  return expr->GetOperatorType() == OperatorType::LOGICAL_INNER_JOIN;
+}
+
+// Whether `predicates` compare each partition key column of the table
+// `left` partitions with the same one of `right`, using the equality of the
+// key's operator family
+static bool JoinsOnPartitionKeys(const PredicateList &predicates,
+                                 const LogicalAppend *left,
+                                 const LogicalAppend *right) {
+  const TableMetadata *metadata =
+      MetadataAccessor::GetTableMetadata(left->GetTableOid());
+  const TableMetadata *right_metadata =
+      MetadataAccessor::GetTableMetadata(right->GetTableOid());
+  int16 strategy = metadata->partition_strategy == PARTITION_STRATEGY_HASH
+                       ? HTEqualStrategyNumber
+                       : BTEqualStrategyNumber;
+  for (size_t i = 0; i < metadata->partition_key.size(); i++) {
+    AttrNumber left_attr = metadata->partition_key[i];
+    AttrNumber right_attr = right_metadata->partition_key[i];
+    bool found = false;
+    for (const Predicate *pred : predicates) {
+      const ColumnRef *other = nullptr;
+      const ColumnRef *column = ColumnOf(pred, left->GetRtIndex(), &other);
+      if (column && column->attr_num == left_attr &&
+          other->rt_index == right->GetRtIndex() &&
+          other->attr_num == right_attr &&
+          get_op_opfamily_strategy(pred->GetOperatorOid(),
+                                   metadata->partition_opfamilies[i]) ==
+              strategy) {
+        found = true;
+        break;
+      }
+    }
+    // Expression keys (attribute 0) cannot be matched.
+    if (!found || left_attr == InvalidAttrNumber)
+      return false;
+  }
+  return true;
+}
+
+// Whether all of `append`'s partitions sit directly below its table, so
+// their bound indexes identify them
+static bool SingleLevelPartitions(const LogicalAppend *append) {
+  const TableMetadata *metadata =
+      MetadataAccessor::GetTableMetadata(append->GetTableOid());
+  for (int index : append->GetPartitions()) {
+    if (metadata->partitions[index].bound_index < 0)
+      return false;
+  }
+  return true;
+}
+
+PgVector<GroupExpression *>
+RulePartitionwiseJoin::Transform(GroupExpression *expr, Memo *memo) const {
+  auto *join = static_cast<LogicalJoin *>(expr->GetOperator());
+  PgVector<GroupExpression *> result;
+  GroupExpression *left_expr = PartitionAppend(expr->GetChildren()[0]);
+  GroupExpression *right_expr = PartitionAppend(expr->GetChildren()[1]);
+  if (!left_expr || !right_expr || HasVolatile(join->GetPredicates()))
+    return result;
+  auto *left = static_cast<LogicalAppend *>(left_expr->GetOperator());
+  auto *right = static_cast<LogicalAppend *>(right_expr->GetOperator());
+  if (left->GetRtIndex() == right->GetRtIndex() ||
+      !SingleLevelPartitions(left) || !SingleLevelPartitions(right) ||
+      !MetadataAccessor::PartitionBoundsMatch(left->GetTableOid(),
+                                              right->GetTableOid()) ||
+      !JoinsOnPartitionKeys(join->GetPredicates(), left, right))
+    return result;
+
+  // Pair up the partitions with the same bound.
+  const TableMetadata *left_metadata =
+      MetadataAccessor::GetTableMetadata(left->GetTableOid());
+  const TableMetadata *right_metadata =
+      MetadataAccessor::GetTableMetadata(right->GetTableOid());
+  PgVector<int> partitions;
+  PgVector<Group *> branches;
+  for (size_t i = 0; i < left->GetPartitions().size(); i++) {
+    int bound =
+        left_metadata->partitions[left->GetPartitions()[i]].bound_index;
+    for (size_t j = 0; j < right->GetPartitions().size(); j++) {
+      if (right_metadata->partitions[right->GetPartitions()[j]]
+              .bound_index != bound)
+        continue;
+      LogicalJoin *branch_join = join->WithPredicates(join->GetPredicates());
+      branch_join->SetRequiredColumns(join->GetRequiredColumns());
+      auto *branch = new GroupExpression(
+          branch_join,
+          {left_expr->GetChildren()[i], right_expr->GetChildren()[j]});
+      branches.push_back(memo->CopyIn(branch, nullptr)->GetGroup());
+      partitions.push_back(left->GetPartitions()[i]);
+    }
+  }
+  if (branches.empty())
+    return result;
+
+  auto *append = new LogicalAppend(left->GetTableOid(), left->GetRtIndex(),
+                                   std::move(partitions));
+  result.push_back(new GroupExpression(append, std::move(branches)));
+  return result;
+}
+
+// --- RulePartitionwiseAggregate ---
+
+bool RulePartitionwiseAggregate::Matches(GroupExpression *expr) const {
+  if (expr->GetOperatorType() != OperatorType::LOGICAL_AGGREGATE)
+    return false;
+  auto *agg = static_cast<LogicalAggregate *>(expr->GetOperator());
+  return agg->GetSplit() == AGGSPLIT_SIMPLE;
+}
+
+// Whether `keys` group on every partition key column of `append`'s table
+static bool GroupsOnPartitionKeys(const GroupKeyList &keys,
+                                  const LogicalAppend *append) {
+  const TableMetadata *metadata =
+      MetadataAccessor::GetTableMetadata(append->GetTableOid());
+  for (AttrNumber attr : metadata->partition_key) {
+    bool found = false;
+    for (const GroupKey &key : keys) {
+      Var *var = (Var *)key.expr;
+      if (IsA(var, Var) && var->varlevelsup == 0 &&
+          var->varno == (int)append->GetRtIndex() && var->varattno == attr) {
+        found = true;
+        break;
+      }
+    }
+    if (!found || attr == InvalidAttrNumber)
+      return false;
+  }
+  return true;
+}
+
+PgVector<GroupExpression *>
+RulePartitionwiseAggregate::Transform(GroupExpression *expr,
+                                      Memo *memo) const {
+  auto *agg = static_cast<LogicalAggregate *>(expr->GetOperator());
+  PgVector<GroupExpression *> result;
+  GroupExpression *child = PartitionAppend(expr->GetChildren()[0]);
+  if (!child || contain_volatile_functions((Node *)agg->GetAggregates()))
+    return result;
+  auto *append = static_cast<LogicalAppend *>(child->GetOperator());
+
+  // Every group lies within one partition: aggregate them separately.
+  if (SingleLevelPartitions(append) &&
+      GroupsOnPartitionKeys(agg->GetKeys(), append)) {
+    PgVector<Group *> branches;
+    for (Group *partition : child->GetChildren()) {
+      auto *branch_agg =
+          new LogicalAggregate(agg->GetKeys(), agg->GetAggregates(),
+                               AGGSPLIT_SIMPLE, agg->IsPartialAggregable(),
+                               agg);
+      branches.push_back(
+          memo->CopyIn(new GroupExpression(branch_agg, {partition}), nullptr)
+              ->GetGroup());
+    }
+    result.push_back(
+        new GroupExpression(CopyAppend(append), std::move(branches)));
+    return result;
+  }
+
+  if (!agg->IsPartialAggregable())
+    return result;
+  // Partial results of a group can come from several partitions; they are
+  // no partition's rows any more, so their Append is a plain one.
+  PgVector<Group *> branches;
+  for (Group *partition : child->GetChildren()) {
+    auto *partial =
+        new LogicalAggregate(agg->GetKeys(), agg->GetAggregates(),
+                             AGGSPLIT_INITIAL_SERIAL, true, agg);
+    branches.push_back(
+        memo->CopyIn(new GroupExpression(partial, {partition}), nullptr)
+            ->GetGroup());
+  }
+  auto *partials_expr =
+      new GroupExpression(new LogicalAppend(), std::move(branches));
+  Group *partials = memo->CopyIn(partials_expr, nullptr)->GetGroup();
+  auto *final_agg = new LogicalAggregate(agg->GetKeys(), agg->GetAggregates(),
+                                         AGGSPLIT_FINAL_DESERIAL, false, agg);
+  result.push_back(new GroupExpression(final_agg, {partials}));
+  return result;
+}
+
+// --- RuleUnionToAggregate ---
+
+bool RuleUnionToAggregate::Matches(GroupExpression *expr) const {
+  if (expr->GetOperatorType() != OperatorType::LOGICAL_SET_OPERATION)
+    return false;
+  auto *setop = static_cast<LogicalSetOperation *>(expr->GetOperator());
+  return setop->GetOperation() == SETOP_UNION && !setop->IsAll();
+}
+
+PgVector<GroupExpression *>
+RuleUnionToAggregate::Transform(GroupExpression *expr, Memo *memo) const {
+  auto *setop = static_cast<LogicalSetOperation *>(expr->GetOperator());
+  PgVector<GroupExpression *> result;
+  if (list_length(setop->GetGroupClauses()) != setop->GetNumColumns())
+    return result;
+
+  GroupKeyList keys;
+  List *first = setop->GetInputColumns()[0];
+  int k = 1;
+  ListCell *lc;
+  foreach (lc, setop->GetGroupClauses()) {
+    SortGroupClause *sgc = (SortGroupClause *)lfirst(lc);
+    Node *column = (Node *)list_nth(first, k - 1);
+    Var *var = makeVar(setop->GetRtIndex(), k, exprType(column),
+                       exprTypmod(column), exprCollation(column), 0);
+    keys.push_back({(Node *)var, sgc->eqop, sgc->sortop, sgc->hashable});
+    k++;
+  }
+
+  auto *union_all = new LogicalSetOperation(
+      SETOP_UNION, true, setop->GetRtIndex(), setop->GetInputColumns(),
+      setop->GetGroupClauses());
+  Group *input =
+      memo->CopyIn(new GroupExpression(union_all, expr->GetChildren()),
+                   nullptr)
+          ->GetGroup();
+  auto *agg =
+      new LogicalAggregate(std::move(keys), NIL, AGGSPLIT_SIMPLE, true);
+  result.push_back(new GroupExpression(agg, {input}));
+  return result;
+}
+
+// --- RuleFilterPushThroughUnionAll ---
+
+bool RuleFilterPushThroughUnionAll::Matches(GroupExpression *expr) const {
+  return expr->GetOperatorType() == OperatorType::LOGICAL_FILTER;
+}
+
+// The UNION ALL among the operators of `group`, if any
+static GroupExpression *UnionAll(Group *group) {
+  for (GroupExpression *expr : group->GetLogicalExpressions()) {
+    if (expr->GetOperatorType() == OperatorType::LOGICAL_SET_OPERATION &&
+        static_cast<LogicalSetOperation *>(expr->GetOperator())->IsUnionAll())
+      return expr;
+  }
+  return nullptr;
+}
+
+static LogicalSetOperation *CopySetOperation(
+    const LogicalSetOperation *setop) {
+  auto *copy = new LogicalSetOperation(
+      setop->GetOperation(), setop->IsAll(), setop->GetRtIndex(),
+      setop->GetInputColumns(), setop->GetGroupClauses());
+  copy->SetRequiredColumns(setop->GetRequiredColumns());
+  return copy;
+}
+
+// Columns the operators of `group` were asked to produce
+static const AttrSet *GroupRequiredColumns(Group *group) {
+  auto *op = static_cast<LogicalOperator *>(
+      group->GetLogicalExpressions()[0]->GetOperator());
+  return op->GetRequiredColumns();
+}
+
+PgVector<GroupExpression *>
+RuleFilterPushThroughUnionAll::Transform(GroupExpression *expr,
+                                         Memo *memo) const {
+  auto *filter = static_cast<LogicalFilter *>(expr->GetOperator());
+  PgVector<GroupExpression *> result;
+  GroupExpression *child = UnionAll(expr->GetChildren()[0]);
+  if (!child || HasVolatile(filter->GetPredicates()))
+    return result;
+
+  // Each branch checks the predicates on its own columns, as selective
+  // there as they were above.
+  auto *setop = static_cast<LogicalSetOperation *>(child->GetOperator());
+  PgVector<Group *> branches;
+  for (size_t i = 0; i < child->GetChildren().size(); i++) {
+    PredicateList predicates;
+    for (const Predicate *pred : filter->GetPredicates()) {
+      Node *clause = setop->MapToInput(pred->GetExpr(), i);
+      if (!clause)
+        return result;
+      predicates.push_back(
+          Translator::DescribePredicate(clause, pred->GetSelectivity()));
+    }
+    Group *input = child->GetChildren()[i];
+    branches.push_back(
+        AddFilter(memo, input, predicates, GroupRequiredColumns(input)));
+  }
+  result.push_back(
+      new GroupExpression(CopySetOperation(setop), std::move(branches)));
+  return result;
+}
+
+// --- RuleLimitPushThroughUnionAll ---
+
+bool RuleLimitPushThroughUnionAll::Matches(GroupExpression *expr) const {
+  return expr->GetOperatorType() == OperatorType::LOGICAL_LIMIT &&
+         static_cast<LogicalLimit *>(expr->GetOperator())->GetLimitCount();
+}
+
+// The LIMIT every input of a UNION ALL below `limit` can take on its own:
+// the count, plus the offset if there is one. Both have to be known then,
+// and valid, so a bad value still fails where the query put it.
+static Node *BranchLimit(const LogicalLimit *limit) {
+  Node *count = limit->GetLimitCount();
+  Node *offset = limit->GetLimitOffset();
+  if (contain_volatile_functions(count))
+    return nullptr;
+  if (!offset)
+    return count;
+  if (!IsA(count, Const) || !IsA(offset, Const) ||
+      ((Const *)count)->constisnull)
+    return nullptr;
+
+  int64 rows = DatumGetInt64(((Const *)count)->constvalue);
+  int64 skipped = ((Const *)offset)->constisnull
+                      ? 0
+                      : DatumGetInt64(((Const *)offset)->constvalue);
+  if (rows < 0 || skipped < 0 ||
+      skipped > std::numeric_limits<int64>::max() - rows)
+    return nullptr;
+  return (Node *)makeConst(INT8OID, -1, InvalidOid, sizeof(int64),
+                           Int64GetDatum(rows + skipped), false,
+                           FLOAT8PASSBYVAL);
+}
+
+// Whether `group` is limited to `count` rows already
+static bool HasLimit(Group *group, Node *count) {
+  for (GroupExpression *expr : group->GetLogicalExpressions()) {
+    if (expr->GetOperatorType() != OperatorType::LOGICAL_LIMIT)
+      continue;
+    auto *limit = static_cast<LogicalLimit *>(expr->GetOperator());
+    if (!limit->GetLimitOffset() && equal(limit->GetLimitCount(), count))
+      return true;
+  }
+  return false;
+}
+
+PgVector<GroupExpression *>
+RuleLimitPushThroughUnionAll::Transform(GroupExpression *expr,
+                                        Memo *memo) const {
+  auto *limit = static_cast<LogicalLimit *>(expr->GetOperator());
+  PgVector<GroupExpression *> result;
+  GroupExpression *child = UnionAll(expr->GetChildren()[0]);
+  Node *count = BranchLimit(limit);
+  if (!child || !count)
+    return result;
+
+  bool limited = true;
+  for (Group *input : child->GetChildren())
+    limited &= HasLimit(input, count);
+  if (limited)
+    return result;
+
+  PgVector<Group *> branches;
+  for (Group *input : child->GetChildren()) {
+    auto *branch_limit = new LogicalLimit(nullptr, count);
+    branches.push_back(
+        memo->CopyIn(new GroupExpression(branch_limit, {input}), nullptr)
+            ->GetGroup());
+  }
+  auto *setop = CopySetOperation(
+      static_cast<LogicalSetOperation *>(child->GetOperator()));
+  Group *input =
+      memo->CopyIn(new GroupExpression(setop, std::move(branches)), nullptr)
+          ->GetGroup();
+  result.push_back(new GroupExpression(
+      new LogicalLimit(limit->GetLimitOffset(), limit->GetLimitCount()),
+      {input}));
+  return result;
+}
+
+// --- RuleInlineCte ---
+
+bool RuleInlineCte::Matches(GroupExpression *expr) const {
+  return expr->GetOperatorType() == OperatorType::LOGICAL_CTE_SCAN &&
+         static_cast<LogicalCteScan *>(expr->GetOperator())->GetInlined();
+}
+
+PgVector<GroupExpression *>
+RuleInlineCte::Transform(GroupExpression *expr, Memo *memo) const {
+  // The copy of the CTE's query has range table entries of its own, so it
+  // only ever ends up in this reference's groups.
+  Operator *inlined =
+      static_cast<LogicalCteScan *>(expr->GetOperator())->GetInlined();
+  Group *input = memo->InitMemo(inlined->GetInputs()[0]);
+  PgVector<GroupExpression *> result;
+  result.push_back(new GroupExpression(inlined, {input}));
+  return result;
+}
+
+// --- RuleFilterMerge ---
+
+bool RuleFilterMerge::Matches(GroupExpression *expr) const {
+  return expr->GetOperatorType() == OperatorType::LOGICAL_FILTER;
+}
+
+PgVector<GroupExpression *>
+RuleFilterMerge::Transform(GroupExpression *expr, Memo *memo) const {
+  auto *filter = static_cast<LogicalFilter *>(expr->GetOperator());
+  PgVector<GroupExpression *> result;
+
+  Group *input = expr->GetChildren()[0];
+  for (GroupExpression *child : input->GetLogicalExpressions()) {
+    if (child->GetOperatorType() != OperatorType::LOGICAL_FILTER)
+      continue;
+    // The lower filter's predicates go first, so a volatile predicate still
+    // only sees the rows it saw before.
+    auto *below = static_cast<LogicalFilter *>(child->GetOperator());
+    auto *merged = new LogicalFilter(
+        Concat(below->GetPredicates(), filter->GetPredicates()));
+    merged->SetRequiredColumns(filter->GetRequiredColumns());
+    result.push_back(new GroupExpression(merged, child->GetChildren()));
+  }
+
+  return result;
+}
+
 // --- RuleGetToScan ---
 
 bool RuleGetToScan::Matches(GroupExpression *expr) const {
-  return expr->GetOperator()->IsLogical() &&
-         dynamic_cast<LogicalGet *>(expr->GetOperator());
+  return expr->IsLogical() && dynamic_cast<LogicalGet *>(expr->GetOperator());
 }
 
 PgVector<GroupExpression *>
-RuleGetToScan::Transform(GroupExpression *expr) const {
+RuleGetToScan::Transform(GroupExpression *expr, Memo *memo) const {
   auto logical_get = dynamic_cast<LogicalGet *>(expr->GetOperator());
   auto physical_scan = new PhysicalTableScan(logical_get->GetTableOid(),
-                                             logical_get->GetRtIndex());
+                                             logical_get->GetRtIndex(),
+                                             logical_get->GetPartitionOid());
   auto group_expr = new GroupExpression(physical_scan, {});
 
   PgVector<GroupExpression *> result;
@@ -22,17 +1173,402 @@ RuleGetToScan::Transform(GroupExpression *expr) const {
   return result;
 }
 
+// --- RuleJoinToNestedLoop ---
+
+bool RuleJoinToNestedLoop::Matches(GroupExpression *expr) const {
+  // The executor's nested loop cannot return unmatched inner rows.
+  auto *join = dynamic_cast<LogicalJoin *>(expr->GetOperator());
+  return join && join->GetJoinType() != JOIN_FULL;
+}
+
+PgVector<GroupExpression *>
+RuleJoinToNestedLoop::Transform(GroupExpression *expr, Memo *memo) const {
+  auto logical = static_cast<LogicalJoin *>(expr->GetOperator());
+  auto physical = new PhysicalNestedLoopJoin(logical->GetJoinType(),
+                                             logical->GetPredicates());
+  auto group_expr = new GroupExpression(physical, expr->GetChildren());
+
+  PgVector<GroupExpression *> result;
+  result.push_back(group_expr);
+  return result;
+}
+
+// --- RuleJoinToIndexNestedLoop ---
+
+bool RuleJoinToIndexNestedLoop::Matches(GroupExpression *expr) const {
+  auto *join = dynamic_cast<LogicalJoin *>(expr->GetOperator());
+  return join && join->GetJoinType() != JOIN_FULL;
+}
+
+// The table `group` scans, with the predicates of the filters on top of it
+// added to `filters`; nullptr unless the group reads a single table (not a
+// partition) through filters without volatile predicates
+static LogicalGet *FilteredTable(Group *group, PredicateList *filters) {
+  for (GroupExpression *expr : group->GetLogicalExpressions()) {
+    Operator *op = expr->GetOperator();
+    if (op->GetType() == OperatorType::LOGICAL_GET) {
+      auto *get = static_cast<LogicalGet *>(op);
+      return get->IsPartition() ? nullptr : get;
+    }
+    if (op->GetType() != OperatorType::LOGICAL_FILTER)
+      continue;
+    const PredicateList &predicates =
+        static_cast<LogicalFilter *>(op)->GetPredicates();
+    PredicateList below;
+    if (HasVolatile(predicates))
+      continue;
+    if (LogicalGet *get = FilteredTable(expr->GetChildren()[0], &below)) {
+      filters->insert(filters->end(), predicates.begin(), predicates.end());
+      filters->insert(filters->end(), below.begin(), below.end());
+      return get;
+    }
+  }
+  return nullptr;
+}
+
+// A join predicate used to look up rows in an index
+struct IndexKey {
+  Predicate *pred;
+  AttrNumber index_column;
+  Node *outer_expr;
+  bool equality;
+};
+
+static bool IsColumn(Node *node, Index rtindex, AttrNumber attnum) {
+  while (IsA(node, RelabelType))
+    node = (Node *)((RelabelType *)node)->arg;
+  return attnum != 0 && IsA(node, Var) && ((Var *)node)->varno == rtindex &&
+         ((Var *)node)->varattno == attnum &&
+         ((Var *)node)->varlevelsup == 0;
+}
+
+// Whether `pred` compares column `i` of `index` on relation `rtindex` with
+// an expression of the outer relations (a constant, if there are none),
+// using an operator of the column's operator family and collation
+static bool MatchIndexKey(Predicate *pred, Index rtindex,
+                          const IndexMetadata &index, size_t i,
+                          const ColSet &outer, IndexKey *key) {
+  if (pred->IsVolatile() || !IsA(pred->GetExpr(), OpExpr))
+    return false;
+  auto *clause = (OpExpr *)pred->GetExpr();
+  if (list_length(clause->args) != 2)
+    return false;
+  auto IsLookupValue = [&](const ColSet &relids) {
+    return outer.IsEmpty() ? relids.IsEmpty()
+                           : !relids.IsEmpty() && relids.IsSubset(outer);
+  };
+  AttrNumber attnum = index.columns[i];
+  Oid opno = clause->opno;
+  if (IsColumn((Node *)linitial(clause->args), rtindex, attnum) &&
+      IsLookupValue(pred->GetRightRelids())) {
+    key->outer_expr = (Node *)lsecond(clause->args);
+  } else if (IsColumn((Node *)lsecond(clause->args), rtindex, attnum) &&
+             IsLookupValue(pred->GetLeftRelids())) {
+    // The executor wants the index column on the left.
+    key->outer_expr = (Node *)linitial(clause->args);
+    opno = get_commutator(opno);
+  } else {
+    return false;
+  }
+  if (!OidIsValid(opno) ||
+      (OidIsValid(index.collations[i]) &&
+       index.collations[i] != clause->inputcollid))
+    return false;
+  int strategy = get_op_opfamily_strategy(opno, index.opfamilies[i]);
+  if (strategy == 0)
+    return false;
+  key->pred = pred;
+  key->index_column = i + 1;
+  key->equality = strategy == BTEqualStrategyNumber;
+  return true;
+}
+
+// Keys for a lookup in `index`: predicates on a prefix of its columns, as
+// long as the columns before are compared for equality
+static PgVector<IndexKey> MatchIndexKeys(const PredicateList &predicates,
+                                         Index rtindex,
+                                         const IndexMetadata &index,
+                                         const ColSet &outer) {
+  PgVector<IndexKey> keys;
+  bool all_equality = true;
+  for (size_t i = 0; all_equality && i < index.columns.size(); i++) {
+    size_t matched = keys.size();
+    for (Predicate *pred : predicates) {
+      IndexKey key;
+      if (MatchIndexKey(pred, rtindex, index, i, outer, &key)) {
+        keys.push_back(key);
+        all_equality &= key.equality;
+      }
+    }
+    if (keys.size() == matched)
+      break;
+  }
+  return keys;
+}
+
+// Fraction of `table`'s rows one lookup with `keys` returns: one row for a
+// unique index with every column given, otherwise one value's share of an
+// equality-compared column, and the default for ranges.
+static double LookupSelectivity(const PgVector<IndexKey> &keys,
+                                const IndexMetadata &index, Oid table_oid) {
+  double rows = std::max(1.0, MetadataAccessor::GetTableRows(table_oid));
+  PgVector<bool> equality_columns(index.columns.size(), false);
+  double selectivity = 1.0;
+  for (const IndexKey &key : keys) {
+    if (!key.equality) {
+      selectivity *= DEFAULT_INEQ_SEL;
+      continue;
+    }
+    equality_columns[key.index_column - 1] = true;
+    double ndistinct = MetadataAccessor::GetColumnStats(
+                           table_oid, index.columns[key.index_column - 1])
+                           .ndistinct;
+    if (ndistinct <= 0.0)
+      ndistinct = std::min(rows, (double)DEFAULT_NUM_DISTINCT);
+    selectivity /= std::max(1.0, ndistinct);
+  }
+  bool all_columns =
+      std::find(equality_columns.begin(), equality_columns.end(), false) ==
+      equality_columns.end();
+  if (index.unique && all_columns)
+    selectivity = 1.0 / rows;
+  return std::min(1.0, std::max(selectivity, 1.0 / rows));
+}
+
+// Cache keys of a Memoize over a lookup with `keys`, with the estimated
+// number of distinct values they take; NIL unless every key is an
+// equality that can be hashed.
+static List *MemoizeCacheKeys(const PgVector<IndexKey> &keys, Index rtindex,
+                              double *distinct) {
+  List *cache_keys = NIL;
+  *distinct = 1.0;
+  for (const IndexKey &key : keys) {
+    if (!key.pred->IsHashJoinable())
+      return NIL;
+    if (list_member(cache_keys, key.outer_expr))
+      continue;
+    TypeCacheEntry *type = lookup_type_cache(
+        exprType(key.outer_expr), TYPECACHE_EQ_OPR | TYPECACHE_HASH_PROC);
+    if (!OidIsValid(type->eq_opr) || !OidIsValid(type->hash_proc))
+      return NIL;
+    cache_keys = lappend(cache_keys, key.outer_expr);
+
+    double ndistinct = 0.0;
+    const ColumnRef *outer_column;
+    if (ColumnOf(key.pred, rtindex, &outer_column))
+      ndistinct = MetadataAccessor::GetColumnStats(outer_column->table_oid,
+                                                   outer_column->attr_num)
+                      .ndistinct;
+    *distinct *= ndistinct > 0.0 ? ndistinct : DEFAULT_NUM_DISTINCT;
+  }
+  return cache_keys;
+}
+
+PgVector<GroupExpression *>
+RuleJoinToIndexNestedLoop::Transform(GroupExpression *expr,
+                                     Memo *memo) const {
+  auto *join = static_cast<LogicalJoin *>(expr->GetOperator());
+  Group *outer = expr->GetChildren()[0];
+  Group *inner = expr->GetChildren()[1];
+  PgVector<GroupExpression *> result;
+
+  PredicateList filters;
+  LogicalGet *get = FilteredTable(inner, &filters);
+  if (!get)
+    return result;
+  const LogicalProperties *inner_props = inner->GetLogicalProperties();
+  double outer_rows = outer->GetLogicalProperties()->GetCardinality();
+
+  for (const IndexMetadata &index :
+       MetadataAccessor::GetTableMetadata(get->GetTableOid())->indexes) {
+    PgVector<IndexKey> keys = MatchIndexKeys(
+        join->GetPredicates(), get->GetRtIndex(), index, GroupRelids(outer));
+    if (keys.empty())
+      continue;
+
+    PredicateList index_predicates;
+    PgVector<AttrNumber> index_columns;
+    for (const IndexKey &key : keys) {
+      index_predicates.push_back(key.pred);
+      index_columns.push_back(key.index_column);
+    }
+    PredicateList rest;
+    for (Predicate *pred : join->GetPredicates()) {
+      if (std::find(index_predicates.begin(), index_predicates.end(),
+                    pred) == index_predicates.end())
+        rest.push_back(pred);
+    }
+
+    // The index scan returns the inner input's rows for one outer row.
+    double selectivity =
+        LookupSelectivity(keys, index, get->GetTableOid());
+    double rows = std::max(
+        1.0, std::rint(inner_props->GetCardinality() * selectivity));
+    auto LookupProps = [&]() {
+      return new LogicalProperties(ColSet(inner_props->GetOutputColumns()),
+                                   ColSet(inner_props->GetRelids()), rows,
+                                   inner_props->GetWidth());
+    };
+    auto *scan = new PhysicalIndexScan(
+        get->GetTableOid(), get->GetRtIndex(), index.oid, index_predicates,
+        index_columns, filters, selectivity, outer_rows);
+    Group *scan_group = memo->NewGroup(LookupProps());
+    memo->CopyIn(new GroupExpression(scan, {}), scan_group);
+    result.push_back(new GroupExpression(
+        new PhysicalNestedLoopJoin(join->GetJoinType(), rest, true),
+        {outer, scan_group}));
+
+    // A semi or anti join stops reading the inner rows early, which
+    // would leave incomplete cache entries.
+    if (join->GetJoinType() != JOIN_INNER &&
+        join->GetJoinType() != JOIN_LEFT)
+      continue;
+    double distinct;
+    List *cache_keys = MemoizeCacheKeys(keys, get->GetRtIndex(), &distinct);
+    if (!cache_keys || outer_rows < 2.0)
+      continue;
+    auto *memoize = new PhysicalMemoize(cache_keys, outer_rows,
+                                        std::min(distinct, outer_rows));
+    Group *memoize_group = memo->NewGroup(LookupProps());
+    memo->CopyIn(new GroupExpression(memoize, {scan_group}), memoize_group);
+    result.push_back(new GroupExpression(
+        new PhysicalNestedLoopJoin(join->GetJoinType(), rest, true),
+        {outer, memoize_group}));
+  }
+  return result;
+}
+
+// --- RuleFilterToIndexScan ---
+
+bool RuleFilterToIndexScan::Matches(GroupExpression *expr) const {
+  return expr->GetOperatorType() == OperatorType::LOGICAL_FILTER;
+}
+
+PgVector<GroupExpression *>
+RuleFilterToIndexScan::Transform(GroupExpression *expr, Memo *memo) const {
+  auto *filter = static_cast<LogicalFilter *>(expr->GetOperator());
+  PgVector<GroupExpression *> result;
+  if (HasVolatile(filter->GetPredicates()))
+    return result;
+  PredicateList predicates = filter->GetPredicates();
+  LogicalGet *get = FilteredTable(expr->GetChildren()[0], &predicates);
+  if (!get)
+    return result;
+
+  for (const IndexMetadata &index :
+       MetadataAccessor::GetTableMetadata(get->GetTableOid())->indexes) {
+    PgVector<IndexKey> keys =
+        MatchIndexKeys(predicates, get->GetRtIndex(), index, ColSet());
+    if (keys.empty())
+      continue;
+
+    PredicateList index_predicates;
+    PgVector<AttrNumber> index_columns;
+    double selectivity = 1.0;
+    for (const IndexKey &key : keys) {
+      index_predicates.push_back(key.pred);
+      index_columns.push_back(key.index_column);
+      selectivity *= key.pred->GetSelectivity();
+    }
+    PredicateList rest;
+    for (Predicate *pred : predicates) {
+      if (std::find(index_predicates.begin(), index_predicates.end(),
+                    pred) == index_predicates.end())
+        rest.push_back(pred);
+    }
+    auto *scan = new PhysicalIndexScan(
+        get->GetTableOid(), get->GetRtIndex(), index.oid,
+        std::move(index_predicates), std::move(index_columns),
+        std::move(rest), selectivity);
+    result.push_back(new GroupExpression(scan, {}));
+  }
+  return result;
+}
+
+// Splits a join's predicates into the keys a hash or merge join can use
+// (hashable or mergejoinable operators comparing one input with the other)
+// and the rest.
+static void SplitJoinKeys(GroupExpression *expr, bool hash,
+                          PredicateList *keys, PredicateList *rest) {
+  auto *join = static_cast<LogicalJoin *>(expr->GetOperator());
+  const ColSet &outer = GroupRelids(expr->GetChildren()[0]);
+  const ColSet &inner = GroupRelids(expr->GetChildren()[1]);
+  for (Predicate *pred : join->GetPredicates()) {
+    bool usable = hash ? pred->IsHashJoinable() : pred->IsMergeJoinable();
+    if (usable && !pred->IsVolatile() && pred->IsJoinKey(outer, inner))
+      keys->push_back(pred);
+    else
+      rest->push_back(pred);
+  }
+}
+
+// --- RuleJoinToHashJoin ---
+
+bool RuleJoinToHashJoin::Matches(GroupExpression *expr) const {
+  return expr->IsLogical() && dynamic_cast<LogicalJoin *>(expr->GetOperator());
+}
+
+PgVector<GroupExpression *>
+RuleJoinToHashJoin::Transform(GroupExpression *expr, Memo *memo) const {
+  auto logical = static_cast<LogicalJoin *>(expr->GetOperator());
+  PgVector<GroupExpression *> result;
+
+  PredicateList keys;
+  PredicateList rest;
+  SplitJoinKeys(expr, true, &keys, &rest);
+  if (keys.empty())
+    return result;
+
+  if (logical->GetJoinType() == JOIN_FULL && !rest.empty())
+    return result;
+
+  auto physical = new PhysicalHashJoin(logical->GetJoinType(), keys, rest);
+  result.push_back(new GroupExpression(physical, expr->GetChildren()));
+  if (logical->GetJoinType() == JOIN_LEFT) {
+    // Build the hash table on the preserved side instead
+    auto swapped = new PhysicalHashJoin(JOIN_RIGHT, keys, rest);
+    result.push_back(new GroupExpression(
+        swapped, {expr->GetChildren()[1], expr->GetChildren()[0]}));
+  }
+  return result;
+}
+
+// --- RuleJoinToMergeJoin ---
+
+bool RuleJoinToMergeJoin::Matches(GroupExpression *expr) const {
+  return expr->IsLogical() && dynamic_cast<LogicalJoin *>(expr->GetOperator());
+}
+
+PgVector<GroupExpression *>
+RuleJoinToMergeJoin::Transform(GroupExpression *expr, Memo *memo) const {
+  auto logical = static_cast<LogicalJoin *>(expr->GetOperator());
+  PgVector<GroupExpression *> result;
+
+  PredicateList keys;
+  PredicateList rest;
+  SplitJoinKeys(expr, false, &keys, &rest);
+  if (keys.empty())
+    return result;
+
+  if (logical->GetJoinType() == JOIN_FULL && !rest.empty())
+    return result;
+
+  auto physical = new PhysicalMergeJoin(logical->GetJoinType(), keys, rest);
+  result.push_back(new GroupExpression(physical, expr->GetChildren()));
+  return result;
+}
+
 // --- RuleFilterToPhysical ---
 
 bool RuleFilterToPhysical::Matches(GroupExpression *expr) const {
-  return expr->GetOperator()->IsLogical() &&
+  return expr->IsLogical() &&
          dynamic_cast<LogicalFilter *>(expr->GetOperator());
 }
 
 PgVector<GroupExpression *>
-RuleFilterToPhysical::Transform(GroupExpression *expr) const {
+RuleFilterToPhysical::Transform(GroupExpression *expr, Memo *memo) const {
   auto logical = dynamic_cast<LogicalFilter *>(expr->GetOperator());
-  auto physical = new PhysicalFilter(logical->GetQual());
+  auto physical = new PhysicalFilter(logical->GetPredicates());
   auto group_expr = new GroupExpression(physical, expr->GetChildren());
 
   PgVector<GroupExpression *> result;
@@ -40,15 +1576,44 @@ RuleFilterToPhysical::Transform(GroupExpression *expr) const {
   return result;
 }
 
+// --- RuleFilterToEmptyResult ---
+
+bool RuleFilterToEmptyResult::Matches(GroupExpression *expr) const {
+  // An anti join whose predicates fail returns its whole left input
+  // instead.
+  const PredicateList *predicates = nullptr;
+  Operator *op = expr->GetOperator();
+  if (op->GetType() == OperatorType::LOGICAL_FILTER)
+    predicates = &static_cast<LogicalFilter *>(op)->GetPredicates();
+  else if (op->GetType() == OperatorType::LOGICAL_INNER_JOIN ||
+           op->GetType() == OperatorType::LOGICAL_SEMI_JOIN)
+    predicates = &static_cast<LogicalJoin *>(op)->GetPredicates();
+  if (!predicates)
+    return false;
+
+  for (const Predicate *pred : *predicates) {
+    if (pred->IsConstantFalse())
+      return true;
+  }
+  return false;
+}
+
+PgVector<GroupExpression *>
+RuleFilterToEmptyResult::Transform(GroupExpression *expr, Memo *memo) const {
+  PgVector<GroupExpression *> result;
+  result.push_back(new GroupExpression(new PhysicalEmptyResult(), {}));
+  return result;
+}
+
 // --- RuleProjectionToPhysical ---
 
 bool RuleProjectionToPhysical::Matches(GroupExpression *expr) const {
-  return expr->GetOperator()->IsLogical() &&
+  return expr->IsLogical() &&
          dynamic_cast<LogicalProjection *>(expr->GetOperator());
 }
 
 PgVector<GroupExpression *>
-RuleProjectionToPhysical::Transform(GroupExpression *expr) const {
+RuleProjectionToPhysical::Transform(GroupExpression *expr, Memo *memo) const {
   auto logical = dynamic_cast<LogicalProjection *>(expr->GetOperator());
   auto physical = new PhysicalProjection(logical->GetTargetList());
   auto group_expr = new GroupExpression(physical, expr->GetChildren());
@@ -61,14 +1626,14 @@ RuleProjectionToPhysical::Transform(GroupExpression *expr) const {
 // --- RuleSortToPhysical ---
 
 bool RuleSortToPhysical::Matches(GroupExpression *expr) const {
-  return expr->GetOperator()->IsLogical() &&
-         dynamic_cast<LogicalSort *>(expr->GetOperator());
+  return expr->IsLogical() && dynamic_cast<LogicalSort *>(expr->GetOperator());
 }
 
 PgVector<GroupExpression *>
-RuleSortToPhysical::Transform(GroupExpression *expr) const {
+RuleSortToPhysical::Transform(GroupExpression *expr, Memo *memo) const {
   auto logical = dynamic_cast<LogicalSort *>(expr->GetOperator());
-  auto physical = new PhysicalSort(logical->GetSortClause());
+  auto physical =
+      new PhysicalSort(logical->GetSortClause(), logical->GetSortKeys());
   auto group_expr = new GroupExpression(physical, expr->GetChildren());
 
   PgVector<GroupExpression *> result;
@@ -76,15 +1641,257 @@ RuleSortToPhysical::Transform(GroupExpression *expr) const {
   return result;
 }
 
+// --- RuleSortToIncrementalSort ---
+
+bool RuleSortToIncrementalSort::Matches(GroupExpression *expr) const {
+  return expr->GetOperatorType() == OperatorType::LOGICAL_SORT;
+}
+
+PgVector<GroupExpression *>
+RuleSortToIncrementalSort::Transform(GroupExpression *expr,
+                                     Memo *memo) const {
+  auto *logical = static_cast<LogicalSort *>(expr->GetOperator());
+  auto *physical = new PhysicalIncrementalSort(logical->GetSortClause(),
+                                               logical->GetSortKeys());
+
+  PgVector<GroupExpression *> result;
+  result.push_back(new GroupExpression(physical, expr->GetChildren()));
+  return result;
+}
+
+// --- RuleWindowToPhysical ---
+
+bool RuleWindowToPhysical::Matches(GroupExpression *expr) const {
+  return expr->GetOperatorType() == OperatorType::LOGICAL_WINDOW;
+}
+
+PgVector<GroupExpression *>
+RuleWindowToPhysical::Transform(GroupExpression *expr, Memo *memo) const {
+  auto *logical = static_cast<LogicalWindow *>(expr->GetOperator());
+  auto *physical = new PhysicalWindowAgg(
+      logical->GetClause(), logical->GetWindowFuncs(),
+      logical->GetTargetList(), logical->GetSortKeys());
+
+  PgVector<GroupExpression *> result;
+  result.push_back(new GroupExpression(physical, expr->GetChildren()));
+  return result;
+}
+
+// --- RuleAggregateToSortedAggregate ---
+
+bool RuleAggregateToSortedAggregate::Matches(GroupExpression *expr) const {
+  if (expr->GetOperatorType() != OperatorType::LOGICAL_AGGREGATE)
+    return false;
+  auto *agg = static_cast<LogicalAggregate *>(expr->GetOperator());
+  for (const GroupKey &key : agg->GetKeys()) {
+    if (!OidIsValid(key.sortop))
+      return false;
+  }
+  return true;
+}
+
+PgVector<GroupExpression *>
+RuleAggregateToSortedAggregate::Transform(GroupExpression *expr,
+                                          Memo *memo) const {
+  auto *logical = static_cast<LogicalAggregate *>(expr->GetOperator());
+  AggStrategy strategy =
+      logical->GetKeys().empty() ? AGG_PLAIN : AGG_SORTED;
+  auto *physical =
+      new PhysicalAggregate(strategy, logical->GetSplit(), logical->GetKeys(),
+                            logical->GetAggregates());
+
+  PgVector<GroupExpression *> result;
+  result.push_back(new GroupExpression(physical, expr->GetChildren()));
+  return result;
+}
+
+// --- RuleAggregateToHashedAggregate ---
+
+bool RuleAggregateToHashedAggregate::Matches(GroupExpression *expr) const {
+  if (expr->GetOperatorType() != OperatorType::LOGICAL_AGGREGATE)
+    return false;
+  auto *agg = static_cast<LogicalAggregate *>(expr->GetOperator());
+  if (agg->GetKeys().empty())
+    return false;
+  for (const GroupKey &key : agg->GetKeys()) {
+    if (!key.hashable)
+      return false;
+  }
+  return true;
+}
+
+PgVector<GroupExpression *>
+RuleAggregateToHashedAggregate::Transform(GroupExpression *expr,
+                                          Memo *memo) const {
+  auto *logical = static_cast<LogicalAggregate *>(expr->GetOperator());
+  auto *physical =
+      new PhysicalAggregate(AGG_HASHED, logical->GetSplit(),
+                            logical->GetKeys(), logical->GetAggregates());
+
+  PgVector<GroupExpression *> result;
+  result.push_back(new GroupExpression(physical, expr->GetChildren()));
+  return result;
+}
+
+// --- RuleAppendToPhysical ---
+
+bool RuleAppendToPhysical::Matches(GroupExpression *expr) const {
+  return expr->GetOperatorType() == OperatorType::LOGICAL_APPEND;
+}
+
+PgVector<GroupExpression *>
+RuleAppendToPhysical::Transform(GroupExpression *expr, Memo *memo) const {
+  auto *append = static_cast<LogicalAppend *>(expr->GetOperator());
+  PgVector<GroupExpression *> result;
+  result.push_back(new GroupExpression(
+      new PhysicalAppend(append->GetRtIndex()), expr->GetChildren()));
+  return result;
+}
+
+// --- RuleSetOperationToAppend ---
+
+bool RuleSetOperationToAppend::Matches(GroupExpression *expr) const {
+  return expr->GetOperatorType() == OperatorType::LOGICAL_SET_OPERATION &&
+         static_cast<LogicalSetOperation *>(expr->GetOperator())->IsUnionAll();
+}
+
+PgVector<GroupExpression *>
+RuleSetOperationToAppend::Transform(GroupExpression *expr, Memo *memo) const {
+  auto *setop = static_cast<LogicalSetOperation *>(expr->GetOperator());
+  PgVector<GroupExpression *> result;
+  result.push_back(new GroupExpression(
+      new PhysicalAppend(setop->GetRtIndex(), setop->GetInputColumns()),
+      expr->GetChildren()));
+  return result;
+}
+
+// --- RuleSortToMergeAppend ---
+
+bool RuleSortToMergeAppend::Matches(GroupExpression *expr) const {
+  return expr->GetOperatorType() == OperatorType::LOGICAL_SORT;
+}
+
+PgVector<GroupExpression *>
+RuleSortToMergeAppend::Transform(GroupExpression *expr, Memo *memo) const {
+  auto *sort = static_cast<LogicalSort *>(expr->GetOperator());
+  PgVector<GroupExpression *> result;
+  GroupExpression *child = UnionAll(expr->GetChildren()[0]);
+  if (!child)
+    return result;
+
+  // Each key has to be one of the UNION ALL's columns, which every input
+  // computes and can be sorted on.
+  auto *setop = static_cast<LogicalSetOperation *>(child->GetOperator());
+  PgVector<AttrNumber> key_columns;
+  ListCell *lc;
+  foreach (lc, sort->GetSortClause()) {
+    Node *key = get_sortgroupclause_expr((SortGroupClause *)lfirst(lc),
+                                         sort->GetTargetList());
+    if (!IsA(key, Var) || ((Var *)key)->varno != (int)setop->GetRtIndex() ||
+        ((Var *)key)->varlevelsup != 0 || ((Var *)key)->varattno <= 0 ||
+        !setop->IsColumnNeeded(((Var *)key)->varattno))
+      return result;
+    key_columns.push_back(((Var *)key)->varattno);
+  }
+
+  auto *merge = new PhysicalMergeAppend(
+      setop->GetRtIndex(), setop->GetInputColumns(), sort->GetSortClause(),
+      std::move(key_columns));
+  result.push_back(new GroupExpression(merge, child->GetChildren()));
+  return result;
+}
+
+// --- RuleSetOperationToSortedSetOp ---
+
+// INTERSECT or EXCEPT, which compare every column
+static bool IsSetOp(GroupExpression *expr) {
+  if (expr->GetOperatorType() != OperatorType::LOGICAL_SET_OPERATION)
+    return false;
+  auto *setop = static_cast<LogicalSetOperation *>(expr->GetOperator());
+  return setop->GetOperation() != SETOP_UNION &&
+         list_length(setop->GetGroupClauses()) == setop->GetNumColumns();
+}
+
+static GroupExpression *MakeSetOp(GroupExpression *expr,
+                                  SetOpStrategy strategy) {
+  auto *setop = static_cast<LogicalSetOperation *>(expr->GetOperator());
+  auto *physical = new PhysicalSetOp(
+      setop->GetOperation(), setop->IsAll(), strategy, setop->GetRtIndex(),
+      setop->GetInputColumns(), setop->GetGroupClauses());
+  return new GroupExpression(physical, expr->GetChildren());
+}
+
+bool RuleSetOperationToSortedSetOp::Matches(GroupExpression *expr) const {
+  if (!IsSetOp(expr))
+    return false;
+  auto *setop = static_cast<LogicalSetOperation *>(expr->GetOperator());
+  ListCell *lc;
+  foreach (lc, setop->GetGroupClauses()) {
+    if (!OidIsValid(((SortGroupClause *)lfirst(lc))->sortop))
+      return false;
+  }
+  return true;
+}
+
+PgVector<GroupExpression *>
+RuleSetOperationToSortedSetOp::Transform(GroupExpression *expr,
+                                         Memo *memo) const {
+  PgVector<GroupExpression *> result;
+  result.push_back(MakeSetOp(expr, SETOP_SORTED));
+  return result;
+}
+
+// --- RuleSetOperationToHashedSetOp ---
+
+bool RuleSetOperationToHashedSetOp::Matches(GroupExpression *expr) const {
+  if (!IsSetOp(expr))
+    return false;
+  auto *setop = static_cast<LogicalSetOperation *>(expr->GetOperator());
+  ListCell *lc;
+  foreach (lc, setop->GetGroupClauses()) {
+    if (!((SortGroupClause *)lfirst(lc))->hashable)
+      return false;
+  }
+  return true;
+}
+
+PgVector<GroupExpression *>
+RuleSetOperationToHashedSetOp::Transform(GroupExpression *expr,
+                                         Memo *memo) const {
+  PgVector<GroupExpression *> result;
+  result.push_back(MakeSetOp(expr, SETOP_HASHED));
+  return result;
+}
+
+// --- RuleCteScanToPhysical ---
+
+bool RuleCteScanToPhysical::Matches(GroupExpression *expr) const {
+  return expr->GetOperatorType() == OperatorType::LOGICAL_CTE_SCAN;
+}
+
+PgVector<GroupExpression *>
+RuleCteScanToPhysical::Transform(GroupExpression *expr, Memo *memo) const {
+  // The shared plans are optimized before the query that reads them.
+  auto *scan = static_cast<LogicalCteScan *>(expr->GetOperator());
+  PgVector<GroupExpression *> result;
+  Group *producer = memo->GetCteProducer(scan->GetCteIndex());
+  if (!producer || !producer->GetBestExpression())
+    return result;
+  result.push_back(new GroupExpression(
+      new PhysicalCteScan(scan->GetCteIndex(), scan->GetRtIndex(),
+                          scan->GetShares()),
+      {}));
+  return result;
+}
+
 // --- RuleLimitToPhysical ---
 
 bool RuleLimitToPhysical::Matches(GroupExpression *expr) const {
-  return expr->GetOperator()->IsLogical() &&
-         dynamic_cast<LogicalLimit *>(expr->GetOperator());
+  return expr->IsLogical() && dynamic_cast<LogicalLimit *>(expr->GetOperator());
 }
 
 PgVector<GroupExpression *>
-RuleLimitToPhysical::Transform(GroupExpression *expr) const {
+RuleLimitToPhysical::Transform(GroupExpression *expr, Memo *memo) const {
   auto logical = dynamic_cast<LogicalLimit *>(expr->GetOperator());
   auto physical =
       new PhysicalLimit(logical->GetLimitOffset(), logical->GetLimitCount());
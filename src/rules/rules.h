@@ -7,47 +7,459 @@
 
 namespace pg_carbon {
 
+// Transformation rules produce logical alternatives and run while groups
+// are explored; implementation rules produce physical operators and only
+// run once a group is optimized.
+enum class RuleType { TRANSFORMATION, IMPLEMENTATION };
+
 class Rule : public PgObject {
 public:
   virtual ~Rule() = default;
+  virtual RuleType GetRuleType() const = 0;
   virtual bool Matches(GroupExpression *expr) const = 0;
-  virtual PgVector<GroupExpression *>
-  Transform(GroupExpression *expr) const = 0;
+  // Returns the new expressions for expr's group. Any new input groups they
+  // need are copied into `memo` by the rule itself.
+  virtual PgVector<GroupExpression *> Transform(GroupExpression *expr,
+                                                Memo *memo) const = 0;
   virtual std::string ToString() const = 0;
+
+  // Index in the rule set, used for GroupExpression's applied-rule mask
+  void SetId(int id) { id_ = id; }
+  int GetId() const { return id_; }
+  // First search stage that applies the rule (see TaskScheduler)
+  void SetStage(int stage) { stage_ = stage; }
+  int GetStage() const { return stage_; }
+
+private:
+  int id_ = -1;
+  int stage_ = 0;
+};
+
+class TransformationRule : public Rule {
+public:
+  RuleType GetRuleType() const override { return RuleType::TRANSFORMATION; }
+};
+
+class ImplementationRule : public Rule {
+public:
+  RuleType GetRuleType() const override { return RuleType::IMPLEMENTATION; }
+};
+
+// --- Transformation Rules ---
+
+// Filter(Join(L, R)) -> Join(Filter(L), Filter(R)): single-relation
+// predicates move to the input that can evaluate them, the rest become join
+// predicates. Above a semi, anti or left join only the left input
+// qualifies, and nothing moves below a full join.
+class RuleFilterPushThroughJoin : public TransformationRule {
+public:
+  bool Matches(GroupExpression *expr) const override;
+  PgVector<GroupExpression *> Transform(GroupExpression *expr,
+                                        Memo *memo) const override;
+  std::string ToString() const override { return "RuleFilterPushThroughJoin"; }
+};
+
+// Join predicates that only read one input are evaluated below the join
+// (for an anti or left join, only those on the right input; for a full
+// join, none).
+class RuleJoinPredicatePushDown : public TransformationRule {
+public:
+  bool Matches(GroupExpression *expr) const override;
+  PgVector<GroupExpression *> Transform(GroupExpression *expr,
+                                        Memo *memo) const override;
+  std::string ToString() const override { return "RuleJoinPredicatePushDown"; }
+};
+
+// A JOIN B -> B JOIN A
+class RuleJoinCommutativity : public TransformationRule {
+public:
+  bool Matches(GroupExpression *expr) const override;
+  PgVector<GroupExpression *> Transform(GroupExpression *expr,
+                                        Memo *memo) const override;
+  std::string ToString() const override { return "RuleJoinCommutativity"; }
+};
+
+// (A JOIN B) JOIN C -> A JOIN (B JOIN C), with the predicates evaluated at
+// the lowest join that sees all their relations. Orders that would need a
+// cross product are not generated.
+class RuleJoinAssociativity : public TransformationRule {
+public:
+  bool Matches(GroupExpression *expr) const override;
+  PgVector<GroupExpression *> Transform(GroupExpression *expr,
+                                        Memo *memo) const override;
+  std::string ToString() const override { return "RuleJoinAssociativity"; }
+};
+
+// (A LEFT JOIN B ON Pab) LEFT JOIN C ON Pbc
+//   -> A LEFT JOIN (B LEFT JOIN C ON Pbc) ON Pab
+// if Pbc only reads B and C and is strict for B: a B row that is all NULLs
+// then cannot match C either way.
+class RuleLeftJoinAssociativity : public TransformationRule {
+public:
+  bool Matches(GroupExpression *expr) const override;
+  PgVector<GroupExpression *> Transform(GroupExpression *expr,
+                                        Memo *memo) const override;
+  std::string ToString() const override { return "RuleLeftJoinAssociativity"; }
+};
+
+// (A LEFT JOIN B ON Pab) JOIN C ON Pac -> (A JOIN C ON Pac) LEFT JOIN B ON Pab
+// if Pac does not read B.
+class RuleInnerJoinPastLeftJoin : public TransformationRule {
+public:
+  bool Matches(GroupExpression *expr) const override;
+  PgVector<GroupExpression *> Transform(GroupExpression *expr,
+                                        Memo *memo) const override;
+  std::string ToString() const override { return "RuleInnerJoinPastLeftJoin"; }
+};
+
+// (A JOIN B ON Pab) LEFT JOIN C ON Pac -> (A LEFT JOIN C ON Pac) JOIN B ON Pab
+// if Pac does not read B; the inverse of RuleInnerJoinPastLeftJoin.
+class RuleLeftJoinPastInnerJoin : public TransformationRule {
+public:
+  bool Matches(GroupExpression *expr) const override;
+  PgVector<GroupExpression *> Transform(GroupExpression *expr,
+                                        Memo *memo) const override;
+  std::string ToString() const override { return "RuleLeftJoinPastInnerJoin"; }
+};
+
+// Removes a join whose right input is a single table none of whose columns
+// are needed above the join, when the join is known to return each left row
+// exactly once anyway: a left join on a unique key of the table, or an
+// inner join along a validated foreign key with NOT NULL columns. The
+// replacement is an empty filter over the left input, since the Memo
+// cannot merge the join's group into the input's.
+class RuleJoinElimination : public TransformationRule {
+public:
+  bool Matches(GroupExpression *expr) const override;
+  PgVector<GroupExpression *> Transform(GroupExpression *expr,
+                                        Memo *memo) const override;
+  std::string ToString() const override { return "RuleJoinElimination"; }
+};
+
+// Eager aggregation: Aggregate(A JOIN B) -> FinalAggregate(PartialAggregate(A)
+// JOIN B) when every aggregate only reads A and can be split into phases.
+// The partial aggregate groups A by its share of the grouping keys and the
+// columns the join reads, so each partial row joins exactly like the rows it
+// stands for. Whether that pays off is left to the cost model, through the
+// number of groups estimated for A.
+class RuleEagerAggregation : public TransformationRule {
+public:
+  bool Matches(GroupExpression *expr) const override;
+  PgVector<GroupExpression *> Transform(GroupExpression *expr,
+                                        Memo *memo) const override;
+  std::string ToString() const override { return "RuleEagerAggregation"; }
+};
+
+// Filter(Append(P1, ..., Pn)) -> Append(Filter(P1), ..., Filter(Pn)) for the
+// partitions of a partitioned table, so each partition's scan evaluates the
+// predicates.
+class RuleFilterPushThroughAppend : public TransformationRule {
+public:
+  bool Matches(GroupExpression *expr) const override;
+  PgVector<GroupExpression *> Transform(GroupExpression *expr,
+                                        Memo *memo) const override;
+  std::string ToString() const override {
+    return "RuleFilterPushThroughAppend";
+  }
+};
+
+// Partition-wise join: Append(A1, ..., An) JOIN Append(B1, ..., Bn)
+//   -> Append(A1 JOIN B1, ..., An JOIN Bn)
+// for an inner join of two tables with the same partition bounds whose
+// predicates compare the partition keys for equality, so that rows can only
+// match within partitions with the same bound. Partitions pruned on either
+// side cannot have any matches.
+class RulePartitionwiseJoin : public TransformationRule {
+public:
+  bool Matches(GroupExpression *expr) const override;
+  PgVector<GroupExpression *> Transform(GroupExpression *expr,
+                                        Memo *memo) const override;
+  std::string ToString() const override { return "RulePartitionwiseJoin"; }
 };
 
-class RuleGetToScan : public Rule {
+// Partition-wise aggregation: Aggregate(Append(P1, ..., Pn)) becomes
+// Append(Aggregate(P1), ..., Aggregate(Pn)) when the grouping keys include
+// the partition key, so no group spans partitions, and
+// FinalAggregate(Append(PartialAggregate(P1), ...)) otherwise, if the
+// aggregates can be split into phases.
+class RulePartitionwiseAggregate : public TransformationRule {
 public:
   bool Matches(GroupExpression *expr) const override;
-  PgVector<GroupExpression *> Transform(GroupExpression *expr) const override;
+  PgVector<GroupExpression *> Transform(GroupExpression *expr,
+                                        Memo *memo) const override;
+  std::string ToString() const override {
+    return "RulePartitionwiseAggregate";
+  }
+};
+
+// UNION(X1, ..., Xn) -> Aggregate(UNION ALL(X1, ..., Xn)) grouping on every
+// column, so the duplicates are removed by the aggregate's implementations.
+class RuleUnionToAggregate : public TransformationRule {
+public:
+  bool Matches(GroupExpression *expr) const override;
+  PgVector<GroupExpression *> Transform(GroupExpression *expr,
+                                        Memo *memo) const override;
+  std::string ToString() const override { return "RuleUnionToAggregate"; }
+};
+
+// Filter(UNION ALL(X1, ..., Xn)) -> UNION ALL(Filter(X1), ..., Filter(Xn)),
+// with the predicates rewritten over each input's columns, so every branch
+// can push them further down.
+class RuleFilterPushThroughUnionAll : public TransformationRule {
+public:
+  bool Matches(GroupExpression *expr) const override;
+  PgVector<GroupExpression *> Transform(GroupExpression *expr,
+                                        Memo *memo) const override;
+  std::string ToString() const override {
+    return "RuleFilterPushThroughUnionAll";
+  }
+};
+
+// Limit(UNION ALL(X1, ..., Xn))
+//   -> Limit(UNION ALL(Limit(X1), ..., Limit(Xn)))
+// No branch has to produce more rows than the limit (plus the offset) on
+// its own.
+class RuleLimitPushThroughUnionAll : public TransformationRule {
+public:
+  bool Matches(GroupExpression *expr) const override;
+  PgVector<GroupExpression *> Transform(GroupExpression *expr,
+                                        Memo *memo) const override;
+  std::string ToString() const override {
+    return "RuleLimitPushThroughUnionAll";
+  }
+};
+
+// CteScan -> the CTE's query planned in place, for a CTE that may be
+// inlined. Which one wins is up to the cost model: the shared plan runs
+// once for all references, the inlined copy gets the predicates and joins
+// of this reference pushed into it.
+class RuleInlineCte : public TransformationRule {
+public:
+  bool Matches(GroupExpression *expr) const override;
+  PgVector<GroupExpression *> Transform(GroupExpression *expr,
+                                        Memo *memo) const override;
+  std::string ToString() const override { return "RuleInlineCte"; }
+};
+
+// Filter(Filter(X)) -> Filter(X), so pushed-down predicates end up in one
+// place.
+class RuleFilterMerge : public TransformationRule {
+public:
+  bool Matches(GroupExpression *expr) const override;
+  PgVector<GroupExpression *> Transform(GroupExpression *expr,
+                                        Memo *memo) const override;
+  std::string ToString() const override { return "RuleFilterMerge"; }
+};
+
+// --- Implementation Rules ---
+
+class RuleGetToScan : public ImplementationRule {
+public:
+  bool Matches(GroupExpression *expr) const override;
+  PgVector<GroupExpression *> Transform(GroupExpression *expr,
+                                        Memo *memo) const override;
   std::string ToString() const override { return "RuleGetToScan"; }
 };
 
-class RuleFilterToPhysical : public Rule {
+class RuleJoinToNestedLoop : public ImplementationRule {
+public:
+  bool Matches(GroupExpression *expr) const override;
+  PgVector<GroupExpression *> Transform(GroupExpression *expr,
+                                        Memo *memo) const override;
+  std::string ToString() const override { return "RuleJoinToNestedLoop"; }
+};
+
+// Nested loop whose right input is a single table (possibly filtered) read
+// through a btree index, with the join predicates on a prefix of the index
+// columns as lookup keys taken from the current left row. The index scan
+// gets a group of its own, as does a Memoize on top of it that caches the
+// rows found for each distinct key when the keys repeat.
+class RuleJoinToIndexNestedLoop : public ImplementationRule {
+public:
+  bool Matches(GroupExpression *expr) const override;
+  PgVector<GroupExpression *> Transform(GroupExpression *expr,
+                                        Memo *memo) const override;
+  std::string ToString() const override {
+    return "RuleJoinToIndexNestedLoop";
+  }
+};
+
+// Filter over a single table whose predicates compare a prefix of the
+// columns of a btree index with constants: read the matching rows through
+// the index, which also returns them in index order.
+class RuleFilterToIndexScan : public ImplementationRule {
+public:
+  bool Matches(GroupExpression *expr) const override;
+  PgVector<GroupExpression *> Transform(GroupExpression *expr,
+                                        Memo *memo) const override;
+  std::string ToString() const override { return "RuleFilterToIndexScan"; }
+};
+
+// Joins on equality keys: hash the right input, probe with the left one.
+// A left join may also hash its left input (a right hash join), and a full
+// join needs every predicate to be a key.
+class RuleJoinToHashJoin : public ImplementationRule {
+public:
+  bool Matches(GroupExpression *expr) const override;
+  PgVector<GroupExpression *> Transform(GroupExpression *expr,
+                                        Memo *memo) const override;
+  std::string ToString() const override { return "RuleJoinToHashJoin"; }
+};
+
+// Joins on mergejoinable keys: sort both inputs and merge them. As with
+// hash joins, a full join needs every predicate to be a key.
+class RuleJoinToMergeJoin : public ImplementationRule {
+public:
+  bool Matches(GroupExpression *expr) const override;
+  PgVector<GroupExpression *> Transform(GroupExpression *expr,
+                                        Memo *memo) const override;
+  std::string ToString() const override { return "RuleJoinToMergeJoin"; }
+};
+
+class RuleFilterToPhysical : public ImplementationRule {
 public:
   bool Matches(GroupExpression *expr) const override;
-  PgVector<GroupExpression *> Transform(GroupExpression *expr) const override;
+  PgVector<GroupExpression *> Transform(GroupExpression *expr,
+                                        Memo *memo) const override;
   std::string ToString() const override { return "RuleFilterToPhysical"; }
 };
 
-class RuleProjectionToPhysical : public Rule {
+// A filter, inner or semi join with a constant-false predicate is
+// implemented by an empty result, without planning its input.
+class RuleFilterToEmptyResult : public ImplementationRule {
 public:
   bool Matches(GroupExpression *expr) const override;
-  PgVector<GroupExpression *> Transform(GroupExpression *expr) const override;
+  PgVector<GroupExpression *> Transform(GroupExpression *expr,
+                                        Memo *memo) const override;
+  std::string ToString() const override { return "RuleFilterToEmptyResult"; }
+};
+
+class RuleProjectionToPhysical : public ImplementationRule {
+public:
+  bool Matches(GroupExpression *expr) const override;
+  PgVector<GroupExpression *> Transform(GroupExpression *expr,
+                                        Memo *memo) const override;
   std::string ToString() const override { return "RuleProjectionToPhysical"; }
 };
 
-class RuleSortToPhysical : public Rule {
+class RuleSortToPhysical : public ImplementationRule {
 public:
   bool Matches(GroupExpression *expr) const override;
-  PgVector<GroupExpression *> Transform(GroupExpression *expr) const override;
+  PgVector<GroupExpression *> Transform(GroupExpression *expr,
+                                        Memo *memo) const override;
   std::string ToString() const override { return "RuleSortToPhysical"; }
 };
 
-class RuleLimitToPhysical : public Rule {
+// Sort that only sorts what the input plan does not deliver in order
+// already (see Ordering).
+class RuleSortToIncrementalSort : public ImplementationRule {
+public:
+  bool Matches(GroupExpression *expr) const override;
+  PgVector<GroupExpression *> Transform(GroupExpression *expr,
+                                        Memo *memo) const override;
+  std::string ToString() const override {
+    return "RuleSortToIncrementalSort";
+  }
+};
+
+// WindowAgg over the input sorted on the window's keys, which the
+// translator adds unless the input plan delivers that order.
+class RuleWindowToPhysical : public ImplementationRule {
+public:
+  bool Matches(GroupExpression *expr) const override;
+  PgVector<GroupExpression *> Transform(GroupExpression *expr,
+                                        Memo *memo) const override;
+  std::string ToString() const override { return "RuleWindowToPhysical"; }
+};
+
+// Aggregation over input sorted on the grouping keys (the translator adds the
+// Sort), or a plain aggregate without keys.
+class RuleAggregateToSortedAggregate : public ImplementationRule {
+public:
+  bool Matches(GroupExpression *expr) const override;
+  PgVector<GroupExpression *> Transform(GroupExpression *expr,
+                                        Memo *memo) const override;
+  std::string ToString() const override {
+    return "RuleAggregateToSortedAggregate";
+  }
+};
+
+// Aggregation into a hash table on the grouping keys, if they are all
+// hashable.
+class RuleAggregateToHashedAggregate : public ImplementationRule {
+public:
+  bool Matches(GroupExpression *expr) const override;
+  PgVector<GroupExpression *> Transform(GroupExpression *expr,
+                                        Memo *memo) const override;
+  std::string ToString() const override {
+    return "RuleAggregateToHashedAggregate";
+  }
+};
+
+class RuleAppendToPhysical : public ImplementationRule {
+public:
+  bool Matches(GroupExpression *expr) const override;
+  PgVector<GroupExpression *> Transform(GroupExpression *expr,
+                                        Memo *memo) const override;
+  std::string ToString() const override { return "RuleAppendToPhysical"; }
+};
+
+// UNION ALL as an Append of its inputs
+class RuleSetOperationToAppend : public ImplementationRule {
+public:
+  bool Matches(GroupExpression *expr) const override;
+  PgVector<GroupExpression *> Transform(GroupExpression *expr,
+                                        Memo *memo) const override;
+  std::string ToString() const override { return "RuleSetOperationToAppend"; }
+};
+
+// Sort(UNION ALL(X1, ..., Xn)) as a MergeAppend of the sorted inputs, when
+// every sort key is an output column of the UNION ALL.
+class RuleSortToMergeAppend : public ImplementationRule {
+public:
+  bool Matches(GroupExpression *expr) const override;
+  PgVector<GroupExpression *> Transform(GroupExpression *expr,
+                                        Memo *memo) const override;
+  std::string ToString() const override { return "RuleSortToMergeAppend"; }
+};
+
+// INTERSECT and EXCEPT over inputs sorted on every column
+class RuleSetOperationToSortedSetOp : public ImplementationRule {
+public:
+  bool Matches(GroupExpression *expr) const override;
+  PgVector<GroupExpression *> Transform(GroupExpression *expr,
+                                        Memo *memo) const override;
+  std::string ToString() const override {
+    return "RuleSetOperationToSortedSetOp";
+  }
+};
+
+// INTERSECT and EXCEPT counting the rows in a hash table, if every column
+// is hashable
+class RuleSetOperationToHashedSetOp : public ImplementationRule {
+public:
+  bool Matches(GroupExpression *expr) const override;
+  PgVector<GroupExpression *> Transform(GroupExpression *expr,
+                                        Memo *memo) const override;
+  std::string ToString() const override {
+    return "RuleSetOperationToHashedSetOp";
+  }
+};
+
+// Reads the CTE's shared plan, if it has one
+class RuleCteScanToPhysical : public ImplementationRule {
+public:
+  bool Matches(GroupExpression *expr) const override;
+  PgVector<GroupExpression *> Transform(GroupExpression *expr,
+                                        Memo *memo) const override;
+  std::string ToString() const override { return "RuleCteScanToPhysical"; }
+};
+
+class RuleLimitToPhysical : public ImplementationRule {
 public:
   bool Matches(GroupExpression *expr) const override;
-  PgVector<GroupExpression *> Transform(GroupExpression *expr) const override;
+  PgVector<GroupExpression *> Transform(GroupExpression *expr,
+                                        Memo *memo) const override;
   std::string ToString() const override { return "RuleLimitToPhysical"; }
 };
 
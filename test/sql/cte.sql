@@ -0,0 +1,59 @@
+--
+-- CTEs: inlined into the query, or planned once and read through CTE Scans
+--
+LOAD 'pg_carbon';
+-- Go through every search stage, however cheap the plans
+SET pg_carbon.stage0_cost_limit = 0;
+SET pg_carbon.stage1_cost_limit = 0;
+
+CREATE TABLE ct (id int PRIMARY KEY, grp int, val int);
+INSERT INTO ct SELECT i, i % 5, i * 3 % 17 FROM generate_series(1, 50) i;
+ANALYZE ct;
+
+-- Referenced once: inlined
+SELECT * FROM carbon_check($$
+  WITH c AS (SELECT id, val FROM ct WHERE grp = 1)
+  SELECT id FROM c WHERE val > 5
+$$);
+SELECT carbon_nodes($$
+  WITH c AS (SELECT id, val FROM ct WHERE grp = 1)
+  SELECT id FROM c WHERE val > 5
+$$) LIKE '%CTE Scan%' AS cte_scan;
+
+-- MATERIALIZED: planned once
+SELECT * FROM carbon_check($$
+  WITH c AS MATERIALIZED (SELECT id, val FROM ct WHERE grp = 1)
+  SELECT id FROM c WHERE val > 5
+$$);
+SELECT carbon_nodes($$
+  WITH c AS MATERIALIZED (SELECT id, val FROM ct WHERE grp = 1)
+  SELECT id FROM c WHERE val > 5
+$$) LIKE '%CTE Scan%' AS cte_scan;
+
+-- Referenced twice: both the shared plan and inlining are costed
+SELECT * FROM carbon_check($$
+  WITH c AS (SELECT grp, val FROM ct WHERE id <= 20)
+  SELECT a.val AS a_val, b.val AS b_val FROM c a JOIN c b ON a.grp = b.grp
+$$);
+SELECT carbon_rule_added($$
+  WITH c AS (SELECT grp, val FROM ct WHERE id <= 20)
+  SELECT a.val AS a_val, b.val AS b_val FROM c a JOIN c b ON a.grp = b.grp
+$$, 'RuleInlineCte') AS inlined;
+
+-- NOT MATERIALIZED: inlined at each reference
+SELECT * FROM carbon_check($$
+  WITH c AS NOT MATERIALIZED (SELECT grp, val FROM ct WHERE id <= 20)
+  SELECT a.val AS a_val, b.val AS b_val FROM c a JOIN c b ON a.grp = b.grp
+$$);
+SELECT carbon_nodes($$
+  WITH c AS NOT MATERIALIZED (SELECT grp, val FROM ct WHERE id <= 20)
+  SELECT a.val AS a_val, b.val AS b_val FROM c a JOIN c b ON a.grp = b.grp
+$$) LIKE '%CTE Scan%' AS cte_scan;
+
+-- Volatile: computed once, so every reference sees the same rows
+SELECT * FROM carbon_check($$
+  WITH c AS (SELECT id, random() AS r FROM ct)
+  SELECT count(*) FROM c a JOIN c b ON a.id = b.id WHERE a.r = b.r
+$$);
+
+DROP TABLE ct;
@@ -0,0 +1,46 @@
+--
+-- Aggregation, and partial aggregates pushed below joins
+--
+LOAD 'pg_carbon';
+-- Go through every search stage, however cheap the plans
+SET pg_carbon.stage0_cost_limit = 0;
+SET pg_carbon.stage1_cost_limit = 0;
+
+CREATE TABLE ea_dept (id int PRIMARY KEY, name text);
+CREATE TABLE ea_emp (id int PRIMARY KEY, dept_id int, salary int);
+INSERT INTO ea_dept VALUES (1, 'eng'), (2, 'ops'), (3, 'hr');
+INSERT INTO ea_emp SELECT i, i % 4, i * 10 FROM generate_series(1, 100) i;
+ANALYZE ea_dept, ea_emp;
+
+-- The aggregates only read the employees, so they can be grouped by
+-- department before the join
+SELECT * FROM carbon_check($$
+  SELECT d.name, sum(e.salary) AS total, avg(e.salary) AS mean, count(*) AS n
+  FROM ea_emp e JOIN ea_dept d ON e.dept_id = d.id
+  GROUP BY d.name
+$$);
+SELECT carbon_rule_added($$
+  SELECT d.name, sum(e.salary) AS total, avg(e.salary) AS mean, count(*) AS n
+  FROM ea_emp e JOIN ea_dept d ON e.dept_id = d.id
+  GROUP BY d.name
+$$, 'RuleEagerAggregation') AS pushed;
+
+-- Below a left join only on its preserved side
+SELECT * FROM carbon_check($$
+  SELECT d.name, sum(e.salary) AS total, count(*) AS n
+  FROM ea_emp e LEFT JOIN ea_dept d ON e.dept_id = d.id
+  GROUP BY d.name
+$$);
+SELECT carbon_rule_added($$
+  SELECT d.name, sum(e.salary) AS total, count(*) AS n
+  FROM ea_emp e LEFT JOIN ea_dept d ON e.dept_id = d.id
+  GROUP BY d.name
+$$, 'RuleEagerAggregation') AS pushed;
+
+-- Without grouping keys
+SELECT * FROM carbon_check($$
+  SELECT sum(e.salary) AS total, max(e.salary) AS top
+  FROM ea_emp e JOIN ea_dept d ON e.dept_id = d.id
+$$);
+
+DROP TABLE ea_emp, ea_dept;
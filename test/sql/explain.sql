@@ -0,0 +1,77 @@
+--
+-- EXPLAIN (CARBON) with pg_carbon on and off
+--
+LOAD 'pg_carbon';
+-- Go through every search stage, however cheap the plans
+SET pg_carbon.stage0_cost_limit = 0;
+SET pg_carbon.stage1_cost_limit = 0;
+
+CREATE TABLE ex_a (id int PRIMARY KEY, b_id int);
+CREATE TABLE ex_b (id int PRIMARY KEY, val int);
+INSERT INTO ex_a SELECT i, i % 10 FROM generate_series(1, 100) i;
+INSERT INTO ex_b SELECT i, i % 3 FROM generate_series(1, 10) i;
+ANALYZE ex_a, ex_b;
+
+-- How many plan nodes name the Memo group they come from
+CREATE FUNCTION ex_grouped_nodes(query text) RETURNS bigint
+LANGUAGE sql AS $$
+  WITH RECURSIVE node(plan) AS (
+    SELECT carbon_explain(query)->'Plan'
+    UNION ALL
+    SELECT child FROM node, json_array_elements(node.plan->'Plans') AS child
+  )
+  SELECT count(*) FROM node WHERE plan->>'Carbon Group' IS NOT NULL
+$$;
+
+-- pg_carbon's plan: the search's details, and the groups of the nodes
+SELECT carbon_explain($$
+  SELECT a.id, b.val FROM ex_a a JOIN ex_b b ON a.b_id = b.id
+$$)->'Carbon'->>'Planner' AS planner;
+SELECT (carbon->>'Memo Groups')::int > 0 AS groups,
+       (carbon->>'Memo Expressions')::int >
+           (carbon->>'Memo Groups')::int AS expressions,
+       carbon->>'Search Stage' AS stage,
+       carbon->>'Budget Exhausted' AS exhausted,
+       json_array_length(carbon->'Rules Fired') > 0 AS rules,
+       (carbon->>'PostgreSQL Total Cost')::float8 > 0 AS standard_cost,
+       carbon->>'Carbon Plan' IS NOT NULL AS carbon_plan
+FROM (SELECT carbon_explain($$
+  SELECT a.id, b.val FROM ex_a a JOIN ex_b b ON a.b_id = b.id
+$$)->'Carbon' AS carbon) s;
+SELECT ex_grouped_nodes($$
+  SELECT a.id, b.val FROM ex_a a JOIN ex_b b ON a.b_id = b.id
+$$) > 0 AS grouped;
+SELECT carbon_memo_has($$
+  SELECT a.id, b.val FROM ex_a a JOIN ex_b b ON a.b_id = b.id
+$$, 'LogicalInnerJoin') AS memo;
+SELECT carbon_relations($$
+  SELECT a.id, b.val FROM ex_a a JOIN ex_b b ON a.b_id = b.id
+$$) AS relations;
+
+-- A query pg_carbon leaves to PostgreSQL, and why
+SELECT carbon->>'Planner' AS planner, carbon->>'Fallback Reason' AS reason
+FROM (SELECT carbon_explain($$
+  SELECT b.id FROM ex_b b WHERE b.id NOT IN (SELECT b_id FROM ex_a)
+$$)->'Carbon' AS carbon) s;
+SELECT ex_grouped_nodes($$
+  SELECT b.id FROM ex_b b WHERE b.id NOT IN (SELECT b_id FROM ex_a)
+$$) AS grouped;
+
+-- With pg_carbon off, only the planner is reported, and the plan scans the
+-- same tables
+SET pg_carbon.enable = off;
+SELECT carbon->>'Planner' AS planner,
+       carbon->>'Memo Groups' IS NULL AS no_search
+FROM (SELECT carbon_explain($$
+  SELECT a.id, b.val FROM ex_a a JOIN ex_b b ON a.b_id = b.id
+$$)->'Carbon' AS carbon) s;
+SELECT ex_grouped_nodes($$
+  SELECT a.id, b.val FROM ex_a a JOIN ex_b b ON a.b_id = b.id
+$$) AS grouped;
+SELECT carbon_relations($$
+  SELECT a.id, b.val FROM ex_a a JOIN ex_b b ON a.b_id = b.id
+$$) AS relations;
+RESET pg_carbon.enable;
+
+DROP FUNCTION ex_grouped_nodes(text);
+DROP TABLE ex_a, ex_b;
@@ -0,0 +1,101 @@
+--
+-- Helpers for the tests that follow: each of them plans queries with
+-- pg_carbon and checks that they return the same rows as PostgreSQL's plans.
+--
+CREATE EXTENSION pg_carbon;
+
+-- EXPLAIN (FORMAT JSON, CARBON) of `query`, for the first statement
+CREATE FUNCTION carbon_explain(query text) RETURNS json
+LANGUAGE plpgsql AS $$
+DECLARE
+  plan json;
+BEGIN
+  EXECUTE 'EXPLAIN (FORMAT JSON, COSTS OFF, CARBON) ' || query INTO plan;
+  RETURN plan->0;
+END
+$$;
+
+-- Which planner planned `query`, how many rows it returns with pg_carbon,
+-- and whether those are the rows PostgreSQL's plan returns, duplicates
+-- included
+CREATE FUNCTION carbon_check(query text, OUT planner text, OUT nrows bigint,
+                             OUT same boolean)
+LANGUAGE plpgsql AS $$
+DECLARE
+  enabled text := current_setting('pg_carbon.enable');
+BEGIN
+  planner := carbon_explain(query)->'Carbon'->>'Planner';
+  PERFORM set_config('pg_carbon.enable', 'off', true);
+  EXECUTE 'CREATE TEMP TABLE carbon_expected AS ' || query;
+  PERFORM set_config('pg_carbon.enable', 'on', true);
+  EXECUTE 'CREATE TEMP TABLE carbon_actual AS ' || query;
+  PERFORM set_config('pg_carbon.enable', 'off', true);
+  EXECUTE 'SELECT count(*) FROM carbon_actual' INTO nrows;
+  EXECUTE 'SELECT NOT EXISTS ((TABLE carbon_actual EXCEPT ALL '
+          'TABLE carbon_expected) UNION ALL (TABLE carbon_expected '
+          'EXCEPT ALL TABLE carbon_actual))' INTO same;
+  DROP TABLE carbon_expected, carbon_actual;
+  PERFORM set_config('pg_carbon.enable', enabled, true);
+END
+$$;
+
+-- Whether `rule` added an expression to the Memo while pg_carbon planned
+-- `query`
+CREATE FUNCTION carbon_rule_added(query text, rule text) RETURNS boolean
+LANGUAGE sql AS $$
+  SELECT EXISTS (
+    SELECT FROM json_array_elements_text(
+                  carbon_explain(query)->'Carbon'->'Rules Fired') AS fired
+    WHERE fired LIKE rule || ':%' AND fired NOT LIKE '%, 0 added')
+$$;
+
+-- The tables the plan of `query` scans, in alphabetical order
+CREATE FUNCTION carbon_relations(query text) RETURNS text
+LANGUAGE sql AS $$
+  WITH RECURSIVE node(plan) AS (
+    SELECT carbon_explain(query)->'Plan'
+    UNION ALL
+    SELECT child FROM node, json_array_elements(node.plan->'Plans') AS child
+  )
+  SELECT string_agg(DISTINCT plan->>'Relation Name', ', '
+                    ORDER BY plan->>'Relation Name')
+  FROM node
+$$;
+
+-- The node types of the plan of `query`, in alphabetical order
+CREATE FUNCTION carbon_nodes(query text) RETURNS text
+LANGUAGE sql AS $$
+  WITH RECURSIVE node(plan) AS (
+    SELECT carbon_explain(query)->'Plan'
+    UNION ALL
+    SELECT child FROM node, json_array_elements(node.plan->'Plans') AS child
+  )
+  SELECT string_agg(DISTINCT plan->>'Node Type', ', '
+                    ORDER BY plan->>'Node Type')
+  FROM node
+$$;
+
+-- Whether pg_carbon's Memo for `query` holds an expression of `operator`,
+-- whether or not the plan uses it
+CREATE FUNCTION carbon_memo_has(query text, operator text) RETURNS boolean
+LANGUAGE plpgsql AS $$
+DECLARE
+  plan json;
+BEGIN
+  EXECUTE 'EXPLAIN (FORMAT JSON, COSTS OFF, CARBON, CARBON_MEMO) ' || query
+    INTO plan;
+  RETURN plan->0->'Carbon'->>'Memo' ~ ('\m' || operator || '\M');
+END
+$$;
+
+-- The fingerprint of `query` (compute_query_id), under which the statistics
+-- views count it
+CREATE FUNCTION carbon_query_id(query text) RETURNS bigint
+LANGUAGE plpgsql AS $$
+DECLARE
+  plan json;
+BEGIN
+  EXECUTE 'EXPLAIN (VERBOSE, FORMAT JSON, COSTS OFF) ' || query INTO plan;
+  RETURN (plan->0->>'Query Identifier')::bigint;
+END
+$$;
@@ -0,0 +1,82 @@
+--
+-- Joins that unique and foreign keys prove redundant
+--
+LOAD 'pg_carbon';
+-- Go through every search stage, however cheap the plans
+SET pg_carbon.stage0_cost_limit = 0;
+SET pg_carbon.stage1_cost_limit = 0;
+
+CREATE TABLE je_customer (id int PRIMARY KEY, name text);
+CREATE TABLE je_order (id int PRIMARY KEY,
+                       customer_id int NOT NULL REFERENCES je_customer,
+                       note_id int, amount int);
+CREATE TABLE je_note (id int, body text);
+INSERT INTO je_customer VALUES (1, 'ann'), (2, 'bob'), (3, 'cy');
+INSERT INTO je_order VALUES (10, 1, 1, 5), (11, 1, NULL, 7), (12, 2, 2, 9);
+INSERT INTO je_note VALUES (1, 'first'), (2, 'second'), (2, 'again');
+ANALYZE je_customer, je_order, je_note;
+
+-- A left join on the primary key of a table none of whose columns are used
+SELECT * FROM carbon_check($$
+  SELECT o.id, o.amount
+  FROM je_order o LEFT JOIN je_customer c ON o.customer_id = c.id
+$$);
+SELECT carbon_relations($$
+  SELECT o.id, o.amount
+  FROM je_order o LEFT JOIN je_customer c ON o.customer_id = c.id
+$$);
+
+-- An inner join along a foreign key with NOT NULL columns
+SELECT * FROM carbon_check($$
+  SELECT o.id, o.amount
+  FROM je_order o JOIN je_customer c ON o.customer_id = c.id
+$$);
+SELECT carbon_relations($$
+  SELECT o.id, o.amount
+  FROM je_order o JOIN je_customer c ON o.customer_id = c.id
+$$);
+
+-- Not when the table's columns are used
+SELECT * FROM carbon_check($$
+  SELECT o.id, c.name
+  FROM je_order o JOIN je_customer c ON o.customer_id = c.id
+$$);
+SELECT carbon_relations($$
+  SELECT o.id, c.name
+  FROM je_order o JOIN je_customer c ON o.customer_id = c.id
+$$);
+
+-- Nor on a column that is not unique: the join duplicates rows
+SELECT * FROM carbon_check($$
+  SELECT o.id, o.amount
+  FROM je_order o LEFT JOIN je_note n ON o.note_id = n.id
+$$);
+SELECT carbon_relations($$
+  SELECT o.id, o.amount
+  FROM je_order o LEFT JOIN je_note n ON o.note_id = n.id
+$$);
+
+-- Nor an inner join that could reject rows of the referencing table
+SELECT * FROM carbon_check($$
+  SELECT o.id, o.amount
+  FROM je_order o JOIN je_customer c ON o.customer_id = c.id
+  WHERE c.name <> 'bob'
+$$);
+
+-- Nor along a deferrable foreign key: until the transaction commits,
+-- referencing rows may have no match
+CREATE TABLE je_deferred (id int PRIMARY KEY,
+                          customer_id int NOT NULL
+                            REFERENCES je_customer DEFERRABLE);
+BEGIN;
+SET CONSTRAINTS ALL DEFERRED;
+INSERT INTO je_deferred VALUES (1, 1), (2, 4);
+SELECT * FROM carbon_check($$
+  SELECT d.id FROM je_deferred d JOIN je_customer c ON d.customer_id = c.id
+$$);
+SELECT carbon_relations($$
+  SELECT d.id FROM je_deferred d JOIN je_customer c ON d.customer_id = c.id
+$$);
+ROLLBACK;
+
+DROP TABLE je_deferred, je_order, je_customer, je_note;
@@ -0,0 +1,49 @@
+--
+-- Parameterized index nested loops, with Memoize caching the lookups of
+-- repeated outer values
+--
+LOAD 'pg_carbon';
+-- Go through every search stage, however cheap the plans
+SET pg_carbon.stage0_cost_limit = 0;
+SET pg_carbon.stage1_cost_limit = 0;
+
+-- Many outer rows over few distinct keys
+CREATE TABLE mz_outer (id int, key int);
+CREATE TABLE mz_inner (id int PRIMARY KEY, val int);
+INSERT INTO mz_outer SELECT i, i % 10 FROM generate_series(1, 1000) i;
+INSERT INTO mz_inner SELECT i, i * 7 % 13 FROM generate_series(1, 100) i;
+ANALYZE mz_outer, mz_inner;
+
+SELECT * FROM carbon_check($$
+  SELECT o.id, i.val FROM mz_outer o JOIN mz_inner i ON o.key = i.id
+$$);
+SELECT carbon_memo_has($$
+  SELECT o.id, i.val FROM mz_outer o JOIN mz_inner i ON o.key = i.id
+$$, 'PhysicalMemoize') AS memoized;
+
+-- Outer rows without a match are kept
+SELECT * FROM carbon_check($$
+  SELECT o.id, i.val FROM mz_outer o LEFT JOIN mz_inner i ON o.key = i.id
+$$);
+SELECT carbon_memo_has($$
+  SELECT o.id, i.val FROM mz_outer o LEFT JOIN mz_inner i ON o.key = i.id
+$$, 'PhysicalMemoize') AS memoized;
+
+-- With a filter on the inner table besides the index key
+SELECT * FROM carbon_check($$
+  SELECT o.id, i.val FROM mz_outer o JOIN mz_inner i ON o.key = i.id
+  WHERE i.val > 3
+$$);
+
+-- A semi or anti join stops reading a lookup early, which would leave an
+-- incomplete cache entry
+SELECT * FROM carbon_check($$
+  SELECT o.id FROM mz_outer o
+  WHERE NOT EXISTS (SELECT FROM mz_inner i WHERE i.id = o.key)
+$$);
+SELECT carbon_memo_has($$
+  SELECT o.id FROM mz_outer o
+  WHERE NOT EXISTS (SELECT FROM mz_inner i WHERE i.id = o.key)
+$$, 'PhysicalMemoize') AS memoized;
+
+DROP TABLE mz_outer, mz_inner;
@@ -0,0 +1,57 @@
+--
+-- Outer joins, and join orders under the outer-join identities
+--
+LOAD 'pg_carbon';
+-- Go through every search stage, however cheap the plans
+SET pg_carbon.stage0_cost_limit = 0;
+SET pg_carbon.stage1_cost_limit = 0;
+
+CREATE TABLE oj_a (id int PRIMARY KEY, b_id int, c_id int);
+CREATE TABLE oj_b (id int PRIMARY KEY, val text);
+CREATE TABLE oj_c (id int PRIMARY KEY, val text);
+INSERT INTO oj_a VALUES (1, 1, 1), (2, 2, NULL), (3, NULL, 3), (4, 5, 4);
+INSERT INTO oj_b VALUES (1, 'b1'), (2, 'b2'), (3, 'b3');
+INSERT INTO oj_c VALUES (1, 'c1'), (3, 'c3'), (4, 'c4');
+ANALYZE oj_a, oj_b, oj_c;
+
+-- (A LEFT JOIN B) JOIN C -> (A JOIN C) LEFT JOIN B
+SELECT * FROM carbon_check($$
+  SELECT a.id AS a_id, b.val AS b_val, c.val AS c_val
+  FROM oj_a a LEFT JOIN oj_b b ON a.b_id = b.id JOIN oj_c c ON a.c_id = c.id
+$$);
+SELECT carbon_rule_added($$
+  SELECT a.id AS a_id, b.val AS b_val, c.val AS c_val
+  FROM oj_a a LEFT JOIN oj_b b ON a.b_id = b.id JOIN oj_c c ON a.c_id = c.id
+$$, 'RuleInnerJoinPastLeftJoin') AS reordered;
+
+-- (A LEFT JOIN B) LEFT JOIN C ON Pbc -> A LEFT JOIN (B LEFT JOIN C)
+SELECT * FROM carbon_check($$
+  SELECT a.id AS a_id, b.val AS b_val, c.val AS c_val
+  FROM oj_a a LEFT JOIN oj_b b ON a.b_id = b.id LEFT JOIN oj_c c ON b.id = c.id
+$$);
+SELECT carbon_rule_added($$
+  SELECT a.id AS a_id, b.val AS b_val, c.val AS c_val
+  FROM oj_a a LEFT JOIN oj_b b ON a.b_id = b.id LEFT JOIN oj_c c ON b.id = c.id
+$$, 'RuleLeftJoinAssociativity') AS reordered;
+
+-- (A JOIN B) LEFT JOIN C -> (A LEFT JOIN C) JOIN B
+SELECT * FROM carbon_check($$
+  SELECT a.id AS a_id, b.val AS b_val, c.val AS c_val
+  FROM oj_a a JOIN oj_b b ON a.b_id = b.id LEFT JOIN oj_c c ON a.c_id = c.id
+$$);
+SELECT carbon_rule_added($$
+  SELECT a.id AS a_id, b.val AS b_val, c.val AS c_val
+  FROM oj_a a JOIN oj_b b ON a.b_id = b.id LEFT JOIN oj_c c ON a.c_id = c.id
+$$, 'RuleLeftJoinPastInnerJoin') AS reordered;
+
+-- Right and full joins
+SELECT * FROM carbon_check($$
+  SELECT a.id AS a_id, b.val AS b_val
+  FROM oj_a a RIGHT JOIN oj_b b ON a.b_id = b.id
+$$);
+SELECT * FROM carbon_check($$
+  SELECT a.id AS a_id, b.id AS b_id
+  FROM oj_a a FULL JOIN oj_b b ON a.b_id = b.id
+$$);
+
+DROP TABLE oj_a, oj_b, oj_c;
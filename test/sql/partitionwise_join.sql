@@ -0,0 +1,59 @@
+--
+-- Partitioned tables: pruning, and partition-wise joins and aggregates
+--
+LOAD 'pg_carbon';
+-- Go through every search stage, however cheap the plans
+SET pg_carbon.stage0_cost_limit = 0;
+SET pg_carbon.stage1_cost_limit = 0;
+
+CREATE TABLE pw_a (id int, val int) PARTITION BY RANGE (id);
+CREATE TABLE pw_a1 PARTITION OF pw_a FOR VALUES FROM (0) TO (50);
+CREATE TABLE pw_a2 PARTITION OF pw_a FOR VALUES FROM (50) TO (100);
+CREATE TABLE pw_b (id int, val int) PARTITION BY RANGE (id);
+CREATE TABLE pw_b1 PARTITION OF pw_b FOR VALUES FROM (0) TO (50);
+CREATE TABLE pw_b2 PARTITION OF pw_b FOR VALUES FROM (50) TO (100);
+INSERT INTO pw_a SELECT i, i FROM generate_series(0, 99) i;
+INSERT INTO pw_b SELECT i, i * 2 FROM generate_series(0, 99, 3) i;
+ANALYZE pw_a, pw_b;
+
+-- Tables with the same bounds, joined on their partition keys
+SELECT * FROM carbon_check($$
+  SELECT a.id, a.val AS a_val, b.val AS b_val
+  FROM pw_a a JOIN pw_b b ON a.id = b.id
+$$);
+SELECT carbon_rule_added($$
+  SELECT a.id, a.val AS a_val, b.val AS b_val
+  FROM pw_a a JOIN pw_b b ON a.id = b.id
+$$, 'RulePartitionwiseJoin') AS partitionwise;
+
+-- With the partitions of one side pruned
+SELECT * FROM carbon_check($$
+  SELECT a.id, a.val AS a_val, b.val AS b_val
+  FROM pw_a a JOIN pw_b b ON a.id = b.id
+  WHERE a.id >= 60
+$$);
+
+-- Not on other columns: rows could match across partitions
+SELECT * FROM carbon_check($$
+  SELECT a.id AS a_id, b.id AS b_id
+  FROM pw_a a JOIN pw_b b ON a.val = b.val
+$$);
+SELECT carbon_rule_added($$
+  SELECT a.id AS a_id, b.id AS b_id
+  FROM pw_a a JOIN pw_b b ON a.val = b.val
+$$, 'RulePartitionwiseJoin') AS partitionwise;
+
+-- Aggregates per partition, grouped by the partition key or not
+SELECT * FROM carbon_check($$
+  SELECT a.id, sum(a.val) AS total FROM pw_a a GROUP BY a.id
+$$);
+SELECT * FROM carbon_check($$
+  SELECT a.val % 10 AS k, sum(a.val) AS total, count(*) AS n
+  FROM pw_a a GROUP BY a.val % 10
+$$);
+SELECT carbon_rule_added($$
+  SELECT a.val % 10 AS k, sum(a.val) AS total, count(*) AS n
+  FROM pw_a a GROUP BY a.val % 10
+$$, 'RulePartitionwiseAggregate') AS partitionwise;
+
+DROP TABLE pw_a, pw_b;
@@ -0,0 +1,79 @@
+--
+-- Preprocessing: constant folding, qual canonicalization, join aliases,
+-- outer join reduction, and sublinks unnested into semi and anti joins
+--
+LOAD 'pg_carbon';
+-- Go through every search stage, however cheap the plans
+SET pg_carbon.stage0_cost_limit = 0;
+SET pg_carbon.stage1_cost_limit = 0;
+
+CREATE TABLE pp_a (id int PRIMARY KEY, b_id int, val int);
+CREATE TABLE pp_b (id int PRIMARY KEY, grp int);
+INSERT INTO pp_a SELECT i, i % 12, i % 7 FROM generate_series(1, 100) i;
+INSERT INTO pp_b SELECT i, i % 3 FROM generate_series(1, 10) i;
+ANALYZE pp_a, pp_b;
+
+-- Constant expressions folded, and a qual that always holds dropped
+SELECT * FROM carbon_check($$
+  SELECT id, val FROM pp_a WHERE val = 2 + 1 AND 1 = 1 AND id > 10 * 5
+$$);
+
+-- A qual that never holds
+SELECT * FROM carbon_check($$
+  SELECT id FROM pp_a WHERE id > 5 AND 2 < 1
+$$);
+
+-- The common factor of an OR of ANDs
+SELECT * FROM carbon_check($$
+  SELECT id FROM pp_a WHERE (val = 1 AND id < 20) OR (val = 1 AND id > 90)
+$$);
+
+-- Columns of a join alias
+SELECT * FROM carbon_check($$
+  SELECT j.id, j.grp FROM (pp_a JOIN pp_b USING (id)) AS j WHERE j.grp = 1
+$$);
+
+-- A left join whose nullable side the WHERE clause filters is an inner join
+SELECT * FROM carbon_check($$
+  SELECT a.id, b.grp FROM pp_a a LEFT JOIN pp_b b ON a.b_id = b.id
+  WHERE b.grp = 2
+$$);
+SELECT carbon_memo_has($$
+  SELECT a.id, b.grp FROM pp_a a LEFT JOIN pp_b b ON a.b_id = b.id
+  WHERE b.grp = 2
+$$, 'LogicalLeftJoin') AS left_join;
+
+-- EXISTS and IN become semi joins
+SELECT * FROM carbon_check($$
+  SELECT b.id FROM pp_b b
+  WHERE EXISTS (SELECT 1 FROM pp_a a WHERE a.b_id = b.id AND a.val = 0)
+$$);
+SELECT carbon_memo_has($$
+  SELECT b.id FROM pp_b b
+  WHERE EXISTS (SELECT 1 FROM pp_a a WHERE a.b_id = b.id AND a.val = 0)
+$$, 'LogicalSemiJoin') AS semi_join;
+SELECT * FROM carbon_check($$
+  SELECT a.id FROM pp_a a WHERE a.b_id IN (SELECT id FROM pp_b WHERE grp = 0)
+$$);
+
+-- NOT EXISTS becomes an anti join
+SELECT * FROM carbon_check($$
+  SELECT b.id FROM pp_b b
+  WHERE NOT EXISTS (SELECT FROM pp_a a WHERE a.b_id = b.id AND a.val = 6
+                    AND a.id < 50)
+$$);
+SELECT carbon_memo_has($$
+  SELECT b.id FROM pp_b b
+  WHERE NOT EXISTS (SELECT FROM pp_a a WHERE a.b_id = b.id AND a.val = 6
+                    AND a.id < 50)
+$$, 'LogicalAntiJoin') AS anti_join;
+
+-- NOT IN and sublinks outside WHERE stay, and PostgreSQL plans the query
+SELECT * FROM carbon_check($$
+  SELECT b.id FROM pp_b b WHERE b.id NOT IN (SELECT b_id FROM pp_a)
+$$);
+SELECT * FROM carbon_check($$
+  SELECT b.id, (SELECT count(*) FROM pp_a a WHERE a.b_id = b.id) FROM pp_b b
+$$);
+
+DROP TABLE pp_a, pp_b;
@@ -0,0 +1,95 @@
+--
+-- The search in stages, and its time, task and memory budgets
+--
+LOAD 'pg_carbon';
+
+CREATE TABLE sr_a (id int PRIMARY KEY, b_id int);
+CREATE TABLE sr_b (id int PRIMARY KEY, c_id int);
+CREATE TABLE sr_c (id int PRIMARY KEY, d_id int);
+CREATE TABLE sr_d (id int PRIMARY KEY, val int);
+INSERT INTO sr_a SELECT i, i % 50 FROM generate_series(1, 200) i;
+INSERT INTO sr_b SELECT i, i % 20 FROM generate_series(1, 50) i;
+INSERT INTO sr_c SELECT i, i % 10 FROM generate_series(1, 20) i;
+INSERT INTO sr_d SELECT i, i % 3 FROM generate_series(1, 10) i;
+ANALYZE sr_a, sr_b, sr_c, sr_d;
+
+-- Plans cheaper than the limits stop the search at stage 0, which only
+-- implements the query as written
+SET pg_carbon.stage0_cost_limit = 1e10;
+SET pg_carbon.stage1_cost_limit = 1e10;
+SELECT * FROM carbon_check($$
+  SELECT a.id AS a_id, c.id AS c_id FROM sr_a a JOIN sr_b b ON a.b_id = b.id
+  JOIN sr_c c ON b.c_id = c.id
+$$);
+SELECT carbon_explain($$
+  SELECT a.id AS a_id, c.id AS c_id FROM sr_a a JOIN sr_b b ON a.b_id = b.id
+  JOIN sr_c c ON b.c_id = c.id
+$$)->'Carbon'->>'Search Stage' AS stage;
+SELECT carbon_rule_added($$
+  SELECT a.id AS a_id, c.id AS c_id FROM sr_a a JOIN sr_b b ON a.b_id = b.id
+  JOIN sr_c c ON b.c_id = c.id
+$$, 'RuleJoinCommutativity') AS commuted;
+
+-- Stage 1 adds the cheap rewrites
+SET pg_carbon.stage0_cost_limit = 0;
+SELECT carbon_explain($$
+  SELECT a.id AS a_id, c.id AS c_id FROM sr_a a JOIN sr_b b ON a.b_id = b.id
+  JOIN sr_c c ON b.c_id = c.id
+$$)->'Carbon'->>'Search Stage' AS stage;
+SELECT carbon_rule_added($$
+  SELECT a.id AS a_id, c.id AS c_id FROM sr_a a JOIN sr_b b ON a.b_id = b.id
+  JOIN sr_c c ON b.c_id = c.id
+$$, 'RuleJoinCommutativity') AS commuted;
+SELECT carbon_rule_added($$
+  SELECT a.id AS a_id, c.id AS c_id FROM sr_a a JOIN sr_b b ON a.b_id = b.id
+  JOIN sr_c c ON b.c_id = c.id
+$$, 'RuleJoinAssociativity') AS reordered;
+
+-- Stage 2 reorders the joins
+SET pg_carbon.stage1_cost_limit = 0;
+SELECT * FROM carbon_check($$
+  SELECT a.id AS a_id, c.id AS c_id FROM sr_a a JOIN sr_b b ON a.b_id = b.id
+  JOIN sr_c c ON b.c_id = c.id
+$$);
+SELECT carbon_explain($$
+  SELECT a.id AS a_id, c.id AS c_id FROM sr_a a JOIN sr_b b ON a.b_id = b.id
+  JOIN sr_c c ON b.c_id = c.id
+$$)->'Carbon'->>'Search Stage' AS stage;
+SELECT carbon_rule_added($$
+  SELECT a.id AS a_id, c.id AS c_id FROM sr_a a JOIN sr_b b ON a.b_id = b.id
+  JOIN sr_c c ON b.c_id = c.id
+$$, 'RuleJoinAssociativity') AS reordered;
+
+-- A used-up budget stops the search, and the groups still without a plan
+-- get the first one there is
+SET pg_carbon.search_task_budget = 1;
+SELECT * FROM carbon_check($$
+  SELECT a.id, d.val FROM sr_a a JOIN sr_b b ON a.b_id = b.id
+  JOIN sr_c c ON b.c_id = c.id JOIN sr_d d ON c.d_id = d.id
+$$);
+SELECT carbon_explain($$
+  SELECT a.id, d.val FROM sr_a a JOIN sr_b b ON a.b_id = b.id
+  JOIN sr_c c ON b.c_id = c.id JOIN sr_d d ON c.d_id = d.id
+$$)->'Carbon'->>'Budget Exhausted' AS exhausted;
+RESET pg_carbon.search_task_budget;
+
+SET pg_carbon.memo_memory_budget = 1;
+SELECT * FROM carbon_check($$
+  SELECT a.id, d.val FROM sr_a a JOIN sr_b b ON a.b_id = b.id
+  JOIN sr_c c ON b.c_id = c.id JOIN sr_d d ON c.d_id = d.id
+$$);
+SELECT carbon_explain($$
+  SELECT a.id, d.val FROM sr_a a JOIN sr_b b ON a.b_id = b.id
+  JOIN sr_c c ON b.c_id = c.id JOIN sr_d d ON c.d_id = d.id
+$$)->'Carbon'->>'Budget Exhausted' AS exhausted;
+RESET pg_carbon.memo_memory_budget;
+
+-- Without a budget, the search runs to the end
+SET pg_carbon.search_time_budget = 0;
+SELECT carbon_explain($$
+  SELECT a.id, d.val FROM sr_a a JOIN sr_b b ON a.b_id = b.id
+  JOIN sr_c c ON b.c_id = c.id JOIN sr_d d ON c.d_id = d.id
+$$)->'Carbon'->>'Budget Exhausted' AS exhausted;
+RESET pg_carbon.search_time_budget;
+
+DROP TABLE sr_a, sr_b, sr_c, sr_d;
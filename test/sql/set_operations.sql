@@ -0,0 +1,72 @@
+--
+-- UNION, INTERSECT and EXCEPT, and rewrites through UNION ALL
+--
+LOAD 'pg_carbon';
+-- Go through every search stage, however cheap the plans
+SET pg_carbon.stage0_cost_limit = 0;
+SET pg_carbon.stage1_cost_limit = 0;
+
+CREATE TABLE so_a (id int, val int);
+CREATE TABLE so_b (id int, val int);
+INSERT INTO so_a SELECT i, i % 5 FROM generate_series(1, 20) i;
+INSERT INTO so_b SELECT i, i % 4 FROM generate_series(11, 30) i;
+ANALYZE so_a, so_b;
+
+SELECT * FROM carbon_check($$
+  SELECT val FROM so_a UNION ALL SELECT val FROM so_b
+$$);
+SELECT carbon_nodes($$
+  SELECT val FROM so_a UNION ALL SELECT val FROM so_b
+$$) LIKE '%Append%' AS appended;
+SELECT * FROM carbon_check($$
+  SELECT val FROM so_a UNION SELECT val FROM so_b
+$$);
+SELECT carbon_rule_added($$
+  SELECT val FROM so_a UNION SELECT val FROM so_b
+$$, 'RuleUnionToAggregate') AS aggregated;
+
+SELECT * FROM carbon_check($$
+  SELECT id FROM so_a INTERSECT SELECT id FROM so_b
+$$);
+SELECT carbon_nodes($$
+  SELECT id FROM so_a INTERSECT SELECT id FROM so_b
+$$) LIKE '%SetOp%' AS set_op;
+SELECT * FROM carbon_check($$
+  SELECT val FROM so_a INTERSECT ALL SELECT val FROM so_b
+$$);
+SELECT * FROM carbon_check($$
+  SELECT id FROM so_a EXCEPT SELECT id FROM so_b
+$$);
+SELECT * FROM carbon_check($$
+  SELECT val FROM so_a EXCEPT ALL SELECT val FROM so_b
+$$);
+
+-- Nested set operations
+SELECT * FROM carbon_check($$
+  (SELECT val FROM so_a UNION ALL SELECT val FROM so_b)
+  EXCEPT SELECT id FROM so_a
+$$);
+
+-- Filters and limits pushed into the branches of a UNION ALL
+SELECT * FROM carbon_check($$
+  SELECT * FROM (SELECT id, val FROM so_a UNION ALL SELECT id, val FROM so_b) u
+  WHERE u.val = 1
+$$);
+SELECT carbon_rule_added($$
+  SELECT * FROM (SELECT id, val FROM so_a UNION ALL SELECT id, val FROM so_b) u
+  WHERE u.val = 1
+$$, 'RuleFilterPushThroughUnionAll') AS pushed;
+SELECT * FROM carbon_check($$
+  SELECT id FROM so_a UNION ALL SELECT id FROM so_b ORDER BY id LIMIT 5
+$$);
+-- Any five of the rows will do, and they are all the same
+SELECT * FROM carbon_check($$
+  SELECT val FROM so_a WHERE val = 1
+  UNION ALL SELECT val FROM so_b WHERE val = 1 LIMIT 5
+$$);
+SELECT carbon_rule_added($$
+  SELECT val FROM so_a WHERE val = 1
+  UNION ALL SELECT val FROM so_b WHERE val = 1 LIMIT 5
+$$, 'RuleLimitPushThroughUnionAll') AS pushed;
+
+DROP TABLE so_a, so_b;
@@ -0,0 +1,51 @@
+--
+-- Shadow mode, which needs pg_carbon in shared_preload_libraries and
+-- compute_query_id on (see pg_carbon.conf)
+--
+CREATE TABLE sh_a (id int PRIMARY KEY, b_id int);
+CREATE TABLE sh_b (id int PRIMARY KEY, val int);
+INSERT INTO sh_a SELECT i, i % 10 FROM generate_series(1, 100) i;
+INSERT INTO sh_b SELECT i, i % 3 FROM generate_series(1, 10) i;
+ANALYZE sh_a, sh_b;
+
+-- Every query planned by both planners, and every run timed
+SET pg_carbon.mode = shadow;
+SET pg_carbon.shadow_plan_rate = 1;
+SET pg_carbon.shadow_sample_rate = 1;
+SELECT pg_carbon_shadow_reset() IS NOT NULL AS reset;
+
+-- Planned three times: once for the fingerprint, and twice to run
+SELECT carbon_query_id($$
+  SELECT count(*) FROM sh_a a JOIN sh_b b ON a.b_id = b.id
+$$) AS join_id \gset
+SELECT count(*) FROM sh_a a JOIN sh_b b ON a.b_id = b.id;
+SELECT count(*) FROM sh_a a JOIN sh_b b ON a.b_id = b.id;
+
+SELECT plans, carbon_failures, regressions <= plans AS regressions,
+       mean_standard_cost > 0 AS standard_cost,
+       mean_carbon_cost > 0 AS carbon_cost,
+       sampled_runs, mean_exec_time >= 0 AS exec_time
+FROM pg_carbon_shadow_stats WHERE queryid = :join_id;
+
+-- The queries run PostgreSQL's plans, so EXPLAIN (CARBON) reports those
+SELECT * FROM carbon_check($$
+  SELECT a.id, b.val FROM sh_a a JOIN sh_b b ON a.b_id = b.id
+$$);
+
+-- A query pg_carbon cannot plan counts as a failure
+SELECT carbon_query_id($$
+  SELECT b.id FROM sh_b b WHERE b.id NOT IN (SELECT b_id FROM sh_a)
+$$) AS not_in_id \gset
+SELECT plans, carbon_failures, mean_carbon_cost IS NULL AS no_carbon_cost
+FROM pg_carbon_shadow_stats WHERE queryid = :not_in_id;
+
+-- With none of the queries sampled, shadow mode plans with PostgreSQL only
+SELECT pg_carbon_shadow_reset() IS NOT NULL AS reset;
+SET pg_carbon.shadow_plan_rate = 0;
+SELECT count(*) FROM sh_a a JOIN sh_b b ON a.b_id = b.id;
+SELECT count(*) FROM pg_carbon_shadow_stats WHERE queryid = :join_id;
+
+RESET pg_carbon.mode;
+RESET pg_carbon.shadow_plan_rate;
+RESET pg_carbon.shadow_sample_rate;
+DROP TABLE sh_a, sh_b;
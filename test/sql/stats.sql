@@ -0,0 +1,54 @@
+--
+-- The statistics views, which need pg_carbon in shared_preload_libraries
+-- and compute_query_id on (see pg_carbon.conf)
+--
+-- Go through every search stage, however cheap the plans
+SET pg_carbon.stage0_cost_limit = 0;
+SET pg_carbon.stage1_cost_limit = 0;
+
+CREATE TABLE st_a (id int PRIMARY KEY, b_id int);
+CREATE TABLE st_b (id int PRIMARY KEY, val int);
+INSERT INTO st_a SELECT i, i % 10 FROM generate_series(1, 100) i;
+INSERT INTO st_b SELECT i, i % 3 FROM generate_series(1, 10) i;
+ANALYZE st_a, st_b;
+
+SELECT pg_carbon_stats_reset() IS NOT NULL AS reset;
+
+-- Planned three times: once for the fingerprint, and twice to run
+SELECT carbon_query_id($$
+  SELECT count(*) FROM st_a a JOIN st_b b ON a.b_id = b.id
+$$) AS join_id \gset
+SELECT count(*) FROM st_a a JOIN st_b b ON a.b_id = b.id;
+SELECT count(*) FROM st_a a JOIN st_b b ON a.b_id = b.id;
+
+SELECT calls, carbon_plans,
+       fallback_unsupported + fallback_no_plan + fallback_not_cheaper +
+           fallback_plan_conversion + fallback_error AS fallbacks,
+       o_group_tasks > 0 AND apply_rule_tasks > 0 AS searched,
+       mean_memo_groups > 0 AS groups,
+       mean_memo_expressions > mean_memo_groups AS expressions,
+       peak_memo_memory > 0 AS memory,
+       budget_exhausted, max_stage,
+       total_time >= max_time AND max_time >= mean_time AS times
+FROM pg_carbon_stats WHERE queryid = :join_id;
+
+SELECT rule, fires >= successes AS counted
+FROM pg_carbon_rule_stats
+WHERE queryid = :join_id AND rule IN ('RuleJoinCommutativity',
+                                      'RuleJoinToHashJoin')
+ORDER BY rule;
+
+-- Queries pg_carbon does not plan are counted as fallbacks
+SELECT carbon_query_id($$
+  SELECT b.id FROM st_b b WHERE b.id NOT IN (SELECT b_id FROM st_a)
+$$) AS not_in_id \gset
+SELECT b.id FROM st_b b WHERE b.id NOT IN (SELECT b_id FROM st_a);
+
+SELECT calls, carbon_plans, fallback_unsupported
+FROM pg_carbon_stats WHERE queryid = :not_in_id;
+
+-- Nothing is left after a reset
+SELECT pg_carbon_stats_reset() IS NOT NULL AS reset;
+SELECT count(*) FROM pg_carbon_stats WHERE queryid = :join_id;
+
+DROP TABLE st_a, st_b;
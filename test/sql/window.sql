@@ -0,0 +1,60 @@
+--
+-- Window functions, and incremental sorts over presorted inputs
+--
+LOAD 'pg_carbon';
+-- Go through every search stage, however cheap the plans
+SET pg_carbon.stage0_cost_limit = 0;
+SET pg_carbon.stage1_cost_limit = 0;
+
+CREATE TABLE wn (id int PRIMARY KEY, grp int, val int);
+INSERT INTO wn SELECT i, i % 4, i * 37 % 101 FROM generate_series(1, 200) i;
+ANALYZE wn;
+
+SELECT * FROM carbon_check($$
+  SELECT id, grp, row_number() OVER (PARTITION BY grp ORDER BY val, id)
+  FROM wn
+$$);
+SELECT carbon_nodes($$
+  SELECT id, grp, row_number() OVER (PARTITION BY grp ORDER BY val, id)
+  FROM wn
+$$) LIKE '%WindowAgg%' AS window_agg;
+
+-- A moving frame
+SELECT * FROM carbon_check($$
+  SELECT id,
+         sum(val) OVER (ORDER BY id ROWS BETWEEN 2 PRECEDING AND CURRENT ROW)
+  FROM wn
+$$);
+
+-- Two windows, one sorted and one not
+SELECT * FROM carbon_check($$
+  SELECT id, rank() OVER (PARTITION BY grp ORDER BY val),
+         count(*) OVER (PARTITION BY grp)
+  FROM wn
+$$);
+
+-- A window over the groups of an aggregation
+SELECT * FROM carbon_check($$
+  SELECT grp, sum(val), rank() OVER (ORDER BY sum(val)) FROM wn GROUP BY grp
+$$);
+
+-- Rows in index order only need sorting within each value of the index key.
+-- The selected columns are the sort keys, so that ties at the limit do not
+-- change the result.
+CREATE TABLE wn_sorted (a int, b int, c int);
+INSERT INTO wn_sorted
+  SELECT i / 100, i % 97, i FROM generate_series(1, 10000) i;
+CREATE INDEX ON wn_sorted (a);
+ANALYZE wn_sorted;
+
+SELECT * FROM carbon_check($$
+  SELECT a, b FROM wn_sorted ORDER BY a, b LIMIT 10
+$$);
+SELECT carbon_rule_added($$
+  SELECT a, b FROM wn_sorted ORDER BY a, b LIMIT 10
+$$, 'RuleSortToIncrementalSort') AS incremental;
+SELECT * FROM carbon_check($$
+  SELECT a, b, c FROM wn_sorted WHERE a < 3 ORDER BY a, b, c
+$$);
+
+DROP TABLE wn, wn_sorted;
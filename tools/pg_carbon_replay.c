@@ -0,0 +1,97 @@
+// pg_carbon_replay: replays pg_carbon dumps (pg_carbon.dump_directory)
+// without a running server. It starts a single-user backend on a data
+// directory no server is using, such as a scratch cluster made with initdb,
+// installs pg_carbon in the database if needed and runs pg_carbon_replay()
+// on each dump. The dumps carry the metadata of their tables, so the
+// tables do not have to exist.
+
+#include "single_user.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void usage(const char *progname) {
+  printf("%s replays pg_carbon dumps in a single-user backend.\n\n"
+         "Usage:\n"
+         "  %s -D DATADIR [OPTION]... DUMP...\n\n"
+         "Options:\n"
+         "  -D, --pgdata=DATADIR      data directory no server is running on\n"
+         "  -d, --dbname=DBNAME       database to replay in (default "
+         "\"postgres\")\n"
+         "  -n, --iterations=N        runs per dump (default 1)\n"
+         "  -c, --current-settings    plan with the database's settings "
+         "instead\n"
+         "                            of the dumped ones\n"
+         "  -?, --help                show this help, then exit\n",
+         progname, progname);
+}
+
+int main(int argc, char **argv) {
+  static const struct option long_options[] = {
+      {"pgdata", required_argument, NULL, 'D'},
+      {"dbname", required_argument, NULL, 'd'},
+      {"iterations", required_argument, NULL, 'n'},
+      {"current-settings", no_argument, NULL, 'c'},
+      {NULL, 0, NULL, 0}};
+  const char *progname = argv[0];
+  const char *datadir = NULL;
+  const char *dbname = "postgres";
+  int iterations = 1;
+  bool dump_settings = true;
+  int c;
+
+  if (argc > 1 &&
+      (strcmp(argv[1], "--help") == 0 || strcmp(argv[1], "-?") == 0)) {
+    usage(progname);
+    exit(0);
+  }
+  while ((c = getopt_long(argc, argv, "D:d:n:c", long_options, NULL)) != -1) {
+    switch (c) {
+    case 'D':
+      datadir = optarg;
+      break;
+    case 'd':
+      dbname = optarg;
+      break;
+    case 'n':
+      iterations = atoi(optarg);
+      break;
+    case 'c':
+      dump_settings = false;
+      break;
+    default:
+      fprintf(stderr, "Try \"%s --help\" for more information.\n",
+              progname);
+      exit(1);
+    }
+  }
+  if (!datadir || optind >= argc || iterations < 1) {
+    fprintf(stderr, "%s: a data directory and at least one dump are "
+                    "required, and iterations must be at least 1\n",
+            progname);
+    fprintf(stderr, "Try \"%s --help\" for more information.\n", progname);
+    exit(1);
+  }
+
+  pid_t pid;
+  FILE *backend = single_user_start(progname, datadir, dbname, false, &pid);
+  fprintf(backend, "CREATE EXTENSION IF NOT EXISTS pg_carbon;\n\n");
+  for (int i = optind; i < argc; i++) {
+    // The backend runs in the data directory.
+    char path[PATH_MAX];
+    if (!realpath(argv[i], path)) {
+      fprintf(stderr, "%s: could not find dump \"%s\": %s\n", progname,
+              argv[i], strerror(errno));
+      continue;
+    }
+    fprintf(backend, "SELECT * FROM pg_carbon_replay(");
+    single_user_literal(backend, path);
+    fprintf(backend, ", %d, %s);\n\n", iterations,
+            dump_settings ? "true" : "false");
+  }
+  return single_user_finish(progname, backend, pid);
+}
@@ -0,0 +1,64 @@
+#include "single_user.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+FILE *single_user_start(const char *progname, const char *datadir,
+                        const char *dbname, bool output_to_stderr,
+                        pid_t *pid) {
+  int fds[2];
+  if (pipe(fds) != 0) {
+    fprintf(stderr, "%s: could not create pipe: %s\n", progname,
+            strerror(errno));
+    exit(1);
+  }
+  *pid = fork();
+  if (*pid < 0) {
+    fprintf(stderr, "%s: could not fork: %s\n", progname, strerror(errno));
+    exit(1);
+  }
+  if (*pid == 0) {
+    // -j: statements end with a semicolon and an empty line
+    dup2(fds[0], STDIN_FILENO);
+    if (output_to_stderr)
+      dup2(STDERR_FILENO, STDOUT_FILENO);
+    close(fds[0]);
+    close(fds[1]);
+    execl(PG_BINDIR "/postgres", "postgres", "--single", "-j", "-D", datadir,
+          dbname, (char *)NULL);
+    fprintf(stderr, "%s: could not run %s/postgres: %s\n", progname,
+            PG_BINDIR, strerror(errno));
+    _exit(1);
+  }
+
+  // A backend that failed to start shows in its exit status.
+  signal(SIGPIPE, SIG_IGN);
+  close(fds[0]);
+  return fdopen(fds[1], "w");
+}
+
+int single_user_finish(const char *progname, FILE *backend, pid_t pid) {
+  int status;
+
+  fclose(backend);
+  if (waitpid(pid, &status, 0) < 0) {
+    fprintf(stderr, "%s: could not wait for the backend: %s\n", progname,
+            strerror(errno));
+    exit(1);
+  }
+  return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
+
+void single_user_literal(FILE *out, const char *str) {
+  fputc('\'', out);
+  for (const char *c = str; *c; c++) {
+    if (*c == '\'')
+      fputc('\'', out);
+    fputc(*c, out);
+  }
+  fputc('\'', out);
+}
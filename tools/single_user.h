@@ -0,0 +1,29 @@
+#ifndef PG_CARBON_SINGLE_USER_H
+#define PG_CARBON_SINGLE_USER_H
+
+// Runs statements in a single-user backend (postgres --single), for the
+// command-line tools that drive pg_carbon without a server.
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+#ifndef PG_BINDIR
+#error PG_BINDIR must be set to the directory of the postgres binary
+#endif
+
+// Starts a backend on `datadir`, which no server may be using, connected to
+// `dbname`. Statements written to the returned stream end with a semicolon
+// and an empty line. What the backend prints goes to stderr if
+// `output_to_stderr`, leaving stdout to the tool. Exits on failure.
+FILE *single_user_start(const char *progname, const char *datadir,
+                        const char *dbname, bool output_to_stderr,
+                        pid_t *pid);
+
+// Closes the backend's input and waits for it; returns its exit status
+int single_user_finish(const char *progname, FILE *backend, pid_t pid);
+
+// Writes `str` as an SQL string literal
+void single_user_literal(FILE *out, const char *str);
+
+#endif // PG_CARBON_SINGLE_USER_H